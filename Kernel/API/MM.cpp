@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 29.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -11,12 +11,16 @@
 
 #include <Arch/CPU.hpp>
 
+#include <Memory/MM.hpp>
 #include <Memory/PMM.hpp>
 #include <Memory/VMM.hpp>
 
 #include <Scheduler/Process.hpp>
 #include <Scheduler/Thread.hpp>
 
+#include <VFS/FileDescriptor.hpp>
+#include <VFS/INode.hpp>
+
 #include <Prism/Utility/Math.hpp>
 
 namespace API::MM
@@ -36,99 +40,50 @@ namespace API::MM
     ErrorOr<intptr_t> MMap(Pointer addr, usize length, i32 prot, i32 flags,
                            i32 fdNum, off_t offset)
     {
-        Process*          current   = Process::GetCurrent();
-        Optional<errno_t> errorCode = NullOpt;
+        Process* current = Process::GetCurrent();
 
         if (addr.Raw() & ~Arch::VMM::GetAddressMask()) return MAP_FAILED;
         flags &= ~(MAP_EXECUTABLE | MAP_DENYWRITE);
-        // NOTE(v1tr10l7): Currently we don't support mapping the files
-        if (!(flags & MAP_ANONYMOUS)) return MAP_FAILED;
-
-        // TODO(v1tr10l7): Lazy mapping
-        using VMM::Access;
-        Access access = Access::eUser;
-        if (prot & PROT_READ) access |= Access::eRead;
-        if (prot & PROT_WRITE) access |= Access::eWrite;
-        if (prot & PROT_EXEC) access |= Access::eExecute;
 
+        bool shared = flags & MAP_SHARED;
+        if (!shared && !(flags & MAP_PRIVATE)) return Error(EINVAL);
         if (length == 0) return Error(EINVAL);
+        if (offset < 0 || offset % PMM::PAGE_SIZE) return Error(EINVAL);
+
+        Access access  = Prot2AccessFlags(prot);
         length         = Math::AlignUp(length, PMM::PAGE_SIZE);
         usize pageSize = PMM::PAGE_SIZE;
         if (flags & MAP_HUGE_2MB) pageSize = 2_mib;
         else if (flags & MAP_HUGE_1GB) pageSize = 1_gib;
 
-        Ref<FileDescriptor> fd = nullptr;
-        if (fdNum != -1) fd = current->GetFileHandle(fdNum);
-        if (offset != 0) return Error(EINVAL);
-
-        auto&       addressSpace = current->AddressSpace();
-        Ref<Region> region       = nullptr;
-
-        // TODO(v1tr10l7): File mapping
-        if (fdNum != -1 && !(flags & MAP_ANONYMOUS))
-        {
-            if (!fd)
-            {
-                errorCode = EBADF;
-                goto fail;
-            }
-            region    = addressSpace.AllocateRegion(length);
-            auto virt = region->VirtualBase();
-
-            if (!fd->CanRead())
-            {
-                errorCode = EPERM;
-                goto free_region;
-            }
-
-            region->SetAccessMode(access);
-
-            ErrorOr<isize> sizeOr;
-            if (offset) sizeOr = fd->Seek(SEEK_SET, offset);
-            if (!sizeOr)
-            {
-                errorCode = sizeOr.error();
-                goto free_region;
-            }
-
-            sizeOr = fd->Read(virt, length);
-            if (!sizeOr)
-            {
-                errorCode = sizeOr.error();
-                goto free_region;
-            }
-
-            return virt.Raw();
-        }
-        if (offset)
-        {
-            errorCode = EINVAL;
-            goto fail;
-        }
+        INode* inode = nullptr;
         if (!(flags & MAP_ANONYMOUS))
         {
-            errorCode = ENOSYS;
-            goto fail;
-        }
+            auto fd = current->GetFileHandle(fdNum);
+            if (!fd) return Error(EBADF);
 
-        if (flags & MAP_FIXED)
-            region = addressSpace.AllocateFixed(addr, length);
-        else if (flags & MAP_ANONYMOUS)
-            region = addressSpace.AllocateRegion(length, pageSize);
+            if (!fd->CanRead()) return Error(EACCES);
+            if (shared && prot & PROT_WRITE && !fd->CanWrite())
+                return Error(EACCES);
 
-        // TODO(v1tr10l7): sharring mappings
-        if (flags & MAP_SHARED) {};
+            inode = fd->INode();
+            if (!inode || !inode->IsRegular()) return Error(ENODEV);
+            // File mappings are always made of regular pages
+            pageSize = 0;
+        }
+
+        auto&       addressSpace = current->AddressSpace();
+        Ref<Region> region       = nullptr;
+        if (flags & MAP_FIXED) region = addressSpace.AllocateFixed(addr, length);
+        else region = addressSpace.AllocateRegion(length, pageSize);
+        if (!region) return Error(ENOMEM);
 
-        if (!region) goto fail;
         region->SetAccessMode(access);
+        if (inode) region->SetBacking(inode, offset, shared);
+        else region->SetShared(shared);
 
         Assert(addressSpace.Find(region->VirtualBase()) == region);
         return region->VirtualBase().Raw();
-
-    free_region:
-        addressSpace.Erase(region->VirtualBase());
-    [[maybe_unused]] fail:
-        return Error(errorCode.ValueOr(ENOMEM));
     }
     ErrorOr<isize> MProtect(Pointer virt, usize length, i32 prot)
     {
@@ -158,13 +113,43 @@ namespace API::MM
         auto& addressSpace = process->AddressSpace();
         if (!addressSpace.Contains(virt)) return Error(EINVAL);
 
-        auto        region    = addressSpace[virt];
+        auto region = addressSpace[virt];
+        RetOnError(::MM::SyncRegion(nullptr, region));
 
-        const auto  phys      = region->PhysicalBase();
-        const usize pageCount = region->Size() / PMM::PAGE_SIZE;
-        PMM::FreePages(phys, pageCount);
+        process->PageMap->UnmapRegion(region);
+        region->FreePhysicalMemory();
 
         addressSpace.Erase(virt);
         return 0;
     }
+    ErrorOr<isize> MSync(Pointer virt, usize length, i32 flags)
+    {
+        if (virt.Raw() % PMM::PAGE_SIZE) return Error(EINVAL);
+        if (flags & ~(MS_ASYNC | MS_INVALIDATE | MS_SYNC)) return Error(EINVAL);
+        if (flags & MS_ASYNC && flags & MS_SYNC) return Error(EINVAL);
+
+        auto  process      = Process::GetCurrent();
+        auto& addressSpace = process->AddressSpace();
+        auto  end = virt.Offset<Pointer>(Math::AlignUp(length, PMM::PAGE_SIZE));
+
+        // Without background writeback of mappings, MS_ASYNC writes back right
+        // away
+        for (Pointer current = virt; current < end;)
+        {
+            auto region = addressSpace.Find(current);
+            if (!region) return Error(ENOMEM);
+
+            Pointer regionEnd = Math::Min(end.Raw(), region->End().Raw());
+            usize   firstPage
+                = (current.Raw() - region->VirtualBase().Raw()) / PMM::PAGE_SIZE;
+            usize pageCount = (regionEnd.Raw() - current.Raw()) / PMM::PAGE_SIZE;
+
+            auto status = ::MM::SyncRegion(process->PageMap, region, firstPage,
+                                           pageCount);
+            RetOnError(status);
+            current = regionEnd;
+        }
+
+        return 0;
+    }
 } // namespace API::MM
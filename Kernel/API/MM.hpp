@@ -15,4 +15,5 @@ namespace API::MM
                            i32 fdNum, off_t offset);
     ErrorOr<isize>    MProtect(Pointer virt, usize length, i32 prot);
     ErrorOr<isize>    MUnMap(Pointer virt, usize length);
+    ErrorOr<isize>    MSync(Pointer virt, usize length, i32 flags);
 } // namespace API::MM
@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 19.12.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -12,12 +12,12 @@ constexpr usize O_RDONLY    = 0x0000;
 constexpr usize O_WRONLY    = 0x0001;
 constexpr usize O_RDWR      = 0x0002;
 
-constexpr usize O_CREAT     = 0x0100;
-constexpr usize O_EXCL      = 0x0200;
-constexpr usize O_NOCTTY    = 0x0400;
-constexpr usize O_TRUNC     = 0x1000;
-constexpr usize O_APPEND    = 0x2000;
-constexpr usize O_NONBLOCK  = 0x4000;
+constexpr usize O_CREAT     = 0100;
+constexpr usize O_EXCL      = 0200;
+constexpr usize O_NOCTTY    = 0400;
+constexpr usize O_TRUNC     = 01000;
+constexpr usize O_APPEND    = 02000;
+constexpr usize O_NONBLOCK  = 04000;
 constexpr usize O_NDELAY    = O_NONBLOCK;
 constexpr usize O_DSYNC     = 010000;
 constexpr usize O_ASYNC     = 020000;
@@ -53,6 +53,13 @@ constexpr usize F_GETFL             = 3;
 constexpr usize F_SETFL             = 4;
 constexpr usize F_DUPFD_CLOEXEC     = 1030;
 
+constexpr isize POSIX_FADV_NORMAL     = 0;
+constexpr isize POSIX_FADV_RANDOM     = 1;
+constexpr isize POSIX_FADV_SEQUENTIAL = 2;
+constexpr isize POSIX_FADV_WILLNEED   = 3;
+constexpr isize POSIX_FADV_DONTNEED   = 4;
+constexpr isize POSIX_FADV_NOREUSE    = 5;
+
 constexpr usize R_OK                = 4; /* Test for read permission.  */
 constexpr usize W_OK                = 2; /* Test for write permission.  */
 constexpr usize X_OK                = 1; /* Test for execute permission.  */
@@ -138,6 +138,11 @@ constexpr usize CLONE_ARGS_SIZE_VER1      = 80;
 /* sizeof third published struct */
 constexpr usize CLONE_ARGS_SIZE_VER2      = 88;
 
+struct sched_param
+{
+    i32 sched_priority;
+};
+
 /*
  * Scheduling policies
  */
@@ -58,3 +58,7 @@ constexpr usize RLIMIT_RTTIME     = 15;
 constexpr usize RLIM_NLIMITS      = 16;
 
 constexpr usize RLIM_INFINITY     = usize(~0ul);
+
+constexpr usize PRIO_PROCESS      = 0;
+constexpr usize PRIO_PGRP         = 1;
+constexpr usize PRIO_USER         = 2;
@@ -1,10 +1,12 @@
 /*
  * Created by v1tr10l7 on 02.12.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
+#include <API/Posix/linux/sched.h>
 #include <API/Posix/sys/mman.h>
+#include <API/Posix/sys/resource.h>
 #include <API/Posix/sys/wait.h>
 #include <API/Process.hpp>
 #include <Arch/InterruptGuard.hpp>
@@ -241,6 +243,97 @@ namespace API::Process
         return process->SetResGID(rgid, egid, sgid);
     }
 
+    namespace
+    {
+        // Only root, or the owner of the target may change its scheduling
+        bool CanReschedule(class Process* current, class Process* target)
+        {
+            if (current->IsSuperUser()) return true;
+
+            auto euid = current->Credentials().EffectiveUserID;
+            return euid == target->Credentials().UserID
+                || euid == target->Credentials().EffectiveUserID;
+        }
+    }; // namespace
+
+    ErrorOr<isize> GetPriority(isize which, isize who)
+    {
+        if (which != PRIO_PROCESS) return Error(EINVAL);
+
+        class Process* process
+            = who ? Scheduler::GetProcess(who) : ::Process::Current();
+        if (!process || !process->MainThread()) return Error(ESRCH);
+
+        // The raw syscall returns 20 - nice, libc converts it back
+        return 20 - process->MainThread()->Scheduling().Nice;
+    }
+    ErrorOr<isize> SetPriority(isize which, isize who, isize niceValue)
+    {
+        if (which != PRIO_PROCESS) return Error(EINVAL);
+
+        class Process* current = ::Process::Current();
+        class Process* process = who ? Scheduler::GetProcess(who) : current;
+        if (!process) return Error(ESRCH);
+        if (!CanReschedule(current, process)) return Error(EPERM);
+
+        if (niceValue < MIN_NICE) niceValue = MIN_NICE;
+        else if (niceValue > MAX_NICE) niceValue = MAX_NICE;
+
+        // All of the threads are checked up front, so that the new nice value
+        // is applied either to all of them, or to none
+        for (const auto& thread : process->Threads())
+            if (niceValue < thread->Scheduling().Nice
+                && !current->IsSuperUser())
+                return Error(EACCES);
+
+        for (const auto& thread : process->Threads())
+        {
+            auto& entity = thread->Scheduling();
+            RetOnError(Scheduler::SetSchedulingPolicy(
+                thread.Raw(), entity.Policy, niceValue,
+                entity.RealTimePriority));
+        }
+
+        return 0;
+    }
+
+    ErrorOr<isize> SchedSetScheduler(pid_t pid, isize policy,
+                                     const sched_param* param)
+    {
+        class Process* current = ::Process::Current();
+        class Process* process = pid ? Scheduler::GetProcess(pid) : current;
+        if (!process || !process->MainThread()) return Error(ESRCH);
+        if (!param || !current->ValidateRead(param)) return Error(EFAULT);
+        if (!CanReschedule(current, process)) return Error(EPERM);
+
+        policy &= ~SCHED_RESET_ON_FORK;
+        if (policy != SCHED_NORMAL && policy != SCHED_FIFO
+            && policy != SCHED_RR && policy != SCHED_BATCH
+            && policy != SCHED_IDLE)
+            return Error(EINVAL);
+
+        auto schedulingPolicy = static_cast<SchedulingPolicy>(policy);
+        if (IsRealTimePolicy(schedulingPolicy) && !current->IsSuperUser())
+            return Error(EPERM);
+
+        i32 priority = CPU::CopyFromUser(param->sched_priority);
+        if (priority < 0 || priority > MAX_REAL_TIME_PRIORITY)
+            return Error(EINVAL);
+
+        Thread* thread = process->MainThread().Raw();
+        RetOnError(Scheduler::SetSchedulingPolicy(
+            thread, schedulingPolicy, thread->Scheduling().Nice, priority));
+        return 0;
+    }
+    ErrorOr<isize> SchedGetScheduler(pid_t pid)
+    {
+        class Process* process
+            = pid ? Scheduler::GetProcess(pid) : ::Process::Current();
+        if (!process || !process->MainThread()) return Error(ESRCH);
+
+        return ToUnderlying(process->MainThread()->Scheduling().Policy);
+    }
+
     ErrorOr<pid_t> GetPGid(pid_t pid)
     {
         // FIXME(v1tr10l7): validate whether pid is a child of the calling
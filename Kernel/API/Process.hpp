@@ -12,6 +12,7 @@
 
 struct timespec;
 struct rusage;
+struct sched_param;
 namespace API::Process
 {
     ErrorOr<isize>  SigProcMask(i32 how, const sigset_t* newSet,
@@ -48,6 +49,13 @@ namespace API::Process
     ErrorOr<isize>  SetResUid(uid_t ruid, uid_t euid, uid_t suid);
     ErrorOr<isize>  SetResGid(gid_t rgid, gid_t egid, gid_t sgid);
 
+    ErrorOr<isize>  GetPriority(isize which, isize who);
+    ErrorOr<isize>  SetPriority(isize which, isize who, isize niceValue);
+
+    ErrorOr<isize>  SchedSetScheduler(pid_t pid, isize policy,
+                                      const sched_param* param);
+    ErrorOr<isize>  SchedGetScheduler(pid_t pid);
+
     ErrorOr<pid_t>  GetPGid(pid_t pid);
     ErrorOr<pid_t>  GetSid(pid_t pid);
 } // namespace API::Process
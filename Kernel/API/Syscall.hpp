@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 25.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -28,6 +28,14 @@ namespace Syscall
         using Type          = Ret(Args...);
         using ArgsContainer = std::tuple<Args...>;
         using RetType       = Ret;
+
+        // Whether converting the arguments has to read the user memory
+        static constexpr bool ReadsUserMemory
+            = (IsSameV<RemoveCvRefType<Args>, Prism::PathView> || ...);
+    };
+    template <typename Ret, typename... Args>
+    struct Signature<Ret (*)(Args...)> : Signature<Ret(Args...)>
+    {
     };
 
     struct NullableString
@@ -70,55 +78,6 @@ namespace Syscall
         else return static_cast<T>(value);
     }
 
-    class WrapperBase
-    {
-      public:
-        virtual ~WrapperBase()                                       = default;
-        virtual ErrorOr<upointer> Run(Array<upointer, 6> args) const = 0;
-    };
-    template <typename Func>
-    class Wrapper : public WrapperBase
-    {
-      public:
-        using Sign = Signature<RemoveCvRefType<Func>>;
-
-        constexpr Wrapper(const char* name, Func* func)
-            : Function(func)
-            , Name(name)
-        {
-        }
-
-        ErrorOr<upointer> Run(Array<upointer, 6> arr) const
-        {
-            typename Sign::ArgsContainer args;
-            usize                        i = 0;
-
-            // Convert array to actual function arguments
-
-            {
-                CPU::UserMemoryProtectionGuard guard;
-                std::apply(
-                    [&](auto&&... args)
-                    {
-                        (std::invoke([&]<typename T>(T& arg)
-                                     { arg = ConvertArgument<T>(arr[i++]); },
-                                     args),
-                         ...);
-                    },
-                    args);
-            }
-            errno    = no_error;
-            auto ret = std::apply(Function, args);
-            if (!ret) return Error(ret.error());
-
-            return ret;
-        }
-
-      private:
-        Func*       Function;
-        const char* Name;
-    };
-
     struct Arguments
     {
         u64      Index;
@@ -133,6 +92,54 @@ namespace Syscall
         }
     };
 
+    /**
+     * @brief Converts the raw arguments to the parameters of `Function`, and
+     * calls it
+     */
+    template <auto Function>
+    ErrorOr<upointer> Invoke(const Arguments& raw)
+    {
+        using Sign = Signature<decltype(Function)>;
+        typename Sign::ArgsContainer args;
+
+        auto                         convert = [&]()
+        {
+            usize i = 0;
+            std::apply(
+                [&](auto&&... args)
+                {
+                    (std::invoke([&]<typename T>(T& arg)
+                                 { arg = ConvertArgument<T>(raw.Args[i++]); },
+                                 args),
+                     ...);
+                },
+                args);
+        };
+
+        // Only syscalls taking paths pay for toggling the user memory
+        // protection
+        if constexpr (Sign::ReadsUserMemory)
+        {
+            CPU::UserMemoryProtectionGuard guard;
+            convert();
+        }
+        else convert();
+
+        errno    = no_error;
+        auto ret = std::apply(Function, args);
+        if (!ret) return Error(ret.error());
+
+        return ret;
+    }
+
+    using Handler = ErrorOr<upointer> (*)(const Arguments&);
+    struct Entry
+    {
+        Handler     Function = nullptr;
+        const char* Name     = nullptr;
+    };
+    constexpr usize MAX_SYSCALL = 512;
+
     enum class ID : u64
     {
         eRead             = 0,
@@ -154,6 +161,7 @@ namespace Syscall
         eAccess           = 21,
         ePipe             = 22,
         eSchedYield       = 24,
+        eMSync            = 26,
         eDup              = 32,
         eDup2             = 33,
         eNanoSleep        = 35,
@@ -165,6 +173,8 @@ namespace Syscall
         eKill             = 62,
         eUname            = 63,
         eFCntl            = 72,
+        eFSync            = 74,
+        eFDataSync        = 75,
         eTruncate         = 76,
         eFTruncate        = 77,
         eGetCwd           = 79,
@@ -205,6 +215,10 @@ namespace Syscall
         eSid              = 124,
         eUTime            = 132,
         eStatFs           = 137,
+        eGetPriority      = 140,
+        eSetPriority      = 141,
+        eSchedSetSched    = 144,
+        eSchedGetSched    = 145,
         eArchPrCtl        = 158,
         eSync             = 162,
         eSetTimeOfDay     = 164,
@@ -212,7 +226,9 @@ namespace Syscall
         eUMount           = 166,
         eReboot           = 169,
         eGetTid           = 186,
+        eReadAhead        = 187,
         eGetDents64       = 217,
+        eFAdvise64        = 221,
         eClockGetTime     = 228,
         eClockNanoSleep   = 230,
         ePanic            = 255,
@@ -234,11 +250,8 @@ namespace Syscall
     };
 
     StringView GetName(usize index);
-    void       RegisterHandler(usize                                        index,
-                               std::function<ErrorOr<upointer>(Arguments&)> handler,
-                               String                                       name);
 #define RegisterSyscall(id, handler)                                           \
-    s_Syscalls[id] = new Wrapper<decltype(handler)>(#handler, handler);
+    Entries[static_cast<usize>(id)] = {Invoke<handler>, #handler};
 
     void InstallAll();
     void Handle(Arguments& args);
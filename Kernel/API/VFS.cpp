@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 25.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -18,11 +18,14 @@
 
 #include <Arch/CPU.hpp>
 
+#include <Memory/PMM.hpp>
+
 #include <Scheduler/Process.hpp>
 #include <Scheduler/Thread.hpp>
 
 #include <Prism/Memory/Scope.hpp>
 #include <Prism/String/StringUtils.hpp>
+#include <Prism/Utility/Math.hpp>
 #include <Prism/Utility/Path.hpp>
 #include <Time/Time.hpp>
 
@@ -30,7 +33,9 @@
 #include <VFS/Filesystem.hpp>
 #include <VFS/INode.hpp>
 #include <VFS/MountPoint.hpp>
+#include <VFS/PathCache.hpp>
 #include <VFS/PathResolver.hpp>
+#include <VFS/Readahead.hpp>
 #include <VFS/VFS.hpp>
 
 namespace API::VFS
@@ -303,6 +308,87 @@ namespace API::VFS
         return 0;
     }
 
+    ErrorOr<isize> FSync(isize fdNum)
+    {
+        auto process = Process::Current();
+        auto fd      = TryOrRet(process->GetFileDescriptor(fdNum));
+        auto inode   = fd->INode();
+        if (!inode) return Error(EINVAL);
+
+        RetOnError(inode->Sync());
+        return 0;
+    }
+    ErrorOr<isize> FDataSync(isize fdNum)
+    {
+        auto process = Process::Current();
+        auto fd      = TryOrRet(process->GetFileDescriptor(fdNum));
+        auto inode   = fd->INode();
+        if (!inode) return Error(EINVAL);
+
+        RetOnError(inode->Sync(true));
+        return 0;
+    }
+    ErrorOr<isize> ReadAhead(isize fdNum, off_t offset, usize count)
+    {
+        auto process = Process::Current();
+        auto fd      = TryOrRet(process->GetFileDescriptor(fdNum));
+        if (!fd->CanRead()) return Error(EBADF);
+
+        auto inode = fd->INode();
+        if (!inode || !inode->IsRegular() || offset < 0) return Error(EINVAL);
+
+        // Filesystems outside the page cache have nothing to read ahead into
+        usize size = inode->Size();
+        if (count == 0 || !inode->UsesPageCache() || usize(offset) >= size)
+            return 0;
+        count       = Math::Min(count, size - offset);
+
+        usize first = offset / PMM::PAGE_SIZE;
+        usize last  = (offset + count - 1) / PMM::PAGE_SIZE;
+        inode->Prefetch(first, last - first + 1);
+        return 0;
+    }
+    ErrorOr<isize> FAdvise64(isize fdNum, off_t offset, off_t length,
+                             isize advice)
+    {
+        auto process = Process::Current();
+        auto fd      = TryOrRet(process->GetFileDescriptor(fdNum));
+        if (fd->IsFifo()) return Error(ESPIPE);
+        if (offset < 0 || length < 0) return Error(EINVAL);
+
+        auto  inode = fd->INode();
+        usize first = offset / PMM::PAGE_SIZE;
+        // A length of 0 covers everything up to the end of the file, the sum
+        // of two off_ts always fits in a usize
+        usize end   = usize(offset) + usize(length);
+        usize count = length == 0 ? usize(-1) - first
+                                  : (end - 1) / PMM::PAGE_SIZE + 1 - first;
+
+        switch (advice)
+        {
+            case POSIX_FADV_NORMAL:
+                fd->SetReadaheadAdvice(ReadaheadAdvice::eNormal);
+                break;
+            case POSIX_FADV_RANDOM:
+                fd->SetReadaheadAdvice(ReadaheadAdvice::eRandom);
+                break;
+            case POSIX_FADV_SEQUENTIAL:
+                fd->SetReadaheadAdvice(ReadaheadAdvice::eSequential);
+                break;
+            case POSIX_FADV_WILLNEED:
+                if (inode && inode->UsesPageCache())
+                    Readahead::Submit(inode, first, count);
+                break;
+            case POSIX_FADV_DONTNEED:
+                if (inode) inode->CachedPages().Drop(first, count);
+                break;
+            case POSIX_FADV_NOREUSE: break;
+
+            default: return Error(EINVAL);
+        }
+
+        return 0;
+    }
     ErrorOr<isize> Truncate(PathView path, off_t length)
     {
         Process* current = Process::Current();
@@ -327,7 +413,10 @@ namespace API::VFS
         auto status = inode->CheckPermissions(W_OK);
         RetOnError(status);
 
-        return inode->Truncate(length);
+        auto result = inode->Truncate(length);
+        if (result) inode->CachedPages().Truncate(length);
+
+        return result;
     }
     ErrorOr<isize> FTruncate(isize fdNum, off_t length)
     {
@@ -435,6 +524,9 @@ namespace API::VFS
         RetOnError(parentINode->RmDir(entry));
         LogDebug("VFS::RmDir: Successfully removed directory");
 
+        parentEntry->RemoveChild(entry);
+        PathCache::Invalidate();
+
         return 0;
     }
     ErrorOr<isize> Creat(const char* pathname, mode_t mode)
@@ -473,7 +565,7 @@ namespace API::VFS
 
     ErrorOr<isize> SyncFilesystems()
     {
-        VFS::Sync();
+        VFS::Sync(true);
         return 0;
     }
     ErrorOr<isize> Mount(const char* pathname, const char* targetPath,
@@ -500,9 +592,11 @@ namespace API::VFS
         String fsType = CPU::CopyStringFromUser(filesystemType).StrView();
         if (fsType.Empty()) return ErrorCode(ENODEV);
 
-        Scope<u8[]> options = new u8[CPU::CopyStringFromUser(
-                                         reinterpret_cast<const char*>(data))
-                                         .Size()];
+        // Options are passed on as a comma separated string, e.g. "noatime"
+        String options;
+        if (data)
+            options = CPU::CopyStringFromUser(static_cast<const char*>(data))
+                          .StrView();
 
         LogDebug("VFS: Mounting `{}`({}) at `{}`", source, fsType, target);
         auto mountPoint = TryOrRet(::VFS::Mount(nullptr, source, target, fsType,
@@ -883,7 +977,7 @@ namespace API::VFS
         auto fs      = inode->Filesystem();
         if (!fs) return Error(ENODEV);
 
-        RetOnError(fs->Sync());
+        RetOnError(fs->Sync(true));
         return 0;
     }
     ErrorOr<isize> RenameAt2(isize oldDirFdNum, const char* oldPath,
@@ -916,6 +1010,12 @@ namespace API::VFS
         auto success   = oldParent->Rename(newParent->INode(), newName);
 
         if (!success) return Error(success.Error());
+
+        // Both names have to be looked up again, the new one may be cached as
+        // missing
+        oldPathResolution.Parent->RemoveChild(oldPathResolution.Entry);
+        newParent->RemoveChild(newName);
+        PathCache::Invalidate();
         return 0;
     }
 }; // namespace API::VFS
@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 25.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -38,6 +38,11 @@ namespace API::VFS
     ErrorOr<isize> Dup(isize oldFdNum);
     ErrorOr<isize> Dup2(isize oldFdNum, isize newFdNum);
     ErrorOr<isize> FCntl(isize fdNum, isize op, pointer arg);
+    ErrorOr<isize> FSync(isize fdNum);
+    ErrorOr<isize> FDataSync(isize fdNum);
+    ErrorOr<isize> ReadAhead(isize fdNum, off_t offset, usize count);
+    ErrorOr<isize> FAdvise64(isize fdNum, off_t offset, off_t length,
+                             isize advice);
 
     ErrorOr<isize> Truncate(PathView path, off_t length);
     ErrorOr<isize> FTruncate(isize fdNum, off_t length);
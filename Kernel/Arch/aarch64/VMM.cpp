@@ -347,5 +347,12 @@ bool PageMap::SetFlags(Pointer virt, PageAttributes flags)
     pmlEntry->Clear();
     pmlEntry->SetAddress(addr);
     pmlEntry->SetFlags(nativeFlags, true);
+
+    usize page = virt.Raw() >> 12ul;
+    __asm__ volatile(
+        "dsb st; \n\t"
+        "tlbi vale1, %0;\n\t"
+        "dsb sy; isb" ::"r"(page)
+        : "memory");
     return true;
 }
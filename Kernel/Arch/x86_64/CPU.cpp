@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 25.05.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -278,6 +278,7 @@ namespace CPU
                 InitializeCPU(cpu);
 
                 current->IsOnline = true;
+                ++s_OnlineCPUsCount;
                 LogInfo("SMP: CPU {} is up", current->ID);
             }
 
@@ -606,26 +607,13 @@ namespace CPU
     UserMemoryProtectionGuard::UserMemoryProtectionGuard() { Stac(); }
     UserMemoryProtectionGuard::~UserMemoryProtectionGuard() { Clac(); }
 
-    bool DuringSyscall()
-    {
-        auto       cpu = GetCurrent();
-        ScopedLock guard(*cpu->Lock);
-
-        return cpu->DuringSyscall;
-    }
+    // Only the owning CPU touches the syscall state, so it isn't locked
+    bool DuringSyscall() { return GetCurrent()->DuringSyscall; }
     void OnSyscallEnter(usize index)
     {
-        auto       cpu = GetCurrent();
-        ScopedLock guard(*cpu->Lock);
-
+        auto cpu           = GetCurrent();
         cpu->DuringSyscall = true;
         cpu->LastSyscallID = index;
     }
-    void OnSyscallLeave()
-    {
-        auto       cpu = GetCurrent();
-        ScopedLock guard(*cpu->Lock);
-
-        cpu->DuringSyscall = false;
-    }
+    void OnSyscallLeave() { GetCurrent()->DuringSyscall = false; }
 }; // namespace CPU
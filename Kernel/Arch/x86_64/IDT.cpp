@@ -151,7 +151,7 @@ constexpr usize        PAGE_FAULT_SGX               = Bit(7);
 
 inline PageFaultReason pageFaultReason(u64 errorCode)
 {
-    PageFaultReason reason;
+    PageFaultReason reason = static_cast<PageFaultReason>(0);
     if (!(errorCode & PAGE_FAULT_PRESENT))
         reason |= PageFaultReason::eNotPresent;
     if (errorCode & PAGE_FAULT_WRITE) reason |= PageFaultReason::eWrite;
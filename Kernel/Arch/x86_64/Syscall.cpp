@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 22.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -34,8 +34,8 @@ namespace Syscall
         args.Args[4]          = ctx->r8;
         args.Args[5]          = ctx->r9;
 
-        auto current       = CPU::GetCurrentThread();
-        current->SavedContext = *ctx;
+        // The frame isn't copied, fork reads it in place
+        CPU::GetCurrentThread()->SyscallContext = ctx;
 
         Handle(args);
         ctx->rax = args.ReturnValue;
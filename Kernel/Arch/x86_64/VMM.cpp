@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 25.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -184,6 +184,14 @@ Pointer PageMap::Virt2Phys(Pointer virt, PageAttributes flags)
     PageTableEntry* pmlEntry = Virt2Pte(m_TopLevel, virt, false, pageSize);
     if (!pmlEntry || !pmlEntry->GetFlag(PTE_PRESENT)) return u64(-1);
 
+    // The walk stops at larger pages, e.g. within the HHDM
+    if (pageSize < LLPAGE_SIZE
+        && Virt2Pte(m_TopLevel, virt, false, LLPAGE_SIZE) == pmlEntry)
+        pageSize = LLPAGE_SIZE;
+    else if (pageSize < LPAGE_SIZE
+             && Virt2Pte(m_TopLevel, virt, false, LPAGE_SIZE) == pmlEntry)
+        pageSize = LPAGE_SIZE;
+
     return pmlEntry->Address() + (virt % pageSize);
 }
 
@@ -263,6 +271,9 @@ bool PageMap::SetFlags(Pointer virt, PageAttributes flags)
     pmlEntry->Clear();
     pmlEntry->SetAddress(addr);
     pmlEntry->SetFlags(nativeFlags, true);
+
+    // Stale entries could still grant the permissions we've just taken away
+    __asm__ volatile("invlpg (%0);" ::"r"(virt.Raw()) : "memory");
     return true;
 }
 
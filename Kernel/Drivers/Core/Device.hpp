@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 28.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -85,6 +85,12 @@ class Device : public File
         return Error(ENOSYS);
     }
 
+    /**
+     * @brief Makes everything, that has been written to the device so far,
+     * durable
+     */
+    virtual ErrorOr<void> Sync() { return {}; }
+
     virtual i32 IoCtl(usize request, uintptr_t argp) { return -1; };
 
     static void Initialize();
@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 24.01.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -77,7 +77,8 @@ namespace PCI
                     MsiXAddress table(ReadAt(capability.Offset + 0x04, 4));
                     MsiXAddress pending(ReadAt(capability.Offset + 0x08, 4));
 
-                    usize       count = control.Irqs;
+                    // The table size is encoded as N - 1
+                    usize       count = control.Irqs + 1;
                     m_MsixMessages    = count;
                     m_MsixIrqs.Allocate(count);
 
@@ -323,8 +324,44 @@ namespace PCI
     }
     bool Device::MsiXSet(u64 cpuid, u16 vector, u16 index)
     {
-        // TODO(v1tr10l7): MsiX
-        return false;
+        if (!m_MsixSupported) return false;
+
+        if (index == u16(-1)) index = 0;
+        if (index >= m_MsixMessages) return false;
+
+        ScopedLock guard(m_Lock, true);
+        if (!m_MsixTable)
+        {
+            Bar bar = GetBar(m_MsixTableBar);
+            if (!bar || !bar.IsMMIO) return false;
+
+            m_MsixTable = bar.Map(0).Offset<Pointer>(m_MsixTableOffset);
+        }
+
+        MsiData    data{};
+        MsiAddress address{};
+        data.Vector           = vector;
+        data.DeliveryMode     = 0;
+
+        address.BaseAddress   = 0xfee;
+        address.DestinationID = cpuid;
+
+        auto entry         = m_MsixTable.As<volatile MsiXEntry>() + index;
+        entry->AddressLow  = *reinterpret_cast<u32*>(&address);
+        entry->AddressHigh = 0;
+        entry->Data        = *reinterpret_cast<u32*>(&data);
+        // Unmasks the vector
+        entry->Control     = 0;
+
+        MsiXControl control;
+        u16*        dest = reinterpret_cast<u16*>(&control);
+        *dest            = ReadAt(m_MsixOffset + 0x02, 2);
+        control.Enable   = 1;
+        control.Mask     = 0;
+        WriteAt(m_MsixOffset + 0x02, *dest, 2);
+
+        m_MsixIrqs.SetIndex(index, true);
+        return true;
     }
 
     u32 Device::ReadAt(u32 offset, i32 accessSize) const
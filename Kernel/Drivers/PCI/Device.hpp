@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 24.01.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -152,6 +152,11 @@ namespace PCI
 
         bool RegisterIrq(u64 cpuid, Delegate<void()> handler);
 
+        inline usize GetMsiXVectorCount() const
+        {
+            return m_MsixSupported ? m_MsixMessages : 0;
+        }
+
       protected:
         friend struct Capability;
 
@@ -168,6 +173,8 @@ namespace PCI
         Bitmap             m_MsixIrqs;
         u8                 m_MsixTableBar;
         u32                m_MsixTableOffset;
+        // Mapped lazily, by the first MsiXSet
+        Pointer            m_MsixTable = nullptr;
         u8                 m_MsixPendingBar;
         u32                m_MsixPendingOffset;
         Delegate<void()>   m_OnIrq;
@@ -0,0 +1,514 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#include <Drivers/Storage/BlockDevice.hpp>
+#include <Drivers/Storage/WriteBack.hpp>
+#include <Memory/MM.hpp>
+#include <Memory/PMM.hpp>
+
+#include <Prism/Containers/Array.hpp>
+#include <Prism/Memory/Memory.hpp>
+#include <Prism/Utility/Math.hpp>
+
+namespace
+{
+    // Byte granular transfers are staged through bounce pages, one bio per
+    // contiguous chunk, all submitted under one plug
+    constexpr usize MAX_CHUNK_SIZE   = 256 * 1024;
+    constexpr usize MAX_BATCH_CHUNKS = 8;
+    // Writes up to this size are absorbed by the cache in the write-back
+    // mode, the larger ones go to the device right away
+    constexpr usize MAX_CACHED_WRITE = 64 * 1024;
+
+    struct Chunk
+    {
+        Bio*    Request  = nullptr;
+        Pointer Bounce   = nullptr;
+        usize   Pages    = 0;
+        usize   Position = 0;
+        usize   Length   = 0;
+    };
+}; // namespace
+
+ErrorOr<isize> BlockDevice::Read(void* dest, off_t offset, usize bytes)
+{
+    return Transfer(BlockDirection::eRead, reinterpret_cast<u8*>(dest), offset,
+                    bytes);
+}
+ErrorOr<isize> BlockDevice::Write(const void* src, off_t offset, usize bytes)
+{
+    auto buffer = const_cast<u8*>(reinterpret_cast<const u8*>(src));
+    return Transfer(BlockDirection::eWrite, buffer, offset, bytes);
+}
+
+ErrorOr<isize> BlockDevice::Transfer(BlockDirection direction, u8* buffer,
+                                     off_t offset, usize bytes)
+{
+    if (offset < 0) return Error(EINVAL);
+
+    usize sectorSize = SectorSize();
+    usize capacity   = SectorCount() * sectorSize;
+    usize first      = static_cast<usize>(offset);
+    if (first >= capacity || bytes == 0) return 0;
+
+    bytes            = Math::Min(bytes, capacity - first);
+    bool  write      = direction == BlockDirection::eWrite;
+
+    if (write && m_WriteBack && bytes <= MAX_CACHED_WRITE)
+    {
+        i32 status = WriteCached(buffer, first, bytes);
+        if (status != 0) return Error(status);
+
+        WriteBack::Balance(*this);
+        return bytes;
+    }
+
+    usize pageOffset = first % PMM::PAGE_SIZE;
+    if (!write && sectorSize <= PMM::PAGE_SIZE && bytes < PMM::PAGE_SIZE
+        && pageOffset + bytes <= PMM::PAGE_SIZE)
+    {
+        Pointer page = CachedPage(first / PMM::PAGE_SIZE);
+        if (!page) return Error(EIO);
+
+        Memory::Copy(buffer, page.ToHigherHalf<u8*>() + pageOffset, bytes);
+        PMM::ReleasePage(page);
+        return bytes;
+    }
+
+    // Whole sectors go straight to the caller's pages, if they are sector
+    // aligned
+    auto address = reinterpret_cast<uintptr_t>(buffer);
+    bool direct  = sectorSize <= PMM::PAGE_SIZE && first % sectorSize == 0
+              && bytes % sectorSize == 0 && address % sectorSize == 0;
+
+    // In write-back mode the cache holds the latest data, so it's updated first
+    // and marked dirty
+    if (write && m_WriteBack) m_CachedPages.Update(first, buffer, bytes, true);
+    if (write) m_NeedsFlush.Store(true);
+
+    i32 status = direct ? TransferDirect(direction, buffer, first, bytes)
+                        : TransferBounced(direction, buffer, first, bytes);
+
+    // The written through pages only have to be kept in sync with what we've
+    // just written, and the reads have to see the data, that has yet to be
+    // written back
+    if (write && !m_WriteBack && status == 0)
+        m_CachedPages.Update(first, buffer, bytes);
+    else if (write && !m_WriteBack) m_CachedPages.Invalidate();
+    else if (!write && m_WriteBack && status == 0)
+        OverlayCached(buffer, first, bytes);
+
+    if (status != 0) return Error(status);
+    return bytes;
+}
+i32 BlockDevice::TransferBounced(BlockDirection direction, u8* buffer,
+                                 usize first, usize bytes)
+{
+    usize sectorSize = SectorSize();
+    usize last       = first + bytes;
+    bool  write      = direction == BlockDirection::eWrite;
+
+    usize chunkSize  = Math::AlignDown(
+        Math::Min(MaxTransferBytes(), MAX_CHUNK_SIZE), sectorSize);
+    if (chunkSize == 0) return EINVAL;
+
+    usize start  = Math::AlignDown(first, sectorSize);
+    usize end    = Math::AlignUp(last, sectorSize);
+    i32   status = 0;
+    for (usize position = start; position < end && status == 0;)
+    {
+        Array<Chunk, MAX_BATCH_CHUNKS> batch{};
+        usize                          count = 0;
+        for (; count < MAX_BATCH_CHUNKS && position < end; ++count)
+        {
+            Chunk& chunk   = batch[count];
+            chunk.Position = position;
+            chunk.Length   = Math::Min(chunkSize, end - position);
+            chunk.Pages    = Math::DivRoundUp(chunk.Length, PMM::PAGE_SIZE);
+            chunk.Bounce   = PMM::AllocatePages(chunk.Pages);
+            if (chunk.Bounce)
+                chunk.Request = new Bio(direction, position / sectorSize);
+            if (!chunk.Request)
+            {
+                if (chunk.Bounce)
+                    PMM::FreePages(chunk.Bounce.Raw(), chunk.Pages);
+                status = ENOMEM;
+                break;
+            }
+
+            chunk.Request->AddSegment(chunk.Bounce, chunk.Length);
+            position += chunk.Length;
+        }
+
+        for (usize i = 0; i < count && write && status == 0; ++i)
+        {
+            Chunk& chunk    = batch[i];
+            u8*    data     = chunk.Bounce.ToHigherHalf<u8*>();
+            usize  chunkEnd = chunk.Position + chunk.Length;
+
+            // Partially overwritten sectors have to be read in first
+            bool   head     = chunk.Position < first;
+            if (head)
+                status = TransferSectors(BlockDirection::eRead,
+                                         chunk.Position / sectorSize,
+                                         chunk.Bounce, sectorSize);
+            if (status == 0 && chunkEnd > last
+                && !(head && chunkEnd - sectorSize == chunk.Position))
+                status = TransferSectors(
+                    BlockDirection::eRead, chunkEnd / sectorSize - 1,
+                    chunk.Bounce.Offset<Pointer>(chunk.Length - sectorSize),
+                    sectorSize);
+
+            usize from = Math::Max(chunk.Position, first);
+            usize to   = Math::Min(chunkEnd, last);
+            Memory::Copy(data + (from - chunk.Position),
+                         buffer + (from - first), to - from);
+        }
+
+        bool submitted = status == 0;
+        if (submitted)
+        {
+            BlockPlug plug(*this);
+            for (usize i = 0; i < count; ++i) Submit(batch[i].Request);
+        }
+
+        for (usize i = 0; i < count; ++i)
+        {
+            Chunk& chunk  = batch[i];
+            i32    result = submitted ? Wait(*chunk.Request) : 0;
+            if (result != 0 && status == 0) status = result;
+
+            if (!write && status == 0)
+            {
+                usize from = Math::Max(chunk.Position, first);
+                usize to   = Math::Min(chunk.Position + chunk.Length, last);
+                Memory::Copy(buffer + (from - first),
+                             chunk.Bounce.ToHigherHalf<u8*>()
+                                 + (from - chunk.Position),
+                             to - from);
+            }
+
+            delete chunk.Request;
+            PMM::FreePages(chunk.Bounce.Raw(), chunk.Pages);
+        }
+    }
+
+    return status;
+}
+i32 BlockDevice::TransferDirect(BlockDirection direction, u8* buffer,
+                                usize first, usize bytes)
+{
+    usize sectorSize  = SectorSize();
+    usize maxBytes    = Math::AlignDown(MaxTransferBytes(), sectorSize);
+    usize maxSegments = Math::Max(MaxSegments(), 1zu);
+    bool  write       = direction == BlockDirection::eWrite;
+    if (maxBytes == 0) return EINVAL;
+
+    i32 status = 0;
+    for (usize done = 0; done < bytes && status == 0;)
+    {
+        // Pages stay pinned until the device is done with them. Reads pin for
+        // writing, which breaks COW sharing first
+        usize           end   = done + Math::Min(bytes - done,
+                                                 maxBytes * MAX_BATCH_CHUNKS);
+        auto            start = Math::AlignDown(
+            reinterpret_cast<uintptr_t>(buffer + done), PMM::PAGE_SIZE);
+        Vector<Pointer> pages;
+        auto pinned = MM::PinPages(buffer + done, end - done, !write, pages);
+        if (!pinned) return static_cast<i32>(pinned.error());
+
+        Array<Bio*, MAX_BATCH_CHUNKS> batch{};
+        usize                         count    = 0;
+        usize                         position = done;
+        while (position < end && count < MAX_BATCH_CHUNKS)
+        {
+            Bio* bio = new Bio(direction, (first + position) / sectorSize);
+            if (!bio)
+            {
+                status = ENOMEM;
+                break;
+            }
+
+            batch[count++] = bio;
+            // The bio is only ever cut at a page boundary, or after a
+            // multiple of sectors, so its length stays a multiple of sectors
+            while (position < end && bio->Bytes() < maxBytes)
+            {
+                auto address = reinterpret_cast<uintptr_t>(buffer + position);
+                usize pageOffset = address % PMM::PAGE_SIZE;
+                usize length     = Math::Min(PMM::PAGE_SIZE - pageOffset,
+                                             end - position);
+                length           = Math::Min(length, maxBytes - bio->Bytes());
+
+                Pointer page = pages[(address - start) / PMM::PAGE_SIZE];
+                Pointer phys = page.Offset<Pointer>(pageOffset);
+                auto&   segments = bio->Segments();
+                if (segments.Size() >= maxSegments
+                    && segments.Back().Physical.Raw() + segments.Back().Length
+                           != phys.Raw())
+                    break;
+
+                bio->AddSegment(phys, length);
+                position += length;
+            }
+        }
+
+        if (status == 0)
+        {
+            BlockPlug plug(*this);
+            for (usize i = 0; i < count; ++i) Submit(batch[i]);
+        }
+
+        for (usize i = 0; i < count; ++i)
+        {
+            i32 result = status == 0 ? Wait(*batch[i]) : 0;
+            if (result != 0 && status == 0) status = result;
+
+            delete batch[i];
+        }
+
+        MM::UnpinPages(pages);
+        done = position;
+    }
+
+    return status;
+}
+i32 BlockDevice::WriteCached(const u8* buffer, usize first, usize bytes)
+{
+    usize capacity = SectorCount() * SectorSize();
+    for (usize done = 0; done < bytes;)
+    {
+        usize   position   = first + done;
+        usize   index      = position / PMM::PAGE_SIZE;
+        usize   pageOffset = position % PMM::PAGE_SIZE;
+        usize   chunk = Math::Min(PMM::PAGE_SIZE - pageOffset, bytes - done);
+        usize   pageBytes
+            = Math::Min(PMM::PAGE_SIZE, capacity - index * PMM::PAGE_SIZE);
+
+        // Wholly overwritten pages are filled before insertion, so no stale
+        // data is ever visible
+        Pointer page   = nullptr;
+        bool    filled = false;
+        if (pageOffset == 0 && chunk == pageBytes)
+        {
+            page = m_CachedPages.Lookup(index);
+            Pointer fresh = page ? nullptr : PageCache::AllocatePage();
+            if (fresh)
+            {
+                Memory::Copy(fresh.ToHigherHalf<u8*>(), buffer + done, chunk);
+                page   = m_CachedPages.Insert(index, fresh);
+                filled = page.Raw() == fresh.Raw();
+            }
+        }
+        else page = CachedPage(index);
+        if (!page) return ENOMEM;
+
+        if (!filled)
+            Memory::Copy(page.ToHigherHalf<u8*>() + pageOffset, buffer + done,
+                         chunk);
+
+        // If the cache couldn't keep the page, it's written through
+        i32 status = 0;
+        if (!m_CachedPages.MarkDirty(index))
+        {
+            m_NeedsFlush.Store(true);
+            status = TransferSectors(BlockDirection::eWrite,
+                                     index * PMM::PAGE_SIZE / SectorSize(),
+                                     page, pageBytes);
+        }
+
+        PMM::ReleasePage(page);
+        if (status != 0) return status;
+        done += chunk;
+    }
+
+    return 0;
+}
+void BlockDevice::OverlayCached(u8* buffer, usize first, usize bytes)
+{
+    if (m_CachedPages.PageCount() == 0) return;
+
+    for (usize done = 0; done < bytes;)
+    {
+        usize   position   = first + done;
+        usize   pageOffset = position % PMM::PAGE_SIZE;
+        usize   chunk = Math::Min(PMM::PAGE_SIZE - pageOffset, bytes - done);
+
+        Pointer page  = m_CachedPages.Lookup(position / PMM::PAGE_SIZE);
+        if (page)
+        {
+            Memory::Copy(buffer + done, page.ToHigherHalf<u8*>() + pageOffset,
+                         chunk);
+            PMM::ReleasePage(page);
+        }
+
+        done += chunk;
+    }
+}
+
+void BlockDevice::SetWriteBack(bool enabled)
+{
+    // Pages are written back as whole sectors, at least one of which must fit a
+    // bio
+    if (enabled
+        && (SectorSize() > PMM::PAGE_SIZE
+            || MaxTransferBytes() < PMM::PAGE_SIZE))
+        return;
+
+    if (enabled && !m_WriteBack) WriteBack::Register(this);
+    else if (!enabled && m_WriteBack) WriteBackPages();
+    m_WriteBack = enabled;
+}
+i32 BlockDevice::WriteBackPages(u64 dirtiedBefore)
+{
+    m_WriteBackLock.Lock();
+    i32 status = WriteBackLocked(dirtiedBefore);
+    m_WriteBackLock.Unlock();
+
+    return status;
+}
+ErrorOr<void> BlockDevice::Sync()
+{
+    m_WriteBackLock.Lock();
+    i32 status = WriteBackLocked(u64(-1));
+
+    // Writes completing after the flag is cleared are flushed by the next sync
+    if (m_NeedsFlush.Load())
+    {
+        m_NeedsFlush.Store(false);
+        i32 flushed = TransferSectors(BlockDirection::eFlush, 0, nullptr, 0);
+        if (flushed != 0) m_NeedsFlush.Store(true);
+        if (status == 0) status = flushed;
+    }
+
+    if (status == 0) status = m_WriteBackError;
+    m_WriteBackError = 0;
+    m_WriteBackLock.Unlock();
+
+    if (status != 0) return Error(status);
+    return {};
+}
+i32 BlockDevice::WriteBackLocked(u64 dirtiedBefore)
+{
+    Vector<PageCache::DirtyPage> pages;
+    if (m_CachedPages.CollectDirty(pages, dirtiedBefore) == 0) return 0;
+
+    usize sectorSize  = SectorSize();
+    usize capacity    = SectorCount() * sectorSize;
+    usize maxBytes    = Math::AlignDown(MaxTransferBytes(), PMM::PAGE_SIZE);
+    usize maxSegments = Math::Max(MaxSegments(), 1zu);
+
+    // Runs of adjacent pages go out as a single bio
+    i32   status      = 0;
+    for (usize next = 0; next < pages.Size();)
+    {
+        Array<Bio*, MAX_BATCH_CHUNKS> batch{};
+        usize                         count = 0;
+        while (next < pages.Size() && count < MAX_BATCH_CHUNKS)
+        {
+            usize position = pages[next].Index * PMM::PAGE_SIZE;
+            Bio*  bio      = new Bio(BlockDirection::eWrite,
+                                     position / sectorSize);
+            if (!bio)
+            {
+                status = ENOMEM;
+                break;
+            }
+
+            batch[count++] = bio;
+            for (usize index = pages[next].Index;
+                 next < pages.Size() && pages[next].Index == index
+                 && bio->Bytes() + PMM::PAGE_SIZE <= maxBytes
+                 && bio->Segments().Size() < maxSegments;
+                 ++next, ++index)
+            {
+                usize pageBytes = Math::Min(
+                    PMM::PAGE_SIZE, capacity - index * PMM::PAGE_SIZE);
+                bio->AddSegment(pages[next].Physical, pageBytes);
+            }
+        }
+
+        {
+            BlockPlug plug(*this);
+            for (usize i = 0; i < count; ++i) Submit(batch[i]);
+        }
+
+        for (usize i = 0; i < count; ++i)
+        {
+            i32 result = Wait(*batch[i]);
+            if (result != 0 && status == 0) status = result;
+
+            delete batch[i];
+        }
+
+        // The pages, we didn't get to, are left for the next writeback
+        if (status != ENOMEM) continue;
+        for (; next < pages.Size(); ++next)
+            m_CachedPages.MarkDirty(pages[next].Index);
+    }
+
+    m_NeedsFlush.Store(true);
+    if (status != 0)
+    {
+        // Pages that fail to write stay cached and clean, the next Sync reports
+        // the error
+        LogError("BlockDevice: Failed to write back {} pages, error: {}",
+                 pages.Size(), status);
+        if (m_WriteBackError == 0) m_WriteBackError = status;
+    }
+
+    for (const auto& page : pages) PMM::ReleasePage(page.Physical);
+    return status;
+}
+i32 BlockDevice::TransferSectors(BlockDirection direction, u64 sector,
+                                 Pointer physical, usize bytes)
+{
+    Bio bio(direction, sector);
+    bio.AddSegment(physical, bytes);
+
+    Submit(&bio);
+    return Wait(bio);
+}
+
+Pointer BlockDevice::CachedPage(usize index)
+{
+    Pointer page = m_CachedPages.Lookup(index);
+    if (page)
+    {
+        PageCache::RecordHit();
+        return page;
+    }
+
+    PageCache::RecordMiss();
+    // The last page of the device might be only partially backed by sectors
+    usize position = index * PMM::PAGE_SIZE;
+    usize bytes
+        = Math::Min(PMM::PAGE_SIZE, SectorCount() * SectorSize() - position);
+
+    // The page is read again, if a written through write raced with the read
+    while (!page)
+    {
+        page = PageCache::AllocatePage();
+        if (!page) return nullptr;
+
+        if (bytes < PMM::PAGE_SIZE)
+            Memory::Fill(page.ToHigherHalf<u8*>() + bytes, 0,
+                         PMM::PAGE_SIZE - bytes);
+
+        usize generation = m_CachedPages.Generation();
+        if (TransferSectors(BlockDirection::eRead, position / SectorSize(),
+                            page, bytes)
+            != 0)
+        {
+            PMM::ReleasePage(page);
+            return nullptr;
+        }
+
+        page = m_CachedPages.Insert(index, page, generation);
+    }
+
+    return page;
+}
@@ -0,0 +1,130 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#pragma once
+
+#include <Drivers/Core/Device.hpp>
+#include <Drivers/Storage/BlockRequest.hpp>
+#include <Library/Locking/Mutex.hpp>
+
+#include <VFS/PageCache.hpp>
+
+/**
+ * @brief Device, which transfers data in whole sectors, through bios, the
+ * byte granular Read and Write, which the filesystems use, are built on top of
+ * them, reads smaller than a page, i.e. mostly the filesystem metadata, are
+ * served from a cache of the device's pages, the sector aligned transfers go
+ * directly to and from the caller's pages, everything else is bounced
+ *
+ * The cache is written through by default, in the write-back mode the small
+ * writes only dirty the cached pages, which are written back later on, by the
+ * flusher, or by Sync, see WriteBack
+ */
+class BlockDevice : public Device
+{
+  public:
+    BlockDevice(DeviceMajor major, DeviceMinor minor)
+        : Device(major, minor)
+    {
+    }
+
+    inline usize   SectorSize() const { return m_Stats.st_blksize; }
+    virtual u64    SectorCount() const      = 0;
+    // Largest bio, which the device accepts
+    virtual usize  MaxTransferBytes() const = 0;
+    // Largest number of segments of a single bio
+    virtual usize  MaxSegments() const { return usize(-1); }
+
+    /**
+     * @brief Queues the bio, it completes asynchronously, see Bio
+     */
+    virtual void   Submit(Bio* bio)         = 0;
+    /**
+     * @brief Holds back the dispatching of the submitted bios, until the
+     * matching Unplug, so that they can be merged
+     */
+    virtual void   Plug() {}
+    virtual void   Unplug() {}
+    /**
+     * @brief Waits for the completion of a submitted bio, drivers may poll
+     * for it, instead of going to sleep
+     */
+    virtual i32    Wait(Bio& bio) { return bio.Wait(); }
+
+    void           SetWriteBack(bool enabled);
+    inline bool    IsWriteBack() const { return m_WriteBack; }
+    /**
+     * @brief Writes back the cached pages, which got dirty before
+     * `dirtiedBefore`, the adjacent ones are coalesced into as few bios, as
+     * the device accepts
+     *
+     * @return 0, or errno of the first failed write
+     */
+    i32            WriteBackPages(u64 dirtiedBefore = u64(-1));
+    /**
+     * @brief Writes back all of the dirty pages, and flushes the device's
+     * volatile write cache, reports the errors of the earlier writebacks as
+     * well
+     */
+    virtual ErrorOr<void> Sync() override;
+
+    virtual ErrorOr<isize> Read(void* dest, off_t offset, usize bytes) override;
+    virtual ErrorOr<isize> Write(const void* src, off_t offset,
+                                 usize bytes) override;
+
+    virtual ErrorOr<isize> Read(const UserBuffer& out, usize count,
+                                isize offset = -1) override
+    {
+        return Read(out.Raw(), offset, count);
+    }
+    virtual ErrorOr<isize> Write(const UserBuffer& in, usize count,
+                                 isize offset = -1) override
+    {
+        return Write(in.Raw(), offset, count);
+    }
+
+  private:
+    PageCache::Mapping m_CachedPages;
+
+    bool               m_WriteBack = false;
+    // Serializes the writebacks, so that Sync also waits for the pages, which
+    // the flusher is writing back at the moment
+    Mutex              m_WriteBackLock;
+    // Set by every write, and cleared by the flush, which makes it durable
+    Atomic<bool>       m_NeedsFlush     = false;
+    // First writeback error, which hasn't been reported by Sync yet
+    i32                m_WriteBackError = 0;
+
+    ErrorOr<isize>     Transfer(BlockDirection direction, u8* buffer,
+                                off_t offset, usize bytes);
+    i32                TransferBounced(BlockDirection direction, u8* buffer,
+                                       usize first, usize bytes);
+    i32                TransferDirect(BlockDirection direction, u8* buffer,
+                                      usize first, usize bytes);
+    i32                TransferSectors(BlockDirection direction, u64 sector,
+                                       Pointer physical, usize bytes);
+    i32                WriteCached(const u8* buffer, usize first, usize bytes);
+    void               OverlayCached(u8* buffer, usize first, usize bytes);
+    i32                WriteBackLocked(u64 dirtiedBefore);
+    Pointer            CachedPage(usize index);
+};
+
+/**
+ * @brief Keeps the device plugged for the lifetime of the guard
+ */
+class BlockPlug : public NonCopyable<BlockPlug>
+{
+  public:
+    explicit BlockPlug(BlockDevice& device)
+        : m_Device(device)
+    {
+        m_Device.Plug();
+    }
+    ~BlockPlug() { m_Device.Unplug(); }
+
+  private:
+    BlockDevice& m_Device;
+};
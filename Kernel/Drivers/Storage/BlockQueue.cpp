@@ -0,0 +1,241 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#include <Drivers/Storage/BlockQueue.hpp>
+#include <Drivers/Storage/StorageDevice.hpp>
+
+namespace
+{
+    // Whether the data of `next` can directly follow the data of `last`
+    // within a single request, without breaking the segment boundary
+    bool SegmentsJoin(const Bio* last, const Bio* next, usize mask)
+    {
+        if (!mask) return true;
+
+        const auto& tail = last->Segments().Back();
+        const auto& head = next->Segments().Front();
+        return ((tail.Physical.Raw() + tail.Length) & mask) == 0
+            && (head.Physical.Raw() & mask) == 0;
+    }
+}; // namespace
+
+void BlockQueue::Submit(Bio* bio)
+{
+    usize sectorSize = m_Limits.SectorSize;
+    bool  flush      = bio->Direction == BlockDirection::eFlush;
+    if ((!bio->Bytes() && !flush) || (bio->Bytes() && flush)
+        || bio->Bytes() % sectorSize
+        || bio->Bytes() > m_Limits.MaxRequestBytes
+        || bio->Segments().Size() > m_Limits.MaxSegments)
+    {
+        bio->Complete(EINVAL);
+        return;
+    }
+
+    // Allocated up front, so that we don't allocate with the queue locked
+    bio->m_Next  = nullptr;
+    auto request = new BlockRequest(bio);
+    if (!request)
+    {
+        bio->Complete(ENOMEM);
+        return;
+    }
+
+    {
+        ScopedLock guard(m_Lock, true);
+        ++m_Statistics.Bios;
+
+        // Flushes are never merged
+        if (!flush && TryMerge(bio)) delete request;
+        else Insert(request);
+    }
+
+    Dispatch();
+}
+
+void BlockQueue::Plug()
+{
+    ScopedLock guard(m_Lock, true);
+    ++m_PlugDepth;
+}
+void BlockQueue::Unplug()
+{
+    {
+        ScopedLock guard(m_Lock, true);
+        Assert(m_PlugDepth > 0);
+        if (--m_PlugDepth > 0) return;
+    }
+
+    Dispatch();
+}
+
+void BlockQueue::Complete(BlockRequest* request, i32 status)
+{
+    // Completion handlers may release their bios, so walk the chain first
+    for (Bio* bio = request->m_Head; bio;)
+    {
+        Bio* next = bio->m_Next;
+        bio->Complete(status);
+        bio = next;
+    }
+    delete request;
+
+    {
+        ScopedLock guard(m_Lock, true);
+        --m_InFlight;
+    }
+
+    Dispatch();
+}
+
+BlockQueueStatistics BlockQueue::GetStatistics()
+{
+    ScopedLock guard(m_Lock, true);
+    return m_Statistics;
+}
+
+bool BlockQueue::TryMerge(Bio* bio)
+{
+    usize         sectorSize = m_Limits.SectorSize;
+    u64           bioEnd     = bio->Sector + bio->Bytes() / sectorSize;
+
+    BlockRequest* previous   = nullptr;
+    for (BlockRequest* request = m_Pending; request;
+         previous = request, request = request->m_Next)
+    {
+        u64 requestEnd = request->Sector + request->Bytes / sectorSize;
+        if (request->Sector > bioEnd) break;
+        if (!CanJoin(request, bio)) continue;
+
+        if (requestEnd == bio->Sector
+            && SegmentsJoin(request->m_Tail, bio, m_Limits.BoundaryMask))
+        {
+            request->m_Tail->m_Next  = bio;
+            request->m_Tail          = bio;
+            request->Bytes          += bio->Bytes();
+            request->Segments       += bio->Segments().Size();
+            ++m_Statistics.BackMerges;
+
+            // The bio might have filled the gap up to the next request
+            BlockRequest* next = request->m_Next;
+            if (next && next->Sector == bioEnd && CanJoin(request, next)
+                && SegmentsJoin(bio, next->m_Head, m_Limits.BoundaryMask))
+            {
+                request->m_Tail->m_Next  = next->m_Head;
+                request->m_Tail          = next->m_Tail;
+                request->Bytes          += next->Bytes;
+                request->Segments       += next->Segments;
+                request->m_Next          = next->m_Next;
+                delete next;
+            }
+
+            return true;
+        }
+        if (bioEnd == request->Sector
+            && SegmentsJoin(bio, request->m_Head, m_Limits.BoundaryMask))
+        {
+            bio->m_Next         = request->m_Head;
+            request->m_Head     = bio;
+            request->Sector     = bio->Sector;
+            request->Bytes     += bio->Bytes();
+            request->Segments  += bio->Segments().Size();
+            ++m_Statistics.FrontMerges;
+
+            if (previous
+                && previous->Sector + previous->Bytes / sectorSize
+                       == request->Sector
+                && CanJoin(previous, request)
+                && SegmentsJoin(previous->m_Tail, bio, m_Limits.BoundaryMask))
+            {
+                previous->m_Tail->m_Next  = request->m_Head;
+                previous->m_Tail          = request->m_Tail;
+                previous->Bytes          += request->Bytes;
+                previous->Segments       += request->Segments;
+                previous->m_Next          = request->m_Next;
+                delete request;
+            }
+
+            return true;
+        }
+    }
+
+    return false;
+}
+bool BlockQueue::CanJoin(const BlockRequest* request, Bio* bio) const
+{
+    return request->Direction == bio->Direction
+        && request->Bytes + bio->Bytes() <= m_Limits.MaxRequestBytes
+        && request->Segments + bio->Segments().Size() <= m_Limits.MaxSegments;
+}
+bool BlockQueue::CanJoin(const BlockRequest* first,
+                         const BlockRequest* second) const
+{
+    return first->Direction == second->Direction
+        && first->Bytes + second->Bytes <= m_Limits.MaxRequestBytes
+        && first->Segments + second->Segments <= m_Limits.MaxSegments;
+}
+void BlockQueue::Insert(BlockRequest* request)
+{
+    BlockRequest** link = &m_Pending;
+    while (*link && (*link)->Sector <= request->Sector)
+        link = &(*link)->m_Next;
+
+    request->m_Next = *link;
+    *link           = request;
+}
+BlockRequest* BlockQueue::NextRequest()
+{
+    // One-way elevator, wraps around to the lowest sector
+    BlockRequest** link = &m_Pending;
+    while (*link && (*link)->Sector < m_HeadSector) link = &(*link)->m_Next;
+    if (!*link) link = &m_Pending;
+
+    BlockRequest* request = *link;
+    *link                 = request->m_Next;
+    request->m_Next       = nullptr;
+
+    m_HeadSector = request->Sector + request->Bytes / m_Limits.SectorSize;
+    return request;
+}
+
+void BlockQueue::Dispatch()
+{
+    // Only one context feeds the driver, the others just queue their requests
+    {
+        ScopedLock guard(m_Lock, true);
+        if (m_Dispatching || m_PlugDepth > 0) return;
+        m_Dispatching = true;
+    }
+
+    for (;;)
+    {
+        usize started = 0;
+        for (;;)
+        {
+            BlockRequest* request = nullptr;
+            {
+                ScopedLock guard(m_Lock, true);
+                if (!m_Pending || m_InFlight >= m_Limits.MaxInFlight) break;
+
+                request = NextRequest();
+                ++m_InFlight;
+                ++m_Statistics.Requests;
+            }
+
+            m_Device.StartRequest(request);
+            ++started;
+        }
+
+        if (started > 0) m_Device.CommitRequests();
+
+        ScopedLock guard(m_Lock, true);
+        if (!m_Pending || m_InFlight >= m_Limits.MaxInFlight || m_PlugDepth > 0)
+        {
+            m_Dispatching = false;
+            return;
+        }
+    }
+}
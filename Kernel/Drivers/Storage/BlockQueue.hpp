@@ -0,0 +1,94 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#pragma once
+
+#include <Drivers/Storage/BlockRequest.hpp>
+#include <Library/Locking/Spinlock.hpp>
+
+#include <Prism/Core/NonCopyable.hpp>
+#include <Prism/Core/Types.hpp>
+
+struct BlockQueueLimits
+{
+    usize SectorSize      = 512;
+    // Largest transfer, the device accepts with a single command
+    usize MaxRequestBytes = 128 * 1024;
+    // Every segment, but the first one, has to start, and every segment, but
+    // the last one, has to end on a multiple of BoundaryMask + 1, e.g. NVMe's
+    // PRPs can only describe whole pages in the middle of a transfer
+    usize BoundaryMask    = 0;
+    // Largest number of segments of a single request
+    usize MaxSegments     = usize(-1);
+    // Number of requests, the driver can have in flight at once
+    usize MaxInFlight     = 1;
+};
+
+struct BlockQueueStatistics
+{
+    usize Bios        = 0;
+    usize Requests    = 0;
+    usize BackMerges  = 0;
+    usize FrontMerges = 0;
+};
+
+class StorageDevice;
+/**
+ * @brief Per device queue of pending requests, submitted bios are either
+ * merged into a pending request, which transfers the adjacent sectors, or
+ * inserted as a new one in the ascending order of sectors, from which they
+ * are handed to the driver in an elevator sweep
+ *
+ * While the queue is plugged, nothing is dispatched, so that a burst of bios
+ * can be collected and merged, before the driver gets to see it
+ */
+class BlockQueue : public NonCopyable<BlockQueue>
+{
+  public:
+    explicit BlockQueue(StorageDevice& device)
+        : m_Device(device)
+    {
+    }
+
+    inline const BlockQueueLimits& Limits() const { return m_Limits; }
+    inline void SetLimits(const BlockQueueLimits& limits) { m_Limits = limits; }
+
+    void        Submit(Bio* bio);
+
+    void        Plug();
+    void        Unplug();
+
+    /**
+     * @brief Called by the driver, once it's done with the request, completes
+     * all of its bios, and dispatches more requests, if there are any
+     */
+    void        Complete(BlockRequest* request, i32 status);
+
+    BlockQueueStatistics GetStatistics();
+
+  private:
+    StorageDevice&       m_Device;
+    BlockQueueLimits     m_Limits;
+
+    Spinlock             m_Lock;
+    BlockRequest*        m_Pending     = nullptr;
+    usize                m_InFlight    = 0;
+    usize                m_PlugDepth   = 0;
+    bool                 m_Dispatching = false;
+    // Where the elevator stopped, the sweep continues from here
+    u64                  m_HeadSector  = 0;
+
+    BlockQueueStatistics m_Statistics;
+
+    bool                 TryMerge(Bio* bio);
+    bool                 CanJoin(const BlockRequest* request, Bio* bio) const;
+    bool                 CanJoin(const BlockRequest* first,
+                                 const BlockRequest* second) const;
+    void                 Insert(BlockRequest* request);
+    BlockRequest*        NextRequest();
+
+    void                 Dispatch();
+};
@@ -0,0 +1,60 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#include <Arch/CPU.hpp>
+
+#include <Drivers/Storage/BlockRequest.hpp>
+
+void Bio::AddSegment(Pointer physical, usize length)
+{
+    if (!length) return;
+    m_Bytes += length;
+
+    if (!m_Segments.Empty())
+    {
+        auto& last = m_Segments.Back();
+        if (last.Physical.Raw() + last.Length == physical.Raw())
+        {
+            last.Length += length;
+            return;
+        }
+    }
+
+    m_Segments.PushBack({physical, length});
+}
+
+void Bio::Complete(i32 status)
+{
+    Status = status;
+    if (OnComplete)
+    {
+        OnComplete.Invoke(this);
+        return;
+    }
+
+    // The waiter may destroy the bio once it sees the completion, so wake it
+    // under the lock
+    bool intState = CPU::SwapInterruptFlag(false);
+    {
+        ScopedLock guard(m_WaitQueue.Lock);
+        m_Completed.Store(true);
+        m_WaitQueue.WakeLocked(usize(-1));
+    }
+
+    CPU::SetInterruptFlag(intState);
+}
+i32 Bio::Wait()
+{
+    m_WaitQueue.WaitUntil([this]() { return m_Completed.Load(); });
+
+    bool intState = CPU::SwapInterruptFlag(false);
+    {
+        ScopedLock guard(m_WaitQueue.Lock);
+    }
+
+    CPU::SetInterruptFlag(intState);
+    return Status;
+}
@@ -0,0 +1,153 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#pragma once
+
+#include <Scheduler/WaitQueue.hpp>
+
+#include <Prism/Containers/Vector.hpp>
+#include <Prism/Core/NonCopyable.hpp>
+#include <Prism/Core/Types.hpp>
+#include <Prism/Memory/Pointer.hpp>
+#include <Prism/Utility/Atomic.hpp>
+#include <Prism/Utility/Delegate.hpp>
+
+enum class BlockDirection : u8
+{
+    eRead  = 0,
+    eWrite = 1,
+    // Commits the device's volatile write cache, carries no data
+    eFlush = 2,
+};
+
+struct BlockSegment
+{
+    // Physical address of the data, a segment may span several pages, as long
+    // as they are physically contiguous
+    Pointer Physical = nullptr;
+    usize   Length   = 0;
+};
+
+/**
+ * @brief Block I/O, a single transfer between consecutive sectors of a block
+ * device, and a list of physical memory segments, its length has to be a
+ * multiple of the device's sector size, flushes carry no data at all
+ *
+ * Bios are submitted with BlockDevice::Submit, and complete asynchronously,
+ * either by running OnComplete, which then takes over the ownership of the
+ * bio, or by waking up whoever waits for it
+ */
+class Bio : public NonCopyable<Bio>
+{
+  public:
+    using CompletionHandler = Delegate<void(Bio* bio)>;
+
+    Bio(BlockDirection direction, u64 sector)
+        : Direction(direction)
+        , Sector(sector)
+    {
+    }
+
+    BlockDirection Direction;
+    // First sector of the transfer, in the units of the device's sector size
+    u64            Sector;
+    // 0 on success, errno otherwise, valid once the bio has completed
+    i32            Status = 0;
+    CompletionHandler OnComplete;
+
+    inline usize      Bytes() const { return m_Bytes; }
+    inline const Vector<BlockSegment>& Segments() const { return m_Segments; }
+
+    inline bool IsCompleted() const { return m_Completed.Load(); }
+    // Index of the driver's hardware queue, the bio was submitted to, so that
+    // its waiter can poll it, or -1, if it wasn't submitted yet
+    inline isize HardwareQueue() const { return m_HardwareQueue.Load(); }
+
+    /**
+     * @brief Appends `length` bytes at `physical` to the transfer, the
+     * segment is folded into the previous one, if they're contiguous
+     */
+    void        AddSegment(Pointer physical, usize length);
+
+    /**
+     * @brief Called by the block layer, once the transfer is done
+     */
+    void        Complete(i32 status);
+    /**
+     * @brief Blocks until the bio completes, may only be used for the bios
+     * without a completion handler
+     *
+     * @return Status of the transfer
+     */
+    i32         Wait();
+
+  private:
+    friend class BlockQueue;
+    friend class BlockRequest;
+
+    Vector<BlockSegment> m_Segments;
+    usize                m_Bytes     = 0;
+    Atomic<bool>         m_Completed     = false;
+    Atomic<isize>        m_HardwareQueue = -1;
+    WaitQueue            m_WaitQueue;
+
+    // Next bio of the request, this one has been merged into
+    Bio*                 m_Next = nullptr;
+};
+
+/**
+ * @brief Request, as seen by the driver, one, or more bios, which have been
+ * merged, because they transfer consecutive sectors in the same direction
+ */
+class BlockRequest : public NonCopyable<BlockRequest>
+{
+  public:
+    explicit BlockRequest(Bio* bio)
+        : Direction(bio->Direction)
+        , Sector(bio->Sector)
+        , Bytes(bio->Bytes())
+        , Segments(bio->Segments().Size())
+        , m_Head(bio)
+        , m_Tail(bio)
+    {
+    }
+
+    BlockDirection Direction;
+    u64            Sector;
+    usize          Bytes;
+    // Upper bound, the segments of the adjacent bios aren't folded together
+    usize          Segments;
+
+    /**
+     * @brief Calls `callback(segment)` for every segment of the merged bios,
+     * in the order of the data they carry
+     */
+    template <typename F>
+    void ForEachSegment(F&& callback) const
+    {
+        for (Bio* bio = m_Head; bio; bio = bio->m_Next)
+            for (const auto& segment : bio->m_Segments) callback(segment);
+    }
+    /**
+     * @brief Records the hardware queue, the request is about to be submitted
+     * to, in all of its bios, before it's submitted, as it may complete
+     * right away
+     */
+    void SetHardwareQueue(usize index)
+    {
+        for (Bio* bio = m_Head; bio; bio = bio->m_Next)
+            bio->m_HardwareQueue.Store(index);
+    }
+
+  private:
+    friend class BlockQueue;
+
+    Bio*          m_Head = nullptr;
+    Bio*          m_Tail = nullptr;
+
+    // Next pending request, in the ascending order of sectors
+    BlockRequest* m_Next = nullptr;
+};
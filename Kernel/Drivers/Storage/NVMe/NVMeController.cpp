@@ -1,9 +1,13 @@
 /*
  * Created by v1tr10l7 on 24.01.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
+#include <Arch/CPU.hpp>
+#include <Arch/InterruptHandler.hpp>
+#include <Arch/InterruptManager.hpp>
+
 #include <Drivers/Storage/NVMe/NVMeController.hpp>
 #include <Drivers/Storage/NVMe/NVMeQueue.hpp>
 #include <Memory/PMM.hpp>
@@ -17,6 +21,12 @@
 
 namespace NVMe
 {
+    namespace
+    {
+        constexpr usize ADMIN_QUEUE_DEPTH  = 64;
+        constexpr usize MAX_IO_QUEUE_DEPTH = 1024;
+    }; // namespace
+
     Atomic<usize> Controller::s_ControllerCount = 0;
 
     Controller::Controller(const PCI::DeviceAddress& address)
@@ -69,15 +79,16 @@ namespace NVMe
         m_QueueSlots     = m_Register->Capabilities.MaxQueueSize;
         u32 queueId      = 0;
 
+        // The admin queue is only used during initialization, and is polled
+        u64 adminDepth   = Math::Min<u64>(m_QueueSlots, ADMIN_QUEUE_DEPTH);
         m_AdminQueue
-            = new Queue(m_CrAddress, queueId, m_DoorbellStride, m_QueueSlots);
-        // TODO(v1tr10l7): Set Msi-X irq
+            = new Queue(m_CrAddress, queueId, m_DoorbellStride, adminDepth);
 
         Pointer asq = m_AdminQueue->GetSubmit();
         Pointer acq = m_AdminQueue->GetComplete();
 
-        m_Register->AdminQueueAttributes.SubmitQueueSize   = m_QueueSlots - 1;
-        m_Register->AdminQueueAttributes.CompleteQueueSize = m_QueueSlots - 1;
+        m_Register->AdminQueueAttributes.SubmitQueueSize   = adminDepth - 1;
+        m_Register->AdminQueueAttributes.CompleteQueueSize = adminDepth - 1;
 
         m_Register->AdminSubmissionQueue                 = asq.FromHigherHalf();
         m_Register->AdminCompletionQueue                 = acq.FromHigherHalf();
@@ -97,6 +108,10 @@ namespace NVMe
                   "NVMe{}: Failed to identify the controller", m_Index);
 
         usize namespaceCount = info->NamespaceCount;
+        // Bits 0-1 report, whether, and with what alignment, SGLs are
+        // supported for the NVM command set
+        m_SupportsSgl        = (info->SglSupport & 0b11) != 0;
+        m_HasWriteCache      = info->VolatileWriteCache & Bit(0);
         delete info;
 
         LogInfo("NVMe: Controller #{} initialized successfully", m_Index);
@@ -131,39 +146,21 @@ namespace NVMe
         return {};
     }
 
-    bool Controller::CreateIoQueues(NameSpace& ns, Queue*& ioQueue, u32 id)
+    void Controller::PollIoQueues()
     {
-        ioQueue
-            = new Queue(m_CrAddress, ns, id, m_DoorbellStride, m_QueueSlots);
-        Submission cmd1 = {};
-        cmd1.OpCode     = OpCode::ADMIN_CREATE_CQ;
-        cmd1.Prp1 = Pointer(u64(ioQueue->GetComplete())).FromHigherHalf<u64>();
-        cmd1.CreateCompletionQueue.CompleteQueueID    = id;
-        cmd1.CreateCompletionQueue.Size               = m_QueueSlots - 1;
-        cmd1.CreateCompletionQueue.CompleteQueueFlags = Bit(0);
-        cmd1.CreateCompletionQueue.IrqVec             = 0;
-        u16 status = m_AdminQueue->AwaitSubmit(&cmd1);
-        if (status)
+        for (;;)
         {
-            delete ioQueue;
-            return false;
-        }
+            usize reaped   = 0;
+            usize inFlight = 0;
+            for (Queue* queue : m_IoQueues)
+            {
+                reaped   += queue->Reap();
+                inFlight += queue->GetInFlight();
+            }
 
-        Submission cmd2 = {};
-        cmd2.OpCode     = OpCode::ADMIN_CREATE_SQ;
-        cmd2.Prp1 = Pointer(u64(ioQueue->GetSubmit())).FromHigherHalf<u64>();
-        cmd2.CreateSubmissionQueue.SubmitQueueID    = id;
-        cmd2.CreateSubmissionQueue.CompleteQueueID  = id;
-        cmd2.CreateSubmissionQueue.Size             = m_QueueSlots - 1;
-        cmd2.CreateSubmissionQueue.SubmitQueueFlags = Bit(0) | (2 << 1);
-        status = m_AdminQueue->AwaitSubmit(&cmd2);
-        if (status)
-        {
-            delete ioQueue;
-            return false;
+            if (inFlight == 0) return;
+            if (reaped == 0) Arch::Pause();
         }
-
-        return true;
     }
 
     i32 Controller::Identify(ControllerInfo* info)
@@ -206,7 +203,13 @@ namespace NVMe
                   "NVMe: Failed to acquire namespaces for controller {}",
                   m_Index);
 
-        SetQueueCount(4);
+        if (!CreateIoQueues())
+        {
+            LogError("NVMe{}: Failed to create the I/O queues", m_Index);
+            delete namespaceIDs;
+            return false;
+        }
+
         for (usize i = 0; i < namespaceCount; i++)
         {
             u32 namespaceID = namespaceIDs[i];
@@ -228,10 +231,99 @@ namespace NVMe
         cmd.Prp1           = 0;
         cmd.Features.Fid   = 0x07;
         cmd.Features.Dword = (count - 1) | ((count - 1) << 16);
-        u16 status         = m_AdminQueue->AwaitSubmit(&cmd);
+        u32 result         = 0;
+        u16 status         = m_AdminQueue->AwaitSubmit(&cmd, &result);
         if (status) return -1;
 
-        return 0;
+        // The granted queue counts may differ, both are 0 based
+        usize submitQueues   = (result & 0xffff) + 1;
+        usize completeQueues = (result >> 16) + 1;
+        return Math::Min(submitQueues, completeQueues);
+    }
+    bool Controller::CreateIoQueues()
+    {
+        // Every cpu gets its own queue pair and interrupt vector, vector 0 is
+        // shared with the admin queue
+        usize cpuCount = CPU::GetOnlineCPUsCount();
+        isize granted  = SetQueueCount(cpuCount);
+        if (granted <= 0) return false;
+
+        usize count    = Math::Min(cpuCount, usize(granted));
+        usize vectors  = GetMsiXVectorCount();
+        m_IoInterrupts = vectors > 0;
+        // Without interrupts, all of the queues would have to be polled
+        // anyway, so there's no point in having more than one
+        count          = m_IoInterrupts ? Math::Min(count, vectors) : 1;
+        m_IoQueueDepth = Math::Min<usize>(m_QueueSlots, MAX_IO_QUEUE_DEPTH);
+
+        for (usize i = 0; i < count; ++i)
+            if (!CreateIoQueue(i)) break;
+
+        LogInfo("NVMe{}: Created {} I/O queues, {} entries each, {}", m_Index,
+                m_IoQueues.Size(), m_IoQueueDepth,
+                m_IoInterrupts ? "interrupt driven" : "polled");
+        return !m_IoQueues.Empty();
+    }
+    bool Controller::CreateIoQueue(u16 index)
+    {
+        u16    id    = index + 1;
+        Queue* queue = new Queue(m_CrAddress, id, m_DoorbellStride,
+                                 m_IoQueueDepth);
+
+        if (m_IoInterrupts)
+        {
+            auto handler = InterruptManager::AllocateHandler();
+            if (!handler)
+            {
+                delete queue;
+                return false;
+            }
+
+            handler->Reserve();
+            handler->SetHandler([queue](CPUContext*) { queue->Reap(); });
+            if (!MsiXSet(CPU::GetCPU(index).LapicID,
+                         handler->GetInterruptVector(), index))
+            {
+                LogError("NVMe{}: Failed to route the irq of queue #{}",
+                         m_Index, id);
+                delete queue;
+                return false;
+            }
+        }
+
+        Submission cmd1 = {};
+        cmd1.OpCode     = OpCode::ADMIN_CREATE_CQ;
+        cmd1.Prp1 = Pointer(u64(queue->GetComplete())).FromHigherHalf<u64>();
+        cmd1.CreateCompletionQueue.CompleteQueueID = id;
+        cmd1.CreateCompletionQueue.Size            = m_IoQueueDepth - 1;
+        // Physically contiguous, and interrupts enabled
+        cmd1.CreateCompletionQueue.CompleteQueueFlags
+            = Bit(0) | (m_IoInterrupts ? Bit(1) : 0);
+        cmd1.CreateCompletionQueue.IrqVec = m_IoInterrupts ? index : 0;
+        u16 status = m_AdminQueue->AwaitSubmit(&cmd1);
+        if (status)
+        {
+            delete queue;
+            return false;
+        }
+
+        Submission cmd2 = {};
+        cmd2.OpCode     = OpCode::ADMIN_CREATE_SQ;
+        cmd2.Prp1 = Pointer(u64(queue->GetSubmit())).FromHigherHalf<u64>();
+        cmd2.CreateSubmissionQueue.SubmitQueueID    = id;
+        cmd2.CreateSubmissionQueue.CompleteQueueID  = id;
+        cmd2.CreateSubmissionQueue.Size             = m_IoQueueDepth - 1;
+        cmd2.CreateSubmissionQueue.SubmitQueueFlags = Bit(0) | (2 << 1);
+        status = m_AdminQueue->AwaitSubmit(&cmd2);
+        if (status)
+        {
+            delete queue;
+            return false;
+        }
+
+        queue->SetUseSgl(m_SupportsSgl);
+        m_IoQueues.PushBack(queue);
+        return true;
     }
     bool Controller::AddNameSpace(u32 namespaceID)
     {
@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 24.01.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -10,6 +10,7 @@
 #include <Drivers/Storage/NVMe/NVMeNameSpace.hpp>
 #include <Drivers/Storage/NVMe/NVMeQueue.hpp>
 
+#include <Prism/Containers/Vector.hpp>
 #include <Prism/String/String.hpp>
 #include <Prism/Utility/Atomic.hpp>
 
@@ -173,7 +174,30 @@ namespace NVMe
         inline Queue* GetAdminQueue() const { return m_AdminQueue; }
         inline usize  GetMaxTransShift() const { return m_MaxTransShift; }
 
-        bool          CreateIoQueues(NameSpace& ns, Queue*& queues, u32 id);
+        /**
+         * @brief The I/O queues are shared by all of the namespaces, there's
+         * one for every cpu, as long as the controller grants us enough of
+         * them, the index is taken modulo their count
+         */
+        inline Queue* GetIoQueue(usize index) const
+        {
+            return m_IoQueues[index % m_IoQueues.Size()];
+        }
+        inline usize GetIoQueueCount() const { return m_IoQueues.Size(); }
+        inline usize GetIoQueueDepth() const { return m_IoQueueDepth; }
+        // Whether the I/O queues complete their commands with interrupts
+        inline bool  HasIoInterrupts() const { return m_IoInterrupts; }
+        // Whether the I/O commands describe their data with SGLs
+        inline bool  SupportsSgl() const { return m_SupportsSgl; }
+        // Whether the written data might sit in a volatile cache, until it's
+        // flushed
+        inline bool  HasWriteCache() const { return m_HasWriteCache; }
+
+        /**
+         * @brief Reaps all of the I/O queues, until there are no more commands
+         * in flight, used when the controller can't interrupt us
+         */
+        void         PollIoQueues();
 
         virtual StringView     Name() const noexcept override { return m_Name; }
 
@@ -213,6 +237,11 @@ namespace NVMe
         Spinlock                            m_Lock;
         class Queue*                        m_AdminQueue    = nullptr;
         usize                               m_MaxTransShift = 0;
+        Vector<Queue*>                      m_IoQueues;
+        usize                               m_IoQueueDepth  = 0;
+        bool                                m_IoInterrupts  = false;
+        bool                                m_SupportsSgl   = false;
+        bool                                m_HasWriteCache = false;
         UnorderedMap<u32, NameSpace*> m_NameSpaces;
 
         static Atomic<usize>                s_ControllerCount;
@@ -221,6 +250,8 @@ namespace NVMe
         bool  DetectNameSpaces(u32 namespaceCount);
 
         isize SetQueueCount(i32 count);
+        bool  CreateIoQueues();
+        bool  CreateIoQueue(u16 index);
         bool  AddNameSpace(u32 id);
     };
 }; // namespace NVMe
@@ -1,12 +1,11 @@
 /*
  * Created by v1tr10l7 on 24.01.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
+#include <Arch/Arch.hpp>
 #include <Arch/CPU.hpp>
-#include <Arch/InterruptHandler.hpp>
-#include <Arch/InterruptManager.hpp>
 
 #include <Drivers/Core/DeviceManager.hpp>
 #include <Drivers/Storage/NVMe/NVMeController.hpp>
@@ -15,6 +14,10 @@
 
 #include <Memory/PMM.hpp>
 
+#include <Prism/Utility/Math.hpp>
+
+#include <Time/Time.hpp>
+
 #include <VFS/DevTmpFs/DevTmpFs.hpp>
 #include <VFS/VFS.hpp>
 
@@ -36,12 +39,28 @@ namespace NVMe
         u64 lbaShift     = info->LbaFormatUpper[formattedLba].DataSize;
         u64 maxLbas      = 1 << (m_Controller->GetMaxTransShift() - lbaShift);
         m_MaxPhysRPages  = (maxLbas * (1 << lbaShift)) / PMM::PAGE_SIZE;
-
-        if (!m_Controller->CreateIoQueues(*this, m_IoQueue, m_ID)) return false;
-        m_Cache            = new CachedBlock[512];
-        m_LbaSize          = 1 << info->LbaFormatUpper[formattedLba].DataSize;
-        m_CacheBlockSize   = m_LbaSize * 4;
-        m_LbaCount         = info->TotalBlockCount;
+        // PRP lists aren't chained, so each has to fit within a single page
+        m_MaxPhysRPages
+            = Math::Min(m_MaxPhysRPages, PMM::PAGE_SIZE / sizeof(u64));
+
+        m_LbaSize  = 1 << info->LbaFormatUpper[formattedLba].DataSize;
+        m_LbaCount = info->TotalBlockCount;
+
+        BlockQueueLimits limits;
+        limits.SectorSize = m_LbaSize;
+        // The length of a transfer is encoded in 16 bits, in the units of LBAs
+        limits.MaxRequestBytes
+            = Math::Min(m_MaxPhysRPages * PMM::PAGE_SIZE, 0x10000 * m_LbaSize);
+        limits.BoundaryMask = PMM::PAGE_SIZE - 1;
+        // SGLs allow any alignment, but a command's list must fit within a page
+        if (m_Controller->SupportsSgl())
+        {
+            limits.BoundaryMask = 0;
+            limits.MaxSegments  = PMM::PAGE_SIZE / sizeof(SglDescriptor);
+        }
+        // Requests mostly land on a single queue, one slot of which stays empty
+        limits.MaxInFlight  = m_Controller->GetIoQueueDepth() - 1;
+        m_RequestQueue.SetLimits(limits);
 
         m_Stats.st_size    = info->TotalBlockCount * m_LbaSize;
         m_Stats.st_blocks  = info->TotalBlockCount;
@@ -56,26 +75,11 @@ namespace NVMe
         LogTrace("NVMe: Creating device at '{}'", path);
         VFS::CreateNode(path, m_Stats.st_mode, ID());
         DeviceManager::RegisterBlockDevice(this);
+        SetWriteBack(true);
         // TODO(v1tr10l7): enumerate partitions
 
         m_PartitionTable.Load(*this);
 
-        for (usize i = 0; i < m_IoQueue->GetDepth(); i++)
-        {
-            break;
-            auto handler = InterruptManager::AllocateHandler();
-            handler->Reserve();
-            /*
-            if (!MsiXSet(CPU::GetCurrent()->LapicID,
-                         handler->GetInterruptVector(), -1))
-            {
-                if (i == 0)
-                    LogError(
-                        "Could not install any irq handlers for io queues");
-                break;
-            }*/
-        }
-
         usize i = 1;
         for (const auto& entry : m_PartitionTable)
         {
@@ -83,6 +87,7 @@ namespace NVMe
                 *this, entry.FirstBlock, entry.LastBlock, 292, i);
             DevTmpFs::RegisterDevice(partition);
             DeviceManager::RegisterBlockDevice(partition);
+            partition->SetWriteBack(true);
 
             StringView partitionPath
                 = fmt::format("/dev/{}n{}p{}", m_Controller->Name(), m_ID, i)
@@ -94,70 +99,92 @@ namespace NVMe
         return true;
     }
 
-    ErrorOr<isize> NameSpace::Read(void* dest, off_t offset, usize bytes)
+    void NameSpace::StartRequest(BlockRequest* request)
     {
-        ScopedLock guard(m_Lock);
-
-        for (usize progress = 0; progress < bytes;)
+        usize sectors = request->Bytes / m_LbaSize;
+        if (request->Sector + sectors > m_LbaCount)
         {
-            u64 sector = (offset + progress) / m_CacheBlockSize;
-            i32 slot   = FindBlock(sector);
-            if (slot == -1) slot = CacheBlock(sector);
-            if (slot == -1) return -1;
-
-            u64   chunk = bytes - progress;
-            usize off   = (offset + progress) % m_CacheBlockSize;
-            if (chunk > m_CacheBlockSize - off) chunk = m_CacheBlockSize - off;
+            m_RequestQueue.Complete(request, ENXIO);
+            return;
+        }
 
-            Memory::Copy(reinterpret_cast<u8*>(dest) + progress,
-                        &m_Cache[slot].Cache[off], chunk);
-            progress += chunk;
+        // Without a volatile write cache, completed writes are already durable
+        bool flush = request->Direction == BlockDirection::eFlush;
+        if (flush && !m_Controller->HasWriteCache())
+        {
+            m_RequestQueue.Complete(request, 0);
+            return;
         }
 
-        return bytes;
-    }
-    ErrorOr<isize> NameSpace::Write(const void* src, off_t offset, usize bytes)
-    {
-        ScopedLock guard(m_Lock);
+        Submission cmd  = {};
+        cmd.NameSpaceID = m_ID;
+        if (flush) cmd.OpCode = OpCode::IO_FLUSH;
+        else
+        {
+            cmd.OpCode         = request->Direction == BlockDirection::eWrite
+                                   ? OpCode::IO_WRITE
+                                   : OpCode::IO_READ;
+            cmd.ReadWrite.SLba = request->Sector;
+            cmd.ReadWrite.Len  = sectors - 1;
+        }
 
-        for (usize progress = 0; progress < bytes;)
+        // Submit to the current cpu's queue, fall back to the others if it's
+        // full, and reap once all of them are
+        usize cpu        = CPU::GetCurrentID();
+        usize queueCount = m_Controller->GetIoQueueCount();
+        for (usize attempt = 0;; ++attempt)
         {
-            u64 sector = (offset + progress) / m_CacheBlockSize;
-            i32 slot   = FindBlock(sector);
-            if (slot == -1)
+            Queue* queue = m_Controller->GetIoQueue(cpu + attempt);
+            request->SetHardwareQueue((cpu + attempt) % queueCount);
+
+            i32 status = queue->SubmitRequest(*this, request, cmd);
+            if (status == 0) return;
+            if (status != EAGAIN)
             {
-                slot = CacheBlock(sector);
-                if (slot == -1) return -1;
+                m_RequestQueue.Complete(request, status);
+                return;
             }
 
-            u64   chunk = bytes - progress;
-            usize off   = (offset + progress) % m_CacheBlockSize;
-            if (chunk > m_CacheBlockSize - off) chunk = m_CacheBlockSize - off;
-
-            const u8* dest = reinterpret_cast<const u8*>(src) + progress;
-            Memory::Copy(&m_Cache[slot].Cache[off], dest, chunk);
-            m_Cache[slot].Status = CacheReady;
-
-            i32 nwritten         = ReadWriteLba(m_Cache[slot].Cache,
-                                                (m_CacheBlockSize / m_LbaSize)
-                                                    * m_Cache[slot].Block,
-                                                m_CacheBlockSize / m_LbaSize, true);
-            if (nwritten == -1) return -1;
-            progress += chunk;
+            if ((attempt + 1) % queueCount == 0 && queue->Reap() == 0)
+                Arch::Pause();
         }
-
-        return bytes;
     }
-
-    ErrorOr<isize> NameSpace::Read(const UserBuffer& out, usize count,
-                                   isize offset)
+    void NameSpace::CommitRequests()
     {
-        return Read(out.Raw(), offset, count);
+        // Without interrupts, whoever starts the requests waits for them too
+        if (!m_Controller->HasIoInterrupts()) m_Controller->PollIoQueues();
     }
-    ErrorOr<isize> NameSpace::Write(const UserBuffer& in, usize count,
-                                    isize offset)
+    i32 NameSpace::Wait(Bio& bio)
     {
-        return NameSpace::Write(in.Raw(), offset, count);
+        // Small reads often complete sooner than a sleep and wakeup take, so
+        // spin for up to twice their average latency first
+        constexpr u64 MAX_POLLED_LATENCY = 50'000;
+
+        // The thread might have migrated since the submission, so we poll the
+        // queue, the bio went to, rather than the current cpu's one
+        isize index = bio.HardwareQueue();
+        if (bio.Direction == BlockDirection::eRead
+            && bio.Bytes() <= POLLED_READ_MAX_BYTES
+            && m_Controller->HasIoInterrupts() && index >= 0)
+        {
+            Queue* queue   = m_Controller->GetIoQueue(index);
+            u64    latency = queue->GetReadLatency();
+            if (latency <= MAX_POLLED_LATENCY)
+            {
+                u64 budget   = latency ? latency * 2 : MAX_POLLED_LATENCY;
+                u64 deadline = Time::GetMonotonicTime().Nanoseconds() + budget;
+                while (!bio.IsCompleted() && queue->GetInFlight() > 0)
+                {
+                    if (queue->Reap() > 0) continue;
+                    if (Time::GetMonotonicTime().Nanoseconds() >= deadline)
+                        break;
+
+                    Arch::Pause();
+                }
+            }
+        }
+
+        return bio.Wait();
     }
 
     StringView NameSpace::Name() const noexcept
@@ -179,104 +206,4 @@ namespace NVMe
 
         return true;
     }
-
-    isize NameSpace::ReadWriteLba(u8* dest, usize start, usize bytes, u8 write)
-    {
-        if (start + bytes >= m_LbaCount) bytes -= (start + bytes) - m_LbaCount;
-
-        usize pageOff          = u64(dest) & (PMM::PAGE_SIZE - 1);
-        bool  shouldUsePrp     = false;
-        bool  shouldUsePrpList = false;
-
-        u32   cid              = m_IoQueue->GetCommandID();
-
-        if ((bytes * m_LbaSize) > PMM::PAGE_SIZE)
-        {
-            if ((bytes * m_LbaSize) > (PMM::PAGE_SIZE * 2))
-            {
-                usize prpcount = ((bytes - 1) * m_LbaSize) / PMM::PAGE_SIZE;
-                AssertFmt(!(prpcount > m_MaxPhysRPages),
-                          "NVMe: Exceeded physical region pages, prpcount => "
-                          "{:#x}, bytes => {:#x}",
-                          prpcount, bytes);
-                for (usize i = 0; i < prpcount; i++)
-                {
-                    m_IoQueue->GetPhysRegPages()[i + cid * m_MaxPhysRPages]
-                        = (Pointer(dest - pageOff).FromHigherHalf<u64>()
-                           + PMM::PAGE_SIZE + i * PMM::PAGE_SIZE);
-                }
-                shouldUsePrp     = false;
-                shouldUsePrpList = true;
-            }
-            else shouldUsePrp = true;
-        }
-
-        Submission cmd        = {};
-        cmd.OpCode            = write ? OpCode::IO_WRITE : OpCode::IO_READ;
-        cmd.Flags             = 0;
-        cmd.NameSpaceID       = m_ID;
-        cmd.ReadWrite.Control = 0;
-        cmd.ReadWrite.Dsmgmt  = 0;
-        cmd.ReadWrite.Ref     = 0;
-        cmd.ReadWrite.AppTag  = 0;
-        cmd.ReadWrite.AppMask = 0;
-        cmd.Metadata          = 0;
-        cmd.ReadWrite.SLba    = start;
-        cmd.ReadWrite.Len     = bytes - 1;
-        if (shouldUsePrpList)
-        {
-            cmd.Prp1 = Pointer(dest).FromHigherHalf<u64>();
-            cmd.Prp2
-                = Pointer(&m_IoQueue->GetPhysRegPages()[cid * m_MaxPhysRPages])
-                      .FromHigherHalf<u64>();
-        }
-        else if (shouldUsePrp)
-            cmd.Prp2 = Pointer(dest)
-                           .Offset<Pointer>(PMM::PAGE_SIZE)
-                           .FromHigherHalf<u64>();
-
-        else cmd.Prp1 = Pointer(dest).FromHigherHalf<u64>();
-
-        u16 status = m_IoQueue->AwaitSubmit(&cmd);
-        AssertFmt(!status, "nvme: failed to read/write with status {:#x}\n",
-                  status);
-        return 0;
-    }
-
-    isize NameSpace::FindBlock(u64 block)
-    {
-        for (usize i = 0; i < 512; i++)
-            if (m_Cache[i].Block == block && m_Cache[i].Status) return i;
-
-        return -1;
-    }
-    isize NameSpace::CacheBlock(u64 block)
-    {
-        i32 target = 0;
-
-        for (target = 0; target < 512; target++)
-            if (!m_Cache[target].Status)
-            {
-                m_Cache[target].Cache = new u8[m_CacheBlockSize];
-                goto write;
-            }
-
-        if (m_Overwritten == 512)
-        {
-            m_Overwritten = 0;
-            target        = m_Overwritten;
-        }
-        else target = m_Overwritten++;
-
-    write:
-        auto lba = ReadWriteLba(m_Cache[target].Cache,
-                                (m_CacheBlockSize / m_LbaSize) * block,
-                                m_CacheBlockSize / m_LbaSize, 0);
-        if (lba == -1) return lba;
-
-        m_Cache[target].Block  = block;
-        m_Cache[target].Status = CacheReady;
-
-        return target;
-    }
 }; // namespace NVMe
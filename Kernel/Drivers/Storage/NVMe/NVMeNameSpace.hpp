@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 24.01.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -53,15 +53,6 @@ namespace NVMe
         u8  VendorSpecific[3712];
     };
 
-    struct CachedBlock
-    {
-        u8* Cache;
-        u64 Block;
-        u64 End;
-        i32 Status;
-    };
-
-    class Queue;
     class NameSpace : public StorageDevice
     {
       public:
@@ -74,40 +65,31 @@ namespace NVMe
 
         virtual StringView Name() const noexcept override;
 
-        virtual ErrorOr<isize> Read(void* dest, off_t offset,
-                                    usize bytes) override;
-        virtual ErrorOr<isize> Write(const void* src, off_t offset,
-                                     usize bytes) override;
-
-        virtual ErrorOr<isize> Read(const UserBuffer& out, usize count,
-                                    isize offset = -1) override;
-        virtual ErrorOr<isize> Write(const UserBuffer& in, usize count,
-                                     isize offset = -1) override;
+        virtual u64        SectorCount() const override { return m_LbaCount; }
 
         virtual i32 IoCtl(usize request, uintptr_t argp) override { return 0; }
 
-      private:
-        Spinlock               m_Lock;
-        u32                    m_ID            = 0;
-        Controller*            m_Controller    = nullptr;
-        usize                  m_MaxPhysRPages = 0;
-        Queue*                 m_IoQueue;
-
-        u64                    m_LbaSize        = 0;
-        u64                    m_LbaCount       = 0;
-        u64                    m_CacheBlockSize = 0;
-        CachedBlock*           m_Cache          = nullptr;
-        usize                  m_Overwritten    = 0;
+        virtual void StartRequest(BlockRequest* request) override;
+        virtual void CommitRequests() override;
+        virtual i32  Wait(Bio& bio) override;
 
-        static constexpr usize CacheWait        = 0;
-        static constexpr usize CacheReady       = 1;
-        static constexpr usize CacheDirty       = 2;
+        /**
+         * @brief Called by the I/O queues, once the controller is done with
+         * the request
+         */
+        inline void  CompleteRequest(BlockRequest* request, i32 status)
+        {
+            m_RequestQueue.Complete(request, status);
+        }
 
-        bool                   Identify(NameSpaceInfo* nsid);
+      private:
+        u32         m_ID            = 0;
+        Controller* m_Controller    = nullptr;
+        usize       m_MaxPhysRPages = 0;
 
-        isize ReadWriteLba(u8* ddest, usize start, usize bytes, u8 write);
+        u64         m_LbaSize       = 0;
+        u64         m_LbaCount      = 0;
 
-        isize FindBlock(u64 block);
-        isize CacheBlock(u64 block);
+        bool        Identify(NameSpaceInfo* nsid);
     };
 }; // namespace NVMe
@@ -1,16 +1,22 @@
 /*
  * Created by v1tr10l7 on 24.01.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
 #include <Common.hpp>
 
+#include <Drivers/Storage/BlockRequest.hpp>
 #include <Drivers/Storage/NVMe/NVMeNameSpace.hpp>
 #include <Drivers/Storage/NVMe/NVMeQueue.hpp>
 
 #include <Memory/PMM.hpp>
 
+#include <Prism/Containers/Array.hpp>
+#include <Prism/Utility/Math.hpp>
+
+#include <Time/Time.hpp>
+
 namespace NVMe
 {
     using Prism::Pointer;
@@ -24,14 +30,22 @@ namespace NVMe
         auto completeDbOffset
             = PMM::PAGE_SIZE + (m_ID * 2 + 1) * (4 << doorbellShift);
 
-        m_Submit = new volatile Submission[depth];
+        // The rings must be physically contiguous, and page aligned
+        usize submitPages = Math::DivRoundUp(depth * sizeof(Submission),
+                                             PMM::PAGE_SIZE);
+        usize completePages = Math::DivRoundUp(depth * sizeof(Completion),
+                                               PMM::PAGE_SIZE);
+
+        m_Submit = Pointer(PMM::CallocatePages(submitPages))
+                       .ToHigherHalf<volatile Submission*>();
         m_SubmitDoorbell
             = crAddress.Offset<Pointer>(submitDbOffset).As<volatile u32>();
 
         m_SubmitHead = 0;
         m_SubmitTail = 0;
 
-        m_Complete   = new volatile Completion[depth];
+        m_Complete   = Pointer(PMM::CallocatePages(completePages))
+                         .ToHigherHalf<volatile Completion*>();
 
         m_CompleteDoorbell
             = crAddress.Offset<Pointer>(completeDbOffset).As<volatile u32>();
@@ -40,16 +54,24 @@ namespace NVMe
         m_CompletePhase = 1;
 
         m_CmdId         = 0;
-        m_PhysRegPgs    = nullptr;
+        m_Commands      = new Command[depth];
     }
-    Queue::Queue(Pointer crAddress, NameSpace& ns, u16 qid, u32 doorbellShift,
-                 u64 depth)
-        : Queue(crAddress, qid, doorbellShift, depth)
+    Queue::~Queue()
     {
-        m_PhysRegPgs = new u64[ns.GetMaxPhysRPgs() * depth];
+        for (usize i = 0; i < m_Depth; ++i)
+            if (m_Commands[i].List)
+                PMM::FreePages(m_Commands[i].List.Raw(), 1);
+        delete[] m_Commands;
+
+        PMM::FreePages(Pointer(m_Submit).FromHigherHalf(),
+                       Math::DivRoundUp(m_Depth * sizeof(Submission),
+                                        PMM::PAGE_SIZE));
+        PMM::FreePages(Pointer(m_Complete).FromHigherHalf(),
+                       Math::DivRoundUp(m_Depth * sizeof(Completion),
+                                        PMM::PAGE_SIZE));
     }
 
-    u16 Queue::AwaitSubmit(Submission* cmd)
+    u16 Queue::AwaitSubmit(Submission* cmd, u32* result)
     {
         u16 currentHead  = m_CompleteHead;
         u16 currentPhase = m_CompletePhase;
@@ -65,6 +87,7 @@ namespace NVMe
 
         status >>= 1;
         AssertFmt(!status, "NVMe: Command error: {:#x}", status);
+        if (result) *result = m_Complete[m_CompleteHead].Result;
 
         currentHead = (currentHead + 1) % m_Depth;
         if (currentHead == 0) currentPhase = !currentPhase;
@@ -87,4 +110,225 @@ namespace NVMe
         *(m_SubmitDoorbell) = currentTail;
         m_SubmitTail        = currentTail;
     }
+
+    i32 Queue::SubmitRequest(NameSpace& owner, BlockRequest* request,
+                             Submission& cmd)
+    {
+        ScopedLock guard(m_Lock, true);
+        // One slot always stays empty to tell a full queue from an empty one
+        if (m_InFlight.Load() + 1 >= m_Depth) return EAGAIN;
+
+        u16 cid = m_NextSlot;
+        while (m_Commands[cid].Request) cid = (cid + 1) % m_Depth;
+        m_NextSlot       = (cid + 1) % m_Depth;
+
+        Command& command = m_Commands[cid];
+        command.Request  = request;
+        command.Owner    = &owner;
+        // Flushes don't carry any data
+        bool described = request->Bytes == 0;
+        if (!described)
+            described = m_UseSgl ? SetupScatterGatherList(command, cmd)
+                                 : SetupDataPointers(command, cmd);
+        if (!described)
+        {
+            command.Request = nullptr;
+            command.Owner   = nullptr;
+            return ENOMEM;
+        }
+
+        command.Issued = 0;
+        if (request->Direction == BlockDirection::eRead
+            && request->Bytes <= POLLED_READ_MAX_BYTES)
+            command.Issued = Time::GetMonotonicTime().Nanoseconds();
+
+        cmd.CompleteID = cid;
+        ++m_InFlight;
+        Submit(&cmd);
+
+        return 0;
+    }
+
+    usize Queue::Reap()
+    {
+        // Completions may start new requests, so they run unlocked, in small
+        // batches
+        constexpr usize BATCH_SIZE = 32;
+        struct Batch
+        {
+            struct Entry
+            {
+                BlockRequest* Request;
+                NameSpace*    Owner;
+                i32           Status;
+            };
+
+            Array<Entry, BATCH_SIZE> Entries{};
+            usize                    Count = 0;
+            u64                      Now   = 0;
+        };
+
+        usize total = 0;
+        for (;;)
+        {
+            Batch             batch;
+            CompletionHandler handler;
+            handler.BindLambda(
+                [this, &batch](u16 cid, u16 status)
+                {
+                    if (cid >= m_Depth || !m_Commands[cid].Request)
+                    {
+                        LogError("NVMe: Completion of an unknown command #{}",
+                                 cid);
+                        return;
+                    }
+
+                    Command& command = m_Commands[cid];
+                    if (command.Issued && batch.Now > command.Issued)
+                    {
+                        u64 sample  = batch.Now - command.Issued;
+                        u64 average = m_ReadLatency.Load();
+                        m_ReadLatency.Store(
+                            average ? (average * 7 + sample) / 8 : sample);
+                    }
+
+                    batch.Entries[batch.Count++]
+                        = {command.Request, command.Owner, status ? EIO : 0};
+                    command.Request = nullptr;
+                    command.Owner   = nullptr;
+                    --m_InFlight;
+                });
+
+            {
+                ScopedLock guard(m_Lock, true);
+                if (m_InFlight.Load() == 0) return total;
+
+                batch.Now = Time::GetMonotonicTime().Nanoseconds();
+                ProcessCompletions(handler, BATCH_SIZE);
+            }
+
+            for (usize i = 0; i < batch.Count; ++i)
+            {
+                auto& entry = batch.Entries[i];
+                entry.Owner->CompleteRequest(entry.Request, entry.Status);
+            }
+
+            total += batch.Count;
+            if (batch.Count < BATCH_SIZE) return total;
+        }
+    }
+
+    usize Queue::ProcessCompletions(CompletionHandler handler, usize max)
+    {
+        usize processed = 0;
+        while (processed < max)
+        {
+            volatile Completion& entry  = m_Complete[m_CompleteHead];
+            u16                  status = entry.Status;
+            if ((status & 0x01) != m_CompletePhase) break;
+
+            u16 cid        = entry.CommandID;
+            m_SubmitHead   = entry.SubmitQueueHead;
+
+            m_CompleteHead = (m_CompleteHead + 1) % m_Depth;
+            if (m_CompleteHead == 0) m_CompletePhase = !m_CompletePhase;
+
+            handler(cid, status >> 1);
+            ++processed;
+        }
+
+        // The doorbell is rung once per batch
+        if (processed > 0) *(m_CompleteDoorbell) = m_CompleteHead;
+        return processed;
+    }
+
+    bool Queue::SetupDataPointers(Command& command, Submission& cmd)
+    {
+        // PRP1 points at the first page, PRP2 at the second one, or at the list
+        // of the rest
+        u64*  list   = nullptr;
+        usize pages  = 0;
+        bool  failed = false;
+        command.Request->ForEachSegment(
+            [&](const BlockSegment& segment)
+            {
+                uintptr_t address = segment.Physical.Raw();
+                for (usize left = segment.Length; left > 0 && !failed;)
+                {
+                    usize pageOffset = address & (PMM::PAGE_SIZE - 1);
+                    usize chunk = Math::Min(left, PMM::PAGE_SIZE - pageOffset);
+
+                    if (pages == 0) cmd.Prp1 = address;
+                    else if (pages == 1) cmd.Prp2 = address;
+                    else
+                    {
+                        if (!list)
+                        {
+                            if (!command.List)
+                                command.List = PMM::AllocatePages(1);
+                            if (!command.List)
+                            {
+                                failed = true;
+                                break;
+                            }
+
+                            list     = command.List.ToHigherHalf<u64*>();
+                            list[0]  = cmd.Prp2;
+                            cmd.Prp2 = command.List.Raw();
+                        }
+
+                        Assert(pages <= PMM::PAGE_SIZE / sizeof(u64));
+                        list[pages - 1] = address;
+                    }
+
+                    ++pages;
+                    address += chunk;
+                    left    -= chunk;
+                }
+            });
+
+        return !failed;
+    }
+    bool Queue::SetupScatterGatherList(Command& command, Submission& cmd)
+    {
+        // A single segment fits the command, more of them need a list within
+        // one page
+        auto request    = command.Request;
+        auto descriptor = reinterpret_cast<SglDescriptor*>(&cmd.Prp1);
+        cmd.Flags      |= SUBMISSION_FLAGS_SGL;
+        if (request->Segments == 1)
+        {
+            request->ForEachSegment(
+                [&](const BlockSegment& segment)
+                {
+                    descriptor->Address = segment.Physical.Raw();
+                    descriptor->Length  = segment.Length;
+                    descriptor->Type    = SglType::DATA_BLOCK;
+                });
+
+            return true;
+        }
+
+        Assert(request->Segments <= PMM::PAGE_SIZE / sizeof(SglDescriptor));
+        if (!command.List) command.List = PMM::AllocatePages(1);
+        if (!command.List) return false;
+
+        auto  list  = command.List.ToHigherHalf<SglDescriptor*>();
+        usize count = 0;
+        request->ForEachSegment(
+            [&](const BlockSegment& segment)
+            {
+                list[count++] = {
+                    .Address  = segment.Physical.Raw(),
+                    .Length   = static_cast<u32>(segment.Length),
+                    .Reserved = {},
+                    .Type     = SglType::DATA_BLOCK,
+                };
+            });
+
+        descriptor->Address = command.List.Raw();
+        descriptor->Length  = count * sizeof(SglDescriptor);
+        descriptor->Type    = SglType::LAST_SEGMENT;
+        return true;
+    }
 }; // namespace NVMe
@@ -1,13 +1,19 @@
 /*
  * Created by v1tr10l7 on 24.01.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
 #pragma once
 
+#include <Library/Locking/Spinlock.hpp>
+
 #include <Prism/Core/Types.hpp>
 #include <Prism/Memory/Pointer.hpp>
+#include <Prism/Utility/Atomic.hpp>
+#include <Prism/Utility/Delegate.hpp>
+
+class BlockRequest;
 
 namespace NVMe
 {
@@ -97,6 +103,22 @@ namespace NVMe
             Abort                 Abort;
         };
     };
+    struct SglDescriptor
+    {
+        u64 Address;
+        u32 Length;
+        u8  Reserved[3];
+        // The descriptor type is in the upper nibble, subtype in the lower one
+        u8  Type;
+    };
+    namespace SglType
+    {
+        constexpr u8 DATA_BLOCK   = 0x00;
+        constexpr u8 LAST_SEGMENT = 0x30;
+    }; // namespace SglType
+    // PSDT field of the submission flags, the data are described by SGLs
+    constexpr u8 SUBMISSION_FLAGS_SGL = 0x40;
+
     struct Completion
     {
         u32 Result;
@@ -107,27 +129,80 @@ namespace NVMe
         u16 Status;
     };
 
+    // Reads up to this size are latency sensitive, and might be polled for
+    constexpr usize POLLED_READ_MAX_BYTES = 16 * 1024;
+
     class NameSpace;
+    /**
+     * @brief Submission and completion queue pair, the admin queue is driven
+     * synchronously with AwaitSubmit, the I/O queues carry many commands at
+     * once, each of which occupies one of the command slots, until it's
+     * reaped, either by the queue's interrupt handler, or by a poller
+     */
     class Queue
     {
       public:
+        using CompletionHandler = Delegate<void(u16 cid, u16 status)>;
+
         Queue() = default;
         Queue(Pointer crAddress, u16 qid, u32 doorbellShift, u64 depth);
-        Queue(Pointer crAddress, NameSpace& ns, u16 qid, u32 doorbellShift,
-              u64 depth);
+        ~Queue();
 
+        inline u16                  GetID() const { return m_ID; }
         inline volatile Submission* GetSubmit() const { return m_Submit; }
         inline volatile Completion* GetComplete() const { return m_Complete; }
 
         inline usize                GetDepth() const { return m_Depth; }
 
         inline u32                  GetCommandID() const { return m_CmdId; }
-        inline u64*                 GetPhysRegPages() { return m_PhysRegPgs; }
+        /**
+         * @brief Describes the data of the I/O commands with SGLs, instead of
+         * PRPs, the segments then don't have to be page aligned
+         */
+        inline void SetUseSgl(bool useSgl) { m_UseSgl = useSgl; }
 
-        u16                         AwaitSubmit(Submission* submission);
-        void                        Submit(Submission* cmd);
+        /**
+         * @brief Submits the command and busy waits for its completion,
+         * storing dword 0 of the completion entry in `result`, if provided
+         */
+        u16   AwaitSubmit(Submission* submission, u32* result = nullptr);
+        void  Submit(Submission* cmd);
+
+        /**
+         * @brief Submits an I/O command, which transfers the request's data,
+         * it's completed with NameSpace::CompleteRequest once the controller
+         * is done with it
+         *
+         * @return 0 on success, EAGAIN if all of the command slots are taken
+         */
+        i32   SubmitRequest(NameSpace& owner, BlockRequest* request,
+                            Submission& cmd);
+        /**
+         * @brief Reaps the completion queue, completing the requests of all
+         * of the posted entries, safe to be called from both the interrupt
+         * handler and the pollers concurrently
+         *
+         * @return Number of the requests completed
+         */
+        usize Reap();
+
+        inline usize GetInFlight() const { return m_InFlight.Load(); }
+        // Moving average of the small reads' latency, in nanoseconds
+        inline u64   GetReadLatency() const { return m_ReadLatency.Load(); }
 
       private:
+        struct Command
+        {
+            BlockRequest* Request = nullptr;
+            NameSpace*    Owner   = nullptr;
+            // Page holding the PRP, or the SGL list, allocated by the first
+            // command in this slot, which needs one, and kept for the ones
+            // that follow
+            Pointer       List    = nullptr;
+            // When was the command submitted, only tracked for small reads
+            u64           Issued  = 0;
+        };
+
         u16                  m_ID               = 0;
         u16                  m_Depth            = 0;
         volatile Submission* m_Submit           = nullptr;
@@ -140,6 +215,16 @@ namespace NVMe
         u16                  m_CompleteHead     = 0;
         u8                   m_CompletePhase    = 0;
         u32                  m_CmdId            = 0;
-        u64*                 m_PhysRegPgs       = nullptr;
+
+        Spinlock             m_Lock;
+        Command*             m_Commands         = nullptr;
+        u16                  m_NextSlot         = 0;
+        Atomic<usize>        m_InFlight         = 0;
+        Atomic<u64>          m_ReadLatency      = 0;
+        bool                 m_UseSgl           = false;
+
+        usize ProcessCompletions(CompletionHandler handler, usize max);
+        bool  SetupDataPointers(Command& command, Submission& cmd);
+        bool  SetupScatterGatherList(Command& command, Submission& cmd);
     };
 }; // namespace NVMe
@@ -1,24 +1,54 @@
 /*
  * Created by v1tr10l7 on 26.01.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
 #pragma once
 
-#include <Drivers/Core/Device.hpp>
+#include <Drivers/Storage/BlockDevice.hpp>
+#include <Drivers/Storage/BlockQueue.hpp>
 #include <Drivers/Storage/PartitionTable.hpp>
 
-class StorageDevice : public Device
+class StorageDevice : public BlockDevice
 {
   public:
     StorageDevice(u16 major, u16 minor)
-        : Device(major, minor)
+        : BlockDevice(major, minor)
+        , m_RequestQueue(*this)
     {
     }
 
-    void LoadPartitionTable();
+    void                LoadPartitionTable();
+
+    inline BlockQueue&  GetRequestQueue() { return m_RequestQueue; }
+
+    virtual usize       MaxTransferBytes() const override
+    {
+        return m_RequestQueue.Limits().MaxRequestBytes;
+    }
+    virtual usize       MaxSegments() const override
+    {
+        return m_RequestQueue.Limits().MaxSegments;
+    }
+
+    virtual void Submit(Bio* bio) override { m_RequestQueue.Submit(bio); }
+    virtual void Plug() override { m_RequestQueue.Plug(); }
+    virtual void Unplug() override { m_RequestQueue.Unplug(); }
+
+    /**
+     * @brief Called by the request queue to hand the request over to the
+     * hardware, the driver reports its completion with BlockQueue::Complete,
+     * either right away, or once the device is done with it
+     */
+    virtual void StartRequest(BlockRequest* request) = 0;
+    /**
+     * @brief Called by the request queue, after it has started a batch of
+     * requests, e.g. to ring the doorbell once for all of them
+     */
+    virtual void CommitRequests() {}
 
   protected:
     PartitionTable m_PartitionTable;
+    BlockQueue     m_RequestQueue;
 };
@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 28.01.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -8,7 +8,7 @@
 
 #include <Drivers/Storage/StorageDevice.hpp>
 
-class StorageDevicePartition : public Device
+class StorageDevicePartition : public BlockDevice
 {
   public:
     StorageDevicePartition(StorageDevice& device, u64 firstBlock, u64 lastBlock,
@@ -19,38 +19,36 @@ class StorageDevicePartition : public Device
         return m_Device.Name();
     }
 
-    virtual ErrorOr<isize> Read(void* dest, off_t offset, usize bytes) override
+    virtual u64 SectorCount() const override
     {
-        // if (m_FirstBlock + offset >= m_LastBlock) return_err(-1, ENODEV);
-        return m_Device.Read(
-            dest, m_Device.Stats().st_blksize * m_FirstBlock + offset, bytes);
+        return m_LastBlock - m_FirstBlock + 1;
     }
-    virtual ErrorOr<isize> Write(const void* src, off_t offset,
-                                 usize bytes) override
+    virtual usize MaxTransferBytes() const override
     {
-        // if (m_FirstBlock + offset >= m_LastBlock) return_err(-1, ENODEV);
-        return m_Device.Write(
-            src, m_Device.Stats().st_blksize * m_FirstBlock + offset, bytes);
+        return m_Device.MaxTransferBytes();
     }
-
-    virtual ErrorOr<isize> Read(const UserBuffer& out, usize count,
-                                isize offset = -1) override
+    virtual usize MaxSegments() const override
     {
-        return Read(out.Raw(), offset, count);
+        return m_Device.MaxSegments();
     }
-    virtual ErrorOr<isize> Write(const UserBuffer& in, usize count,
-                                 isize offset = -1) override
+
+    // Remapped onto the whole device, so they merge with its other bios
+    virtual void Submit(Bio* bio) override
     {
-        return Write(in.Raw(), offset, count);
+        bio->Sector += m_FirstBlock;
+        m_Device.Submit(bio);
     }
+    virtual void Plug() override { m_Device.Plug(); }
+    virtual void Unplug() override { m_Device.Unplug(); }
+    virtual i32  Wait(Bio& bio) override { return m_Device.Wait(bio); }
 
-    virtual i32 IoCtl(usize request, uintptr_t argp) override
+    virtual i32  IoCtl(usize request, uintptr_t argp) override
     {
         return m_Device.IoCtl(request, argp);
     }
 
   private:
-    StorageDevice&  m_Device;
-    u64             m_FirstBlock;
-    CTOS_UNUSED u64 m_LastBlock;
+    StorageDevice& m_Device;
+    u64            m_FirstBlock;
+    u64            m_LastBlock;
 };
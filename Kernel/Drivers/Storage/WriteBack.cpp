@@ -0,0 +1,94 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#include <Drivers/Storage/BlockDevice.hpp>
+#include <Drivers/Storage/WriteBack.hpp>
+
+#include <Library/Locking/Spinlock.hpp>
+
+#include <Prism/Containers/Vector.hpp>
+
+#include <Scheduler/Process.hpp>
+#include <Scheduler/Scheduler.hpp>
+
+#include <Time/Time.hpp>
+#include <VFS/PageCache.hpp>
+
+namespace WriteBack
+{
+    namespace
+    {
+        // Pages dirty for 5s are written back twice a second. Above 1/10 of the
+        // cache all of them are, above 1/5 the writers have to write back
+        // themselves
+        constexpr u64   FLUSH_INTERVAL     = 500'000'000;
+        constexpr u64   DIRTY_EXPIRE       = 5'000'000'000;
+        constexpr usize BACKGROUND_DIVISOR = 10;
+        constexpr usize THROTTLE_DIVISOR   = 5;
+
+        // The devices are never unregistered, so the list only ever grows
+        Spinlock             s_Lock;
+        Vector<BlockDevice*> s_Devices;
+
+        bool                 TooManyDirty(usize divisor)
+        {
+            auto stats = PageCache::GetStatistics();
+            return stats.Dirty > stats.Limit / divisor;
+        }
+        template <typename F>
+        void ForEachDevice(F&& callback)
+        {
+            for (usize i = 0;; ++i)
+            {
+                BlockDevice* device = nullptr;
+                {
+                    ScopedLock guard(s_Lock, true);
+                    if (i >= s_Devices.Size()) return;
+                    device = s_Devices[i];
+                }
+
+                callback(device);
+            }
+        }
+
+        void Flusher()
+        {
+            for (;;)
+            {
+                Time::NanoSleep(FLUSH_INTERVAL);
+
+                u64 now    = Time::GetMonotonicTime().Nanoseconds();
+                u64 cutoff = now > DIRTY_EXPIRE ? now - DIRTY_EXPIRE : 0;
+                if (TooManyDirty(BACKGROUND_DIVISOR)) cutoff = u64(-1);
+
+                ForEachDevice([cutoff](BlockDevice* device)
+                              { device->WriteBackPages(cutoff); });
+            }
+        }
+    }; // namespace
+
+    void Initialize()
+    {
+        auto colonel = Scheduler::KernelProcess();
+        auto flusher = colonel->CreateThread(Flusher, 0);
+        Scheduler::EnqueueThread(flusher.Raw());
+    }
+
+    void Register(BlockDevice* device)
+    {
+        ScopedLock guard(s_Lock, true);
+        s_Devices.PushBack(device);
+    }
+
+    void Balance(BlockDevice& device)
+    {
+        if (TooManyDirty(THROTTLE_DIVISOR)) device.WriteBackPages();
+    }
+    void SyncAll()
+    {
+        ForEachDevice([](BlockDevice* device) { (void)device->Sync(); });
+    }
+}; // namespace WriteBack
@@ -0,0 +1,36 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#pragma once
+
+#include <Prism/Core/Types.hpp>
+
+class BlockDevice;
+/**
+ * @brief Writeback of the block devices, which cache their writes, the
+ * flusher thread periodically writes back the pages, which have been dirty for
+ * too long, and all of them, once they take up too much of the page cache
+ */
+namespace WriteBack
+{
+    /**
+     * @brief Starts the flusher thread
+     */
+    void Initialize();
+
+    void Register(BlockDevice* device);
+
+    /**
+     * @brief Called by the writers, after they've dirtied the pages of
+     * `device`, once the dirty pages take up too much of the cache, they have
+     * to write back the pages of their device on their own
+     */
+    void Balance(BlockDevice& device);
+    /**
+     * @brief Syncs every registered device
+     */
+    void SyncAll();
+}; // namespace WriteBack
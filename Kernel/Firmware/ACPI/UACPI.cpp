@@ -316,7 +316,7 @@ namespace uACPI
         {
             timespec duration;
             duration.tv_sec  = msec / 1000;
-            duration.tv_nsec = msec * 1000;
+            duration.tv_nsec = (msec % 1000) * 1'000'000;
             timespec remaining;
 
             if (Time::Sleep(&duration, &remaining))
@@ -392,9 +392,9 @@ namespace uACPI
         }
         void uacpi_kernel_reset_event(uacpi_handle handle)
         {
-            auto& event   = *reinterpret_cast<Event*>(handle);
+            auto&      event = *reinterpret_cast<Event*>(handle);
+            ScopedLock guard(event.Queue.Lock);
             event.Pending = 0;
-            event.Listeners.Clear();
         }
         uacpi_status
         uacpi_kernel_handle_firmware_request(uacpi_firmware_request*)
@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 16.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -18,6 +18,7 @@
 #include <Drivers/Core/CharacterDevice.hpp>
 #include <Drivers/PCI/PCI.hpp>
 #include <Drivers/Serial.hpp>
+#include <Drivers/Storage/WriteBack.hpp>
 #include <Drivers/TTY.hpp>
 #include <Drivers/Terminal.hpp>
 #include <Drivers/USB/USB.hpp>
@@ -58,6 +59,7 @@
 #include <VFS/INode.hpp>
 #include <VFS/Initrd/Initrd.hpp>
 #include <VFS/MountPoint.hpp>
+#include <VFS/Readahead.hpp>
 #include <VFS/VFS.hpp>
 
 #include <VFS/DevTmpFs/DevTmpFs.hpp>
@@ -125,6 +127,8 @@ static bool loadInitProcess(Path initPath)
 static void kernelThread()
 {
     VFS::Initialize();
+    WriteBack::Initialize();
+    Readahead::Initialize();
 
     CharacterDevice::RegisterBaseMemoryDevices();
     Arch::ProbeDevices();
@@ -156,7 +160,7 @@ static void kernelThread()
     if (moduleDirectory)
     {
         for (const auto& [name, child] : moduleDirectory->Children())
-            System::LoadModule(child);
+            if (!child->IsNegative()) System::LoadModule(child);
     }
 
     LogTrace("Loading init process...");
@@ -7,6 +7,7 @@
 #include <Library/ELF.hpp>
 #include <Library/Module.hpp>
 
+#include <Memory/Allocator/KernelHeap.hpp>
 #include <Memory/AddressSpace.hpp>
 #include <Memory/PMM.hpp>
 #include <Memory/Region.hpp>
@@ -51,11 +52,23 @@ namespace ELF
     }
     ErrorOr<void> Image::Load(INode* inode, Pointer loadBase)
     {
-        isize fileSize = inode->Stats().st_size;
-        m_Image.Resize(fileSize + 100);
-
+        // Only the headers are read, the segments are mapped from the page
+        // cache
+        m_INode    = inode;
         m_LoadBase = loadBase;
-        if (inode->Read(m_Image.Raw(), 0, fileSize) != fileSize)
+
+        struct Header   header;
+        constexpr isize headerSize = sizeof(header);
+        if (inode->CachedRead(&header, 0, headerSize) != headerSize)
+            return Error(ENOEXEC);
+
+        isize headersSize = header.ProgramHeaderTableOffset
+                          + header.ProgramEntryCount * header.ProgramEntrySize;
+        headersSize       = Math::Max(headersSize, headerSize);
+        if (headersSize > inode->Size()) return Error(ENOEXEC);
+
+        m_Image.Resize(headersSize);
+        if (inode->CachedRead(m_Image.Raw(), 0, headersSize) != headersSize)
             return Error(EIO);
         if (!Parse()) return Error(ENOEXEC);
 
@@ -377,8 +390,12 @@ namespace ELF
             return Error(ENOEXEC);
         }
 
-        if (!ParseSectionHeaders()) return Error(ENOEXEC);
-        if (m_SymbolSection && m_StringSection) LoadSymbols();
+        // Executables loaded from files don't need their sections
+        if (!m_INode)
+        {
+            if (!ParseSectionHeaders()) return Error(ENOEXEC);
+            if (m_SymbolSection && m_StringSection) LoadSymbols();
+        }
 
         for (usize i = 0; i < m_Header.ProgramEntryCount; i++)
         {
@@ -391,7 +408,8 @@ namespace ELF
                     break;
                 case HeaderType::eInterp:
                 {
-                    char* path = new char[current->SegmentSizeInFile + 1];
+                    char* path = new (KernelHeap::Uninitialized)
+                        char[current->SegmentSizeInFile + 1];
                     Read(path, current->Offset, current->SegmentSizeInFile);
                     path[current->SegmentSizeInFile] = 0;
 
@@ -413,6 +431,12 @@ namespace ELF
         return {};
     }
 
+    void Image::ReadFromFile(void* buffer, isize offset, isize count)
+    {
+        if (!m_INode || m_INode->CachedRead(buffer, offset, count) != count)
+            Memory::Fill(buffer, 0, count);
+    }
+
     StringView Image::LookupString(usize index)
     {
         if (!m_StringTable || index >= m_StringSection->Size) return ""_sv;
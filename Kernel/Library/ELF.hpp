@@ -83,6 +83,8 @@ namespace ELF
       private:
         Buffer                        m_Image;
         Pointer                       m_LoadBase = nullptr;
+        // The file, the image's headers were read from, if any
+        INode*                        m_INode    = nullptr;
 
         struct Header                 m_Header;
         AuxiliaryVector               m_AuxiliaryVector;
@@ -102,7 +104,10 @@ namespace ELF
         template <typename T>
         void Read(T* buffer, isize offset, isize count = sizeof(T))
         {
-            Memory::Copy(buffer, m_Image.Raw() + offset, count);
+            if (offset + count <= static_cast<isize>(m_Image.Size()))
+                Memory::Copy(buffer, m_Image.Raw() + offset, count);
+            else ReadFromFile(buffer, offset, count);
         }
+        void ReadFromFile(void* buffer, isize offset, isize count);
     };
 }; // namespace ELF
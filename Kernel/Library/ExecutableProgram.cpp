@@ -9,10 +9,14 @@
 
 #include <Memory/AddressSpace.hpp>
 #include <Memory/PMM.hpp>
+#include <Memory/Region.hpp>
 #include <Memory/VMM.hpp>
 
+#include <Prism/Utility/Math.hpp>
+
 #include <VFS/DirectoryEntry.hpp>
 #include <VFS/FileDescriptor.hpp>
+#include <VFS/INode.hpp>
 #include <VFS/VFS.hpp>
 
 ErrorOr<void> ExecutableProgram::Load(PathView path, PageMap* pageMap,
@@ -138,42 +142,76 @@ ExecutableProgram::LoadImage(PathView path, PageMap* pageMap,
 
     if (!image->Load(file.Raw(), m_LoadBase)) return Error(ENOEXEC);
 
-    auto forEachProgramHeader = [&](ELF::ProgramHeader* header) -> bool
+    ErrorOr<void> status               = {};
+    auto          forEachProgramHeader = [&](ELF::ProgramHeader* header) -> bool
     {
-        if (header->Type == ELF::HeaderType::eLoad)
-        {
-            usize misalign  = header->VirtualAddress & (PMM::PAGE_SIZE - 1);
-            usize pageCount = Math::DivRoundUp(
-                header->SegmentSizeInMemory + misalign, PMM::PAGE_SIZE);
-
-            Pointer phys = PMM::CallocatePages(pageCount);
-            Assert(phys);
-
-            auto  virt = header->VirtualAddress + m_LoadBase;
-            usize size = pageCount * PMM::PAGE_SIZE;
-            Assert(pageMap->MapRange(virt, phys, size,
-                                     PageAttributes::eRWXU
-                                         | PageAttributes::eWriteBack));
-            auto region
-                = new Region(phys, header->VirtualAddress + m_LoadBase, size);
-            using VMM::Access;
-            region->SetAccessMode(Access::eReadWriteExecute | Access::eUser);
-
-            addressSpace.Insert(region->VirtualBase(), region);
-            Memory::Copy(phys.Offset<Pointer>(misalign).ToHigherHalf(),
-                         image->Raw().Offset(header->Offset),
-                         header->SegmentSizeInFile);
-
-            // if (interpreter)
-            //     m_InterpreterBase = std::min(m_InterpreterBase, virt);
-        }
-
-        return true;
+        if (header->Type != ELF::HeaderType::eLoad) return true;
+
+        status = MapSegment(inode, header, pageMap, addressSpace);
+        return static_cast<bool>(status);
     };
 
     ELF::Image::ProgramHeaderEnumerator programHeaderIterator;
     programHeaderIterator.BindLambda(forEachProgramHeader);
 
     image->ForEachProgramHeader(programHeaderIterator);
+    RetOnError(status);
+
     return image;
 }
+
+ErrorOr<void> ExecutableProgram::MapSegment(INode*              inode,
+                                            ELF::ProgramHeader* header,
+                                            PageMap*            pageMap,
+                                            AddressSpace&       addressSpace)
+{
+    using VMM::Access;
+    constexpr Access access   = Access::eReadWriteExecute | Access::eUser;
+
+    Pointer          virt     = header->VirtualAddress + m_LoadBase;
+    Pointer          base     = Math::AlignDown(virt.Raw(), PMM::PAGE_SIZE);
+    usize            misalign = virt.Raw() - base.Raw();
+    if (header->Offset % PMM::PAGE_SIZE != misalign) return Error(ENOEXEC);
+
+    usize fileOffset = header->Offset - misalign;
+    usize fileEnd    = misalign + header->SegmentSizeInFile;
+    usize memoryEnd  = Math::AlignUp(misalign + header->SegmentSizeInMemory,
+                                     PMM::PAGE_SIZE);
+
+    // File-only pages are mapped privately from the page cache. The last
+    // partial page before bss is copied, so it can be zeroed past the file data
+    bool  hasBss    = header->SegmentSizeInMemory > header->SegmentSizeInFile;
+    usize mappedEnd = hasBss ? Math::AlignDown(fileEnd, PMM::PAGE_SIZE)
+                             : Math::AlignUp(fileEnd, PMM::PAGE_SIZE);
+    if (mappedEnd > 0)
+    {
+        Ref<Region> region = new Region(0, base, mappedEnd);
+        region->SetAccessMode(access);
+        region->SetBacking(inode, fileOffset, false);
+
+        addressSpace.Insert(region->VirtualBase(), region);
+    }
+    if (memoryEnd <= mappedEnd) return {};
+
+    Ref<Region> bss
+        = new Region(0, base.Offset(mappedEnd), memoryEnd - mappedEnd);
+    bss->SetAccessMode(access);
+    addressSpace.Insert(bss->VirtualBase(), bss);
+    if (fileEnd <= mappedEnd) return {};
+
+    Pointer page = PMM::CallocatePages(1);
+    if (!page) return Error(ENOMEM);
+
+    isize bytes = fileEnd - mappedEnd;
+    if (inode->CachedRead(page.ToHigherHalf<u8*>(), fileOffset + mappedEnd,
+                          bytes)
+            != bytes
+        || !pageMap->Map(bss->VirtualBase(), page, bss->PageAttributes()))
+    {
+        PMM::FreePages(page.Raw(), 1);
+        return Error(EIO);
+    }
+
+    bss->InsertPage(0, page);
+    return {};
+}
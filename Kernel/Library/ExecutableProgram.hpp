@@ -34,4 +34,7 @@ class ExecutableProgram
     ErrorOr<Ref<ELF::Image>> LoadImage(PathView path, PageMap* pageMap,
                                        AddressSpace& addressSpace,
                                        bool          interpreter = false);
+    ErrorOr<void>            MapSegment(INode* inode, ELF::ProgramHeader* header,
+                                        PageMap*      pageMap,
+                                        AddressSpace& addressSpace);
 };
@@ -8,25 +8,21 @@
 
 void ConditionalVariable::Wait(Mutex& mutex)
 {
-    auto thread = Thread::Current();
-    {
-        ScopedLock guard(m_Lock);
-        m_Event.Listeners.EmplaceBack(thread, 0);
-        thread->Events().PushBack(&m_Event);
-    }
-
+    u64 sequence = m_Sequence.Load();
     mutex.Unlock();
-    m_Event.Await();
+
+    m_WaitQueue.WaitUntil([this, sequence]()
+                          { return m_Sequence.Load() != sequence; }, true);
     mutex.Lock();
 }
 
 void ConditionalVariable::NotifyOne()
 {
-    ScopedLock guard(m_Lock);
-    if (!m_Event.Listeners.Empty()) m_Event.Trigger(true);
+    ++m_Sequence;
+    m_WaitQueue.WakeOne();
 }
 void ConditionalVariable::NotifyAll()
 {
-    ScopedLock guard(m_Lock);
-    m_Event.Trigger(true);
+    ++m_Sequence;
+    m_WaitQueue.WakeAll();
 }
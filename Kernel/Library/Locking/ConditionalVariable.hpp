@@ -17,6 +17,7 @@ class ConditionalVariable : public NonCopyable<ConditionalVariable>
     void NotifyAll();
 
   private:
-    Spinlock m_Lock;
-    Event    m_Event;
+    // Bumped on every notification, so racing waiters don't go to sleep
+    Atomic<u64> m_Sequence = 0;
+    WaitQueue   m_WaitQueue;
 };
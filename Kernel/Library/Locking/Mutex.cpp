@@ -21,25 +21,17 @@ bool Mutex::TryLock()
 }
 void Mutex::Lock()
 {
-    if (TryLock()) goto lock_success;
-
-    for (;;)
-    {
-        if (TryLock()) break;
-
-        m_LockEvent.Await(true);
-    }
-
-lock_success:
-    m_Holder = Thread::Current();
+    m_WaitQueue.WaitUntil([this]() { return TryLock(); }, true);
 }
 void Mutex::Unlock()
 {
-    ScopedLock guard(m_Lock);
-    Assert(m_Locked && Thread::Current() == m_Holder);
+    {
+        ScopedLock guard(m_Lock);
+        Assert(m_Locked && Thread::Current() == m_Holder);
 
-    m_Locked = false;
-    m_Holder = nullptr;
+        m_Locked = false;
+        m_Holder = nullptr;
+    }
 
-    Event::Trigger(&m_LockEvent);
+    m_WaitQueue.WakeOne();
 }
@@ -8,9 +8,9 @@
 #pragma once
 
 #include <Prism/Core/Types.hpp>
-#include <Scheduler/Event.hpp>
 #include <Scheduler/Scheduler.hpp>
 #include <Scheduler/Thread.hpp>
+#include <Scheduler/WaitQueue.hpp>
 
 class Mutex : public NonCopyable<Mutex>
 {
@@ -22,8 +22,8 @@ class Mutex : public NonCopyable<Mutex>
     void Unlock();
 
   private:
-    Spinlock m_Lock;
-    bool     m_Locked = false;
-    Thread*  m_Holder = nullptr;
-    Event    m_LockEvent;
+    Spinlock  m_Lock;
+    bool      m_Locked = false;
+    Thread*   m_Holder = nullptr;
+    WaitQueue m_WaitQueue;
 };
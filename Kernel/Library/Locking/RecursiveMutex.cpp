@@ -9,12 +9,7 @@
 
 void RecursiveMutex::Lock()
 {
-    for (;;)
-    {
-        if (TryLock()) break;
-
-        m_Event.Await();
-    }
+    m_WaitQueue.WaitUntil([this]() { return TryLock(); }, true);
 }
 bool RecursiveMutex::TryLock()
 {
@@ -38,13 +33,14 @@ bool RecursiveMutex::TryLock()
 }
 void RecursiveMutex::Unlock()
 {
-    ScopedLock guard(m_Lock);
-    Assert(m_Locked && m_Owner == Thread::Current());
-
-    if (--m_Depth == 0)
     {
+        ScopedLock guard(m_Lock);
+        Assert(m_Locked && m_Owner == Thread::Current());
+
+        if (--m_Depth > 0) return;
         m_Locked = false;
         m_Owner  = nullptr;
-        m_Event.Trigger();
     }
+
+    m_WaitQueue.WakeOne();
 }
@@ -7,7 +7,7 @@
 #pragma once
 
 #include <Library/Locking/Spinlock.hpp>
-#include <Scheduler/Event.hpp>
+#include <Scheduler/WaitQueue.hpp>
 
 class RecursiveMutex : public NonCopyable<RecursiveMutex>
 {
@@ -19,9 +19,9 @@ class RecursiveMutex : public NonCopyable<RecursiveMutex>
     void Unlock();
 
   private:
-    Spinlock m_Lock;
-    bool     m_Locked = false;
-    usize    m_Depth  = 0;
-    Thread*  m_Owner  = nullptr;
-    Event    m_Event;
+    Spinlock  m_Lock;
+    bool      m_Locked = false;
+    usize     m_Depth  = 0;
+    Thread*   m_Owner  = nullptr;
+    WaitQueue m_WaitQueue;
 };
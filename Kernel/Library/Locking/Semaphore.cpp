@@ -8,18 +8,16 @@
 
 void Semaphore::Signal()
 {
-    ScopedLock guard(m_Lock);
-    if (!m_Event.Listeners.Empty()) m_Event.Trigger();
-    else ++m_Count;
+    {
+        ScopedLock guard(m_Lock);
+        ++m_Count;
+    }
+
+    m_WaitQueue.WakeOne();
 }
 void Semaphore::Wait()
 {
-    for (;;)
-    {
-        if (TryWait()) break;
-
-        m_Event.Await();
-    }
+    m_WaitQueue.WaitUntil([this]() { return TryWait(); }, true);
 }
 bool Semaphore::TryWait()
 {
@@ -7,7 +7,7 @@
 #pragma once
 
 #include <Library/Locking/Spinlock.hpp>
-#include <Scheduler/Event.hpp>
+#include <Scheduler/WaitQueue.hpp>
 
 class Semaphore : public NonCopyable<Semaphore>
 {
@@ -22,7 +22,7 @@ class Semaphore : public NonCopyable<Semaphore>
     bool TryWait();
 
   private:
-    Spinlock m_Lock;
-    usize    m_Count = 0;
-    Event    m_Event;
+    Spinlock  m_Lock;
+    usize     m_Count = 0;
+    WaitQueue m_WaitQueue;
 };
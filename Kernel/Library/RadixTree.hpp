@@ -0,0 +1,196 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#pragma once
+
+#include <Prism/Containers/Array.hpp>
+#include <Prism/Core/NonCopyable.hpp>
+#include <Prism/Core/Types.hpp>
+
+/**
+ * @brief Sparse array of pointers, indexed by an integer, e.g. a page offset
+ * within a file. Every level of the tree resolves 6 bits of the index, and the
+ * tree only grows as tall, as the highest index stored requires, so that
+ * lookups for small files take one, or two pointer dereferences
+ *
+ * It does no locking, and doesn't own the stored values
+ */
+template <typename T>
+class RadixTree : public NonCopyable<RadixTree<T>>
+{
+  public:
+    RadixTree() = default;
+    ~RadixTree() { Clear(); }
+
+    inline usize Size() const { return m_Size; }
+    inline bool  Empty() const { return m_Size == 0; }
+
+    T*           Find(usize index) const
+    {
+        if (!m_Root || index > MaxIndex(m_Height)) return nullptr;
+
+        Node* node = m_Root;
+        for (usize level = m_Height; level > 0; --level)
+        {
+            node = static_cast<Node*>(node->Slots[SlotOf(index, level)]);
+            if (!node) return nullptr;
+        }
+
+        return static_cast<T*>(node->Slots[SlotOf(index, 0)]);
+    }
+    /**
+     * @brief Stores `value` at `index`
+     *
+     * @return false, if the slot is already taken, or we ran out of memory
+     */
+    bool Insert(usize index, T* value)
+    {
+        if (!m_Root && !(m_Root = new Node)) return false;
+        while (index > MaxIndex(m_Height))
+        {
+            Node* root = new Node;
+            if (!root) return false;
+
+            root->Slots[0] = m_Root;
+            root->Count    = 1;
+            m_Root         = root;
+            ++m_Height;
+        }
+
+        Node* node = m_Root;
+        for (usize level = m_Height; level > 0; --level)
+        {
+            void*& slot = node->Slots[SlotOf(index, level)];
+            if (!slot)
+            {
+                if (!(slot = new Node)) return false;
+                ++node->Count;
+            }
+
+            node = static_cast<Node*>(slot);
+        }
+
+        void*& slot = node->Slots[SlotOf(index, 0)];
+        if (slot) return false;
+
+        slot = value;
+        ++node->Count;
+        ++m_Size;
+        return true;
+    }
+    /**
+     * @brief Removes the value stored at `index`, releasing the nodes, which
+     * became empty
+     *
+     * @return The removed value, or nullptr, if there was none
+     */
+    T* Erase(usize index)
+    {
+        if (!m_Root || index > MaxIndex(m_Height)) return nullptr;
+
+        Array<Node*, MAX_HEIGHT + 1> path{};
+        Node*                        node = m_Root;
+        for (usize level = m_Height; level > 0; --level)
+        {
+            path[level] = node;
+            node        = static_cast<Node*>(node->Slots[SlotOf(index, level)]);
+            if (!node) return nullptr;
+        }
+        path[0]  = node;
+
+        T* value = static_cast<T*>(node->Slots[SlotOf(index, 0)]);
+        if (!value) return nullptr;
+
+        usize height = m_Height;
+        for (usize level = 0; level <= height; ++level)
+        {
+            Node* current                         = path[level];
+            current->Slots[SlotOf(index, level)] = nullptr;
+            if (--current->Count > 0) break;
+
+            delete current;
+            if (level == height)
+            {
+                m_Root   = nullptr;
+                m_Height = 0;
+            }
+        }
+
+        --m_Size;
+        return value;
+    }
+
+    /**
+     * @brief Calls `callback(index, value)` for every stored value, in the
+     * ascending order of indices, the callback must not modify the tree
+     */
+    template <typename F>
+    void ForEach(F&& callback) const
+    {
+        if (m_Root) ForEach(m_Root, m_Height, 0, callback);
+    }
+    /**
+     * @brief Releases all of the nodes, the values themselves are left
+     * untouched
+     */
+    void Clear()
+    {
+        if (m_Root) FreeNode(m_Root, m_Height);
+
+        m_Root   = nullptr;
+        m_Height = 0;
+        m_Size   = 0;
+    }
+
+  private:
+    constexpr static usize BITS_PER_LEVEL = 6;
+    constexpr static usize FANOUT         = 1zu << BITS_PER_LEVEL;
+    constexpr static usize MAX_HEIGHT
+        = (sizeof(usize) * 8 + BITS_PER_LEVEL - 1) / BITS_PER_LEVEL;
+
+    struct Node
+    {
+        Array<void*, FANOUT> Slots{};
+        usize                Count = 0;
+    };
+
+    Node*                  m_Root   = nullptr;
+    // Number of levels above the leaves, which hold the values themselves
+    usize                  m_Height = 0;
+    usize                  m_Size   = 0;
+
+    constexpr static usize SlotOf(usize index, usize level)
+    {
+        return (index >> (level * BITS_PER_LEVEL)) & (FANOUT - 1);
+    }
+    constexpr static usize MaxIndex(usize height)
+    {
+        usize bits = (height + 1) * BITS_PER_LEVEL;
+        return bits >= sizeof(usize) * 8 ? ~0zu : (1zu << bits) - 1;
+    }
+
+    template <typename F>
+    static void ForEach(Node* node, usize level, usize base, F& callback)
+    {
+        for (usize i = 0; i < FANOUT; ++i)
+        {
+            void* slot = node->Slots[i];
+            if (!slot) continue;
+
+            usize index = base | (i << (level * BITS_PER_LEVEL));
+            if (level == 0) callback(index, static_cast<T*>(slot));
+            else ForEach(static_cast<Node*>(slot), level - 1, index, callback);
+        }
+    }
+    static void FreeNode(Node* node, usize level)
+    {
+        if (level > 0)
+            for (void* slot : node->Slots)
+                if (slot) FreeNode(static_cast<Node*>(slot), level - 1);
+
+        delete node;
+    }
+};
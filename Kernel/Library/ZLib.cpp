@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 06.04.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -9,268 +9,480 @@
 #include <Library/Logger.hpp>
 #include <Library/ZLib.hpp>
 
-#include <Prism/Memory/ByteStream.hpp>
-#include <Prism/Utility/Checksum.hpp>
+#include <Prism/Memory/Memory.hpp>
+#include <Prism/Utility/Math.hpp>
 
 namespace ZLib
 {
-    inline constexpr i32 ReverseBits(i32 value, i32 count)
+    namespace
     {
-        Assert(count <= 16);
+        constexpr u16 LENGTH_BASE[]
+            = {3,  4,  5,  6,  7,  8,  9,  10,  11,  13,  15,  17,  19,  23, 27,
+               31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        constexpr u8 LENGTH_EXTRA_BITS[]
+            = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+               2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+        constexpr u16 DISTANCE_BASE[] = {
+            1,    2,    3,    4,    5,    7,    9,    13,    17,    25,
+            33,   49,   65,   97,   129,  193,  257,  385,   513,   769,
+            1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+        constexpr u8 DISTANCE_EXTRA_BITS[]
+            = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+               6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+        constexpr u8 CODE_LENGTH_ORDER[19] = {16, 17, 18, 0,  8, 7,  9,
+                                              6,  10, 5,  11, 4, 12, 3,
+                                              13, 2,  14, 1,  15};
+
+        constexpr u32 ADLER32_MODULO = 65521;
+        // The most bytes, which can be summed up, before the sums can overflow
+        constexpr usize ADLER32_RUN = 5552;
+
+        struct Crc32Table
+        {
+            u32 Entries[256];
 
-        i32 reversedBits = ((value & 0xaaaa) >> 1) | ((value & 0x5555) << 1);
-        reversedBits
-            = ((reversedBits & 0xcccc) >> 2) | ((reversedBits & 0x3333) << 2);
-        reversedBits
-            = ((reversedBits & 0xf0f0) >> 4) | ((reversedBits & 0x0f0f) << 4);
-        reversedBits
-            = ((reversedBits & 0xff00) >> 8) | ((reversedBits & 0x00ff) << 8);
+            constexpr Crc32Table()
+                : Entries()
+            {
+                for (u32 i = 0; i < 256; ++i)
+                {
+                    u32 crc = i;
+                    for (usize bit = 0; bit < 8; ++bit)
+                        crc = crc & 1 ? 0xedb88320 ^ (crc >> 1) : crc >> 1;
+                    Entries[i] = crc;
+                }
+            }
+        };
+        constexpr Crc32Table CRC32_TABLE;
 
-        return reversedBits >> (16 - count);
-    }
+        constexpr u8 GZIP_FLAG_HEADER_CRC = Bit(1);
+        constexpr u8 GZIP_FLAG_EXTRA      = Bit(2);
+        constexpr u8 GZIP_FLAG_NAME       = Bit(3);
+        constexpr u8 GZIP_FLAG_COMMENT    = Bit(4);
 
-    bool HuffmanTree::Build(Span<u8, DynamicExtent> bitLengths)
-    {
-        i32            totalSymbolsAssigned = 0;
-        Array<i32, 16> nextCodeForLength    = {};
-        Array<i32, 17> codeLengthCounts     = {};
-
-        FastLookupTable.Fill(0);
-        codeLengthCounts.Fill(0);
-
-        for (usize i = 0; i < bitLengths.Size(); ++i)
-            ++codeLengthCounts[bitLengths[i]];
-        codeLengthCounts[0] = 0;
-        for (i32 length = 1; length < 16; ++length)
-            if (codeLengthCounts[length] > (1 << length))
+        inline u32 ReverseBits(u32 value, usize count)
+        {
+            u32 reversed = 0;
+            for (usize i = 0; i < count; ++i, value >>= 1)
+                reversed = (reversed << 1) | (value & 1);
+
+            return reversed;
+        }
+
+        // Copies the match a word at a time, whenever its source doesn't
+        // overlap with the 8 bytes being written, the last word might spill
+        // past the end of the match
+        inline u8* CopyMatch(u8* out, usize distance, usize length)
+        {
+            const u8* source = out - distance;
+            if (distance >= sizeof(u64))
             {
-                LogError("ZLib: Invalid code lengths");
-                return false;
+                u8* end = out + length;
+                do {
+                    u64 word;
+                    __builtin_memcpy(&word, source, sizeof(u64));
+                    __builtin_memcpy(out, &word, sizeof(u64));
+                    out += sizeof(u64);
+                    source += sizeof(u64);
+                } while (out < end);
+
+                return end;
+            }
+            if (distance == 1)
+            {
+                Memory::Fill(out, *source, length);
+                return out + length;
             }
 
-        auto huffmanCode = 0;
-        for (i32 length = 1; length < 16; ++length)
+            while (length--) *out++ = *source++;
+            return out;
+        }
+    }; // namespace
+
+    Format Detect(Pointer data, usize size)
+    {
+        const u8* bytes = data.As<u8>();
+        if (size >= 18 && bytes[0] == 0x1f && bytes[1] == 0x8b && bytes[2] == 8)
+            return Format::eGZip;
+
+        if (size >= 6 && (bytes[0] & 0x0f) == 8 && (bytes[0] >> 4) <= 7
+            && ((bytes[0] << 8) | bytes[1]) % 31 == 0)
+            return Format::eZLib;
+
+        return Format::eNone;
+    }
+
+    bool HuffmanTable::Build(const u8* lengths, usize count, bool pairLiterals)
+    {
+        Array<u16, MAX_BITS + 1> offsets   = {};
+        Array<u32, MAX_BITS + 1> nextCodes = {};
+
+        FastTable.Fill(0);
+        Counts.Fill(0);
+        for (usize symbol = 0; symbol < count; ++symbol)
+            ++Counts[lengths[symbol]];
+        Counts[0] = 0;
+
+        // Incomplete codes are valid, e.g. a single distance code
+        i32 left  = 1;
+        for (usize length = 1; length <= MAX_BITS; ++length)
         {
-            nextCodeForLength[length]        = huffmanCode;
-            FirstCodeOfLength[length]        = huffmanCode;
-            FirstSymbolIndexOfLength[length] = totalSymbolsAssigned;
-            huffmanCode = (huffmanCode + codeLengthCounts[length]);
-            if (codeLengthCounts[length] && (huffmanCode - 1ull >= Bit(length)))
+            left <<= 1;
+            left  -= Counts[length];
+            if (left < 0)
             {
-                LogError("ZLib: Invalid canonical code");
+                LogError("ZLib: Over-subscribed huffman code");
                 return false;
             }
-            MaxCodeInclusive[length] = huffmanCode << (16 - length);
-            huffmanCode <<= 1;
-            totalSymbolsAssigned += codeLengthCounts[length];
         }
-        MaxCodeInclusive[16] = 0x10000;
-        for (usize symbol = 0; symbol < bitLengths.Size(); ++symbol)
+
+        u32 code = 0;
+        for (usize length = 1; length <= MAX_BITS; ++length)
         {
-            i32 length = bitLengths[symbol];
-            if (bitLengths[symbol] == 0) continue;
+            code                  = (code + Counts[length - 1]) << 1;
+            nextCodes[length]     = code;
+            if (length < MAX_BITS)
+                offsets[length + 1] = offsets[length] + Counts[length];
+        }
 
-            i32 symbolIndex = nextCodeForLength[length]
-                            - FirstCodeOfLength[length]
-                            + FirstSymbolIndexOfLength[length];
-            u16 fastTableValue            = (u16)((length << 9) | symbol);
+        for (usize symbol = 0; symbol < count; ++symbol)
+        {
+            usize length = lengths[symbol];
+            if (!length) continue;
 
-            SymbolBitLengths[symbolIndex] = (u8)length;
-            SymbolValues[symbolIndex]     = (u16)symbol;
-            if (length <= FAST_BITS)
-            {
-                i32 reversedBits
-                    = ReverseBits(nextCodeForLength[length], length);
-                while (reversedBits < (1 << FAST_BITS))
-                {
-                    FastLookupTable[reversedBits] = fastTableValue;
-                    reversedBits += (1 << length);
-                }
-            }
-            ++nextCodeForLength[length];
+            Symbols[offsets[length]++] = symbol;
+            u32 reversed = ReverseBits(nextCodes[length]++, length);
+            if (length > FAST_BITS) continue;
+
+            u32 entry = symbol | (length << LENGTH_SHIFT);
+            for (u32 i = reversed; i < (1u << FAST_BITS); i += 1u << length)
+                FastTable[i] = entry;
         }
-        return true;
-    }
-    i32 HuffmanTree::Decode(BitStream<>& stream)
-    {
-        i32 bits      = stream.PeekBits(16);
-        i32 fastEntry = FastLookupTable[bits & FAST_MASK];
-        if (fastEntry)
+        if (!pairLiterals) return true;
+
+        // Entries hold a second literal, if the first one's code leaves enough
+        // bits for it
+        for (usize i = 0; i < FastTable.Size(); ++i)
         {
-            i32 codeLength = fastEntry >> 9;
-            stream.DropBits(codeLength);
-            return fastEntry & 511;
+            u32   entry  = FastTable[i];
+            usize length = (entry >> LENGTH_SHIFT) & LENGTH_MASK;
+            if (!length || (entry & SYMBOL_MASK) >= 256) continue;
+
+            u32   second       = FastTable[i >> length];
+            usize secondLength = (second >> LENGTH_SHIFT) & LENGTH_MASK;
+            if (!secondLength || (second & SYMBOL_MASK) >= 256
+                || length + secondLength > FAST_BITS)
+                continue;
+
+            FastTable[i] = entry | PAIR | ((second & 0xff) << SECOND_SHIFT)
+                         | ((length + secondLength) << PAIR_LENGTH_SHIFT);
         }
-        return DecodeSlowPath(stream);
+
+        return true;
     }
-    i32 HuffmanTree::DecodeSlowPath(BitStream<>& stream)
+
+    Inflater::Inflater(Pointer data, usize size)
+        : m_Format(Detect(data, size))
+        , m_InputStart(data.As<u8>())
+        , m_Input(data.As<u8>())
+        , m_InputEnd(data.As<u8>() + size)
     {
-        i32 reversedBits = ReverseBits(stream.PeekBits(16), 16);
-
-        i32 codeLength   = 0;
-        for (codeLength = FAST_BITS + 1;; ++codeLength)
-            if (reversedBits < MaxCodeInclusive[codeLength]) break;
-        if (codeLength >= 16) return -1;
-        i32 symbolIndex = (reversedBits >> (16 - codeLength))
-                        - FirstCodeOfLength[codeLength]
-                        + FirstSymbolIndexOfLength[codeLength];
-        if (symbolIndex >= MAX_SYMBOLS) return -1;
-        if (SymbolBitLengths[symbolIndex] != codeLength) return -1;
-        stream.DropBits(codeLength);
-        return SymbolValues[symbolIndex];
+        m_Buffer = new u8[BUFFER_SIZE];
+        if (!m_Buffer || !ParseHeader()) return;
+
+        m_Checksum = m_Format == Format::eZLib ? 1 : 0;
+        m_State    = State::eBlockHeader;
     }
+    Inflater::~Inflater() { delete[] m_Buffer; }
 
-    Decompressor::~Decompressor()
+    isize Inflater::Read(u8* out, usize count)
     {
-        if (m_OutputBuffer)
+        usize done = 0;
+        while (done < count)
         {
-            delete[] m_OutputBuffer;
-            m_OutputBuffer = nullptr;
-            m_OutputSize   = 0;
+            const u8* data  = nullptr;
+            isize     bytes = Next(data, count - done);
+            if (bytes < 0) return -1;
+            if (bytes == 0) break;
+
+            Memory::Copy(out + done, data, bytes);
+            done += bytes;
         }
+
+        return done;
+    }
+    isize Inflater::Next(const u8*& data, usize count)
+    {
+        if (m_ReadPosition == m_Position && !Fill()) return -1;
+
+        usize bytes = Math::Min(count, m_Position - m_ReadPosition);
+        data        = m_Buffer + m_ReadPosition;
+        m_ReadPosition += bytes;
+
+        return bytes;
     }
 
-    bool Decompressor::Decompress(usize initialSize)
+    bool Inflater::ParseHeader()
     {
-        if (initialSize == 0) initialSize = m_InputSize;
-        EnsureCapacity(initialSize);
-        BitStream stream(m_InputData.As<u8>(), m_InputSize);
-        m_InputEnd = m_InputData.Offset<u8*>(m_InputSize);
+        const u8* header = m_Input;
+        usize     size   = m_InputEnd - m_Input;
+        if (m_Format == Format::eZLib)
+        {
+            if (header[1] & 0x20)
+            {
+                LogError(
+                    "ZLib: Predefined dictionaries are currently not "
+                    "supported");
+                return false;
+            }
 
-        Header header(stream.Read<u16>());
-        if (header.CompressionMethod != CompressionMethod::eDeflate)
+            m_Input += 2;
+            return true;
+        }
+        if (m_Format != Format::eGZip)
         {
-            LogError("ZLib: Non-Deflate compression is not supported");
+            LogError("ZLib: Unknown stream format");
             return false;
         }
-        if (header.DictionaryPresent)
+
+        u8    flags      = header[3];
+        usize offset     = 10;
+        auto  skipString = [&]()
         {
-            LogError(
-                "ZLib: Predefined dictionaries are currently not supported");
+            while (offset < size && header[offset]) ++offset;
+            ++offset;
+        };
+
+        if (flags & GZIP_FLAG_EXTRA)
+            offset += 2 + (header[offset] | (header[offset + 1] << 8));
+        if (flags & GZIP_FLAG_NAME) skipString();
+        if (flags & GZIP_FLAG_COMMENT) skipString();
+        if (flags & GZIP_FLAG_HEADER_CRC) offset += 2;
+
+        // The trailer takes another 8 bytes
+        if (offset + 8 > size)
+        {
+            LogError("ZLib: Truncated gzip header");
             return false;
         }
-        if (header.Data.Load() % 31)
+
+        m_Input += offset;
+        return true;
+    }
+    bool Inflater::ParseTrailer()
+    {
+        AlignToInput();
+
+        usize     size    = m_Format == Format::eZLib ? 4 : 8;
+        const u8* trailer = m_Input;
+        if (usize(m_InputEnd - m_Input) < size)
         {
-            LogError("ZLib: Invalid checksum");
+            LogError("ZLib: Truncated stream");
             return false;
         }
+        m_Input += size;
 
-        if (stream.IsEndOfStream())
+        if (m_Format == Format::eZLib)
         {
-            LogError("ZLib: End of stream");
+            u32 adler32 = (trailer[0] << 24) | (trailer[1] << 16)
+                        | (trailer[2] << 8) | trailer[3];
+            if (adler32 == m_Checksum) return true;
+
+            LogError(
+                "ZLib: Invalid adler32 checksum, adler32: {:#x}, "
+                "computedAdler32: {:#x}",
+                adler32, m_Checksum);
             return false;
         }
 
-        if (!DecompressStream(stream))
+        u32 crc32 = 0, length = 0;
+        Memory::Copy(&crc32, trailer, sizeof(u32));
+        Memory::Copy(&length, trailer + 4, sizeof(u32));
+        if (crc32 != m_Checksum || length != u32(m_TotalOut))
         {
-            delete[] m_OutputBuffer;
-            m_OutputBuffer = nullptr;
-            m_OutputSize   = 0;
+            LogError(
+                "ZLib: Invalid gzip trailer, crc32: {:#x}, computedCrc32: "
+                "{:#x}, size: {}, decompressedSize: {}",
+                crc32, m_Checksum, length, u32(m_TotalOut));
             return false;
         }
-        m_OutputSize = m_OutputPointer - m_OutputBuffer;
+
         return true;
     }
 
-    bool Decompressor::EnsureCapacity(usize count)
+    void Inflater::Refill()
     {
-        usize currentOffset
-            = m_OutputBuffer ? m_OutputPointer - m_OutputBuffer : 0;
-        usize newSize = m_OutputBuffer == 0 ? count : m_OutputSize;
+        // Whole words are loaded unaligned, only the bytes that fit are counted
+        if (m_InputEnd - m_Input >= isize(sizeof(u64)))
+        {
+            u64 word;
+            __builtin_memcpy(&word, m_Input, sizeof(u64));
 
-        while (newSize < currentOffset + count) newSize <<= 1;
+            m_BitBuffer |= word << m_BitCount;
+            m_Input += (63 - m_BitCount) >> 3;
+            m_BitCount |= 56;
+            return;
+        }
 
-        if (m_OutputBuffer) delete[] m_OutputBuffer;
-        m_OutputBuffer  = new u8[newSize];
-        m_OutputSize    = newSize;
+        while (m_BitCount <= 56)
+        {
+            if (m_Input < m_InputEnd)
+                m_BitBuffer |= u64(*m_Input++) << m_BitCount;
+            else ++m_Padding;
+            m_BitCount += 8;
+        }
+    }
+    u32 Inflater::GetBits(usize count)
+    {
+        u32 bits = m_BitBuffer & ((1ull << count) - 1);
+        DropBits(count);
 
-        m_OutputPointer = m_OutputBuffer + currentOffset;
-        m_OutputEnd     = m_OutputBuffer + newSize;
-        return true;
+        return bits;
     }
+    void Inflater::DropBits(usize count)
+    {
+        m_BitBuffer >>= count;
+        m_BitCount -= count;
+    }
+    void Inflater::AlignToInput()
+    {
+        DropBits(m_BitCount % 8);
 
-    bool Decompressor::DecompressStream(BitStream<>& stream)
+        m_Input -= m_BitCount / 8 - Math::Min(m_Padding, m_BitCount / 8);
+        m_BitBuffer = 0;
+        m_BitCount  = 0;
+        m_Padding   = 0;
+    }
+    bool Inflater::Truncated() const { return m_Padding * 8 > m_BitCount; }
+
+    i32  Inflater::DecodeSlowPath(const HuffmanTable& table)
     {
-        bool final = true;
-        do {
-            final          = stream.ReadBits(1);
+        u32   bits  = m_BitBuffer;
+        i32   code  = 0;
+        i32   first = 0;
+        usize index = 0;
+        for (usize length = 1; length <= HuffmanTable::MAX_BITS; ++length)
+        {
+            code      |= bits & 1;
+            bits     >>= 1;
+
+            i32 count  = table.Counts[length];
+            if (code - count < first)
+            {
+                DropBits(length);
+                return table.Symbols[index + (code - first)];
+            }
 
-            BlockType type = static_cast<BlockType>(stream.ReadBits(2));
+            index += count;
+            first  = (first + count) << 1;
+            code <<= 1;
+        }
 
-            if (!ParseBlock(stream, type)) return false;
-            if (!DecodeBlock(stream)) return false;
-        } while (!final);
+        return -1;
+    }
 
-        u32 checksum = 0;
-        Memory::Copy(&checksum, m_InputData.Offset<u8*>(m_InputSize - 4), 4);
-        checksum = ConvertEndian<Endian::eNative, Endian::eBig>(checksum);
+    bool Inflater::Fill()
+    {
+        if (m_State == State::eError) return false;
 
-        const u32 computedAdler32
-            = Adler32::DoChecksum(m_OutputBuffer, DecompressedSize());
-        if (checksum != computedAdler32)
-            LogError(
-                "ZLib: Invalid adler32 checksum, adler32: {:#x}, "
-                "computedAdler32: {:#x}",
-                checksum, computedAdler32);
+        // When out of room, the last 32 KiB, which back references can reach,
+        // move to the front
+        if (m_Position > BUFFER_SIZE - 2 * WINDOW_SIZE)
+        {
+            Memory::Copy(m_Buffer, m_Buffer + m_Position - WINDOW_SIZE,
+                         WINDOW_SIZE);
+            m_Position = WINDOW_SIZE;
+        }
+        m_ReadPosition = m_Position;
 
+        usize start    = m_Position;
+        bool  ok       = true;
+        while (ok && m_Position == start && m_State != State::eDone)
+        {
+            switch (m_State)
+            {
+                case State::eBlockHeader:
+                    if (m_FinalBlock) m_State = State::eTrailer;
+                    else ok = ReadBlockHeader();
+                    break;
+                case State::eStored: ok = CopyStored(); break;
+                case State::eHuffman: ok = DecodeHuffman(); break;
+                case State::eTrailer:
+                    ok = ParseTrailer();
+                    if (ok) m_State = State::eDone;
+                    break;
+
+                default: break;
+            }
+        }
+        if (ok && Truncated())
+        {
+            LogError("ZLib: Truncated stream");
+            ok = false;
+        }
+        if (!ok)
+        {
+            m_State = State::eError;
+            return false;
+        }
+
+        UpdateChecksum(m_Buffer + start, m_Position - start);
+        m_TotalOut += m_Position - start;
         return true;
     }
-    bool Decompressor::ParseBlock(BitStream<>& stream, BlockType blockType)
+
+    bool Inflater::ReadBlockHeader()
     {
-        constexpr Array<u8, HuffmanTree::MAX_SYMBOLS> defaultLengths = {
-            8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-            8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-            8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-            8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-            8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-            8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
-            8, 8, 8, 8, 8, 8, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-            9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-            9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-            9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-            9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
-            9, 9, 9, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
-            7, 7, 7, 7, 8, 8, 8, 8, 8, 8, 8, 8};
-
-        constexpr Array<u8, 32> defaultDistances
-            = {5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
-               5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5};
-        static_assert(defaultLengths.Size() == HuffmanTree::MAX_SYMBOLS);
-        static_assert(defaultDistances.Size() == 32);
-
-        switch (blockType)
+        Refill();
+        m_FinalBlock   = GetBits(1);
+        BlockType type = static_cast<BlockType>(GetBits(2));
+
+        switch (type)
         {
             case BlockType::eUncompressed:
             {
-                stream.AlignToByteBoundary();
-                u16 length        = stream.Read<u16>();
-                u16 negatedLength = stream.Read<u16>();
+                AlignToInput();
+                if (m_InputEnd - m_Input < 4)
+                {
+                    LogError("ZLib: Truncated stream");
+                    return false;
+                }
+
+                u16 length        = m_Input[0] | (m_Input[1] << 8);
+                u16 negatedLength = m_Input[2] | (m_Input[3] << 8);
+                m_Input += 4;
                 if ((length ^ 0xffff) != negatedLength)
                 {
                     LogError("ZLib: (length ^ 0xffff) != negatedLength");
                     return false;
                 }
-                if (m_OutputPointer + length >= m_OutputEnd)
-                    if (!EnsureCapacity(length * 2)) return false;
-                stream.Read(m_OutputPointer, length);
 
-                m_OutputPointer += length;
+                m_StoredLeft = length;
+                m_State      = State::eStored;
+                return true;
             }
-            break;
             case BlockType::eFixedHuffmanCode:
-                if (!m_LiteralLengthTree.Build(Span<u8, DynamicExtent>{
-                        const_cast<u8*>(defaultLengths.Raw()),
-                        defaultLengths.Size()})
-                    || !m_DistanceTree.Build(Span<u8, DynamicExtent>{
-                        const_cast<u8*>(defaultDistances.Raw()),
-                        defaultDistances.Size()}))
+            {
+                u8 fixedLengths[288 + 32];
+                for (usize i = 0; i < 288; ++i)
+                    fixedLengths[i] = i < 144   ? 8
+                                    : i < 256 ? 9
+                                    : i < 280 ? 7
+                                              : 8;
+                Memory::Fill(fixedLengths + 288, 5, 32);
+
+                if (!m_Literals.Build(fixedLengths, 288, true)
+                    || !m_Distances.Build(fixedLengths + 288, 32))
                 {
                     LogError("ZLib: Failed to build fixed huffman codes");
                     return false;
                 }
                 break;
+            }
             case BlockType::eDynamicHuffmanCode:
-                if (!DecodeCanonicalCodes(stream))
+                if (!ReadCodeLengths())
                 {
                     LogError(
                         "ZLib: Failed to build dynamic huffman canonical "
@@ -281,141 +493,245 @@ namespace ZLib
 
             default:
                 LogError("ZLib: Invalid block type, blockType: {}",
-                         ToUnderlying(blockType));
+                         ToUnderlying(type));
                 return false;
         }
 
+        m_State = State::eHuffman;
         return true;
     }
-    bool Decompressor::DecodeCanonicalCodes(BitStream<>& stream)
+    bool Inflater::ReadCodeLengths()
     {
-        constexpr u8 codeLengthOrder[19] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
-                                            11, 4,  12, 3, 13, 2, 14, 1, 15};
-        HuffmanTree  codeLengthTree;
-        u8           allCodeLengths[320];
-        u8           codeLengthCodeLengths[19];
-
-        i32          literalCodeCount    = stream.ReadBits(5) + 257;
-        i32          distanceCodeCount   = stream.ReadBits(5) + 1;
-        i32          codeLengthCodeCount = stream.ReadBits(4) + 4;
-        i32          totalCodes          = literalCodeCount + distanceCodeCount;
-
-        Memory::Fill(codeLengthCodeLengths, 0, sizeof(codeLengthCodeLengths));
-        for (i32 i = 0; i < codeLengthCodeCount; ++i)
-            codeLengthCodeLengths[codeLengthOrder[i]] = stream.ReadBits(3);
-        if (!codeLengthTree.Build({codeLengthCodeLengths, 19})) return false;
+        HuffmanTable codeLengthTable;
+        u8           lengths[286 + 30];
+        u8           codeLengthLengths[19] = {};
+
+        Refill();
+        usize literalCount    = GetBits(5) + 257;
+        usize distanceCount   = GetBits(5) + 1;
+        usize codeLengthCount = GetBits(4) + 4;
+        usize total           = literalCount + distanceCount;
+        if (literalCount > 286 || distanceCount > 30) return false;
+
+        for (usize i = 0; i < codeLengthCount; ++i)
+        {
+            Refill();
+            codeLengthLengths[CODE_LENGTH_ORDER[i]] = GetBits(3);
+        }
+        if (!codeLengthTable.Build(codeLengthLengths, 19)) return false;
 
-        i32 i = 0;
-        for (i = 0; i < totalCodes;)
+        for (usize i = 0; i < total;)
         {
-            i32 symbol = codeLengthTree.Decode(stream);
+            Refill();
+            i32   symbol = Decode(codeLengthTable);
 
-            i32 repeat = 0;
-            i32 value  = 0;
+            u8    value  = 0;
+            usize repeat = 0;
             switch (symbol)
             {
-                case 0 ... 15: allCodeLengths[i++] = (u8)symbol; continue;
+                case 0 ... 15: lengths[i++] = symbol; continue;
                 case 16:
-                    value  = allCodeLengths[i - 1];
-                    repeat = stream.ReadBits(2) + 3;
+                    if (i == 0) return false;
+                    value  = lengths[i - 1];
+                    repeat = GetBits(2) + 3;
                     break;
-                case 17: repeat = stream.ReadBits(3) + 3; break;
-                case 18: repeat = stream.ReadBits(7) + 11; break;
+                case 17: repeat = GetBits(3) + 3; break;
+                case 18: repeat = GetBits(7) + 11; break;
                 default: LogError("ZLib: Invalid code length"); return false;
             }
 
-            Memory::Fill(allCodeLengths + i, value, repeat);
+            if (i + repeat > total)
+            {
+                LogError("ZLib: Invalid number of code lengths");
+                return false;
+            }
+            Memory::Fill(lengths + i, value, repeat);
             i += repeat;
         }
-        if (i != totalCodes)
+        if (Truncated() || lengths[256] == 0) return false;
+
+        return m_Literals.Build(lengths, literalCount, true)
+            && m_Distances.Build(lengths + literalCount, distanceCount);
+    }
+    bool Inflater::CopyStored()
+    {
+        usize available = m_InputEnd - m_Input;
+        usize bytes     = Math::Min(m_StoredLeft, FILL_LIMIT - m_Position);
+        if (bytes > available)
         {
-            LogError("ZLib: Invalid number of code lengths");
+            LogError("ZLib: Truncated stream");
             return false;
         }
 
-        if (!m_LiteralLengthTree.Build(
-                {allCodeLengths, (usize)literalCodeCount}))
-            return false;
-        if (!m_DistanceTree.Build(
-                {allCodeLengths + literalCodeCount, (usize)distanceCodeCount}))
-            return false;
+        Memory::Copy(m_Buffer + m_Position, m_Input, bytes);
+        m_Input += bytes;
+        m_Position += bytes;
+        m_StoredLeft -= bytes;
+
+        if (!m_StoredLeft) m_State = State::eBlockHeader;
         return true;
     }
-
-    bool Decompressor::DecodeBlock(BitStream<>& stream)
+    bool Inflater::DecodeHuffman()
     {
-        u8* currentPointer = m_OutputPointer;
-        for (;;)
+        u8* out = m_Buffer + m_Position;
+        u8* end = m_Buffer + FILL_LIMIT;
+
+        // One refill covers the longest match, 15 + 5 length and 15 + 13
+        // distance bits
+        while (out < end)
         {
-            i32 symbol = m_LiteralLengthTree.Decode(stream);
-            if (symbol < 0)
+            Refill();
+            u32 entry = m_Literals.FastTable[m_BitBuffer
+                                             & HuffmanTable::FAST_MASK];
+            if (entry & HuffmanTable::PAIR)
             {
-                LogError("ZLib: Bad huffman code");
-                return false;
+                out[0] = entry;
+                out[1] = entry >> HuffmanTable::SECOND_SHIFT;
+                out += 2;
+                DropBits((entry >> HuffmanTable::PAIR_LENGTH_SHIFT)
+                         & HuffmanTable::PAIR_LENGTH_MASK);
+                continue;
             }
-            else if (symbol < 256)
+
+            i32 symbol = Decode(m_Literals);
+            if (symbol < 256)
             {
-                if (currentPointer >= m_OutputEnd)
-                {
-                    if (!EnsureCapacity(4096)) return false;
-                    currentPointer = m_OutputPointer;
-                }
-                *currentPointer++ = symbol;
+                if (symbol < 0) break;
+                *out++ = symbol;
                 continue;
             }
-
             if (symbol == 256)
             {
-                m_OutputPointer = currentPointer;
+                m_State    = State::eBlockHeader;
+                m_Position = out - m_Buffer;
                 return true;
             }
-            if (symbol >= 286)
-            {
-                LogError("ZLib: Bad huffman code");
-                return false;
-            }
+
             symbol -= 257;
-            constexpr i32 lengthBase[] = {
-                3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
-                31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
-
-            constexpr i32 lengthExtraBits[]
-                = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
-                   2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
-
-            i32 len = lengthBase[symbol];
-            if (lengthExtraBits[symbol])
-                len += stream.ReadBits(lengthExtraBits[symbol]);
-            symbol = m_DistanceTree.Decode(stream);
-            if (symbol < 0 || symbol >= 30)
+            if (symbol >= 29) break;
+            usize length = LENGTH_BASE[symbol]
+                         + GetBits(LENGTH_EXTRA_BITS[symbol]);
+
+            symbol = Decode(m_Distances);
+            if (symbol < 0 || symbol >= 30) break;
+            usize distance = DISTANCE_BASE[symbol]
+                           + GetBits(DISTANCE_EXTRA_BITS[symbol]);
+            if (distance > usize(out - m_Buffer))
             {
-                LogError("ZLib: Bad huffman code");
+                LogError("ZLib: Bad distance");
                 return false;
             }
-            constexpr i32 distBase[] = {
-                1,    2,    3,    4,    5,    7,    9,    13,    17,    25,
-                33,   49,   65,   97,   129,  193,  257,  385,   513,   769,
-                1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
-
-            constexpr i32 distExtraBits[]
-                = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
-                   6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
-
-            i32 distance = distBase[symbol];
-            if (distExtraBits[symbol])
-                distance += stream.ReadBits(distExtraBits[symbol]);
-            if (currentPointer - m_OutputBuffer < distance)
+
+            out = CopyMatch(out, distance, length);
+        }
+
+        m_Position = out - m_Buffer;
+        if (out < end)
+        {
+            LogError("ZLib: Bad huffman code");
+            return false;
+        }
+
+        return true;
+    }
+
+    void Inflater::UpdateChecksum(const u8* data, usize size)
+    {
+        if (m_Format == Format::eGZip)
+        {
+            u32 crc = ~m_Checksum;
+            while (size--)
+                crc = CRC32_TABLE.Entries[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+
+            m_Checksum = ~crc;
+            return;
+        }
+
+        u32 a = m_Checksum & 0xffff;
+        u32 b = m_Checksum >> 16;
+        while (size)
+        {
+            usize run = Math::Min(size, ADLER32_RUN);
+            size -= run;
+            while (run--)
             {
-                LogError("ZLib: Bad distance");
-                return false;
+                a += *data++;
+                b += a;
             }
-            if (currentPointer + len >= m_OutputEnd)
+
+            a %= ADLER32_MODULO;
+            b %= ADLER32_MODULO;
+        }
+
+        m_Checksum = (b << 16) | a;
+    }
+
+    Decompressor::~Decompressor()
+    {
+        if (m_OutputBuffer)
+        {
+            delete[] m_OutputBuffer;
+            m_OutputBuffer = nullptr;
+            m_OutputSize   = 0;
+        }
+    }
+
+    bool Decompressor::Decompress(usize initialSize)
+    {
+        if (initialSize == 0) initialSize = m_InputSize;
+        if (Detect(m_InputData, m_InputSize) != Format::eZLib)
+        {
+            LogError("ZLib: Invalid header");
+            return false;
+        }
+
+        Inflater inflater(m_InputData, m_InputSize);
+        EnsureCapacity(initialSize);
+        for (;;)
+        {
+            if (m_OutputPointer == m_OutputEnd && !EnsureCapacity(4096))
+                break;
+
+            isize bytes = inflater.Read(m_OutputPointer,
+                                        m_OutputEnd - m_OutputPointer);
+            if (bytes <= 0)
             {
-                if (!EnsureCapacity(len * 2)) return false;
-                currentPointer = m_OutputPointer;
+                if (bytes == 0) return true;
+                break;
             }
-            u8* src = reinterpret_cast<u8*>(currentPointer - distance);
-            while (len--) *currentPointer++ = distance == 1 ? *src : *src++;
+            m_OutputPointer += bytes;
         }
+
+        delete[] m_OutputBuffer;
+        m_OutputBuffer  = nullptr;
+        m_OutputPointer = nullptr;
+        m_OutputEnd     = nullptr;
+        m_OutputSize    = 0;
+        return false;
+    }
+
+    bool Decompressor::EnsureCapacity(usize count)
+    {
+        usize currentOffset
+            = m_OutputBuffer ? m_OutputPointer - m_OutputBuffer : 0;
+        usize newSize = m_OutputBuffer ? m_OutputSize : count;
+
+        while (newSize < currentOffset + count) newSize <<= 1;
+        if (m_OutputBuffer && newSize == m_OutputSize) return true;
+
+        u8* buffer = new u8[newSize];
+        if (!buffer) return false;
+        if (m_OutputBuffer)
+        {
+            Memory::Copy(buffer, m_OutputBuffer, currentOffset);
+            delete[] m_OutputBuffer;
+        }
+
+        m_OutputBuffer  = buffer;
+        m_OutputSize    = newSize;
+
+        m_OutputPointer = m_OutputBuffer + currentOffset;
+        m_OutputEnd     = m_OutputBuffer + newSize;
+        return true;
     }
 }; // namespace ZLib
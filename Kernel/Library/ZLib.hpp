@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 06.04.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -8,10 +8,8 @@
 
 #include <Prism/Containers/Array.hpp>
 #include <Prism/Containers/Span.hpp>
-#include <Prism/Containers/Vector.hpp>
 #include <Prism/Core/Types.hpp>
 
-#include <Prism/Memory/BitStream.hpp>
 #include <Prism/Memory/Endian.hpp>
 #include <Prism/Memory/Pointer.hpp>
 
@@ -53,26 +51,155 @@ namespace ZLib
         eReserved           = 0b11,
     };
 
-    struct HuffmanTree
+    enum class Format : u8
     {
-        inline static constexpr i32 FAST_BITS   = 9;
-        inline static constexpr i32 FAST_MASK   = (1 << FAST_BITS) - 1;
-        inline static constexpr i32 MAX_SYMBOLS = 288;
-
-        Array<u16, 1 << FAST_BITS>  FastLookupTable;
-        Array<u16, 16>              FirstCodeOfLength;
-        Array<i32, 17>              MaxCodeInclusive;
-        Array<u16, 16>              FirstSymbolIndexOfLength;
-        Array<u8, MAX_SYMBOLS>      SymbolBitLengths;
-        Array<u16, MAX_SYMBOLS>     SymbolValues;
-
-        HuffmanTree() = default;
-
-        bool Build(Span<u8, DynamicExtent> bitLengths);
-        i32  Decode(BitStream<>& stream);
-        i32  DecodeSlowPath(BitStream<>& stream);
+        eNone,
+        eZLib,
+        eGZip,
     };
+    /**
+     * @brief Recognizes the zlib and gzip wrappers of the deflate stream
+     */
+    Format Detect(Pointer data, usize size);
+
+    /**
+     * @brief Decoding tables of a canonical huffman code, the codes of up to
+     * FAST_BITS bits are resolved with a single lookup, for the literals even
+     * two of them at once, only the longer ones fall back to the bit by bit
+     * walk of the canonical code
+     */
+    struct HuffmanTable
+    {
+        inline static constexpr i32 FAST_BITS         = 10;
+        inline static constexpr i32 FAST_MASK         = (1 << FAST_BITS) - 1;
+        inline static constexpr i32 MAX_BITS          = 15;
+        inline static constexpr i32 MAX_SYMBOLS       = 288;
+
+        // Layout of the fast table's entries, zero means, that the code is
+        // longer than FAST_BITS
+        inline static constexpr u32 SYMBOL_MASK       = 0x1ff;
+        inline static constexpr u32 LENGTH_SHIFT      = 9;
+        inline static constexpr u32 LENGTH_MASK       = 0x0f;
+        inline static constexpr u32 SECOND_SHIFT      = 16;
+        inline static constexpr u32 PAIR_LENGTH_SHIFT = 24;
+        inline static constexpr u32 PAIR_LENGTH_MASK  = 0x1f;
+        inline static constexpr u32 PAIR              = 1u << 31;
+
+        Array<u32, 1 << FAST_BITS>  FastTable;
+        Array<u16, MAX_BITS + 1>    Counts;
+        Array<u16, MAX_SYMBOLS>     Symbols;
+
+        HuffmanTable() = default;
+
+        /**
+         * @param pairLiterals Whether the entries may hold two literals, the
+         * second one stored in the bits above SECOND_SHIFT
+         */
+        bool Build(const u8* lengths, usize count, bool pairLiterals = false);
+    };
+
+    /**
+     * @brief Streaming decoder of the zlib and gzip wrapped deflate streams,
+     * the output is produced piece by piece, as it's being pulled, only the
+     * last 32 KiB of it are kept around for the back references
+     */
+    class Inflater
+    {
+      public:
+        Inflater(Pointer data, usize size);
+        ~Inflater();
+
+        inline Format GetFormat() const { return m_Format; }
+        inline bool   Failed() const { return m_State == State::eError; }
+        inline usize  TotalIn() const { return m_Input - m_InputStart; }
+        inline usize  TotalOut() const { return m_TotalOut; }
+
+        /**
+         * @brief Decodes up to `count` bytes into `out`
+         *
+         * @return the number of bytes decoded, 0 at the end of the stream,
+         * or -1, if the stream is malformed
+         */
+        isize         Read(u8* out, usize count);
+        /**
+         * @brief Same as Read, but without the copy, `data` points straight
+         * into the window, and is only valid until the next call
+         */
+        isize         Next(const u8*& data, usize count);
 
+      private:
+        enum class State : u8
+        {
+            eBlockHeader,
+            eStored,
+            eHuffman,
+            eTrailer,
+            eDone,
+            eError,
+        };
+
+        inline static constexpr usize WINDOW_SIZE = 32_kib;
+        inline static constexpr usize BUFFER_SIZE = 128_kib;
+        inline static constexpr usize MAX_MATCH   = 258;
+        // The literal pairs, and the word sized copies of the matches may
+        // write a few bytes past the end of the output
+        inline static constexpr usize FILL_LIMIT
+            = BUFFER_SIZE - MAX_MATCH - sizeof(u64);
+
+        Format       m_Format       = Format::eNone;
+        State        m_State        = State::eError;
+        bool         m_FinalBlock   = false;
+
+        const u8*    m_InputStart   = nullptr;
+        const u8*    m_Input        = nullptr;
+        const u8*    m_InputEnd     = nullptr;
+        u64          m_BitBuffer    = 0;
+        usize        m_BitCount     = 0;
+        // Zero bytes shifted in past the end of the input
+        usize        m_Padding      = 0;
+
+        u8*          m_Buffer       = nullptr;
+        usize        m_Position     = 0;
+        usize        m_ReadPosition = 0;
+        usize        m_TotalOut     = 0;
+        usize        m_StoredLeft   = 0;
+        u32          m_Checksum     = 0;
+
+        HuffmanTable m_Literals;
+        HuffmanTable m_Distances;
+
+        bool         ParseHeader();
+        bool         ParseTrailer();
+
+        void         Refill();
+        u32          GetBits(usize count);
+        void         DropBits(usize count);
+        // Gives the whole bytes left in the bit buffer back to the input
+        void         AlignToInput();
+        bool         Truncated() const;
+
+        i32          DecodeSlowPath(const HuffmanTable& table);
+        inline i32   Decode(const HuffmanTable& table)
+        {
+            u32 entry = table.FastTable[m_BitBuffer & HuffmanTable::FAST_MASK];
+            if (!entry) return DecodeSlowPath(table);
+
+            DropBits((entry >> HuffmanTable::LENGTH_SHIFT)
+                     & HuffmanTable::LENGTH_MASK);
+            return entry & HuffmanTable::SYMBOL_MASK;
+        }
+
+        bool         Fill();
+        bool         ReadBlockHeader();
+        bool         ReadCodeLengths();
+        bool         CopyStored();
+        bool         DecodeHuffman();
+        void         UpdateChecksum(const u8* data, usize size);
+    };
+
+    /**
+     * @brief Decodes the whole zlib stream into a single buffer
+     */
     class Decompressor
     {
       public:
@@ -95,27 +222,16 @@ namespace ZLib
         }
 
       private:
-        Pointer     m_InputData     = nullptr;
-        usize       m_InputSize     = 0;
+        Pointer m_InputData     = nullptr;
+        usize   m_InputSize     = 0;
 
-        u8*         m_InputEnd      = nullptr;
+        u8*     m_OutputBuffer  = nullptr;
+        usize   m_OutputSize    = 0;
 
-        u8*         m_OutputBuffer  = nullptr;
-        usize       m_OutputSize    = 0;
-
-        u8*         m_OutputPointer = nullptr;
-        u8*         m_OutputEnd     = nullptr;
-
-        HuffmanTree m_LiteralLengthTree;
-        HuffmanTree m_DistanceTree;
+        u8*     m_OutputPointer = nullptr;
+        u8*     m_OutputEnd     = nullptr;
 
         // Ensures that output buffer can hold @count additional bytes
-        bool        EnsureCapacity(usize count);
-
-        bool        DecompressStream(BitStream<>& stream);
-        bool        ParseBlock(BitStream<>& stream, BlockType blockType);
-        bool        DecodeCanonicalCodes(BitStream<>& stream);
-
-        bool        DecodeBlock(BitStream<>& stream);
+        bool    EnsureCapacity(usize count);
     };
 }; // namespace ZLib
@@ -160,6 +160,22 @@ Ref<Region> AddressSpace::Find(Pointer address) const
 
 void AddressSpace::Clear() { m_RegionTree.Clear(); }
 
+usize AddressSpace::VirtualSize() const
+{
+    usize size = 0;
+    for (const auto& entry : m_RegionTree) size += entry.Value->Size();
+
+    return size;
+}
+usize AddressSpace::ResidentSize() const
+{
+    usize size = 0;
+    for (const auto& entry : m_RegionTree)
+        size += entry.Value->ResidentPageCount() * PMM::PAGE_SIZE;
+
+    return size;
+}
+
 void AddressSpace::Dump()
 {
     for (const auto& entry : m_RegionTree)
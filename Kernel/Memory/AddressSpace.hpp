@@ -39,6 +39,9 @@ class AddressSpace : public NonCopyable<AddressSpace>
     inline Ref<Region> operator[](Pointer virt) { return m_RegionTree[virt]; }
     void               Clear();
 
+    usize              VirtualSize() const;
+    usize              ResidentSize() const;
+
     auto               begin() { return m_RegionTree.begin(); }
     auto               end() { return m_RegionTree.end(); }
 
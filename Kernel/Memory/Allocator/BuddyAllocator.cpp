@@ -1,12 +1,24 @@
 /*
  * Created by v1tr10l7 on 08.07.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
 #include <Memory/Allocator/BuddyAllocator.hpp>
 #include <Prism/Utility/Math.hpp>
 
+namespace
+{
+    constexpr usize DMA_ZONE_TOP = 16_mib;
+
+    // Smallest order, whose block fits `pageCount` pages
+    inline usize    OrderOf(usize pageCount)
+    {
+        if (pageCount <= 1) return 0;
+        return 64 - __builtin_clzll(pageCount - 1);
+    }
+}; // namespace
+
 ErrorOr<void> BuddyAllocator::Initialize(MemoryMap& memoryMap, usize pageSize)
 {
     if (!Math::IsPowerOfTwo(pageSize)) return Error(EINVAL);
@@ -14,7 +26,55 @@ ErrorOr<void> BuddyAllocator::Initialize(MemoryMap& memoryMap, usize pageSize)
 
     auto memoryZones = Span(memoryMap.Entries, memoryMap.EntryCount);
     for (const auto& zone : memoryZones)
-        IgnoreUnused(zone);
+    {
+        Pointer top = zone.Base().Offset(zone.Length());
+        m_MemoryTop = Math::Max(m_MemoryTop.Raw(), top.Raw());
+
+        switch (zone.Type())
+        {
+            case MemoryZoneType::eUsable:
+                m_UsableMemorySize += zone.Length();
+                m_UsableMemoryTop = Math::Max(m_UsableMemoryTop, top);
+
+                break;
+            case MemoryZoneType::eACPI_Reclaimable:
+            case MemoryZoneType::eBootloaderReclaimable:
+            case MemoryZoneType::eKernelAndModules:
+                m_UsedMemory += zone.Length();
+                break;
+            default: continue;
+        }
+
+        m_TotalMemory += zone.Length();
+    }
+
+    if (!m_MemoryTop) return Error(ENOMEM);
+
+    m_PageCount  = m_UsableMemoryTop.Raw() / pageSize;
+    m_PageStates = new u8[m_PageCount];
+    if (!m_PageStates) return Error(ENOMEM);
+    Memory::Fill(m_PageStates, 0, m_PageCount);
+
+    usize dmaTop = Math::Min(DMA_ZONE_TOP / pageSize, m_PageCount);
+    m_Zones[ToUnderlying(Zone::eDMA)].Base    = 0;
+    m_Zones[ToUnderlying(Zone::eDMA)].Top     = dmaTop;
+    m_Zones[ToUnderlying(Zone::eNormal)].Base = dmaTop;
+    m_Zones[ToUnderlying(Zone::eNormal)].Top  = m_PageCount;
+
+    ScopedLock guard(m_Lock);
+    for (const auto& zone : memoryZones)
+    {
+        if (zone.Type() != MemoryZoneType::eUsable) continue;
+
+        usize first = Math::AlignUp(zone.Base().Raw(), pageSize) / pageSize;
+        usize last  = (zone.Base().Raw() + zone.Length()) / pageSize;
+
+        // Page 0 is never handed out, so that null still signals failure
+        if (first == 0) first = 1;
+        if (first >= last) continue;
+
+        FreeRange(first, last - first);
+    }
 
     return {};
 }
@@ -29,5 +89,151 @@ usize BuddyAllocator::FreeMemorySize() const
 usize   BuddyAllocator::UsedMemorySize() const { return m_UsedMemory; }
 usize   BuddyAllocator::PageSize() const { return m_PageSize; }
 
-Pointer BuddyAllocator::AllocatePages(usize pageCount) { return nullptr; }
-void    BuddyAllocator::FreePages(Pointer page, usize pageCount) {}
+Pointer BuddyAllocator::AllocatePages(usize pageCount)
+{
+    return AllocatePages(pageCount, Zone::eNormal);
+}
+void BuddyAllocator::FreePages(Pointer page, usize pageCount)
+{
+    ScopedLock guard(m_Lock);
+    if (pageCount == 0 || !page) return;
+
+    FreeRange(page.Raw() / m_PageSize, pageCount);
+    m_UsedMemory -= pageCount * m_PageSize;
+}
+
+Pointer BuddyAllocator::AllocatePages(usize pageCount, Zone zone)
+{
+    if (pageCount == 0) return nullptr;
+
+    usize order = OrderOf(pageCount);
+    if (order > MAX_ORDER) return nullptr;
+
+    ScopedLock guard(m_Lock);
+    for (isize i = ToUnderlying(zone); i >= 0; i--)
+    {
+        auto frame = AllocateBlock(m_Zones[i], order);
+        if (!frame) continue;
+
+        // The excess pages go straight back to the free lists
+        usize blockSize = 1zu << order;
+        if (pageCount < blockSize)
+            FreeRange(*frame + pageCount, blockSize - pageCount);
+
+        m_UsedMemory += pageCount * m_PageSize;
+        return *frame * m_PageSize;
+    }
+
+    return nullptr;
+}
+
+usize BuddyAllocator::FreeBlockCount(Zone zone, usize order) const
+{
+    if (order > MAX_ORDER) return 0;
+    return m_Zones[ToUnderlying(zone)].FreeCounts[order];
+}
+StringView BuddyAllocator::ZoneName(Zone zone)
+{
+    switch (zone)
+    {
+        case Zone::eDMA: return "DMA"_sv;
+        case Zone::eNormal: return "Normal"_sv;
+
+        default: break;
+    }
+
+    return "Unknown"_sv;
+}
+
+BuddyAllocator::ZoneInfo& BuddyAllocator::ZoneOf(usize frame)
+{
+    for (auto& zone : m_Zones)
+        if (frame >= zone.Base && frame < zone.Top) return zone;
+
+    AssertNotReached();
+}
+BuddyAllocator::FreeBlock* BuddyAllocator::BlockAt(usize frame) const
+{
+    return Pointer(frame * m_PageSize).ToHigherHalf<FreeBlock*>();
+}
+
+void BuddyAllocator::PushBlock(ZoneInfo& zone, usize frame, usize order)
+{
+    FreeBlock* block = BlockAt(frame);
+    FreeBlock* head  = zone.FreeLists[order];
+
+    block->Previous  = nullptr;
+    block->Next      = head;
+    if (head) head->Previous = block;
+
+    zone.FreeLists[order] = block;
+    ++zone.FreeCounts[order];
+    m_PageStates[frame] = FREE_BLOCK_BIT | order;
+}
+void BuddyAllocator::RemoveBlock(ZoneInfo& zone, usize frame, usize order)
+{
+    FreeBlock* block = BlockAt(frame);
+    if (block->Previous) block->Previous->Next = block->Next;
+    else zone.FreeLists[order] = block->Next;
+    if (block->Next) block->Next->Previous = block->Previous;
+
+    --zone.FreeCounts[order];
+    m_PageStates[frame] = 0;
+}
+
+Optional<usize> BuddyAllocator::AllocateBlock(ZoneInfo& zone, usize order)
+{
+    usize current = order;
+    while (current <= MAX_ORDER && !zone.FreeLists[current]) ++current;
+    if (current > MAX_ORDER) return NullOpt;
+
+    usize frame = Pointer(zone.FreeLists[current]).FromHigherHalf<usize>()
+                / m_PageSize;
+    RemoveBlock(zone, frame, current);
+
+    // Split the block, until it's of the requested size, the upper halves
+    // become free blocks of their own
+    while (current > order)
+    {
+        --current;
+        PushBlock(zone, frame + (1zu << current), current);
+    }
+
+    return frame;
+}
+void BuddyAllocator::ReleaseBlock(usize frame, usize order)
+{
+    auto& zone = ZoneOf(frame);
+    while (order < MAX_ORDER)
+    {
+        usize buddy = frame ^ (1zu << order);
+        if (buddy < zone.Base || buddy >= zone.Top
+            || m_PageStates[buddy] != (FREE_BLOCK_BIT | order))
+            break;
+
+        RemoveBlock(zone, buddy, order);
+        frame = Math::Min(frame, buddy);
+        ++order;
+    }
+
+    PushBlock(zone, frame, order);
+}
+void BuddyAllocator::FreeRange(usize frame, usize count)
+{
+    Assert(frame + count <= m_PageCount);
+
+    // Carved into the largest naturally aligned blocks within the zone
+    while (count > 0)
+    {
+        usize order = frame ? __builtin_ctzll(frame) : MAX_ORDER;
+        order       = Math::Min(order, MAX_ORDER);
+
+        usize zoneTop = ZoneOf(frame).Top;
+        while ((1zu << order) > count || frame + (1zu << order) > zoneTop)
+            --order;
+
+        ReleaseBlock(frame, order);
+        frame += 1zu << order;
+        count -= 1zu << order;
+    }
+}
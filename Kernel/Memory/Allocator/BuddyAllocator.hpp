@@ -1,38 +1,98 @@
 /*
  * Created by v1tr10l7 on 08.07.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
 #pragma once
 
 #include <Memory/Allocator/PageFrameAllocator.hpp>
-#include <Prism/Containers/Bitmap.hpp>
 
+#include <Prism/Containers/Array.hpp>
+#include <Prism/String/StringView.hpp>
+#include <Prism/Utility/Optional.hpp>
+
+/**
+ * @brief Binary buddy allocator, free memory is kept as naturally aligned
+ * blocks of 2^order pages, on a free list per order, and zone. Allocations
+ * split the smallest fitting block, and freed blocks are merged with their
+ * buddies, as long as they are free as well
+ */
 class BuddyAllocator : public PageFrameAllocator
 {
   public:
-    virtual ErrorOr<void> Initialize(MemoryMap& memoryMap,
-                                     usize      pageSize) override;
-    virtual void          Shutdown() override;
+    enum class Zone : u8
+    {
+        // Memory below 16 MiB, reachable by legacy DMA engines
+        eDMA    = 0,
+        eNormal = 1,
+        eCount,
+    };
+    constexpr static usize ZONE_COUNT = ToUnderlying(Zone::eCount);
+    constexpr static usize MAX_ORDER  = 18;
+
+    virtual ErrorOr<void>  Initialize(MemoryMap& memoryMap,
+                                      usize      pageSize) override;
+    virtual void           Shutdown() override;
 
-    virtual usize         MemoryTop() const override;
-    virtual usize         TotalMemorySize() const override;
-    virtual usize         FreeMemorySize() const override;
-    virtual usize         UsedMemorySize() const override;
-    virtual usize         PageSize() const override;
+    virtual usize          MemoryTop() const override;
+    virtual usize          TotalMemorySize() const override;
+    virtual usize          FreeMemorySize() const override;
+    virtual usize          UsedMemorySize() const override;
+    virtual usize          PageSize() const override;
 
-    virtual Pointer       AllocatePages(usize pageCount) override;
-    virtual void          FreePages(Pointer page, usize pageCount) override;
+    virtual Pointer        AllocatePages(usize pageCount) override;
+    virtual void           FreePages(Pointer page, usize pageCount) override;
+
+    /**
+     * @brief Allocates pages from the `zone`, falling back to the lower zones
+     * once it is exhausted
+     */
+    Pointer                AllocatePages(usize pageCount, Zone zone);
+
+    usize                  FreeBlockCount(Zone zone, usize order) const;
+    static StringView      ZoneName(Zone zone);
 
   private:
-    Pointer m_MemoryTop        = 0;
-    Pointer m_UsableMemoryTop  = 0;
+    struct FreeBlock
+    {
+        FreeBlock* Next     = nullptr;
+        FreeBlock* Previous = nullptr;
+    };
+    struct ZoneInfo
+    {
+        // Range of page frames covered by the zone
+        usize                              Base = 0;
+        usize                              Top  = 0;
+
+        Array<FreeBlock*, MAX_ORDER + 1>   FreeLists{};
+        Array<usize, MAX_ORDER + 1>        FreeCounts{};
+    };
+
+    // Free blocks record their order in their first page, other pages stay
+    // zeroed
+    constexpr static u8      FREE_BLOCK_BIT = Bit(7);
+
+    u8*                      m_PageStates      = nullptr;
+    usize                    m_PageCount       = 0;
+    Array<ZoneInfo, ZONE_COUNT> m_Zones;
+
+    Pointer                  m_MemoryTop        = 0;
+    Pointer                  m_UsableMemoryTop  = 0;
+
+    usize                    m_PageSize         = 0;
+    usize                    m_UsableMemorySize = 0;
+    usize                    m_TotalMemory      = 0;
+    usize                    m_UsedMemory       = 0;
+
+    ZoneInfo&                ZoneOf(usize frame);
+    FreeBlock*               BlockAt(usize frame) const;
 
-    usize   m_PageSize         = 0;
-    usize   m_UsableMemorySize = 0;
-    usize   m_TotalMemory      = 0;
-    usize   m_UsedMemory       = 0;
+    void                     PushBlock(ZoneInfo& zone, usize frame, usize order);
+    void                     RemoveBlock(ZoneInfo& zone, usize frame,
+                                         usize order);
 
-    Pointer FindFreeRegions(usize& start, usize count, usize limit);
+    Optional<usize>          AllocateBlock(ZoneInfo& zone, usize order);
+    void                     ReleaseBlock(usize frame, usize order);
+    void                     FreeRange(usize frame, usize count);
 };
@@ -1,17 +1,21 @@
 /*
  * Created by v1tr10l7 on 17.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
 #include <Common.hpp>
 
+#include <Arch/CPU.hpp>
 #include <Library/Locking/Spinlock.hpp>
 #include <Memory/PMM.hpp>
 #include <Memory/PageMap.hpp>
 
 #include <Memory/Allocator/KernelHeap.hpp>
-#include <Prism/Memory/SlabPool.hpp>
+
+#include <Prism/Containers/Array.hpp>
+#include <Prism/Containers/RedBlackTree.hpp>
+#include <Prism/Utility/Atomic.hpp>
 
 namespace VMM
 {
@@ -19,44 +23,87 @@ namespace VMM
 }
 namespace KernelHeap
 {
-    struct PageAllocPolicy
+    namespace
     {
-        static Pointer CallocatePages(usize pageCount = 1)
+        constexpr usize SIZE_CLASSES[] = {16,  32,  48,  64,   96,   128,  192,
+                                          256, 384, 512, 768, 1024, 1536, 2048};
+        constexpr usize SIZE_CLASS_COUNT
+            = sizeof(SIZE_CLASSES) / sizeof(SIZE_CLASSES[0]);
+        constexpr usize MIN_ALIGNMENT     = 16;
+
+        constexpr usize SLAB_SIZE         = PMM::PAGE_SIZE;
+        constexpr u32   SLAB_MAGIC        = 0x51ab51ab;
+        // How many completely free slabs a cache holds on to, before it starts
+        // returning them to the PMM
+        constexpr usize MAX_EMPTY_SLABS   = 2;
+
+        constexpr usize MAGAZINE_SIZE     = 32;
+        constexpr usize MAGAZINE_BATCH    = MAGAZINE_SIZE / 2;
+
+        struct FreeObject
         {
-            return Pointer(PMM::CallocatePages(pageCount)).ToHigherHalf();
-        }
-        static void FreePages(Pointer memory, usize pageCount = 1)
+            FreeObject* Next;
+        };
+        struct SlabCache;
+        // Slabs are single pages with the header first, so slab objects are
+        // never page aligned, which is how Free recognizes large objects
+        struct Slab
         {
-            PMM::FreePages(memory.FromHigherHalf(), pageCount);
-        }
-    };
-    class SpinLockPolicy
-    {
-      public:
-        void                     Init() {}
-        [[nodiscard]] ScopedLock Lock() { return ScopedLock(m_Lock); }
+            u32         Magic;
+            u32         InUse;
+            SlabCache*  Cache;
+            FreeObject* FreeList;
+            Slab*       Next;
+            Slab*       Previous;
+        };
+        constexpr usize SLAB_HEADER_SIZE
+            = (sizeof(Slab) + MIN_ALIGNMENT - 1) & ~(MIN_ALIGNMENT - 1);
 
-      private:
-        Spinlock m_Lock;
-    };
+        struct SlabCache
+        {
+            usize    SizeClass      = 0;
+            usize    ObjectSize     = 0;
+            usize    ObjectsPerSlab = 0;
 
-    namespace
-    {
-        constexpr usize BUCKET_COUNT         = 8;
+            Spinlock Lock;
+            // Slabs with at least one free object, full slabs aren't linked
+            // anywhere, until something gets freed to them
+            Slab*    Partial        = nullptr;
+            usize    SlabCount      = 0;
+            usize    EmptySlabs     = 0;
+            // Objects taken out of the slabs, including the ones cached in
+            // magazines
+            usize    InUse          = 0;
+        };
+
+        struct Magazine
+        {
+            Array<void*, MAGAZINE_SIZE> Objects;
+            usize                       Count       = 0;
+
+            usize                       Allocations = 0;
+            usize                       Frees       = 0;
+        };
+        using CPUMagazines = Array<Magazine, SIZE_CLASS_COUNT>;
+
+        bool                              s_Initialized        = false;
+        Pointer                           s_EarlyHeapBase      = nullptr;
+        usize                             s_EarlyHeapSize      = 0;
+        usize                             s_EarlyHeapAllocated = 0;
+        Pointer                           s_EarlyHeapCurrent   = nullptr;
 
-        bool            s_Initialized        = false;
-        Pointer         s_EarlyHeapBase      = nullptr;
-        usize           s_EarlyHeapSize      = 0;
-        usize           s_EarlyHeapAllocated = 0;
-        Pointer         s_EarlyHeapCurrent   = nullptr;
+        Array<SlabCache, SIZE_CLASS_COUNT> s_Caches;
+        // The count is stored last, publishing the magazine once it's populated
+        CPUMagazines**                    s_Magazines          = nullptr;
+        Atomic<usize>                     s_MagazineCount      = 0;
 
-        alignas(SlabPool<8, PageAllocPolicy, SpinLockPolicy>) static u8
-            s_SlabPoolStorage[sizeof(
-                SlabPool<8, PageAllocPolicy, SpinLockPolicy>)];
-        static SlabPool<8, PageAllocPolicy, SpinLockPolicy>* s_SlabPool
-            = nullptr;
+        // Large objects bypass the slabs, and get whole pages straight from
+        // the PMM, keyed here by their address
+        Spinlock                          s_LargeObjectsLock;
+        RedBlackTree<uintptr_t, usize>    s_LargeObjects;
+        LargeObjectStatistics             s_LargeObjectStatistics;
 
-        Pointer EarlyHeapAllocate(usize size)
+        Pointer                           EarlyHeapAllocate(usize size)
         {
             size = Math::AlignUp(size, sizeof(void*));
             Assert(s_EarlyHeapSize - s_EarlyHeapAllocated > size);
@@ -67,6 +114,231 @@ namespace KernelHeap
 
             return memory;
         }
+        bool IsEarlyHeapAddress(Pointer memory)
+        {
+            return memory.Raw() >= s_EarlyHeapBase.Raw()
+                && memory.Raw() < s_EarlyHeapBase.Raw() + s_EarlyHeapSize;
+        }
+        inline bool IsLargeObject(Pointer memory)
+        {
+            return (memory.Raw() & (PMM::PAGE_SIZE - 1)) == 0;
+        }
+
+        isize SizeClassOf(usize bytes)
+        {
+            for (usize i = 0; i < SIZE_CLASS_COUNT; i++)
+                if (bytes <= SIZE_CLASSES[i]) return i;
+
+            return -1;
+        }
+        Slab* SlabOf(Pointer object)
+        {
+            auto slab
+                = Pointer(Math::AlignDown(object.Raw(), SLAB_SIZE)).As<Slab>();
+            Assert(slab->Magic == SLAB_MAGIC);
+
+            return slab;
+        }
+
+        void LinkSlab(SlabCache& cache, Slab* slab)
+        {
+            slab->Previous = nullptr;
+            slab->Next     = cache.Partial;
+            if (cache.Partial) cache.Partial->Previous = slab;
+            cache.Partial = slab;
+        }
+        void UnlinkSlab(SlabCache& cache, Slab* slab)
+        {
+            if (slab->Previous) slab->Previous->Next = slab->Next;
+            else cache.Partial = slab->Next;
+            if (slab->Next) slab->Next->Previous = slab->Previous;
+
+            slab->Next = slab->Previous = nullptr;
+        }
+
+        Slab* CreateSlab(SlabCache& cache)
+        {
+            Pointer page = PMM::AllocatePages(1);
+            if (!page) return nullptr;
+
+            auto slab      = page.ToHigherHalf<Slab*>();
+            slab->Magic    = SLAB_MAGIC;
+            slab->InUse    = 0;
+            slab->Cache    = &cache;
+            slab->FreeList = nullptr;
+
+            Pointer objects
+                = Pointer(slab).Offset(SLAB_HEADER_SIZE).Offset(
+                    (cache.ObjectsPerSlab - 1) * cache.ObjectSize);
+            for (usize i = 0; i < cache.ObjectsPerSlab; i++)
+            {
+                auto object    = objects.As<FreeObject>();
+                object->Next   = slab->FreeList;
+                slab->FreeList = object;
+
+                objects        = objects.Raw() - cache.ObjectSize;
+            }
+
+            LinkSlab(cache, slab);
+            ++cache.SlabCount;
+            ++cache.EmptySlabs;
+            return slab;
+        }
+
+        // Both expect the cache's lock to be held
+        void* SlabAllocate(SlabCache& cache)
+        {
+            Slab* slab = cache.Partial;
+            if (!slab && !(slab = CreateSlab(cache))) return nullptr;
+
+            FreeObject* object = slab->FreeList;
+            slab->FreeList     = object->Next;
+
+            if (slab->InUse++ == 0) --cache.EmptySlabs;
+            if (!slab->FreeList) UnlinkSlab(cache, slab);
+
+            ++cache.InUse;
+            return object;
+        }
+        void SlabFree(SlabCache& cache, void* memory)
+        {
+            Slab* slab     = SlabOf(memory);
+            auto  object   = reinterpret_cast<FreeObject*>(memory);
+
+            object->Next   = slab->FreeList;
+            slab->FreeList = object;
+            if (slab->InUse-- == cache.ObjectsPerSlab) LinkSlab(cache, slab);
+            --cache.InUse;
+
+            if (slab->InUse > 0 || ++cache.EmptySlabs <= MAX_EMPTY_SLABS)
+                return;
+
+            UnlinkSlab(cache, slab);
+            slab->Magic = 0;
+            --cache.EmptySlabs;
+            --cache.SlabCount;
+
+            PMM::FreePages(Pointer(slab).FromHigherHalf().Raw(), 1);
+        }
+
+        Magazine* CurrentMagazine(usize sizeClass)
+        {
+            usize cpuID = CPU::GetCurrentID();
+            if (cpuID >= s_MagazineCount.Load()) return nullptr;
+
+            return &(*s_Magazines[cpuID])[sizeClass];
+        }
+        void* CacheAllocate(usize sizeClass)
+        {
+            auto& cache    = s_Caches[sizeClass];
+            bool  intState = CPU::SwapInterruptFlag(false);
+
+            auto  magazine = CurrentMagazine(sizeClass);
+            if (!magazine)
+            {
+                void* object = nullptr;
+                {
+                    ScopedLock guard(cache.Lock);
+                    object = SlabAllocate(cache);
+                }
+
+                CPU::SetInterruptFlag(intState);
+                return object;
+            }
+
+            if (magazine->Count == 0)
+            {
+                ScopedLock guard(cache.Lock);
+                for (usize i = 0; i < MAGAZINE_BATCH; i++)
+                {
+                    void* object = SlabAllocate(cache);
+                    if (!object) break;
+
+                    magazine->Objects[magazine->Count++] = object;
+                }
+            }
+
+            void* object = nullptr;
+            if (magazine->Count > 0)
+            {
+                object = magazine->Objects[--magazine->Count];
+                ++magazine->Allocations;
+            }
+
+            CPU::SetInterruptFlag(intState);
+            return object;
+        }
+        void CacheFree(void* memory)
+        {
+            SlabCache& cache     = *SlabOf(memory)->Cache;
+            usize      sizeClass = cache.SizeClass;
+            bool       intState  = CPU::SwapInterruptFlag(false);
+
+            auto       magazine  = CurrentMagazine(sizeClass);
+            if (!magazine)
+            {
+                {
+                    ScopedLock guard(cache.Lock);
+                    SlabFree(cache, memory);
+                }
+
+                CPU::SetInterruptFlag(intState);
+                return;
+            }
+
+            if (magazine->Count == MAGAZINE_SIZE)
+            {
+                ScopedLock guard(cache.Lock);
+                for (usize i = 0; i < MAGAZINE_BATCH; i++)
+                    SlabFree(cache, magazine->Objects[--magazine->Count]);
+            }
+
+            magazine->Objects[magazine->Count++] = memory;
+            ++magazine->Frees;
+            CPU::SetInterruptFlag(intState);
+        }
+
+        Pointer LargeAllocate(usize bytes)
+        {
+            usize   pageCount = Math::DivRoundUp(bytes, PMM::PAGE_SIZE);
+            Pointer pages     = PMM::AllocatePages(pageCount);
+            if (!pages) return nullptr;
+
+            Pointer    memory = pages.ToHigherHalf();
+            ScopedLock guard(s_LargeObjectsLock, true);
+            s_LargeObjects.Insert(memory.Raw(), pageCount);
+
+            ++s_LargeObjectStatistics.Objects;
+            ++s_LargeObjectStatistics.Allocations;
+            s_LargeObjectStatistics.Pages += pageCount;
+            return memory;
+        }
+        usize LargeObjectSize(Pointer memory)
+        {
+            ScopedLock guard(s_LargeObjectsLock, true);
+            auto       it = s_LargeObjects.Find(memory.Raw());
+            Assert(it != s_LargeObjects.end());
+
+            return it->Value * PMM::PAGE_SIZE;
+        }
+        void LargeFree(Pointer memory)
+        {
+            usize pageCount = 0;
+            {
+                ScopedLock guard(s_LargeObjectsLock, true);
+                auto       it = s_LargeObjects.Find(memory.Raw());
+                Assert(it != s_LargeObjects.end());
+
+                pageCount = it->Value;
+                s_LargeObjects.Erase(memory.Raw());
+
+                --s_LargeObjectStatistics.Objects;
+                ++s_LargeObjectStatistics.Frees;
+                s_LargeObjectStatistics.Pages -= pageCount;
+            }
+
+            PMM::FreePages(memory.FromHigherHalf().Raw(), pageCount);
+        }
     } // namespace
 
     void EarlyInitialize(Pointer base, usize length)
@@ -100,40 +372,138 @@ namespace KernelHeap
     void Initialize()
     {
         EarlyLogTrace("KernelHeap: Initializing...");
-        s_SlabPool = new (&s_SlabPoolStorage)
-            SlabPool<8, PageAllocPolicy, SpinLockPolicy>();
-        s_SlabPool->Initialize();
+        for (usize i = 0; i < SIZE_CLASS_COUNT; i++)
+        {
+            auto& cache          = s_Caches[i];
+            cache.SizeClass      = i;
+            cache.ObjectSize     = SIZE_CLASSES[i];
+            cache.ObjectsPerSlab = (SLAB_SIZE - SLAB_HEADER_SIZE) / SIZE_CLASSES[i];
+        }
 
         s_Initialized = true;
-        LogInfo("KernelHeap: Initialized `{}` slab buckets", BUCKET_COUNT);
+        LogInfo("KernelHeap: Initialized `{}` slab caches", SIZE_CLASS_COUNT);
+    }
+    void InitializeMagazines(usize cpuCount)
+    {
+        if (s_Magazines) return;
+
+        // Allocations made in the meantime still go through the slabs
+        auto magazines = new CPUMagazines*[cpuCount];
+        for (usize cpuID = 0; cpuID < cpuCount; cpuID++)
+            magazines[cpuID] = new CPUMagazines;
+
+        s_Magazines = magazines;
+        s_MagazineCount.Store(cpuCount);
+
+        LogInfo("KernelHeap: Initialized magazines for {} cpus", cpuCount);
     }
 
     Pointer Allocate(usize bytes)
     {
         if (!s_Initialized) return EarlyHeapAllocate(bytes);
-        return s_SlabPool->Allocate(bytes);
+        if (bytes == 0) bytes = 1;
+
+        isize sizeClass = SizeClassOf(bytes);
+        if (sizeClass < 0) return LargeAllocate(bytes);
+
+        return CacheAllocate(sizeClass);
     }
     Pointer Callocate(usize bytes)
     {
-        return s_Initialized ? s_SlabPool->Callocate(bytes)
-                             : EarlyHeapAllocate(bytes);
+        Pointer memory = Allocate(bytes);
+        if (memory) Memory::Fill(memory, 0, bytes);
+
+        return memory;
     }
     Pointer Reallocate(Pointer memory, usize size)
     {
-        return s_SlabPool->Reallocate(memory, size);
+        if (!memory) return Allocate(size);
+
+        // The early heap is mapped as a whole, so copying past the old size is
+        // harmless
+        usize oldSize = size;
+        if (!IsEarlyHeapAddress(memory))
+            oldSize = IsLargeObject(memory) ? LargeObjectSize(memory)
+                                            : SlabOf(memory)->Cache->ObjectSize;
+        if (size <= oldSize && !IsEarlyHeapAddress(memory)) return memory;
+
+        Pointer newMemory = Allocate(size);
+        if (!newMemory) return nullptr;
+
+        Memory::Copy(newMemory, memory, Math::Min(oldSize, size));
+        Free(memory);
+        return newMemory;
+    }
+    void Free(Pointer memory)
+    {
+        if (!memory || IsEarlyHeapAddress(memory)) return;
+        if (IsLargeObject(memory)) return LargeFree(memory);
+
+        CacheFree(memory);
+    }
+
+    usize          SizeClassCount() { return SIZE_CLASS_COUNT; }
+    SlabStatistics GetStatistics(usize sizeClass)
+    {
+        SlabStatistics stats{};
+        if (sizeClass >= SIZE_CLASS_COUNT) return stats;
+
+        auto& cache          = s_Caches[sizeClass];
+        stats.ObjectSize     = cache.ObjectSize;
+        stats.ObjectsPerSlab = cache.ObjectsPerSlab;
+        {
+            ScopedLock guard(cache.Lock, true);
+            stats.Slabs         = cache.SlabCount;
+            stats.ActiveObjects = cache.InUse;
+        }
+
+        // The magazines are read racily, the numbers are only an overview
+        for (usize cpuID = 0; cpuID < s_MagazineCount.Load(); cpuID++)
+        {
+            auto& magazine = (*s_Magazines[cpuID])[sizeClass];
+            stats.CachedObjects += magazine.Count;
+            stats.Allocations += magazine.Allocations;
+            stats.Frees += magazine.Frees;
+        }
+        stats.ActiveObjects -= Math::Min(stats.ActiveObjects,
+                                         stats.CachedObjects);
+
+        return stats;
+    }
+    LargeObjectStatistics GetLargeObjectStatistics()
+    {
+        ScopedLock guard(s_LargeObjectsLock, true);
+        return s_LargeObjectStatistics;
     }
-    void Free(Pointer memory) { return s_SlabPool->Free(memory); }
 } // namespace KernelHeap
 
+// Much of the kernel still expects new to zero the memory. Code that overwrites
+// it anyway should use new (KernelHeap::Uninitialized)
 void* operator new(usize size) { return KernelHeap::Callocate(size); }
-void* operator new(usize size, std::align_val_t)
+void* operator new(usize size, std::align_val_t alignment)
 {
-    return KernelHeap::Callocate(size);
+    if (static_cast<usize>(alignment) <= KernelHeap::MIN_ALIGNMENT)
+        return KernelHeap::Callocate(size);
+
+    // Large objects are always page aligned
+    Assert(static_cast<usize>(alignment) <= PMM::PAGE_SIZE);
+    Pointer memory = KernelHeap::LargeAllocate(size);
+    if (memory) Memory::Fill(memory, 0, size);
+
+    return memory;
 }
 void* operator new[](usize size) { return KernelHeap::Callocate(size); }
-void* operator new[](usize size, std::align_val_t)
+void* operator new[](usize size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+void* operator new(usize size, KernelHeap::UninitializedTag)
+{
+    return KernelHeap::Allocate(size);
+}
+void* operator new[](usize size, KernelHeap::UninitializedTag)
 {
-    return KernelHeap::Callocate(size);
+    return KernelHeap::Allocate(size);
 }
 void operator delete(void* memory) noexcept { KernelHeap::Free(memory); }
 void operator delete(void* memory, std::align_val_t) noexcept
@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 17.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -11,12 +11,51 @@
 
 namespace KernelHeap
 {
-    void    Initialize();
+    struct SlabStatistics
+    {
+        usize ObjectSize     = 0;
+        usize ObjectsPerSlab = 0;
+        usize Slabs          = 0;
+        // Objects handed out to callers
+        usize ActiveObjects  = 0;
+        // Free objects, which are cached in the per-cpu magazines
+        usize CachedObjects  = 0;
+        usize Allocations    = 0;
+        usize Frees          = 0;
+    };
+    struct LargeObjectStatistics
+    {
+        usize Objects     = 0;
+        usize Pages       = 0;
+        usize Allocations = 0;
+        usize Frees       = 0;
+    };
+
+    // Tag for the non-zeroing operator new, e.g. new (KernelHeap::Uninitialized)
+    // u8[size], for memory, which is going to be overwritten anyway
+    struct UninitializedTag
+    {
+    };
+    inline constexpr UninitializedTag Uninitialized{};
+
+    void                              Initialize();
+    /**
+     * @brief Sets up the per-cpu magazines, which front the slab caches, until
+     * then every allocation takes the slab cache's lock
+     */
+    void                              InitializeMagazines(usize cpuCount);
 
     // TODO(v1tr10l7): alignment
-    Pointer Allocate(usize bytes);
-    Pointer Callocate(usize bytes);
-    Pointer Reallocate(Pointer address, usize size);
+    Pointer                           Allocate(usize bytes);
+    Pointer                           Callocate(usize bytes);
+    Pointer                           Reallocate(Pointer address, usize size);
 
-    void    Free(Pointer memory);
+    void                              Free(Pointer memory);
+
+    usize                             SizeClassCount();
+    SlabStatistics                    GetStatistics(usize sizeClass);
+    LargeObjectStatistics             GetLargeObjectStatistics();
 } // namespace KernelHeap
+
+void* operator new(usize size, KernelHeap::UninitializedTag);
+void* operator new[](usize size, KernelHeap::UninitializedTag);
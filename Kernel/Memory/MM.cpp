@@ -1,16 +1,22 @@
 /*
  * Created by v1tr10l7 on 10.07.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
 #include <API/Syscall.hpp>
+#include <Arch/User.hpp>
 
 #include <Memory/Allocator/KernelHeap.hpp>
 #include <Memory/MM.hpp>
 #include <Scheduler/Process.hpp>
+#include <VFS/INode.hpp>
 
+#include <Boot/CommandLine.hpp>
+
+#include <Prism/Containers/Vector.hpp>
 #include <Prism/String/Formatter.hpp>
+#include <Prism/String/StringUtils.hpp>
 
 #include <icxxabi>
 #include <limine.h>
@@ -35,6 +41,154 @@ namespace MM
         enum PagingMode s_PagingMode            = PagingMode::eNone;
         MemoryMap       s_MemoryMap;
         EfiMemoryMap    s_EfiMemoryMap;
+
+        // Neighbouring pages populated along with the faulting one, set by
+        // `mm.fault-around=<pages>`. Off by default, anonymous memory gains
+        // little
+        constexpr usize MAX_FAULT_AROUND_PAGES = 16;
+        usize           s_FaultAroundPages     = 1;
+
+        Pointer FilePage(Ref<Region> region, usize index, bool write)
+        {
+            usize fileIndex = region->FileOffset() / PMM::PAGE_SIZE + index;
+            return region->BackingINode()->CachedPage(fileIndex, write);
+        }
+        bool PopulatePage(Process* process, Ref<Region> region, usize index,
+                          bool write = false)
+        {
+            {
+                ScopedLock guard(region->Lock());
+                if (region->LookupPage(index)) return true;
+            }
+
+            // Reading the file page in might block, so the region is unlocked,
+            // private mappings never write to it, as they copy it first, while
+            // the shared ones have to see the file's own page
+            Pointer phys = region->IsFileBacked()
+                             ? FilePage(region, index, region->IsShared())
+                             : PMM::CallocatePages(1);
+            if (!phys) return false;
+
+            ScopedLock guard(region->Lock());
+            if (region->LookupPage(index))
+            {
+                PMM::ReleasePage(phys);
+                return true;
+            }
+
+            // File pages start out read only. Private mappings copy them on
+            // write, shared ones mark them dirty
+            auto flags = region->PageAttributes();
+            if (region->IsFileBacked())
+            {
+                if (write && region->IsShared()) region->MarkDirty(index, phys);
+                else flags &= ~PageAttributes::eWrite;
+            }
+
+            Pointer virt = region->VirtualBase().Offset(index * PMM::PAGE_SIZE);
+            if (!process->PageMap->Map(virt, phys, flags))
+            {
+                PMM::ReleasePage(phys);
+                return false;
+            }
+
+            region->InsertPage(index, phys);
+            return true;
+        }
+        bool HandleDemandPageFault(Process* process, Ref<Region> region,
+                                   const PageFaultInfo& info)
+        {
+            auto reason = info.Reason();
+            if (!region->IsDemandPaged()
+                || !(reason & PageFaultReason::eNotPresent))
+                return false;
+
+            if (reason & PageFaultReason::eWrite && !region->IsWriteable())
+                return false;
+            if (reason & PageFaultReason::eInstructionFetch
+                && !region->IsExecutable())
+                return false;
+
+            usize offset = info.VirtualAddress().Raw()
+                         - region->VirtualBase().Raw();
+            usize index  = offset / PMM::PAGE_SIZE;
+
+            if (!PopulatePage(process, region, index,
+                              reason & PageFaultReason::eWrite))
+                return false;
+            if (s_FaultAroundPages <= 1) return true;
+
+            usize first = index - index % s_FaultAroundPages;
+            usize last
+                = std::min(first + s_FaultAroundPages, region->PageCount());
+            for (usize i = first; i < last; i++)
+                if (!PopulatePage(process, region, i)) break;
+
+            return true;
+        }
+        bool HandleSharedWriteFault(Process* process, Ref<Region> region,
+                                    const PageFaultInfo& info)
+        {
+            auto reason = info.Reason();
+            if (!region->IsFileBacked() || !region->IsShared()
+                || reason & PageFaultReason::eNotPresent
+                || !(reason & PageFaultReason::eWrite)
+                || !region->IsWriteable())
+                return false;
+
+            Pointer virt  = Math::AlignDown(info.VirtualAddress().Raw(),
+                                            PMM::PAGE_SIZE);
+            usize   index = (virt.Raw() - region->VirtualBase().Raw())
+                        / PMM::PAGE_SIZE;
+
+            ScopedLock guard(region->Lock());
+            Pointer    page = region->LookupPage(index);
+            if (!page) return false;
+
+            region->MarkDirty(index, page);
+            return process->PageMap->SetFlags(virt, region->PageAttributes());
+        }
+        bool HandleCopyOnWriteFault(Process* process, Ref<Region> region,
+                                    const PageFaultInfo& info)
+        {
+            auto reason = info.Reason();
+            if (!region->IsDemandPaged() || reason & PageFaultReason::eNotPresent
+                || !(reason & PageFaultReason::eWrite)
+                || !region->IsWriteable() || region->IsShared())
+                return false;
+
+            Pointer virt  = Math::AlignDown(info.VirtualAddress().Raw(),
+                                            PMM::PAGE_SIZE);
+            usize   index = (virt.Raw() - region->VirtualBase().Raw())
+                        / PMM::PAGE_SIZE;
+
+            ScopedLock guard(region->Lock());
+            Pointer    page = region->LookupPage(index);
+            if (!page) return false;
+
+            // Nobody else shares the page anymore, so it can be made writable
+            // again
+            auto flags = region->PageAttributes();
+            if (PMM::PageReferenceCount(page) == 1)
+                return process->PageMap->SetFlags(virt, flags);
+
+            Pointer copy = PMM::AllocatePages(1);
+            if (!copy) return false;
+
+            Memory::Copy(copy.ToHigherHalf<void*>(), page.ToHigherHalf<void*>(),
+                         PMM::PAGE_SIZE);
+            process->PageMap->Unmap(virt);
+            if (!process->PageMap->Map(virt, copy, flags))
+            {
+                PMM::FreePages(copy.Raw(), 1);
+                return false;
+            }
+
+            region->RemovePage(index);
+            region->InsertPage(index, copy);
+            PMM::ReleasePage(page);
+            return true;
+        }
     }; // namespace
 
     void PrepareInitialHeap(const BootMemoryInfo& memoryInfo)
@@ -93,6 +247,14 @@ namespace MM
                         s_HigherHalfOffset);
 
         KernelHeap::MapEarlyHeap();
+
+        auto faultAround = CommandLine::GetString("mm.fault-around");
+        if (!faultAround.Empty())
+        {
+            usize pages = StringUtils::ToNumber<usize>(faultAround, 10);
+            s_FaultAroundPages
+                = std::max(std::min(pages, MAX_FAULT_AROUND_PAGES), 1zu);
+        }
     }
 
     Pointer         KernelPhysicalAddress() { return s_KernelPhysicalAddress; }
@@ -158,22 +320,14 @@ namespace MM
         auto  region       = addressSpace.AllocateRegion(bytes, 0);
         if (!region) return nullptr;
 
-        usize pageCount = Math::DivRoundUp(bytes, PMM::PAGE_SIZE);
-        auto  phys      = PMM::CallocatePages(pageCount);
-        if (!phys) return nullptr;
-
         using VMM::Access;
         Access access = Access::eUser;
         if (flags & PageAttributes::eRead) access |= Access::eRead;
         if (flags & PageAttributes::eWrite) access |= Access::eWrite;
         if (flags & PageAttributes::eExecutable) access |= Access::eExecute;
 
-        region->SetPhysicalBase(phys);
+        // Demand paged, allocated on first touch by HandlePageFault
         region->SetAccessMode(access);
-
-        auto pageMap = process->PageMap;
-        pageMap->MapRegion(region);
-
         return region;
     }
 
@@ -182,6 +336,146 @@ namespace MM
         // TODO(v1tr10l7): Free region
     }
 
+    ErrorOr<void> SyncRegion(PageMap* pageMap, Ref<Region> region,
+                             usize firstPage, usize pageCount)
+    {
+        if (!region->IsFileBacked() || !region->IsShared()) return {};
+
+        auto  inode = region->BackingINode();
+        auto  flags = region->PageAttributes();
+        usize last  = firstPage + Math::Min(pageCount, region->PageCount());
+        flags &= ~PageAttributes::eWrite;
+
+        // The pages are write protected, and marked clean before they're
+        // written back without the region lock, so that the writes racing with
+        // us mark them dirty again
+        Vector<std::pair<usize, Pointer>> dirty;
+        {
+            ScopedLock guard(region->Lock());
+            for (const auto& [index, page] : region->DirtyPages())
+            {
+                if (index < firstPage || index >= last) continue;
+
+                Pointer virt
+                    = region->VirtualBase().Offset(index * PMM::PAGE_SIZE);
+                if (pageMap) pageMap->SetFlags(virt, flags);
+
+                PMM::ReferencePage(page);
+                dirty.PushBack({index, page});
+            }
+
+            for (const auto& [index, page] : dirty)
+                region->DirtyPages().Erase(index);
+        }
+
+        ErrorOr<void> status = {};
+        for (const auto& [index, page] : dirty)
+        {
+            usize offset = region->FileOffset() + index * PMM::PAGE_SIZE;
+            usize size   = inode->Size();
+            if (status && offset < size)
+            {
+                usize bytes = Math::Min(PMM::PAGE_SIZE, size - offset);
+                if (inode->Write(page.ToHigherHalf<u8*>(), offset, bytes) < 0)
+                    status = Error(EIO);
+            }
+
+            // Pages, which didn't make it to the file stay dirty, unless they
+            // got unmapped in the meantime
+            if (!status)
+            {
+                ScopedLock guard(region->Lock());
+                if (region->LookupPage(index) == page)
+                    region->MarkDirty(index, page);
+            }
+            PMM::ReleasePage(page);
+        }
+
+        return status;
+    }
+
+    ErrorOr<void> PinPages(Pointer virt, usize bytes, bool write,
+                           Vector<Pointer>& pages)
+    {
+        bool     user    = Arch::InUserRange(virt, bytes);
+        auto     process = Process::Current();
+        PageMap* pageMap = user ? process->PageMap : VMM::GetKernelPageMap();
+        if (user && !pageMap) return Error(EFAULT);
+
+        Pointer first  = Math::AlignDown(virt.Raw(), PMM::PAGE_SIZE);
+        Pointer last   = Math::AlignUp(virt.Raw() + bytes, PMM::PAGE_SIZE);
+        usize   pinned = pages.Size();
+        auto    fail   = [&]() -> ErrorOr<void>
+        {
+            for (usize i = pinned; i < pages.Size(); ++i)
+                PMM::UnpinPage(pages[i]);
+
+            pages.Resize(pinned);
+            return Error(EFAULT);
+        };
+
+        for (Pointer page = first; page < last;
+             page         = page.Offset(PMM::PAGE_SIZE))
+        {
+            if (!user)
+            {
+                Pointer phys = pageMap->Virt2Phys(page);
+                if (phys.Raw() == u64(-1)) return fail();
+
+                PMM::PinPage(phys);
+                pages.PushBack(phys);
+                continue;
+            }
+
+            auto region = process->AddressSpace().Find(page);
+            if (!region
+                || !(write ? region->IsWriteable() : region->IsReadable()))
+                return fail();
+
+            usize   index = (page.Raw() - region->VirtualBase().Raw())
+                        / PMM::PAGE_SIZE;
+            Pointer phys  = nullptr;
+            while (!phys)
+            {
+                // Touch the page the way the device will, to fault it in, or
+                // break COW. The writes are atomic no-ops
+                {
+                    CPU::UserMemoryProtectionGuard guard;
+                    auto byte = Pointer(Math::Max(page.Raw(), virt.Raw()))
+                                    .As<volatile u8>();
+                    if (write) __atomic_fetch_add(byte, 0, __ATOMIC_RELAXED);
+                    else (void)*byte;
+                }
+
+                // The frame is pinned under the region lock, so that munmap,
+                // or a copy-on-write break can't swap it from under us, if
+                // either of them got in after the touch, we start over
+                ScopedLock guard(region->Lock());
+                phys = pageMap->Virt2Phys(page);
+                if (phys.Raw() == u64(-1) || !region->LookupPage(index))
+                    return fail();
+
+                usize owners
+                    = PMM::PageReferenceCount(phys) - PMM::PagePinCount(phys);
+                if (region->LookupPage(index) != phys
+                    || (write && !region->IsShared() && owners > 1))
+                {
+                    phys = nullptr;
+                    continue;
+                }
+
+                PMM::PinPage(phys);
+                pages.PushBack(phys);
+            }
+        }
+
+        return {};
+    }
+    void UnpinPages(const Vector<Pointer>& pages)
+    {
+        for (auto page : pages) PMM::UnpinPage(page);
+    }
+
     void HandlePageFault(const PageFaultInfo& info)
     {
         auto message = Format("Page Fault occurred at '{:#x}'\nCaused by:\n",
@@ -197,22 +491,11 @@ namespace MM
             region             = addressSpace.Find(info.VirtualAddress());
         }
 
-        if (region)
-        {
-            usize pageCount = Math::DivRoundUp(region->Size(), PMM::PAGE_SIZE);
-            auto  phys      = PMM::CallocatePages(pageCount);
-
-            if (phys)
-            {
-                region->SetPhysicalBase(phys);
-
-                auto pageMap = process->PageMap;
-                pageMap->MapRegion(region);
-                return;
-            }
-
-            errno = ENOMEM;
-        }
+        if (region
+            && (HandleDemandPageFault(process, region, info)
+                || HandleSharedWriteFault(process, region, info)
+                || HandleCopyOnWriteFault(process, region, info)))
+            return;
 
         if (reason & PageFaultReason::eNotPresent)
             message += "\t- Non-present page\n";
@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 10.07.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -12,6 +12,7 @@
 #include <Memory/PageTableEntry.hpp>
 #include <Memory/Region.hpp>
 
+#include <Prism/Containers/Vector.hpp>
 #include <Prism/Core/Types.hpp>
 
 enum class MemoryUsage
@@ -26,6 +27,7 @@ enum class MemoryUsage
 };
 
 struct MemoryMap;
+class PageMap;
 namespace MM
 {
     void            PrepareInitialHeap(const BootMemoryInfo& memoryInfo);
@@ -43,6 +45,24 @@ namespace MM
     Ref<Region>     AllocateUserRegion(const usize bytes, PageAttributes flags);
 
     void            FreeRegion(Ref<Region> region);
+    /**
+     * @brief Writes the pages of a shared file mapping, which were written to
+     * since the last sync, back to the file, and write protects them again,
+     * unless the `pageMap` is null, e.g. when the region is being torn down
+     */
+    ErrorOr<void>   SyncRegion(PageMap* pageMap, Ref<Region> region,
+                               usize firstPage = 0, usize pageCount = ~0zu);
+
+    /**
+     * @brief Faults in the pages backing the buffer, appends their physical
+     * addresses to `pages`, and pins each of them, so that they can't be
+     * freed, or shared copy-on-write, while a device accesses them directly
+     *
+     * @param write Whether the buffer is about to be written to
+     */
+    ErrorOr<void>   PinPages(Pointer virt, usize bytes, bool write,
+                             Vector<Pointer>& pages);
+    void            UnpinPages(const Vector<Pointer>& pages);
 
     void            HandlePageFault(const PageFaultInfo& info);
 }; // namespace MM
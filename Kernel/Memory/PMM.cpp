@@ -1,19 +1,24 @@
 /*
  * Created by v1tr10l7 on 17.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
 #include <Common.hpp>
 
+#include <Arch/CPU.hpp>
+#include <Boot/CommandLine.hpp>
 #include <Debug/Debug.hpp>
 #include <Library/Locking/Spinlock.hpp>
 
 #include <Memory/PMM.hpp>
 
 #include <Memory/Allocator/BitmapAllocator.hpp>
+#include <Memory/Allocator/BuddyAllocator.hpp>
 #include <Memory/Allocator/KernelHeap.hpp>
 
+#include <Prism/Containers/Array.hpp>
+#include <Prism/Containers/Vector.hpp>
 #include <Prism/String/StringUtils.hpp>
 #include <Prism/Utility/Math.hpp>
 
@@ -23,8 +28,89 @@ namespace PMM
     {
         bool            s_Initialized = false;
 
-        MemoryMap       s_MemoryMap{};
-        BitmapAllocator s_BitmapAllocator;
+        MemoryMap           s_MemoryMap{};
+        BitmapAllocator     s_BitmapAllocator;
+        BuddyAllocator      s_BuddyAllocator;
+        PageFrameAllocator* s_Allocator = &s_BitmapAllocator;
+
+        // Single pages come from a per-cpu stack, used with interrupts
+        // disabled. The allocator lock is only taken to refill or drain it
+        constexpr usize PAGE_CACHE_SIZE  = 64;
+        constexpr usize PAGE_CACHE_BATCH = 16;
+        struct PageCache
+        {
+            Array<Pointer, PAGE_CACHE_SIZE> Pages;
+            usize                           Count = 0;
+        };
+        Vector<PageCache*> s_PageCaches;
+
+        PageCache*         CurrentPageCache()
+        {
+            usize cpuID = CPU::GetCurrentID();
+            return cpuID < s_PageCaches.Size() ? s_PageCaches[cpuID] : nullptr;
+        }
+        Pointer AllocateCachedPage()
+        {
+            bool    intState = CPU::SwapInterruptFlag(false);
+            Pointer page     = nullptr;
+
+            auto    cache    = CurrentPageCache();
+            if (!cache)
+            {
+                CPU::SetInterruptFlag(intState);
+                return s_Allocator->AllocatePages(1);
+            }
+
+            if (cache->Count == 0)
+            {
+                for (usize i = 0; i < PAGE_CACHE_BATCH; i++)
+                {
+                    Pointer refill = s_Allocator->AllocatePages(1);
+                    if (!refill) break;
+
+                    cache->Pages[cache->Count++] = refill;
+                }
+            }
+
+            if (cache->Count > 0) page = cache->Pages[--cache->Count];
+            CPU::SetInterruptFlag(intState);
+            return page;
+        }
+        void FreeCachedPage(Pointer page)
+        {
+            bool intState = CPU::SwapInterruptFlag(false);
+            auto cache    = CurrentPageCache();
+            if (!cache)
+            {
+                CPU::SetInterruptFlag(intState);
+                return s_Allocator->FreePages(page, 1);
+            }
+
+            if (cache->Count == PAGE_CACHE_SIZE)
+            {
+                for (usize i = 0; i < PAGE_CACHE_BATCH; i++)
+                    s_Allocator->FreePages(cache->Pages[--cache->Count], 1);
+            }
+
+            cache->Pages[cache->Count++] = page;
+            CPU::SetInterruptFlag(intState);
+        }
+
+        // Additional references of each physical page, indexed by the page
+        // frame number, every pin adds PIN_BIAS on top of its reference
+        constexpr u32   PIN_BIAS             = 1 << 20;
+        Atomic<u32>*    s_PageReferences     = nullptr;
+        usize           s_PageReferenceCount = 0;
+        // Never freed, as it keeps an extra reference of its own
+        Pointer         s_ZeroPage           = nullptr;
+
+        Atomic<u32>&    PageReferences(Pointer page)
+        {
+            usize frame = page.Raw() / PAGE_SIZE;
+            Assert(frame < s_PageReferenceCount);
+
+            return s_PageReferences[frame];
+        }
 
         Pointer         EarlyAllocatePages(usize count = 1)
         {
@@ -72,26 +158,71 @@ namespace PMM
         }
 #endif
 
-        auto status = s_BitmapAllocator.Initialize(s_MemoryMap, PAGE_SIZE);
+        // The bitmap allocator is kept for comparison, `pmm.allocator=bitmap`
+        StringView allocatorName = "buddy"_sv;
+        if (CommandLine::GetString("pmm.allocator") == "bitmap"_sv)
+        {
+            s_Allocator   = &s_BitmapAllocator;
+            allocatorName = "bitmap"_sv;
+        }
+        else s_Allocator = &s_BuddyAllocator;
+
+        auto status = s_Allocator->Initialize(s_MemoryMap, PAGE_SIZE);
         if (!status)
         {
             LogError(
-                "PMM: Failed to initialize bitmap allocator, the error code: "
+                "PMM: Failed to initialize {} allocator, the error code: "
                 "{}",
-                ToString(status.Error()));
+                allocatorName, ToString(status.Error()));
+            return false;
+        }
+
+        s_PageReferenceCount = s_Allocator->MemoryTop() / PAGE_SIZE;
+        usize referencesSize = s_PageReferenceCount * sizeof(Atomic<u32>);
+        usize referencesPageCount
+            = Math::AlignUp(referencesSize, PAGE_SIZE) / PAGE_SIZE;
+
+        Pointer references = s_Allocator->AllocatePages(referencesPageCount);
+        if (!references)
+        {
+            LogError("PMM: Failed to allocate the page reference counters");
+            return false;
+        }
+
+        Memory::Fill(references.ToHigherHalf(), 0, referencesSize);
+        s_PageReferences = references.ToHigherHalf<Atomic<u32>*>();
+
+        s_ZeroPage = s_Allocator->AllocatePages(1);
+        if (!s_ZeroPage)
+        {
+            LogError("PMM: Failed to allocate the zero page");
             return false;
         }
+
+        Memory::Fill(s_ZeroPage.ToHigherHalf(), 0, PAGE_SIZE);
+        ReferencePage(s_ZeroPage);
         EarlyLogInfo("PMM: Initialized");
 
         EarlyLogInfo(
             "PMM: Memory Map entry count: %zu, Total Memory: %zuMiB, Free "
             "Memory%zuMiB ",
-            entryCount, s_BitmapAllocator.TotalMemorySize() / 1024 / 1024,
+            entryCount, s_Allocator->TotalMemorySize() / 1024 / 1024,
             GetFreeMemory() / 1024 / 1024);
+        LogInfo("PMM: Using the {} allocator", allocatorName);
 
         return (s_Initialized = true);
     }
-    bool             IsInitialized() { return s_Initialized; }
+    bool IsInitialized() { return s_Initialized; }
+    void InitializePageCaches(usize cpuCount)
+    {
+        if (!s_PageCaches.Empty()) return;
+
+        s_PageCaches.Resize(cpuCount);
+        for (usize cpuID = 0; cpuID < cpuCount; cpuID++)
+            s_PageCaches[cpuID] = new PageCache;
+
+        LogInfo("PMM: Initialized page caches for {} cpus", cpuCount);
+    }
 
     Span<MemoryZone> MemoryZones()
     {
@@ -101,7 +232,9 @@ namespace PMM
     void* AllocatePages(usize count)
     {
         if (!s_Initialized) return EarlyAllocatePages(count);
-        return s_BitmapAllocator.AllocatePages(count);
+        if (count == 1) return AllocateCachedPage();
+
+        return s_Allocator->AllocatePages(count);
     }
     void* CallocatePages(usize count)
     {
@@ -114,11 +247,83 @@ namespace PMM
 
     void FreePages(void* ptr, usize count)
     {
-        return s_BitmapAllocator.FreePages(ptr, count);
+        if (count == 1 && ptr) return FreeCachedPage(ptr);
+        return s_Allocator->FreePages(ptr, count);
+    }
+
+    Pointer ZeroPage() { return s_ZeroPage; }
+
+    bool    IsManaged(Pointer page, usize count)
+    {
+        Pointer end = page.Offset(count * PAGE_SIZE);
+        if (end.Raw() / PAGE_SIZE > s_PageReferenceCount) return false;
+
+        for (const auto& zone : MemoryZones())
+        {
+            if (page < zone.Base() || end > zone.Base().Offset(zone.Length()))
+                continue;
+
+            auto type = zone.Type();
+            return type == MemoryZoneType::eUsable
+                || type == MemoryZoneType::eBootloaderReclaimable
+                || type == MemoryZoneType::eKernelAndModules;
+        }
+
+        return false;
+    }
+
+    void ReferencePage(Pointer page) { ++PageReferences(page); }
+    usize PageReferenceCount(Pointer page)
+    {
+        return PageReferences(page).Load() % PIN_BIAS + 1;
+    }
+    void PinPage(Pointer page)
+    {
+        auto& references = PageReferences(page);
+        u32   count      = references.Load();
+
+        while (!references.CompareExchange(count, count + PIN_BIAS + 1, false,
+                                           MemoryOrder::eAtomicAcquire,
+                                           MemoryOrder::eAtomicRelaxed))
+            ;
+    }
+    usize PagePinCount(Pointer page)
+    {
+        return PageReferences(page).Load() / PIN_BIAS;
+    }
+    void UnpinPage(Pointer page)
+    {
+        auto& references = PageReferences(page);
+        u32   count      = references.Load();
+        Assert(count >= PIN_BIAS);
+
+        while (!references.CompareExchange(count, count - PIN_BIAS, false,
+                                           MemoryOrder::eAtomicAcquire,
+                                           MemoryOrder::eAtomicRelaxed))
+            ;
+        ReleasePage(page);
+    }
+    void ReleasePage(Pointer page)
+    {
+        auto& references = PageReferences(page);
+        u32   count      = references.Load();
+
+        while (count > 0)
+            if (references.CompareExchange(count, count - 1, false,
+                                           MemoryOrder::eAtomicAcquire,
+                                           MemoryOrder::eAtomicRelaxed))
+                return;
+
+        FreePages(page.Raw(), 1);
+    }
+
+    BuddyAllocator* GetBuddyAllocator()
+    {
+        return s_Allocator == &s_BuddyAllocator ? &s_BuddyAllocator : nullptr;
     }
 
-    uintptr_t GetMemoryTop() { return s_BitmapAllocator.MemoryTop(); }
-    u64       GetTotalMemory() { return s_BitmapAllocator.TotalMemorySize(); }
+    uintptr_t GetMemoryTop() { return s_Allocator->MemoryTop(); }
+    u64       GetTotalMemory() { return s_Allocator->TotalMemorySize(); }
     u64       GetFreeMemory() { return GetTotalMemory() - GetUsedMemory(); }
-    u64       GetUsedMemory() { return s_BitmapAllocator.UsedMemorySize(); }
+    u64       GetUsedMemory() { return s_Allocator->UsedMemorySize(); }
 } // namespace PMM
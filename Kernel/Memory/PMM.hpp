@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 17.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -11,13 +11,20 @@
 
 #include <Prism/Containers/Span.hpp>
 #include <Prism/Memory/Pointer.hpp>
+#include <Prism/Utility/Atomic.hpp>
 
+class BuddyAllocator;
 namespace PMM
 {
     constexpr usize     PAGE_SIZE = 0x1000;
 
     CTOS_NO_KASAN bool  Initialize(const MemoryMap& memoryMap);
     bool                IsInitialized();
+    /**
+     * @brief Sets up the per-cpu caches of single pages, which front the page
+     * frame allocator, allocations go straight to the allocator until then
+     */
+    void                InitializePageCaches(usize cpuCount);
 
     Span<MemoryZone>  MemoryZones();
 
@@ -49,6 +56,38 @@ namespace PMM
         else FreePages(reinterpret_cast<void*>(ptr), count);
     }
 
+    /**
+     * @brief Page filled with zeroes, which may be mapped read only, wherever
+     * nothing has been written yet, it's referenced, and released as usual
+     */
+    Pointer   ZeroPage();
+
+    /**
+     * @brief Whether the pages are RAM handed out by the PMM, only those may be
+     * referenced, or freed, device memory, like the framebuffer, is not
+     */
+    bool      IsManaged(Pointer page, usize count = 1);
+    // Pages start out with a single owner, each extra owner, e.g. COW after
+    // fork, takes a reference
+    void      ReferencePage(Pointer page);
+    usize     PageReferenceCount(Pointer page);
+    /**
+     * @brief Drops a reference to the page, and frees it, once the last owner
+     * is gone
+     */
+    void      ReleasePage(Pointer page);
+    /**
+     * @brief Pins take a reference, which additionally marks the page as being
+     * accessed by a device, so that fork doesn't share it copy-on-write
+     */
+    void      PinPage(Pointer page);
+    usize     PagePinCount(Pointer page);
+    void      UnpinPage(Pointer page);
+
+    // The active buddy allocator, or nullptr, if `pmm.allocator=bitmap` was
+    // requested
+    BuddyAllocator* GetBuddyAllocator();
+
     uintptr_t GetMemoryTop();
     usize     GetTotalMemory();
     usize     GetFreeMemory();
@@ -26,12 +26,13 @@ inline constexpr bool operator&(const PageFaultReason lhs,
 {
     return ToUnderlying(lhs) & ToUnderlying(rhs);
 }
-inline constexpr PageFaultReason operator|=(PageFaultReason&      lhs,
-                                            const PageFaultReason rhs)
+inline constexpr PageFaultReason& operator|=(PageFaultReason&      lhs,
+                                             const PageFaultReason rhs)
 {
     auto result = ToUnderlying(lhs) | ToUnderlying(rhs);
+    lhs         = static_cast<PageFaultReason>(result);
 
-    return static_cast<PageFaultReason>(result);
+    return lhs;
 }
 
 class PageFaultInfo
@@ -1,12 +1,14 @@
 /*
  * Created by v1tr10l7 on 10.07.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
+#include <Memory/AddressSpace.hpp>
 #include <Memory/PageMap.hpp>
 #include <Memory/VMM.hpp>
 
+#include <Prism/Memory/Memory.hpp>
 #include <Prism/Utility/Math.hpp>
 
 namespace Arch::VMM
@@ -14,6 +16,16 @@ namespace Arch::VMM
     extern usize GetPageSize(PageAttributes flags);
 };
 
+namespace
+{
+    // Pages shared copy-on-write are never mapped writable
+    PageAttributes ResidentPageFlags(PageAttributes flags, Pointer page)
+    {
+        if (PMM::PageReferenceCount(page) > 1) flags &= ~PageAttributes::eWrite;
+        return flags;
+    }
+}; // namespace
+
 PageMap::PageMap(Pointer topLevel)
     : m_TopLevel(topLevel.As<PageTable>())
 {
@@ -137,7 +149,15 @@ bool PageMap::MapRegion(const Ref<Region> region, const usize pageSize)
 
     const PageAttributes flags
         = region->PageAttributes() | PageSizeFlags(pageSize);
-    return MapRange(virt, phys, size, flags);
+    if (!region->IsDemandPaged()) return MapRange(virt, phys, size, flags);
+
+    // Untouched pages of demand paged regions are left to the fault handler
+    for (const auto& [index, page] : region->ResidentPages())
+        if (!Map(virt.Offset(index * PMM::PAGE_SIZE), page,
+                 ResidentPageFlags(flags, page)))
+            return false;
+
+    return true;
 }
 bool PageMap::RemapRegion(const Ref<Region> region, Pointer newVirt)
 {
@@ -146,7 +166,137 @@ bool PageMap::RemapRegion(const Ref<Region> region, Pointer newVirt)
     const PageAttributes flags   = region->PageAttributes();
 
     if (!newVirt) newVirt = region->VirtualBase();
-    return RemapRange(oldVirt, newVirt, size, flags);
+    if (!region->IsDemandPaged())
+        return RemapRange(oldVirt, newVirt, size, flags);
+
+    for (const auto& [index, page] : region->ResidentPages())
+    {
+        usize offset = index * PMM::PAGE_SIZE;
+        if (!Remap(oldVirt.Offset(offset), newVirt.Offset(offset),
+                   ResidentPageFlags(flags, page)))
+            return false;
+    }
+
+    return true;
+}
+bool PageMap::UnmapRegion(const Ref<Region> region)
+{
+    const auto virt = region->VirtualBase();
+    if (!region->IsDemandPaged()) return UnmapRange(virt, region->Size());
+
+    for (const auto& [index, page] : region->ResidentPages())
+        if (!Unmap(virt.Offset(index * PMM::PAGE_SIZE))) return false;
+
+    return true;
+}
+
+PageMap* PageMap::Fork(AddressSpace& addressSpace,
+                       AddressSpace& childAddressSpace)
+{
+    auto child = new PageMap();
+    if (!child) return nullptr;
+
+    auto shareRegion = [&](Pointer base, Ref<Region> region) -> bool
+    {
+        // Device memory isn't reference counted, both processes map it as is
+        bool device
+            = !region->IsDemandPaged()
+           && !PMM::IsManaged(region->PhysicalBase(), region->PageCount());
+        Pointer     phys = device ? region->PhysicalBase() : Pointer(nullptr);
+        Ref<Region> copy = new Region(phys, region->VirtualBase(),
+                                      region->Size(), region->FileDescriptor());
+        copy->SetAccessMode(region->Access());
+        if (region->IsFileBacked())
+            copy->SetBacking(region->BackingINode(), region->FileOffset(),
+                             region->IsShared());
+        else copy->SetShared(region->IsShared());
+        childAddressSpace.Insert(base, copy);
+        if (device) return child->MapRegion(copy);
+
+        ScopedLock     guard(region->Lock());
+        PageAttributes flags = region->PageAttributes();
+        region->TrackPages();
+
+        // Shared anonymous pages have nowhere else to be found later, so the
+        // missing ones are faulted in now, and both processes map them all
+        // writable
+        bool sharedAnonymous = region->IsShared() && !region->IsFileBacked();
+        for (usize i = 0; sharedAnonymous && i < region->PageCount(); i++)
+        {
+            if (region->LookupPage(i)) continue;
+
+            Pointer page = PMM::CallocatePages(1);
+            if (!page) return false;
+            if (!Map(base.Offset(i * PMM::PAGE_SIZE), page, flags))
+            {
+                PMM::ReleasePage(page);
+                return false;
+            }
+
+            region->InsertPage(i, page);
+        }
+
+        // Nothing is copied, the pages are shared until one side writes to them
+        if (!sharedAnonymous) flags &= ~PageAttributes::eWrite;
+        for (const auto& [index, page] : region->ResidentPages())
+        {
+            Pointer virt = base.Offset(index * PMM::PAGE_SIZE);
+
+            // A device might be writing to a pinned page, so it stays with the
+            // parent, and the child gets a copy right away
+            if (!region->IsShared() && PMM::PagePinCount(page) > 0)
+            {
+                Pointer copied = PMM::AllocatePages(1);
+                if (!copied) return false;
+
+                Memory::Copy(copied.ToHigherHalf<void*>(),
+                             page.ToHigherHalf<void*>(), PMM::PAGE_SIZE);
+                copy->InsertPage(index, copied);
+                if (!child->Map(virt, copied, region->PageAttributes()))
+                    return false;
+                continue;
+            }
+
+            PMM::ReferencePage(page);
+            copy->InsertPage(index, page);
+
+            if ((!sharedAnonymous && !SetFlags(virt, flags))
+                || !child->Map(virt, page, flags))
+                return false;
+        }
+
+        return true;
+    };
+
+    for (const auto& [base, region] : addressSpace)
+    {
+        if (shareRegion(base, region)) continue;
+
+        for (const auto& [childBase, childRegion] : childAddressSpace)
+            childRegion->FreePhysicalMemory();
+
+        childAddressSpace.Clear();
+        delete child;
+
+        // With the child's references gone, the pages nobody else shares are
+        // made writable again
+        for (const auto& [parentBase, parentRegion] : addressSpace)
+        {
+            if (!parentRegion->IsDemandPaged()
+                || (parentRegion->IsShared() && !parentRegion->IsFileBacked()))
+                continue;
+
+            ScopedLock     guard(parentRegion->Lock());
+            PageAttributes flags = parentRegion->PageAttributes();
+            for (const auto& [index, page] : parentRegion->ResidentPages())
+                SetFlags(parentBase.Offset(index * PMM::PAGE_SIZE),
+                         ResidentPageFlags(flags, page));
+        }
+
+        return nullptr;
+    }
+
+    return child;
 }
 
 bool PageMap::SetFlagsRange(Pointer virt, usize size, PageAttributes flags)
@@ -14,6 +14,7 @@
 
 #include <Prism/Core/Error.hpp>
 
+class AddressSpace;
 class PageMap;
 namespace VMM
 {
@@ -85,6 +86,16 @@ class PageMap
     bool        MapRegion(const Ref<Region> region,
                           const usize       pageSize = PMM::PAGE_SIZE);
     bool        RemapRegion(const Ref<Region> region, Pointer newVirt = 0);
+    bool        UnmapRegion(const Ref<Region> region);
+
+    /**
+     * @brief Creates the page map of a child process, every page in
+     * `addressSpace` is shared with the child copy-on-write, both mappings
+     * are write protected, until either side writes to the page, the shared
+     * regions are inserted into `childAddressSpace`
+     */
+    PageMap*    Fork(AddressSpace& addressSpace,
+                     AddressSpace& childAddressSpace);
 
     bool        SetFlagsRange(Pointer virt, usize size,
                               PageAttributes flags
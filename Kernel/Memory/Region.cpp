@@ -1,14 +1,22 @@
 /*
  * Created by v1tr10l7 on 17.04.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
+#include <Memory/PMM.hpp>
 #include <Memory/Region.hpp>
 #include <Memory/VMM.hpp>
 
+#include <VFS/INode.hpp>
+
 namespace VMM
 {
+    Region::~Region()
+    {
+        if (m_BackingINode) m_BackingINode->Release();
+    }
+
     enum PageAttributes Region::PageAttributes() const
     {
         enum PageAttributes flags = PageAttributes::eWriteBack;
@@ -21,4 +29,81 @@ namespace VMM
         return flags | PageAttributes::eRead | PageAttributes::eWrite
              | PageAttributes::eExecutable;
     }
+
+    usize Region::ResidentPageCount() const
+    {
+        return m_DemandPaged ? m_ResidentPageCount : PageCount();
+    }
+
+    Pointer Region::LookupPage(usize index) const
+    {
+        if (!m_DemandPaged) return m_PhysicalBase.Offset(index * PMM::PAGE_SIZE);
+
+        auto it = m_ResidentPages.Find(index);
+        return it != m_ResidentPages.end() ? it->Value : nullptr;
+    }
+    void Region::InsertPage(usize index, Pointer phys)
+    {
+        Assert(m_DemandPaged && index < PageCount());
+        Assert(!LookupPage(index));
+
+        m_ResidentPages.Insert(index, phys);
+        ++m_ResidentPageCount;
+    }
+    Pointer Region::RemovePage(usize index)
+    {
+        Pointer phys = LookupPage(index);
+        if (!m_DemandPaged || !phys) return nullptr;
+
+        m_ResidentPages.Erase(index);
+        --m_ResidentPageCount;
+        return phys;
+    }
+
+    void Region::TrackPages()
+    {
+        if (m_DemandPaged) return;
+
+        for (usize i = 0; i < PageCount(); i++)
+            m_ResidentPages.Insert(i, m_PhysicalBase.Offset(i * PMM::PAGE_SIZE));
+
+        m_ResidentPageCount = PageCount();
+        m_PhysicalBase      = nullptr;
+        m_DemandPaged       = true;
+    }
+
+    void Region::SetBacking(INode* inode, usize offset, bool shared)
+    {
+        Assert(m_DemandPaged && !m_ResidentPageCount);
+
+        if (inode) inode->Retain();
+        if (m_BackingINode) m_BackingINode->Release();
+
+        m_BackingINode = inode;
+        m_FileOffset   = offset;
+        m_Shared       = shared;
+    }
+    void Region::MarkDirty(usize index, Pointer phys)
+    {
+        if (m_DirtyPages.Find(index) == m_DirtyPages.end())
+            m_DirtyPages.Insert(index, phys);
+    }
+
+    void Region::FreePhysicalMemory()
+    {
+        ScopedLock guard(m_Lock);
+        if (!m_DemandPaged)
+        {
+            if (PMM::IsManaged(m_PhysicalBase, PageCount()))
+                PMM::FreePages(m_PhysicalBase.Raw(), PageCount());
+            m_PhysicalBase = nullptr;
+            m_DemandPaged  = true;
+            return;
+        }
+
+        for (const auto& entry : m_ResidentPages) PMM::ReleasePage(entry.Value);
+        m_ResidentPages.Clear();
+        m_DirtyPages.Clear();
+        m_ResidentPageCount = 0;
+    }
 }; // namespace VMM
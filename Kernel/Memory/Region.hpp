@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 18.12.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -9,10 +9,15 @@
 #include <Common.hpp>
 
 #include <API/Posix/sys/mman.h>
+#include <Library/Locking/Spinlock.hpp>
 #include <Memory/AddressRange.hpp>
+#include <Memory/PMM.hpp>
+
+#include <Prism/Containers/RedBlackTree.hpp>
 #include <Prism/Memory/Ref.hpp>
 
 class FileDescriptor;
+class INode;
 enum class PageAttributes : isize;
 
 namespace VMM
@@ -56,9 +61,10 @@ namespace VMM
             : m_VirtualRange(virt, size)
             , m_PhysicalBase(phys)
             , m_Fd(fd)
-
+            , m_DemandPaged(!phys)
         {
         }
+        ~Region();
 
         inline bool Contains(const Pointer address) const
         {
@@ -82,7 +88,11 @@ namespace VMM
         inline enum Access           Access() const { return m_Access; }
         enum PageAttributes          PageAttributes() const;
 
-        inline void    SetPhysicalBase(Pointer phys) { m_PhysicalBase = phys; }
+        inline void SetPhysicalBase(Pointer phys)
+        {
+            m_PhysicalBase = phys;
+            m_DemandPaged  = !phys;
+        }
         inline void    SetAccessMode(enum Access access) { m_Access = access; }
 
         constexpr bool IsReadable() const { return m_Access & Access::eRead; }
@@ -92,11 +102,74 @@ namespace VMM
             return m_Access & Access::eExecute;
         }
 
+        // Pages of demand paged regions, indexed by their page offset in the
+        // region
+        inline bool  IsDemandPaged() const { return m_DemandPaged; }
+        inline usize PageCount() const { return Size() / PMM::PAGE_SIZE; }
+        usize        ResidentPageCount() const;
+
+        Pointer      LookupPage(usize index) const;
+        void         InsertPage(usize index, Pointer phys);
+        Pointer      RemovePage(usize index);
+
+        inline RedBlackTree<usize, Pointer>& ResidentPages()
+        {
+            return m_ResidentPages;
+        }
+        /**
+         * @brief Converts a physically contiguous region into one, which
+         * tracks its pages individually, so that they can be shared with, or
+         * replaced independently of the rest
+         */
+        void TrackPages();
+
+        /**
+         * @brief Backs the region with the contents of `inode`, starting at
+         * `offset`, the pages are then faulted in from its page cache.
+         * Shared regions map the cached pages themselves, and write back to
+         * the file, private ones copy them on the first write, the region
+         * keeps `inode` alive until it's destroyed
+         */
+        void          SetBacking(INode* inode, usize offset, bool shared);
+        inline INode* BackingINode() const { return m_BackingINode; }
+        inline usize  FileOffset() const { return m_FileOffset; }
+        inline bool   IsFileBacked() const { return m_BackingINode; }
+        inline bool   IsShared() const { return m_Shared; }
+        // Shared anonymous regions keep their pages shared across fork
+        inline void   SetShared(bool shared) { m_Shared = shared; }
+
+        // Shared file pages are mapped read only until written, to track which
+        // are dirty
+        void          MarkDirty(usize index, Pointer phys);
+        inline RedBlackTree<usize, Pointer>& DirtyPages()
+        {
+            return m_DirtyPages;
+        }
+
+        /**
+         * @brief Drops the region's reference to every physical page backing
+         * it, pages which aren't shared with anyone else are returned to the
+         * PMM
+         */
+        void             FreePhysicalMemory();
+
+        inline Spinlock& Lock() { return m_Lock; }
+
       private:
-        AddressRange          m_VirtualRange;
-        Pointer               m_PhysicalBase = nullptr;
-        enum Access           m_Access       = Access::eNone;
-        class FileDescriptor* m_Fd           = nullptr;
+        Spinlock                     m_Lock;
+        AddressRange                 m_VirtualRange;
+        Pointer                      m_PhysicalBase = nullptr;
+        enum Access                  m_Access       = Access::eNone;
+        class FileDescriptor*        m_Fd           = nullptr;
+
+        bool                         m_DemandPaged  = false;
+        RedBlackTree<usize, Pointer> m_ResidentPages;
+        usize                        m_ResidentPageCount = 0;
+
+        INode*                       m_BackingINode      = nullptr;
+        usize                        m_FileOffset        = 0;
+        bool                         m_Shared            = false;
+        RedBlackTree<usize, Pointer> m_DirtyPages;
     };
 }; // namespace VMM
 using VMM::Region;
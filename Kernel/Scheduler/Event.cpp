@@ -23,38 +23,13 @@ static Optional<usize> CheckPending(Span<Event*> events)
     return NullOpt;
 }
 
-static void AttachListeners(Span<Event*> events, Thread* thread)
-{
-    thread->Events().Clear();
-
-    for (usize i = 0; const auto& event : events)
-    {
-        event->Listeners.EmplaceBack(thread, i);
-        thread->Events().PushBack(event);
-        i++;
-    }
-}
-static void DetachListeners(Thread* thread)
-{
-    for (const auto& event : thread->Events())
-    {
-        for (auto it = event->Listeners.begin(); it < event->Listeners.end();
-             it++)
-        {
-            if (it->Thread != thread) continue;
-            it = event->Listeners.Erase(it);
-        }
-    }
-    thread->Events().Clear();
-}
-
 static void LockEvents(Span<Event*> events)
 {
-    for (auto& event : events) event->Lock.Acquire();
+    for (auto& event : events) event->Queue.Lock.Acquire();
 }
 static void UnlockEvents(Span<Event*> events)
 {
-    for (auto& event : events) event->Lock.Release();
+    for (auto& event : events) event->Queue.Lock.Release();
 }
 
 Optional<usize> Event::Await(Span<Event*> events, bool block)
@@ -63,55 +38,54 @@ Optional<usize> Event::Await(Span<Event*> events, bool block)
     bool intState = CPU::SwapInterruptFlag(false);
     LockEvents(events);
 
-    auto i = CheckPending(events);
-    if (i.HasValue())
+    auto pending = CheckPending(events);
+    if (pending.HasValue() || !block)
     {
         UnlockEvents(events);
         CPU::SetInterruptFlag(intState);
-        return i;
+        return pending;
     }
 
-    if (!block)
+    // Only waitpid on many children needs more entries than the thread embeds
+    usize           count   = events.Size();
+    WaitQueueEntry* entries = count <= MAX_WAIT_ENTRIES
+                                ? &thread->WaitEntry(0)
+                                : new WaitQueueEntry[count];
+
+    thread->SetState(ThreadState::eBlocked);
+    for (usize i = 0; i < count; i++)
     {
-        UnlockEvents(events);
-        CPU::SetInterruptFlag(intState);
-        return NullOpt;
-    }
+        auto& entry     = entries[i];
+        entry.Thread    = thread;
+        entry.Which     = i;
+        entry.Exclusive = false;
 
-    AttachListeners(events, thread);
+        events[i]->Queue.Enqueue(entry);
+    }
     UnlockEvents(events);
-    CPU::SetInterruptFlag(true);
 
-    Scheduler::Block(thread);
+    if (thread->State() == ThreadState::eBlocked) Scheduler::Yield(true);
 
+    // The waking event's entry is already unlinked, the rest go in O(1) each
     CPU::SetInterruptFlag(false);
     LockEvents(events);
-
-    DetachListeners(thread);
+    for (usize i = 0; i < count; i++) events[i]->Queue.Dequeue(entries[i]);
     UnlockEvents(events);
 
     CPU::SetInterruptFlag(intState);
+    if (count > MAX_WAIT_ENTRIES) delete[] entries;
+
     return thread->Which();
 }
 
 void Event::Trigger(Event* event, bool drop)
 {
     bool intState = CPU::SwapInterruptFlag(false);
-
-    if (event->Listeners.Empty())
-    {
-        if (!drop) ++event->Pending;
-        return;
-    }
-
-    ScopedLock guard(event->Lock);
-    for (const auto& listener : event->Listeners)
     {
-        auto thread = listener.Thread;
-        thread->SetWhich(listener.Which);
-        Scheduler::Unblock(thread);
+        ScopedLock guard(event->Queue.Lock);
+        if (event->Queue.HasWaiters()) event->Queue.WakeLocked(usize(-1));
+        else if (!drop) ++event->Pending;
     }
 
-    event->Listeners.Clear();
     CPU::SetInterruptFlag(intState);
 }
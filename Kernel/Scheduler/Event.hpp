@@ -6,21 +6,14 @@
  */
 #pragma once
 
-#include <Library/Locking/Spinlock.hpp>
+#include <Scheduler/WaitQueue.hpp>
 
 #include <Prism/Containers/Array.hpp>
-#include <Prism/Containers/Deque.hpp>
 #include <Prism/Containers/Span.hpp>
 
 #include <Prism/Core/Types.hpp>
 #include <Prism/Utility/Optional.hpp>
 
-constexpr usize MAX_LISTENERS = 32;
-struct EventListener
-{
-    struct Thread* Thread;
-    usize          Which;
-};
 struct Event
 {
   public:
@@ -34,7 +27,6 @@ struct Event
     static Optional<usize> Await(Span<Event*> events, bool block = true);
     static void            Trigger(Event* event, bool drop = false);
 
-    Spinlock               Lock;
-    usize                  Pending;
-    Deque<EventListener>   Listeners;
+    usize                  Pending = 0;
+    WaitQueue              Queue;
 };
@@ -0,0 +1,148 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#include <Scheduler/FairSchedulingClass.hpp>
+#include <Scheduler/Thread.hpp>
+
+namespace
+{
+    // Each nice level is worth ~10% cpu time relative to its neighbours, as in
+    // Linux
+    constexpr u64 s_NiceToWeight[MAX_NICE - MIN_NICE + 1] = {
+        88761, 71755, 56483, 46273, 36291, // -20
+        29154, 23254, 18705, 14949, 11916, // -15
+        9548,  7620,  6100,  4904,  3906,  // -10
+        3121,  2501,  1991,  1586,  1277,  // -5
+        1024,  820,   655,   526,   423,   // 0
+        335,   272,   215,   172,   137,   // 5
+        110,   87,    70,    56,    45,    // 10
+        36,    29,    23,    18,    15,    // 15
+    };
+} // namespace
+
+u64 FairSchedulingClass::NiceToWeight(i32 nice)
+{
+    if (nice < MIN_NICE) nice = MIN_NICE;
+    else if (nice > MAX_NICE) nice = MAX_NICE;
+
+    return s_NiceToWeight[nice - MIN_NICE];
+}
+
+void FairSchedulingClass::Enqueue(Thread* thread, EnqueueFlags flags)
+{
+    auto& entity = thread->Scheduling();
+
+    if (flags & EnqueueFlags::eNew) entity.VirtualRuntime = m_MinVirtualRuntime;
+    else if (flags & EnqueueFlags::eMigrated)
+        entity.VirtualRuntime += m_MinVirtualRuntime;
+    else if (flags & EnqueueFlags::eWakeup)
+    {
+        // Sleepers get some credit to run soon after waking, bounded so they
+        // can't monopolize the cpu
+        u64 credit  = TARGET_LATENCY_NS / 2;
+        u64 floor   = m_MinVirtualRuntime > credit
+                        ? m_MinVirtualRuntime - credit
+                        : 0;
+        u64 ceiling = m_MinVirtualRuntime + TARGET_LATENCY_NS;
+
+        if (entity.VirtualRuntime < floor) entity.VirtualRuntime = floor;
+        else if (entity.VirtualRuntime > ceiling)
+            entity.VirtualRuntime = ceiling;
+    }
+
+    m_Timeline.Insert(KeyOf(thread), thread);
+    ++m_Size;
+    m_TotalWeight += entity.Weight;
+}
+void    FairSchedulingClass::Dequeue(Thread* thread) { Remove(thread); }
+
+Thread* FairSchedulingClass::PickNext()
+{
+    if (m_Timeline.IsEmpty()) return nullptr;
+
+    Thread* thread = m_Timeline.begin()->Value;
+    Remove(thread);
+    UpdateMinVirtualRuntime(thread->Scheduling().VirtualRuntime);
+
+    return thread;
+}
+Thread* FairSchedulingClass::Steal()
+{
+    if (m_Timeline.IsEmpty()) return nullptr;
+
+    // The leftmost thread is about to run on its own cpu
+    auto it = m_Timeline.begin();
+    if (m_Size > 1) ++it;
+
+    Thread* thread = it->Value;
+    Remove(thread);
+
+    // Make the virtual runtime relative, the destination rebases it
+    auto& entity          = thread->Scheduling();
+    entity.VirtualRuntime = entity.VirtualRuntime > m_MinVirtualRuntime
+                              ? entity.VirtualRuntime - m_MinVirtualRuntime
+                              : 0;
+    return thread;
+}
+
+Timestep FairSchedulingClass::TimeSlice(Thread* thread) const
+{
+    auto& entity      = thread->Scheduling();
+    u64   totalWeight = m_TotalWeight + entity.Weight;
+    usize runnable    = m_Size + 1;
+
+    u64   period      = TARGET_LATENCY_NS;
+    if (runnable * MIN_GRANULARITY_NS > period)
+        period = runnable * MIN_GRANULARITY_NS;
+
+    u64 slice = period * entity.Weight / totalWeight;
+    if (slice < MIN_GRANULARITY_NS) slice = MIN_GRANULARITY_NS;
+
+    return Timestep(slice);
+}
+void FairSchedulingClass::Account(Thread* thread, u64 deltaNs)
+{
+    auto& entity = thread->Scheduling();
+
+    entity.TotalRuntime += deltaNs;
+    entity.VirtualRuntime += deltaNs * NICE_0_WEIGHT / entity.Weight;
+    UpdateMinVirtualRuntime(entity.VirtualRuntime);
+}
+bool FairSchedulingClass::ShouldPreempt(const SchedulingEntity& current,
+                                        Thread*                 woken) const
+{
+    if (IsRealTimePolicy(current.Policy)) return false;
+
+    return woken->Scheduling().VirtualRuntime + WAKEUP_GRANULARITY_NS
+         < current.VirtualRuntime;
+}
+
+FairSchedulingClass::Key FairSchedulingClass::KeyOf(Thread* thread)
+{
+    return {thread->Scheduling().VirtualRuntime,
+            reinterpret_cast<upointer>(thread)};
+}
+void FairSchedulingClass::UpdateMinVirtualRuntime(u64 current)
+{
+    u64 candidate = current;
+    if (!m_Timeline.IsEmpty())
+    {
+        u64 leftmost = m_Timeline.begin()->Key.VirtualRuntime;
+        if (leftmost < candidate) candidate = leftmost;
+    }
+
+    // The minimum virtual runtime never goes backwards
+    if (candidate > m_MinVirtualRuntime) m_MinVirtualRuntime = candidate;
+}
+void FairSchedulingClass::Remove(Thread* thread)
+{
+    auto it = m_Timeline.Find(KeyOf(thread));
+    if (it == m_Timeline.end()) return;
+
+    m_Timeline.Erase(it->Key);
+    --m_Size;
+    m_TotalWeight -= thread->Scheduling().Weight;
+}
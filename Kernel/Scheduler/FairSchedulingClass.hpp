@@ -0,0 +1,55 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#pragma once
+
+#include <Prism/Containers/RedBlackTree.hpp>
+#include <Scheduler/SchedulingClass.hpp>
+
+class FairSchedulingClass final : public SchedulingClass
+{
+  public:
+    // Every thread should run once per target latency, but for at least the
+    // minimum granularity
+    static constexpr u64 TARGET_LATENCY_NS     = 20'000'000;
+    static constexpr u64 MIN_GRANULARITY_NS    = 3'000'000;
+    static constexpr u64 WAKEUP_GRANULARITY_NS = 1'000'000;
+
+    static u64           NiceToWeight(i32 nice);
+
+    virtual void         Enqueue(Thread* thread, EnqueueFlags flags) override;
+    virtual void         Dequeue(Thread* thread) override;
+
+    virtual Thread*      PickNext() override;
+    virtual Thread*      Steal() override;
+
+    virtual usize        Size() const override { return m_Size; }
+
+    virtual Timestep     TimeSlice(Thread* thread) const override;
+    virtual void         Account(Thread* thread, u64 deltaNs) override;
+    virtual bool ShouldPreempt(const SchedulingEntity& current,
+                               Thread*                 woken) const override;
+
+    inline u64   MinVirtualRuntime() const { return m_MinVirtualRuntime; }
+
+  private:
+    struct Key
+    {
+        u64      VirtualRuntime;
+        upointer Thread;
+
+        constexpr auto operator<=>(const Key&) const = default;
+    };
+
+    RedBlackTree<Key, Thread*> m_Timeline;
+    usize                      m_Size              = 0;
+    u64                        m_TotalWeight       = 0;
+    u64                        m_MinVirtualRuntime = 0;
+
+    static Key                 KeyOf(Thread* thread);
+    void                       UpdateMinVirtualRuntime(u64 current);
+    void                       Remove(Thread* thread);
+};
@@ -6,6 +6,7 @@
  */
 #include <API/Posix/sys/wait.h>
 #include <Arch/CPU.hpp>
+#include <Memory/MM.hpp>
 
 #include <Prism/String/StringUtils.hpp>
 #include <Prism/Utility/Math.hpp>
@@ -296,9 +297,8 @@ ErrorOr<i32> Process::Exec(String path, char** argv, char** envp)
 
     for (const auto& [virt, region] : m_AddressSpace)
     {
-        auto  phys      = region->PhysicalBase();
-        usize pageCount = Math::DivRoundUp(region->Size(), PMM::PAGE_SIZE);
-        PMM::FreePages(phys, pageCount);
+        (void)MM::SyncRegion(nullptr, region);
+        region->FreePhysicalMemory();
     }
 
     m_Name = path;
@@ -431,8 +431,11 @@ ErrorOr<Process*> Process::Fork()
     Assert(newProcess);
 
     LogTrace("Process: new process created!");
-    // TODO(v1tr10l7): implement PageMap::Fork;
-    class PageMap* pageMap = new class PageMap();
+    newProcess->m_AddressSpace.Clear();
+
+    LogDebug("Process: Sharing the address space");
+    class PageMap* pageMap
+        = PageMap->Fork(m_AddressSpace, newProcess->m_AddressSpace);
     if (!pageMap) return Error(ENOMEM);
 
     newProcess->PageMap = pageMap;
@@ -440,39 +443,6 @@ ErrorOr<Process*> Process::Fork()
     newProcess->m_Umask = m_Umask;
     m_Children.PushBack(newProcess);
 
-    newProcess->m_AddressSpace.Clear();
-    LogDebug("Process: Copying the address space");
-    for (const auto& [base, range] : m_AddressSpace)
-    {
-        usize pageCount
-            = Math::AlignUp(range->Size(), PMM::PAGE_SIZE) / PMM::PAGE_SIZE;
-
-        uintptr_t physicalSpace = PMM::CallocatePages<uintptr_t>(pageCount);
-        Assert(physicalSpace);
-
-        Memory::Copy(Pointer(physicalSpace).ToHigherHalf<void*>(),
-                     range->PhysicalBase().ToHigherHalf<void*>(),
-                     range->Size());
-        pageMap->MapRange(range->VirtualBase(), physicalSpace, range->Size(),
-                          PageAttributes::eRWXU | PageAttributes::eWriteBack);
-
-        auto newRegion
-            = new Region(physicalSpace, range->VirtualBase(), range->Size());
-        newRegion->SetAccessMode(range->Access());
-        newProcess->m_AddressSpace.Insert(range->VirtualBase(), newRegion);
-        continue;
-        // auto newRegion = newProcess->m_AddressSpace.AllocateFixed(
-        //     range->VirtualBase(), range->Size());
-        // if (!newRegion)
-        //    newRegion
-        //        = newProcess->m_AddressSpace.AllocateRegion(range->Size());
-        newRegion->SetPhysicalBase(physicalSpace);
-        newRegion->SetAccessMode(range->Access());
-
-        // pageMap->MapRegion(newRegion);
-        //  TODO(v1tr10l7): Free regions;
-    }
-
     newProcess->m_NextTid.Store(m_NextTid.Load());
     LogDebug("Process: Copying fd table");
     for (const auto& [i, fd] : m_FdTable)
@@ -523,6 +493,15 @@ i32 Process::Exit(i32 code)
     }
     m_Zombies.Clear();
 
+    // Pages still shared copy-on-write stay alive until their last owner is
+    // gone
+    for (const auto& [base, region] : m_AddressSpace)
+    {
+        (void)MM::SyncRegion(nullptr, region);
+        region->FreePhysicalMemory();
+    }
+    m_AddressSpace.Clear();
+
     delete PageMap;
     m_Status = W_EXITCODE(code, 0);
     m_Exited = true;
@@ -0,0 +1,85 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#include <Scheduler/RealTimeSchedulingClass.hpp>
+
+void RealTimeSchedulingClass::Enqueue(Thread* thread, EnqueueFlags flags)
+{
+    auto& entity   = thread->Scheduling();
+    usize priority = entity.RealTimePriority;
+    Assert(priority < PRIORITY_COUNT);
+
+    // Preempted SCHED_FIFO threads stay at the head of their priority list
+    bool preempted = !(flags & EnqueueFlags::eWakeup)
+                  && !(flags & EnqueueFlags::eNew)
+                  && entity.Policy == SchedulingPolicy::eFifo;
+    if (preempted) m_Queues[priority].PushFront(thread);
+    else m_Queues[priority].PushBack(thread);
+
+    m_ActivePriorities[priority / 64] |= Bit(priority % 64);
+    ++m_Size;
+}
+void RealTimeSchedulingClass::Dequeue(Thread* thread)
+{
+    if (!thread->Hook.IsLinked()) return;
+
+    usize priority = thread->Scheduling().RealTimePriority;
+    thread->Hook.Unlink(thread);
+    --m_Size;
+
+    if (m_Queues[priority].Empty())
+        m_ActivePriorities[priority / 64] &= ~Bit(priority % 64);
+}
+
+Thread* RealTimeSchedulingClass::PickNext()
+{
+    isize priority = HighestPriority();
+    if (priority < 0) return nullptr;
+
+    return PopFront(priority);
+}
+Thread* RealTimeSchedulingClass::Steal() { return PickNext(); }
+
+Timestep RealTimeSchedulingClass::TimeSlice(Thread* thread) const
+{
+    if (thread->Scheduling().Policy == SchedulingPolicy::eRoundRobin)
+        return Timestep(ROUND_ROBIN_SLICE_NS);
+
+    return Timestep(FIFO_SLICE_NS);
+}
+void RealTimeSchedulingClass::Account(Thread* thread, u64 deltaNs)
+{
+    thread->Scheduling().TotalRuntime += deltaNs;
+}
+bool RealTimeSchedulingClass::ShouldPreempt(const SchedulingEntity& current,
+                                            Thread*                 woken) const
+{
+    if (!IsRealTimePolicy(current.Policy)) return true;
+
+    return woken->Scheduling().RealTimePriority > current.RealTimePriority;
+}
+
+isize RealTimeSchedulingClass::HighestPriority() const
+{
+    for (isize word = m_ActivePriorities.Size() - 1; word >= 0; --word)
+    {
+        u64 bits = m_ActivePriorities[word];
+        if (bits) return word * 64 + (63 - __builtin_clzll(bits));
+    }
+
+    return -1;
+}
+Thread* RealTimeSchedulingClass::PopFront(usize priority)
+{
+    auto&   queue  = m_Queues[priority];
+    Thread* thread = queue.PopFrontElement();
+    if (!thread) return nullptr;
+
+    --m_Size;
+    if (queue.Empty()) m_ActivePriorities[priority / 64] &= ~Bit(priority % 64);
+
+    return thread;
+}
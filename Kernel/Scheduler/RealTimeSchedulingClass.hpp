@@ -0,0 +1,43 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#pragma once
+
+#include <Prism/Containers/Array.hpp>
+
+#include <Scheduler/SchedulingClass.hpp>
+#include <Scheduler/Thread.hpp>
+
+class RealTimeSchedulingClass final : public SchedulingClass
+{
+  public:
+    static constexpr u64 ROUND_ROBIN_SLICE_NS = 100'000'000;
+    // SCHED_FIFO doesn't need a slice, but we still tick to rebalance
+    static constexpr u64 FIFO_SLICE_NS        = 1'000'000'000;
+
+    virtual void         Enqueue(Thread* thread, EnqueueFlags flags) override;
+    virtual void         Dequeue(Thread* thread) override;
+
+    virtual Thread*      PickNext() override;
+    virtual Thread*      Steal() override;
+
+    virtual usize        Size() const override { return m_Size; }
+
+    virtual Timestep     TimeSlice(Thread* thread) const override;
+    virtual void         Account(Thread* thread, u64 deltaNs) override;
+    virtual bool ShouldPreempt(const SchedulingEntity& current,
+                               Thread*                 woken) const override;
+
+  private:
+    static constexpr usize PRIORITY_COUNT = MAX_REAL_TIME_PRIORITY + 1;
+
+    Array<Thread::List, PRIORITY_COUNT> m_Queues;
+    Array<u64, 2>                       m_ActivePriorities = {};
+    usize                               m_Size             = 0;
+
+    isize                               HighestPriority() const;
+    Thread*                             PopFront(usize priority);
+};
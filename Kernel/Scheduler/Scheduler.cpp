@@ -14,9 +14,12 @@
 #endif
 
 #include <Library/Locking/Spinlock.hpp>
+#include <Memory/Allocator/KernelHeap.hpp>
 #include <Memory/PMM.hpp>
 
+#include <Scheduler/FairSchedulingClass.hpp>
 #include <Scheduler/Process.hpp>
+#include <Scheduler/RealTimeSchedulingClass.hpp>
 #include <Scheduler/Scheduler.hpp>
 #include <Scheduler/Thread.hpp>
 #include <Time/Time.hpp>
@@ -27,12 +30,47 @@
 
 namespace
 {
-    Spinlock s_Lock{};
-    bool     s_SchedulerEnabled = false;
+    bool s_SchedulerEnabled = false;
+
+    // How much longer the busiest queue has to be, before we pull from it
+    constexpr usize IMBALANCE_THRESHOLD      = 2;
+    constexpr usize REBALANCE_INTERVAL_TICKS = 4;
+    // Longest an idle cpu without pending timers goes without a tick
+    constexpr usize MAX_IDLE_INTERVAL_MS     = 1000;
 
     struct CPULocalData
     {
-        Atomic<bool> PreemptionEnabled;
+        Atomic<bool>  PreemptionEnabled;
+        Atomic<bool>  Idling;
+
+        Atomic<usize> Migrations;
+        Atomic<usize> StealAttempts;
+        Atomic<usize> Steals;
+        Atomic<usize> ContextSwitches;
+
+        usize         TicksSinceRebalance = 0;
+
+        // What the cpu runs, published by itself on every switch, so that
+        // wakers elsewhere never dereference a thread, which might be gone
+        Atomic<u8>    RunningPolicy;
+        Atomic<u8>    RunningPriority;
+        Atomic<u64>   RunningVirtualRuntime;
+
+        void          Publish(const SchedulingEntity& entity)
+        {
+            RunningPolicy.Store(ToUnderlying(entity.Policy));
+            RunningPriority.Store(entity.RealTimePriority);
+            RunningVirtualRuntime.Store(entity.VirtualRuntime);
+        }
+        SchedulingEntity Running() const
+        {
+            SchedulingEntity entity;
+            entity.Policy = static_cast<SchedulingPolicy>(RunningPolicy.Load());
+            entity.RealTimePriority = RunningPriority.Load();
+            entity.VirtualRuntime   = RunningVirtualRuntime.Load();
+
+            return entity;
+        }
     };
     CPULocalData*                 s_CPULocalData;
 
@@ -40,12 +78,25 @@ namespace
     Spinlock                      s_ProcessListLock;
     UnorderedMap<pid_t, Process*> s_Processes;
     Ref<ProcFs>                   s_ProcFs = nullptr;
+
+    u64                           Now()
+    {
+        auto clock = CPU::HighResolutionClock();
+        if (clock)
+        {
+            auto maybeNow = clock->Now();
+            if (maybeNow) return maybeNow->Nanoseconds();
+        }
+
+        return Time::GetMonotonicTime().Nanoseconds();
+    }
 } // namespace
 
 struct ThreadQueue
 {
     mutable Spinlock Lock;
     Thread::List     Queue;
+    usize            CPUID = 0;
 
     constexpr usize  Size() const { return Queue.Size(); }
     constexpr bool   IsEmpty() const { return Queue.Empty(); }
@@ -67,11 +118,13 @@ struct ThreadQueue
     inline void PushBack(Thread* t)
     {
         ScopedLock guard(Lock);
+        t->m_EnqueuedOn = CPUID;
         Queue.PushBack(t);
     }
     inline void PushFront(Thread* t)
     {
         ScopedLock guard(Lock);
+        t->m_EnqueuedOn = CPUID;
         Queue.PushFront(t);
     }
 
@@ -95,6 +148,7 @@ struct ThreadQueue
         if (IsEmpty()) return nullptr;
 
         ScopedLock guard(Lock);
+        if (Queue.Empty()) return nullptr;
         return Queue.PopFrontElement();
     }
     inline Thread* PopBackElement()
@@ -102,9 +156,9 @@ struct ThreadQueue
         if (IsEmpty()) return nullptr;
         ScopedLock guard(Lock);
 
+        if (Queue.Empty()) return nullptr;
         return Queue.PopBackElement();
     }
-
     inline void Erase(auto it)
     {
         ScopedLock guard(Lock);
@@ -112,18 +166,70 @@ struct ThreadQueue
     }
 };
 
-constexpr usize                               QUEUE_TYPE_EXECUTION = 0;
-constexpr usize                               QUEUE_TYPE_WAIT      = 1;
-constexpr usize                               QUEUE_TYPE_READY     = 2;
-constexpr usize                               QUEUE_TYPE_BLOCKED   = 3;
-constexpr usize                               QUEUE_TYPE_COUNT     = 4;
+struct RunQueue
+{
+    mutable Spinlock        Lock;
+    usize                   CPUID = 0;
+
+    RealTimeSchedulingClass RealTime;
+    FairSchedulingClass     Fair;
+
+    inline usize Size() const { return RealTime.Size() + Fair.Size(); }
+    inline bool  IsEmpty() const { return Size() == 0; }
+
+    inline SchedulingClass& ClassOf(Thread* thread)
+    {
+        if (IsRealTimePolicy(thread->Scheduling().Policy)) return RealTime;
+
+        return Fair;
+    }
+
+    inline void Enqueue(Thread* thread, EnqueueFlags flags)
+    {
+        ScopedLock guard(Lock);
+        thread->m_IsEnqueued = true;
+        thread->m_EnqueuedOn = CPUID;
+        ClassOf(thread).Enqueue(thread, flags);
+    }
+    inline Thread* PickNext()
+    {
+        if (IsEmpty()) return nullptr;
+        ScopedLock guard(Lock);
+
+        Thread*    thread
+            = !RealTime.IsEmpty() ? RealTime.PickNext() : Fair.PickNext();
+        if (thread) thread->m_IsEnqueued = false;
+
+        return thread;
+    }
+    // Used for stealing, never spin on another cpu's queue lock
+    inline Thread* TrySteal()
+    {
+        if (IsEmpty() || !Lock.TestAndAcquire()) return nullptr;
+
+        Thread* thread = Fair.Steal();
+        if (!thread) thread = RealTime.Steal();
+        if (thread) thread->m_IsEnqueued = false;
+
+        Lock.Release();
+        return thread;
+    }
+    inline void Account(Thread* thread, u64 deltaNs)
+    {
+        ScopedLock guard(Lock);
+        ClassOf(thread).Account(thread, deltaNs);
+    }
+};
+
+constexpr usize                               QUEUE_TYPE_WAIT    = 0;
+constexpr usize                               QUEUE_TYPE_READY   = 1;
+constexpr usize                               QUEUE_TYPE_BLOCKED = 2;
+constexpr usize                               QUEUE_TYPE_COUNT   = 3;
 
+Vector<RunQueue*>                             s_RunQueues;
 Vector<Array<ThreadQueue*, QUEUE_TYPE_COUNT>> s_Queues;
 
-ThreadQueue&                                  ExecutionQueue(u64 cpuID)
-{
-    return *(s_Queues[cpuID][QUEUE_TYPE_EXECUTION]);
-}
+RunQueue& ExecutionQueue(u64 cpuID) { return *s_RunQueues[cpuID]; }
 ThreadQueue& WaitQueue(u64 cpuID)
 {
     return *(s_Queues[cpuID][QUEUE_TYPE_WAIT]);
@@ -144,20 +250,34 @@ void Scheduler::Initialize()
     s_CPULocalData  = new CPULocalData[cpuCount];
     s_KernelProcess = Process::CreateKernelProcess();
 
+    s_RunQueues.Resize(cpuCount);
     s_Queues.Resize(cpuCount);
     for (usize cpuID = 0; cpuID < cpuCount; cpuID++)
     {
+        s_RunQueues[cpuID]        = new RunQueue;
+        s_RunQueues[cpuID]->CPUID = cpuID;
+
         for (usize queueIndex = 0; queueIndex < QUEUE_TYPE_COUNT; queueIndex++)
-            s_Queues[cpuID][queueIndex] = new ThreadQueue;
+        {
+            s_Queues[cpuID][queueIndex]        = new ThreadQueue;
+            s_Queues[cpuID][queueIndex]->CPUID = cpuID;
+        }
     }
 
     for (usize i = 0; i < cpuCount; i++)
+    {
         s_CPULocalData[i].PreemptionEnabled.Store(true);
+        // APs are parked in their idle threads at this point
+        s_CPULocalData[i].Idling.Store(i != CPU::GetCurrentID());
+    }
+    Time::InitializeTimers(cpuCount);
+    PMM::InitializePageCaches(cpuCount);
+    KernelHeap::InitializeMagazines(cpuCount);
     s_SchedulerEnabled = true;
     Time::GetSchedulerTimer()->SetCallback<Tick>();
 
     LogInfo("Scheduler: Kernel process created");
-    LogInfo("Scheduler: Initialized");
+    LogInfo("Scheduler: Initialized with {} run queues", cpuCount);
 }
 KERNEL_INIT_CODE
 void Scheduler::InitializeProcFs()
@@ -225,16 +345,17 @@ void Scheduler::Unblock(Thread* thread)
     if (thread->State() != ThreadState::eBlocked) return;
 
     thread->SetState(ThreadState::eReady);
-    if (!thread->m_IsEnqueued)
+    // A thread still on its way out of a cpu is enqueued by that cpu, once
+    // its context has been saved
+    if (thread->m_OnCPU.Load() || thread->IsEnqueued()) return;
+
+    if (thread->Hook.IsLinked())
     {
+        auto& blockedQueue = BlockedQueue(thread->m_EnqueuedOn);
+        ScopedLock guard(blockedQueue.Lock);
         if (thread->Hook.IsLinked()) thread->Hook.Unlink(thread);
-        EnqueueThread(thread);
     }
-
-#ifdef CTOS_TARGET_X86_64
-    Lapic::Instance()->SendIpi(Time::GetSchedulerTimer()->InterruptVector(),
-                               CPU::Current()->LapicID);
-#endif
+    EnqueueThread(thread, EnqueueFlags::eWakeup);
 }
 
 void Scheduler::Yield(bool saveCtx)
@@ -308,39 +429,114 @@ Process* Scheduler::GetProcess(pid_t pid)
     return it != s_Processes.end() ? s_Processes[pid] : nullptr;
 }
 
-void Scheduler::EnqueueThread(Thread* thread)
+void Scheduler::EnqueueThread(Thread* thread, EnqueueFlags flags)
 {
     Assert(!thread->Hook.IsLinked());
-    if (thread->m_IsEnqueued) return;
 
-    ScopedLock guard(s_Lock);
-    thread->m_IsEnqueued = true;
+    bool expected = false;
+    if (!thread->m_IsEnqueued.CompareExchange(expected, true, false,
+                                              MemoryOrder::eAtomicAcquire,
+                                              MemoryOrder::eAtomicRelaxed))
+        return;
     thread->SetState(ThreadState::eReady);
 
-    ExecutionQueue(CPU::GetCurrentID()).PushBack(thread);
+    usize cpuID    = SelectCPU(thread);
+    auto& runQueue = ExecutionQueue(cpuID);
+    runQueue.Enqueue(thread, flags);
+    if (!s_SchedulerEnabled) return;
+
+    // Kick the target if it's idle, or if the woken thread should preempt,
+    // a snapshot torn by a concurrent switch costs at most a spurious kick
+    auto& target = s_CPULocalData[cpuID];
+    if (target.Idling.Load()
+        || runQueue.ClassOf(thread).ShouldPreempt(target.Running(), thread))
+        WakeUpCPU(cpuID);
 }
 
 void Scheduler::EnqueueNotReady(Thread* thread)
 {
     Assert(!thread->Hook.IsLinked());
-    ScopedLock guard(s_Lock);
 
-    thread->m_IsEnqueued = true;
+    bool expected = false;
+    if (!thread->m_IsEnqueued.CompareExchange(expected, true, false,
+                                              MemoryOrder::eAtomicAcquire,
+                                              MemoryOrder::eAtomicRelaxed))
+        return;
+
     if (thread->State() == ThreadState::eRunning)
         thread->SetState(ThreadState::eReady);
 
-    ExecutionQueue(CPU::GetCurrentID()).PushBack(thread);
+    ExecutionQueue(CPU::GetCurrentID()).Enqueue(thread, EnqueueFlags::eNone);
 }
 void Scheduler::DequeueThread(Thread* thread)
 {
-    Assert(thread->Hook.IsLinked());
-
     if (!thread->IsEnqueued()) return;
-    ScopedLock guard(s_Lock);
+    auto&      queue = ExecutionQueue(thread->m_EnqueuedOn);
+    ScopedLock guard(queue.Lock);
+    if (!thread->IsEnqueued()) return;
 
+    queue.ClassOf(thread).Dequeue(thread);
     thread->m_IsEnqueued = false;
     thread->SetState(ThreadState::eDequeued);
-    thread->Hook.Unlink(thread);
+}
+
+ErrorOr<void> Scheduler::SetSchedulingPolicy(Thread*          thread,
+                                             SchedulingPolicy policy, i32 nice,
+                                             u8 realTimePriority)
+{
+    if (nice < MIN_NICE || nice > MAX_NICE) return Error(EINVAL);
+    if (IsRealTimePolicy(policy)
+        && (realTimePriority < 1 || realTimePriority > MAX_REAL_TIME_PRIORITY))
+        return Error(EINVAL);
+    if (!IsRealTimePolicy(policy) && realTimePriority != 0)
+        return Error(EINVAL);
+
+    auto apply = [&]()
+    {
+        auto& entity            = thread->Scheduling();
+        entity.Policy           = policy;
+        entity.Nice             = nice;
+        entity.RealTimePriority = realTimePriority;
+        entity.Weight           = FairSchedulingClass::NiceToWeight(nice);
+    };
+
+    // Weight and priority are run queue bookkeeping, so requeue queued threads
+    isize queuedOn = thread->m_EnqueuedOn;
+    if (!thread->IsEnqueued() || queuedOn < 0)
+    {
+        apply();
+        return {};
+    }
+
+    auto&      queue = ExecutionQueue(queuedOn);
+    ScopedLock guard(queue.Lock);
+    if (!thread->IsEnqueued() || thread->m_EnqueuedOn != queuedOn)
+    {
+        apply();
+        return {};
+    }
+
+    queue.ClassOf(thread).Dequeue(thread);
+    apply();
+    queue.ClassOf(thread).Enqueue(thread, EnqueueFlags::eNone);
+
+    return {};
+}
+
+usize Scheduler::GetCPUCount() { return s_RunQueues.Size(); }
+Scheduler::Statistics Scheduler::GetStatistics(usize cpuID)
+{
+    Statistics stats{};
+    if (cpuID >= s_RunQueues.Size()) return stats;
+
+    auto& local           = s_CPULocalData[cpuID];
+    stats.QueuedThreads   = ExecutionQueue(cpuID).Size();
+    stats.Migrations      = local.Migrations.Load();
+    stats.StealAttempts   = local.StealAttempts.Load();
+    stats.Steals          = local.Steals.Load();
+    stats.ContextSwitches = local.ContextSwitches.Load();
+
+    return stats;
 }
 
 UnorderedMap<pid_t, Process*>& Scheduler::GetProcessMap()
@@ -348,21 +544,110 @@ UnorderedMap<pid_t, Process*>& Scheduler::GetProcessMap()
     return s_Processes;
 }
 
-Thread* Scheduler::GetNextThread(usize cpuID)
+usize Scheduler::SelectCPU(Thread* thread)
+{
+    usize cpuCount  = s_RunQueues.Size();
+    isize lastCPU   = thread->m_Tls.RunningOn;
+    usize currentID = CPU::GetCurrentID();
+
+    // Prefer the last cpu for its warm caches, unless it's noticeably busier
+    usize preferred
+        = lastCPU >= 0 && usize(lastCPU) < cpuCount ? lastCPU : currentID;
+    if (cpuCount < 2 || !s_SchedulerEnabled) return preferred;
+    if (s_CPULocalData[preferred].Idling.Load()) return preferred;
+
+    usize idlest = preferred;
+    for (usize cpuID = 0; cpuID < cpuCount; cpuID++)
+    {
+        if (s_CPULocalData[cpuID].Idling.Load()
+            && ExecutionQueue(cpuID).IsEmpty())
+            return cpuID;
+
+        if (ExecutionQueue(cpuID).Size() < ExecutionQueue(idlest).Size())
+            idlest = cpuID;
+    }
+
+    if (ExecutionQueue(preferred).Size()
+        >= ExecutionQueue(idlest).Size() + IMBALANCE_THRESHOLD)
+    {
+        ++s_CPULocalData[idlest].Migrations;
+        return idlest;
+    }
+
+    return preferred;
+}
+usize Scheduler::FindBusiestCPU(usize cpuID)
 {
-    if (ExecutionQueue(CPU::GetCurrentID()).IsEmpty()) return nullptr;
+    usize busiest = cpuID;
+    for (usize i = 0; i < s_RunQueues.Size(); i++)
+        if (ExecutionQueue(i).Size() > ExecutionQueue(busiest).Size())
+            busiest = i;
+
+    return busiest;
+}
+void Scheduler::WakeUpCPU(usize cpuID)
+{
+#ifdef CTOS_TARGET_X86_64
+    Lapic::Instance()->SendIpi(Time::GetSchedulerTimer()->InterruptVector(),
+                               CPU::GetCPU(cpuID).LapicID);
+#endif
+}
+
+Thread* Scheduler::StealThread(usize cpuID)
+{
+    if (s_RunQueues.Size() < 2) return nullptr;
+
+    auto& local = s_CPULocalData[cpuID];
+    ++local.StealAttempts;
 
-    auto thread = ExecutionQueue(CPU::GetCurrentID()).PopFrontElement();
+    usize busiest = FindBusiestCPU(cpuID);
+    if (busiest == cpuID) return nullptr;
+
+    // Steal from the tail, the head is about to run, and likely cache hot
+    Thread* thread = ExecutionQueue(busiest).TrySteal();
     if (!thread) return nullptr;
 
-    thread->m_IsEnqueued = false;
+    // The stolen thread runs right away, so rebase its vruntime here
+    if (!IsRealTimePolicy(thread->Scheduling().Policy))
+        thread->Scheduling().VirtualRuntime
+            += ExecutionQueue(cpuID).Fair.MinVirtualRuntime();
+
+    ++local.Steals;
+    ++local.Migrations;
+    return thread;
+}
+void Scheduler::Rebalance(usize cpuID)
+{
+    auto& local = s_CPULocalData[cpuID];
+    if (++local.TicksSinceRebalance < REBALANCE_INTERVAL_TICKS) return;
+    local.TicksSinceRebalance = 0;
+
+    usize busiest = FindBusiestCPU(cpuID);
+    if (busiest == cpuID
+        || ExecutionQueue(busiest).Size()
+               < ExecutionQueue(cpuID).Size() + IMBALANCE_THRESHOLD)
+        return;
+
+    Thread* thread = ExecutionQueue(busiest).TrySteal();
+    if (!thread) return;
+
+    ExecutionQueue(cpuID).Enqueue(thread, EnqueueFlags::eMigrated);
+    ++local.Migrations;
+}
+
+Thread* Scheduler::GetNextThread(usize cpuID)
+{
+    auto thread = ExecutionQueue(cpuID).PickNext();
+    if (!thread) thread = StealThread(cpuID);
+    if (!thread) return nullptr;
 
     Assert(!thread->Hook.IsLinked());
     return thread;
 }
 Thread* Scheduler::PickReadyThread()
 {
-    auto newThread = GetNextThread(CPU::Current()->ID);
+    usize cpuID     = CPU::GetCurrentID();
+    auto  newThread = GetNextThread(cpuID);
 
     for (; newThread && newThread->State() != ThreadState::eReady;)
     {
@@ -373,13 +658,13 @@ Thread* Scheduler::PickReadyThread()
         }
         else if (newThread->IsBlocked())
         {
-            BlockedQueue(CPU::GetCurrentID()).PushBack(newThread);
-            newThread = GetNextThread(CPU::Current()->ID);
+            BlockedQueue(cpuID).PushBack(newThread);
+            newThread = GetNextThread(cpuID);
             continue;
         }
 
         EnqueueNotReady(newThread);
-        newThread = GetNextThread(CPU::Current()->ID);
+        newThread = GetNextThread(cpuID);
     }
 
     Thread* currentThread = Thread::Current();
@@ -397,13 +682,20 @@ void Scheduler::SwitchContext(Thread* newThread, CPUContext* oldContext)
     {
         if (currentThread == newThread)
             return currentThread->YieldAwaitLock.Acquire();
-        if (currentThread != CPU::Current()->Idle)
-            EnqueueNotReady(currentThread);
 
+        // Save the context before the thread is visible to other cpus
         CPU::SaveThread(currentThread, oldContext);
+        // Wakers leave the threads, which are on a cpu, to us, either they,
+        // or we win the race to enqueue it
+        currentThread->m_OnCPU.Store(false);
+        if (currentThread != CPU::Current()->Idle)
+            EnqueueNotReady(currentThread);
     }
 
+    newThread->m_OnCPU.Store(true);
     CPU::LoadThread(newThread, oldContext);
+    ++s_CPULocalData[CPU::GetCurrentID()].ContextSwitches;
+    newThread->Scheduling().StartedAt = Now();
 
     if (currentThread && currentThread->IsDead()
         && currentThread->Parent()->IsDead()
@@ -414,15 +706,60 @@ void Scheduler::SwitchContext(Thread* newThread, CPUContext* oldContext)
 void Scheduler::Tick(CPUContext* ctx)
 {
     Thread* newThread = nullptr;
+    usize   cpuID     = CPU::GetCurrentID();
+
+    Time::RunTimers(cpuID);
     if (!IsPreemptionEnabled()) goto reschedule;
 
+    Rebalance(cpuID);
+    AccountCurrentThread(cpuID);
+
     newThread = PickReadyThread();
     Assert(newThread);
     SwitchContext(newThread, ctx);
 
+    s_CPULocalData[cpuID].Idling.Store(newThread == CPU::Current()->Idle);
     if (newThread != CPU::Current()->Idle)
+    {
+        s_CPULocalData[cpuID].Publish(newThread->Scheduling());
         newThread->SetState(ThreadState::eRunning);
+    }
 
 reschedule:
-    CPU::Reschedule(newThread->Parent()->m_Quantum * 1_ms);
+    if (!newThread) newThread = Thread::Current();
+    CPU::Reschedule(NextTickIn(cpuID, newThread));
+}
+
+void Scheduler::AccountCurrentThread(usize cpuID)
+{
+    Thread* current = Thread::Current();
+    if (!current || current == CPU::Current()->Idle || current->IsDead())
+        return;
+
+    auto& entity = current->Scheduling();
+    u64   now    = Now();
+    u64   delta  = now > entity.StartedAt ? now - entity.StartedAt : 0;
+
+    ExecutionQueue(cpuID).Account(current, delta);
+    entity.StartedAt = now;
+}
+Timestep Scheduler::NextTickIn(usize cpuID, Thread* thread)
+{
+    // The one-shot timer fires at the slice end, or the next timer deadline.
+    // Idle cpus sleep until a timer, an IPI, or MAX_IDLE_INTERVAL_MS
+    Timestep next   = TimeSlice(cpuID, thread);
+    auto     expiry = Time::NextTimerExpiry(cpuID);
+
+    if (!thread || thread == CPU::Current()->Idle)
+        next = MAX_IDLE_INTERVAL_MS * 1_ms;
+    if (expiry && *expiry < next) next = *expiry;
+
+    return next;
+}
+Timestep Scheduler::TimeSlice(usize cpuID, Thread* thread)
+{
+    Thread* idle = CPU::Current()->Idle;
+    if (!thread || thread == idle) return idle->Parent()->m_Quantum * 1_ms;
+
+    return ExecutionQueue(cpuID).ClassOf(thread).TimeSlice(thread);
 }
@@ -43,19 +43,47 @@ class Scheduler
     static bool     ValidatePid(pid_t pid);
     static Process* GetProcess(pid_t pid);
 
-    static void     EnqueueThread(Thread* thread);
+    static void     EnqueueThread(Thread*      thread,
+                                  EnqueueFlags flags = EnqueueFlags::eNew);
     static void     EnqueueNotReady(Thread* thread);
     static void     DequeueThread(Thread* thread);
 
+    static ErrorOr<void> SetSchedulingPolicy(Thread*          thread,
+                                             SchedulingPolicy policy, i32 nice,
+                                             u8 realTimePriority = 0);
+
+    struct Statistics
+    {
+        usize QueuedThreads   = 0;
+        usize Migrations      = 0;
+        usize StealAttempts   = 0;
+        usize Steals          = 0;
+        usize ContextSwitches = 0;
+    };
+
+    static usize      GetCPUCount();
+    static Statistics GetStatistics(usize cpuID);
+
   private:
     Scheduler() = default;
 
     static UnorderedMap<pid_t, Process*>& GetProcessMap();
     friend class Process;
 
+    static usize   SelectCPU(Thread* thread);
+    static usize   FindBusiestCPU(usize cpuID);
+    static void    WakeUpCPU(usize cpuID);
+
+    static Thread* StealThread(usize cpuID);
+    static void    Rebalance(usize cpuID);
+
     static Thread* GetNextThread(usize cpuID);
     static Thread* PickReadyThread();
     static void    SwitchContext(Thread* newThread, struct CPUContext* context);
 
-    static void    Tick(struct CPUContext*);
+    static void     AccountCurrentThread(usize cpuID);
+    static Timestep NextTickIn(usize cpuID, Thread* thread);
+    static Timestep TimeSlice(usize cpuID, Thread* thread);
+
+    static void     Tick(struct CPUContext*);
 }; // namespace Scheduler
@@ -0,0 +1,98 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#pragma once
+
+#include <Prism/Core/Types.hpp>
+#include <Prism/Utility/Time.hpp>
+
+struct Thread;
+enum class SchedulingPolicy : u8
+{
+    eNormal     = 0,
+    eFifo       = 1,
+    eRoundRobin = 2,
+    eBatch      = 3,
+    eIdle       = 5,
+};
+
+constexpr bool IsRealTimePolicy(SchedulingPolicy policy)
+{
+    return policy == SchedulingPolicy::eFifo
+        || policy == SchedulingPolicy::eRoundRobin;
+}
+
+constexpr i32 MIN_NICE               = -20;
+constexpr i32 MAX_NICE               = 19;
+constexpr u8  MAX_REAL_TIME_PRIORITY = 99;
+constexpr u64 NICE_0_WEIGHT          = 1024;
+
+enum class EnqueueFlags : u8
+{
+    eNone     = 0,
+    // The thread was just created, and never ran before
+    eNew      = Bit(0),
+    // The thread is waking up after sleeping
+    eWakeup   = Bit(1),
+    // The thread was pulled from another cpu's run queue
+    eMigrated = Bit(2),
+};
+inline constexpr bool operator&(const EnqueueFlags lhs, const EnqueueFlags rhs)
+{
+    return ToUnderlying(lhs) & ToUnderlying(rhs);
+}
+inline constexpr EnqueueFlags operator|(const EnqueueFlags lhs,
+                                        const EnqueueFlags rhs)
+{
+    auto result = ToUnderlying(lhs) | ToUnderlying(rhs);
+
+    return static_cast<EnqueueFlags>(result);
+}
+
+struct SchedulingEntity
+{
+    SchedulingPolicy Policy           = SchedulingPolicy::eNormal;
+    i32              Nice             = 0;
+    u8               RealTimePriority = 0;
+    u64              Weight           = NICE_0_WEIGHT;
+
+    u64              VirtualRuntime   = 0;
+    u64              StartedAt        = 0;
+    u64              TotalRuntime     = 0;
+    u64              RemainingSlice   = 0;
+};
+
+/**
+ * @brief Interface every scheduling class has to implement,
+ * each cpu owns one instance of every class, and the run queue lock
+ * is held by the scheduler around every call
+ */
+class SchedulingClass
+{
+  public:
+    virtual ~SchedulingClass()                                  = default;
+
+    virtual void    Enqueue(Thread* thread, EnqueueFlags flags) = 0;
+    virtual void    Dequeue(Thread* thread)                     = 0;
+
+    /**
+     * @brief Removes, and returns the thread that should run next
+     */
+    virtual Thread* PickNext()                                  = 0;
+    /**
+     * @brief Removes, and returns a thread which can be migrated to another
+     * cpu
+     */
+    virtual Thread*  Steal()                                  = 0;
+
+    virtual usize    Size() const                             = 0;
+    inline bool      IsEmpty() const { return Size() == 0; }
+
+    virtual Timestep TimeSlice(Thread* thread) const          = 0;
+    virtual void     Account(Thread* thread, u64 deltaNs)     = 0;
+    virtual bool ShouldPreempt(const SchedulingEntity& current,
+                               Thread*                 woken) const = 0;
+};
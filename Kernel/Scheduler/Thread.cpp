@@ -1,7 +1,7 @@
 
 /*
  * Created by v1tr10l7 on 17.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -66,34 +66,49 @@ Thread::Thread(Process* parent, Vector<StringView>& argv,
 
     if (!parent->PageMap) parent->PageMap = VMM::GetKernelPageMap();
 
-    auto mapUserStack = [this]() -> std::pair<uintptr_t, uintptr_t>
+    // The user stack is demand paged, only the initial frame is populated
+    Pointer stackVirt = m_Parent->m_UserStackTop.Raw() - CPU::USER_STACK_SIZE;
+    Pointer stackTopVirt = stackVirt.Offset(CPU::USER_STACK_SIZE);
+
+    using VMM::Access;
+    Ref<Region> stackRegion = new Region(0, stackVirt, CPU::USER_STACK_SIZE);
+    stackRegion->SetAccessMode(Access::eReadWriteExecute | Access::eUser);
+
+    usize frameSize = 64 * sizeof(uintptr_t);
+    for (const auto& arg : argv)
+        frameSize += arg.Size() + 1 + sizeof(uintptr_t);
+    for (const auto& env : envp)
+        frameSize += env.Size() + 1 + sizeof(uintptr_t);
+
+    usize framePageCount = Math::DivRoundUp(frameSize, PMM::PAGE_SIZE);
+    Assert(framePageCount < stackRegion->PageCount());
+
+    Pointer frame = PMM::CallocatePages(framePageCount);
+    Assert(frame);
+    Pointer frameTop
+        = frame.ToHigherHalf<Pointer>().Offset(framePageCount * PMM::PAGE_SIZE);
+    m_Tls.Stack = program.PrepareStack(frameTop, stackTopVirt, argv, envp);
+
+    usize firstFramePage = stackRegion->PageCount() - framePageCount;
+    for (usize i = 0; i < framePageCount; i++)
     {
-        Pointer stackPhys
-            = PMM::CallocatePages(CPU::USER_STACK_SIZE / PMM::PAGE_SIZE);
-        Pointer stackVirt
-            = m_Parent->m_UserStackTop.Raw() - CPU::USER_STACK_SIZE;
-
-        Assert(m_Parent->PageMap->MapRange(
-            stackVirt, stackPhys, CPU::USER_STACK_SIZE,
-            PageAttributes::eRWXU | PageAttributes::eWriteBack));
-
-        using VMM::Access;
-        auto stackRegion
-            = new Region(stackPhys, stackVirt, CPU::USER_STACK_SIZE);
-        stackRegion->SetAccessMode(Access::eReadWriteExecute | Access::eUser);
-        m_Stacks.PushBack(stackRegion);
-        m_Parent->m_AddressSpace.Insert(stackVirt, stackRegion);
-
-        m_StackVirt              = stackVirt;
-        m_Parent->m_UserStackTop = stackVirt.Raw() - PMM::PAGE_SIZE;
-        return {stackPhys.ToHigherHalf<Pointer>().Offset(CPU::USER_STACK_SIZE),
-                stackVirt.Offset(CPU::USER_STACK_SIZE)};
-    };
-
-    auto [stackTopWritable, stackTopVirt] = mapUserStack();
-
-    m_Tls.Stack
-        = program.PrepareStack(stackTopWritable, stackTopVirt, argv, envp);
+        Pointer page = PMM::AllocatePages(1);
+        Assert(page);
+        Memory::Copy(page.ToHigherHalf<void*>(),
+                     frame.Offset(i * PMM::PAGE_SIZE).ToHigherHalf<void*>(),
+                     PMM::PAGE_SIZE);
+
+        stackRegion->InsertPage(firstFramePage + i, page);
+    }
+    PMM::FreePages(frame.Raw(), framePageCount);
+
+    Assert(m_Parent->PageMap->MapRegion(stackRegion));
+    m_Stacks.PushBack(stackRegion);
+    m_Parent->m_AddressSpace.Insert(stackVirt, stackRegion);
+
+    m_StackVirt              = stackVirt;
+    m_Parent->m_UserStackTop = stackVirt.Raw() - PMM::PAGE_SIZE;
+
     CPU::PrepareThread(this, program.EntryPoint(), 0);
 }
 
@@ -131,6 +146,9 @@ Thread::~Thread()
 {
     for (auto& region : m_Stacks)
     {
+        // Demand paged stacks are released along with the address space
+        if (region->IsDemandPaged()) continue;
+
         auto  phys      = region->PhysicalBase();
         usize pageCount = Math::DivRoundUp(region->Size(), PMM::PAGE_SIZE);
         PMM::FreePages(phys, pageCount);
@@ -237,6 +255,14 @@ bool Thread::DispatchSignal(u8 signal)
 
     for (const auto& stack : m_Stacks)
     {
+        // The stack was duplicated along with the address space
+        auto copy = process->m_AddressSpace.Find(stack->VirtualBase());
+        if (copy)
+        {
+            newThread->m_Stacks.PushBack(copy);
+            continue;
+        }
+
         auto    stackPhys    = stack->PhysicalBase();
         usize   stackVirt    = stack->VirtualBase();
         usize   stackSize    = stack->Size();
@@ -263,11 +289,18 @@ bool Thread::DispatchSignal(u8 signal)
                  m_Tls.FpuStoragePageCount * PMM::PAGE_SIZE);
 
     newThread->m_Parent    = process;
-    newThread->Context     = SavedContext;
+    Assert(SyscallContext);
+    newThread->Context     = *SyscallContext;
     newThread->Context.rax = 0;
     newThread->Context.rdx = 0;
 
     newThread->m_IsUser    = m_IsUser;
+
+    // Scheduling parameters are inherited, the accounted runtime is not
+    newThread->m_Scheduling.Policy           = m_Scheduling.Policy;
+    newThread->m_Scheduling.Nice             = m_Scheduling.Nice;
+    newThread->m_Scheduling.RealTimePriority = m_Scheduling.RealTimePriority;
+    newThread->m_Scheduling.Weight           = m_Scheduling.Weight;
 #ifdef CTOS_TARGET_X86_64
     newThread->m_GsBase = m_GsBase;
     newThread->m_FsBase = m_FsBase;
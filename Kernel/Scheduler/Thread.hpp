@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 25.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -23,6 +23,7 @@
 #include <Prism/Containers/Deque.hpp>
 #include <Prism/Containers/IntrusiveList.hpp>
 #include <Scheduler/Event.hpp>
+#include <Scheduler/SchedulingClass.hpp>
 
 namespace CPU
 {
@@ -95,7 +96,7 @@ struct Thread : public RefCounted
     inline Process*   Parent() const { return m_Parent; }
     constexpr bool    IsUser() const { return m_IsUser; }
 
-    inline bool       IsEnqueued() const { return m_IsEnqueued; }
+    inline bool       IsEnqueued() const { return m_IsEnqueued.Load(); }
     constexpr bool    IsDead() const
     {
         return m_State == ThreadState::eExited
@@ -131,12 +132,18 @@ struct Thread : public RefCounted
     inline void    SetGsBase(Pointer gs) { m_GsBase = gs; }
 #endif
 
-    inline Event&                Event() { return m_Event; }
-    inline Deque<struct Event*>& Events() { return m_Events; }
+    inline Event&          Event() { return m_Event; }
+    inline WaitQueueEntry& WaitEntry(usize index)
+    {
+        return m_WaitEntries[index];
+    }
     inline usize                 Which() const { return m_Which; }
 
     inline void                  SetWhich(usize which) { m_Which = which; }
 
+    inline SchedulingEntity&     Scheduling() { return m_Scheduling; }
+    inline const SchedulingEntity& Scheduling() const { return m_Scheduling; }
+
     using List = IntrusiveList<Thread>;
 
   private:
@@ -162,9 +169,11 @@ struct Thread : public RefCounted
     friend Thread* CPU::GetCurrentThread();
 
   public:
-    CPUContext Context;
-    CPUContext SavedContext;
-    Spinlock   YieldAwaitLock;
+    CPUContext  Context;
+    // The frame of the syscall, that the thread is currently in, it lives on
+    // the kernel stack, fork is the only one, that has to look into it
+    CPUContext* SyscallContext = nullptr;
+    Spinlock    YieldAwaitLock;
 
   private:
     Vector<::Ref<Region>> m_Stacks;
@@ -177,21 +186,27 @@ struct Thread : public RefCounted
     Pointer m_El0Base;
 #endif
 
-    bool     m_IsEnqueued     = false;
-    sigset_t m_SignalMask     = 0;
-    sigset_t m_PendingSignals = 0;
+    Atomic<bool>     m_IsEnqueued     = false;
+    isize            m_EnqueuedOn     = -1;
+    // Set while the thread runs on a cpu, until its context is saved again
+    Atomic<bool>     m_OnCPU          = false;
+    SchedulingEntity m_Scheduling;
+    sigset_t         m_SignalMask     = 0;
+    sigset_t         m_PendingSignals = 0;
 
   public:
     ThreadTLS m_Tls;
 
   private:
-    struct Event         m_Event;
-    Deque<struct Event*> m_Events;
-    usize                m_Which = 0;
+    struct Event                            m_Event;
+    Array<WaitQueueEntry, MAX_WAIT_ENTRIES> m_WaitEntries;
+    usize                                   m_Which = 0;
 
     friend class IntrusiveList<Thread>;
     friend struct IntrusiveListHook<Thread>;
     friend struct ThreadQueue;
+    friend struct RunQueue;
+    friend class RealTimeSchedulingClass;
 
     IntrusiveListHook<Thread> Hook;
 
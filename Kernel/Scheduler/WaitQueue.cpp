@@ -0,0 +1,107 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#include <Arch/CPU.hpp>
+
+#include <Scheduler/Scheduler.hpp>
+#include <Scheduler/Thread.hpp>
+#include <Scheduler/WaitQueue.hpp>
+
+usize WaitQueue::Wake(usize exclusive)
+{
+    // Pairs with the fence in PrepareToWait, the caller's store must not be
+    // reordered past the load of the counter
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (!HasWaiters()) return 0;
+
+    bool  intState = CPU::SwapInterruptFlag(false);
+    usize woken    = 0;
+    {
+        ScopedLock guard(Lock);
+        woken = WakeLocked(exclusive);
+    }
+
+    CPU::SetInterruptFlag(intState);
+    return woken;
+}
+
+void WaitQueue::Enqueue(WaitQueueEntry& entry)
+{
+    Assert(!entry.Hook.IsLinked());
+
+    // Non-exclusive waiters go first, so waking one exclusive waiter wakes them
+    // all
+    if (entry.Exclusive) m_Waiters.PushBack(&entry);
+    else m_Waiters.PushFront(&entry);
+    ++m_WaiterCount;
+}
+void WaitQueue::Dequeue(WaitQueueEntry& entry)
+{
+    if (!entry.Hook.IsLinked()) return;
+
+    entry.Hook.Unlink(&entry);
+    --m_WaiterCount;
+}
+usize WaitQueue::WakeLocked(usize exclusive)
+{
+    usize woken = 0;
+    while (!m_Waiters.Empty())
+    {
+        auto entry = m_Waiters.PopFrontElement();
+        --m_WaiterCount;
+
+        entry->Thread->SetWhich(entry->Which);
+        Scheduler::Unblock(entry->Thread);
+        ++woken;
+
+        if (entry->Exclusive && --exclusive == 0) break;
+    }
+
+    return woken;
+}
+
+bool WaitQueue::PrepareToWait(bool exclusive)
+{
+    auto  thread    = Thread::Current();
+    auto& entry     = thread->WaitEntry(0);
+    bool  intState  = CPU::SwapInterruptFlag(false);
+
+    entry.Thread    = thread;
+    entry.Which     = 0;
+    entry.Exclusive = exclusive;
+
+    ScopedLock guard(Lock);
+    // Mark the thread blocked before wakers can see the entry
+    thread->SetState(ThreadState::eBlocked);
+    Enqueue(entry);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    return intState;
+}
+void WaitQueue::Sleep()
+{
+    auto thread = Thread::Current();
+    if (thread->State() == ThreadState::eBlocked) Scheduler::Yield(true);
+}
+void WaitQueue::FinishWait(bool intState)
+{
+    auto  thread = Thread::Current();
+    auto& entry  = thread->WaitEntry(0);
+
+    CPU::SetInterruptFlag(false);
+    {
+        ScopedLock guard(Lock);
+        Dequeue(entry);
+
+        // The condition was satisfied before we went to sleep, a waker might
+        // have marked us as ready, but never enqueued us, as we were on a cpu
+        if (thread->State() == ThreadState::eBlocked
+            || thread->State() == ThreadState::eReady)
+            thread->SetState(ThreadState::eRunning);
+    }
+
+    CPU::SetInterruptFlag(intState);
+}
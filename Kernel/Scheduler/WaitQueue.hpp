@@ -0,0 +1,92 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#pragma once
+
+#include <Library/Locking/Spinlock.hpp>
+
+#include <Prism/Containers/IntrusiveList.hpp>
+#include <Prism/Core/Types.hpp>
+#include <Prism/Utility/Atomic.hpp>
+
+constexpr usize MAX_WAIT_ENTRIES = 32;
+
+struct Thread;
+class WaitQueue;
+
+/**
+ * @brief Links a sleeping thread into a wait queue, every thread embeds
+ * MAX_WAIT_ENTRIES of them, so going to sleep never allocates
+ */
+struct WaitQueueEntry
+{
+    struct Thread* Thread    = nullptr;
+    usize          Which     = 0;
+    // Exclusive waiters are woken one at a time, to avoid thundering herds
+    bool           Exclusive = false;
+
+    using List               = IntrusiveList<WaitQueueEntry>;
+
+  private:
+    friend class IntrusiveList<WaitQueueEntry>;
+    friend struct IntrusiveListHook<WaitQueueEntry>;
+    friend class WaitQueue;
+
+    IntrusiveListHook<WaitQueueEntry> Hook;
+};
+
+class WaitQueue : public NonCopyable<WaitQueue>
+{
+  public:
+    WaitQueue() = default;
+
+    /**
+     * @brief Blocks the current thread until condition() returns true,
+     * condition is always evaluated after the thread is linked into the queue,
+     * so a wakeup issued in between can't be lost
+     */
+    template <typename Condition>
+    void WaitUntil(Condition condition, bool exclusive = false)
+    {
+        if (condition()) return;
+
+        for (;;)
+        {
+            bool intState  = PrepareToWait(exclusive);
+            bool satisfied = condition();
+            if (!satisfied) Sleep();
+
+            FinishWait(intState);
+            if (satisfied) return;
+            if (condition()) return;
+        }
+    }
+
+    /**
+     * @brief Wakes every non-exclusive waiter, and up to `exclusive` exclusive
+     * ones
+     */
+    usize       Wake(usize exclusive);
+    inline void WakeOne() { Wake(1); }
+    inline void WakeAll() { Wake(usize(-1)); }
+
+    inline bool HasWaiters() const { return m_WaiterCount.Load() != 0; }
+
+    // The following require Lock held, with interrupts disabled
+    void        Enqueue(WaitQueueEntry& entry);
+    void        Dequeue(WaitQueueEntry& entry);
+    usize       WakeLocked(usize exclusive);
+
+    Spinlock    Lock;
+
+  private:
+    WaitQueueEntry::List m_Waiters;
+    Atomic<usize>        m_WaiterCount = 0;
+
+    bool                 PrepareToWait(bool exclusive);
+    void                 Sleep();
+    void                 FinishWait(bool intState);
+};
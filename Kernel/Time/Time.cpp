@@ -14,31 +14,15 @@
 #include <Library/Logger.hpp>
 
 #include <Prism/Algorithm/Find.hpp>
-#include <Prism/Containers/Deque.hpp>
+#include <Prism/Containers/Vector.hpp>
 #include <Prism/Utility/Time.hpp>
 
-#include <Scheduler/Event.hpp>
+#include <Scheduler/Thread.hpp>
 #include <Time/Time.hpp>
+#include <Time/TimerWheel.hpp>
 
 namespace Time
 {
-    struct Timer
-    {
-        explicit Timer(Timestep when)
-            : When(when)
-        {
-            Arm();
-        }
-
-        Optional<usize> Index = NullOpt;
-        bool            Fired = false;
-        Timestep        When{0};
-        Event           Event;
-
-        void            Arm();
-        void            Disarm();
-    };
-
     namespace
     {
         HardwareTimer::List s_HardwareTimers;
@@ -49,26 +33,45 @@ namespace Time
         Timestep            s_RealTime;
         Timestep            s_Monotonic;
 
-        Deque<Timer*>       s_ArmedTimers;
-        Spinlock            s_TimersLock;
+        Vector<TimerWheel*> s_TimerWheels;
+
+        // Timer deadlines are in terms of this clock
+        u64                 CurrentTime()
+        {
+            auto highResClock = CPU::HighResolutionClock();
+            if (highResClock)
+            {
+                auto maybeNow = highResClock->Now();
+                if (maybeNow) return maybeNow->Nanoseconds();
+            }
+
+            return s_Monotonic.Nanoseconds();
+        }
     } // namespace
 
-    void Timer::Arm()
+    void Timer::Arm(Timestep timeout)
     {
-        ScopedLock guard(s_TimersLock);
+        Disarm();
+
+        Fired.Store(false);
+        Deadline = CurrentTime() + timeout.Nanoseconds();
+        Expires  = (Deadline + TIMER_WHEEL_RESOLUTION - 1)
+                / TIMER_WHEEL_RESOLUTION;
 
-        Index = s_ArmedTimers.Size();
-        s_ArmedTimers.PushBack(this);
+        Assert(!s_TimerWheels.Empty());
+        s_TimerWheels[CPU::GetCurrentID()]->Arm(*this);
     }
     void Timer::Disarm()
     {
-        ScopedLock guard(s_TimersLock);
-        auto       it = s_ArmedTimers.begin();
-        for (; it != s_ArmedTimers.end(); it++)
-            if (*it == this) break;
+        isize cpuID = CPUID.Load();
+        if (cpuID < 0) return;
 
-        if (it != s_ArmedTimers.end()) s_ArmedTimers.Erase(it);
-        Index = NullOpt;
+        s_TimerWheels[cpuID]->Disarm(*this);
+    }
+    Timestep Timer::Remaining() const
+    {
+        u64 now = CurrentTime();
+        return Deadline > now ? Deadline - now : 0;
     }
 
     void Initialize(DateTime dateAtBoot)
@@ -89,6 +92,16 @@ namespace Time
                              ? *cpuLocalTimer
                              : s_HardwareTimers.Head();
     }
+    void InitializeTimers(usize cpuCount)
+    {
+        u64 now = CurrentTime();
+
+        s_TimerWheels.Resize(cpuCount);
+        for (usize cpuID = 0; cpuID < cpuCount; cpuID++)
+            s_TimerWheels[cpuID] = new TimerWheel(cpuID, now);
+
+        LogInfo("Time: Initialized {} timer wheels", cpuCount);
+    }
 
     HardwareTimer* GetSchedulerTimer() { return s_SchedulerTimer; }
 
@@ -145,35 +158,65 @@ namespace Time
 
     ErrorOr<void> NanoSleep(usize ns)
     {
-        Timer* timer = new Timer(ns);
-        timer->Event.Await(true);
-        timer->Disarm();
+        // Timer wheels are driven by the scheduler, so spin until it's up
+        if (s_TimerWheels.Empty())
+        {
+            u64 deadline = CurrentTime() + ns;
+            while (CurrentTime() < deadline) Arch::Pause();
+
+            return {};
+        }
+
+        Timer timer;
+        timer.Arm(ns);
+        timer.WaitQueue.WaitUntil([&timer]() { return timer.Fired.Load(); });
+        timer.Disarm();
 
-        delete timer;
         return {};
     }
     ErrorOr<void> Sleep(const timespec* duration, timespec* remaining)
     {
-        LogDebug("Sleeping");
-        usize ns = static_cast<usize>(duration->tv_sec) * 1'000'000'000;
-        if (ns == 0) ns = static_cast<usize>(duration->tv_nsec);
-
-        Timer* timer = new Timer(ns);
-
-        if (!timer->Event.Await(true))
+        usize ns = static_cast<usize>(duration->tv_sec) * 1'000'000'000
+                 + static_cast<usize>(duration->tv_nsec);
+        if (s_TimerWheels.Empty()) return NanoSleep(ns);
+
+        Timer timer;
+        timer.Arm(ns);
+        timer.WaitQueue.WaitUntil(
+            [&timer]() {
+                return timer.Fired.Load()
+                    || Thread::Current()->WasInterrupted();
+            });
+        timer.Disarm();
+
+        if (!timer.Fired.Load())
         {
+            u64 left = timer.Remaining().Nanoseconds();
             if (remaining)
-                *remaining = {static_cast<isize>(timer->When.Seconds()),
-                              static_cast<isize>(timer->When.Nanoseconds())};
-            timer->Disarm();
+                *remaining = {static_cast<isize>(left / 1'000'000'000),
+                              static_cast<isize>(left % 1'000'000'000)};
             return Error(EINTR);
         }
 
-        timer->Disarm();
-        delete timer;
         return {};
     }
 
+    void RunTimers(usize cpuID)
+    {
+        if (cpuID >= s_TimerWheels.Size()) return;
+        s_TimerWheels[cpuID]->Advance(CurrentTime());
+    }
+    Optional<Timestep> NextTimerExpiry(usize cpuID)
+    {
+        if (cpuID >= s_TimerWheels.Size()) return NullOpt;
+
+        auto expiry = s_TimerWheels[cpuID]->NextExpiry();
+        if (!expiry) return NullOpt;
+
+        u64 now = CurrentTime();
+        return Timestep(*expiry > now ? *expiry - now : 0);
+    }
+
     void Tick(usize ns)
     {
         auto highResClock = CPU::HighResolutionClock();
@@ -194,23 +237,5 @@ namespace Time
             s_RealTime += ns;
             s_Monotonic += ns;
         }
-
-        if (s_TimersLock.TestAndAcquire())
-        {
-            for (auto& timer : s_ArmedTimers)
-            {
-                if (timer->Fired) continue;
-
-                if (ns >= timer->When.Nanoseconds()) timer->When = 0_ns;
-                else timer->When -= ns;
-                if (timer->When == 0_ns)
-                {
-                    timer->Event.Trigger(false);
-                    timer->Fired = true;
-                }
-            }
-
-            s_TimersLock.Release();
-        }
     }
 }; // namespace Time
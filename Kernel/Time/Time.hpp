@@ -9,6 +9,7 @@
 #include <API/UnixTypes.hpp>
 
 #include <Prism/Core/Types.hpp>
+#include <Prism/Utility/Optional.hpp>
 #include <Prism/Utility/Time.hpp>
 
 #include <Time/ClockSource.hpp>
@@ -16,22 +17,30 @@
 
 namespace Time
 {
-    void           Initialize(DateTime bootTime);
-    HardwareTimer* GetSchedulerTimer();
+    void               Initialize(DateTime bootTime);
+    void               InitializeTimers(usize cpuCount);
+    HardwareTimer*     GetSchedulerTimer();
 
-    ErrorOr<void>  RegisterTimer(HardwareTimer* timer);
-    ErrorOr<void>  RegisterClockSource(ClockSource* clock);
+    ErrorOr<void>      RegisterTimer(HardwareTimer* timer);
+    ErrorOr<void>      RegisterClockSource(ClockSource* clock);
 
-    Timestep       GetBootTime();
-    Timestep       GetTimeSinceBoot();
-    Timestep       GetRealTime();
-    Timestep       GetMonotonicTime();
+    Timestep           GetBootTime();
+    Timestep           GetTimeSinceBoot();
+    Timestep           GetRealTime();
+    Timestep           GetMonotonicTime();
 
-    timespec       GetReal();
-    timespec       GetMonotonic();
+    timespec           GetReal();
+    timespec           GetMonotonic();
 
-    ErrorOr<void>  NanoSleep(usize ns);
-    ErrorOr<void>  Sleep(const timespec* duration, timespec* remaining);
+    ErrorOr<void>      NanoSleep(usize ns);
+    ErrorOr<void>      Sleep(const timespec* duration, timespec* remaining);
 
-    void           Tick(usize ns);
+    void               Tick(usize ns);
+
+    /**
+     * @brief Fires all of the expired timers armed on the given cpu, called
+     * by the scheduler on every local timer interrupt
+     */
+    void               RunTimers(usize cpuID);
+    Optional<Timestep> NextTimerExpiry(usize cpuID);
 } // namespace Time
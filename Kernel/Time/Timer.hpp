@@ -0,0 +1,54 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#pragma once
+
+#include <Prism/Containers/IntrusiveList.hpp>
+#include <Prism/Core/Types.hpp>
+#include <Prism/Utility/Atomic.hpp>
+#include <Prism/Utility/Time.hpp>
+
+#include <Scheduler/WaitQueue.hpp>
+
+namespace Time
+{
+    class TimerWheel;
+
+    /**
+     * @brief One-shot timer, which wakes up everything waiting on it once it
+     * expires. It never allocates, so it can safely live on the stack, as long
+     * as it's disarmed before going out of scope
+     */
+    struct Timer : public NonCopyable<Timer>
+    {
+        Timer() = default;
+        ~Timer() { Disarm(); }
+
+        void         Arm(Timestep timeout);
+        void         Disarm();
+
+        inline bool  IsArmed() const { return CPUID.Load() >= 0; }
+        Timestep     Remaining() const;
+
+        // Absolute expiration time, in nanoseconds
+        u64          Deadline = 0;
+        // Expiration time, in timer wheel ticks
+        u64          Expires  = 0;
+        Atomic<bool> Fired    = false;
+        WaitQueue    WaitQueue;
+
+        using List = IntrusiveList<Timer>;
+
+      private:
+        friend class TimerWheel;
+        friend class IntrusiveList<Timer>;
+        friend struct IntrusiveListHook<Timer>;
+
+        // The cpu, whose wheel the timer is armed on, or -1
+        Atomic<isize>           CPUID = -1;
+        IntrusiveListHook<Timer> Hook;
+    };
+}; // namespace Time
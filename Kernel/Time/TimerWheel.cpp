@@ -0,0 +1,166 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#include <Arch/CPU.hpp>
+#include <Debug/Assertions.hpp>
+
+#include <Time/TimerWheel.hpp>
+
+namespace Time
+{
+    TimerWheel::TimerWheel(usize cpuID, u64 now)
+        : m_CPUID(cpuID)
+        , m_CurrentTick(now / TIMER_WHEEL_RESOLUTION)
+    {
+    }
+
+    void TimerWheel::Arm(Timer& timer)
+    {
+        bool intState = CPU::SwapInterruptFlag(false);
+        {
+            ScopedLock guard(m_Lock);
+            Assert(!timer.Hook.IsLinked());
+
+            timer.CPUID.Store(m_CPUID);
+            Insert(timer);
+        }
+
+        CPU::SetInterruptFlag(intState);
+    }
+    void TimerWheel::Disarm(Timer& timer)
+    {
+        bool intState = CPU::SwapInterruptFlag(false);
+        {
+            // Timers fire under the lock, so past it the wheel no longer
+            // references it
+            ScopedLock guard(m_Lock);
+            if (timer.CPUID.Load() == static_cast<isize>(m_CPUID))
+            {
+                if (timer.Hook.IsLinked())
+                {
+                    timer.Hook.Unlink(&timer);
+                    --m_Count;
+                }
+                timer.CPUID.Store(-1);
+            }
+        }
+
+        CPU::SetInterruptFlag(intState);
+    }
+
+    void TimerWheel::Advance(u64 now)
+    {
+        u64        target = now / TIMER_WHEEL_RESOLUTION;
+        ScopedLock guard(m_Lock);
+
+        // Nothing to walk, usually after a long idle period
+        if (m_Count == 0 && m_CurrentTick <= target)
+        {
+            m_CurrentTick = target + 1;
+            return;
+        }
+
+        for (; m_CurrentTick <= target; ++m_CurrentTick)
+        {
+            usize index = m_CurrentTick & ROOT_MASK;
+            if (index == 0)
+            {
+                for (usize level = 0; level < LEVEL_COUNT; level++)
+                {
+                    usize shift      = ROOT_BITS + level * LEVEL_BITS;
+                    usize levelIndex = (m_CurrentTick >> shift) & LEVEL_MASK;
+
+                    Cascade(level, levelIndex);
+                    if (levelIndex != 0) break;
+                }
+            }
+
+            auto& slot = m_Root[index];
+            while (!slot.Empty())
+            {
+                Timer* timer = slot.PopFrontElement();
+                --m_Count;
+
+                // Timers beyond the wheel's range sit in the outermost level,
+                // and are rehashed until due
+                if (timer->Expires > m_CurrentTick)
+                {
+                    Insert(*timer);
+                    continue;
+                }
+
+                Fire(*timer);
+            }
+
+            if (m_Count == 0)
+            {
+                m_CurrentTick = target + 1;
+                break;
+            }
+        }
+    }
+    Optional<u64> TimerWheel::NextExpiry()
+    {
+        ScopedLock guard(m_Lock);
+        if (m_Count == 0) return NullOpt;
+
+        // Outer levels can't expire before the root level wraps around
+        u64 boundary = (m_CurrentTick | ROOT_MASK) + 1;
+        for (u64 tick = m_CurrentTick; tick < boundary; tick++)
+            if (!m_Root[tick & ROOT_MASK].Empty())
+                return tick * TIMER_WHEEL_RESOLUTION;
+
+        return boundary * TIMER_WHEEL_RESOLUTION;
+    }
+
+    void TimerWheel::Insert(Timer& timer)
+    {
+        u64 expires = timer.Expires;
+        if (expires < m_CurrentTick) expires = m_CurrentTick;
+
+        u64 delta = expires - m_CurrentTick;
+        if (delta >= MAX_RANGE)
+        {
+            delta   = MAX_RANGE - 1;
+            expires = m_CurrentTick + delta;
+        }
+
+        Timer::List* slot = &m_Root[expires & ROOT_MASK];
+        if (delta >= ROOT_SIZE)
+        {
+            for (usize level = 0; level < LEVEL_COUNT; level++)
+            {
+                usize shift = ROOT_BITS + level * LEVEL_BITS;
+                if (delta >= (1zu << (shift + LEVEL_BITS))) continue;
+
+                slot = &m_Levels[level][(expires >> shift) & LEVEL_MASK];
+                break;
+            }
+        }
+
+        slot->PushBack(&timer);
+        ++m_Count;
+    }
+    void TimerWheel::Cascade(usize level, usize index)
+    {
+        auto& slot = m_Levels[level][index];
+        while (!slot.Empty())
+        {
+            Timer* timer = slot.PopFrontElement();
+            --m_Count;
+
+            Insert(*timer);
+        }
+    }
+    void TimerWheel::Fire(Timer& timer)
+    {
+        timer.Fired.Store(true);
+        timer.WaitQueue.WakeAll();
+
+        // Must come last, after this the owner may destroy the timer
+        timer.CPUID.Store(-1);
+    }
+}; // namespace Time
@@ -0,0 +1,73 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#pragma once
+
+#include <Library/Locking/Spinlock.hpp>
+
+#include <Prism/Containers/Array.hpp>
+#include <Prism/Utility/Optional.hpp>
+
+#include <Time/Timer.hpp>
+
+namespace Time
+{
+    // Granularity of a single timer wheel tick, in nanoseconds
+    constexpr u64 TIMER_WHEEL_RESOLUTION = 1'000'000;
+
+    /**
+     * @brief Per-cpu hierarchical timer wheel, timers are hashed into the root
+     * level by their expiration tick, or into one of the outer levels, which
+     * get cascaded inwards, whenever the root level wraps around. Arming, and
+     * disarming a timer are both constant time operations, and advancing the
+     * wheel only touches the slots which actually expire
+     */
+    class TimerWheel : public NonCopyable<TimerWheel>
+    {
+      public:
+        TimerWheel(usize cpuID, u64 now);
+
+        void          Arm(Timer& timer);
+        void          Disarm(Timer& timer);
+
+        /**
+         * @brief Fires every timer which has expired by `now`
+         */
+        void          Advance(u64 now);
+        /**
+         * @brief Returns the time, by which the wheel has to be advanced next,
+         * or NullOpt if there are no timers armed
+         */
+        Optional<u64> NextExpiry();
+
+        inline usize  Size() const { return m_Count; }
+
+      private:
+        constexpr static usize ROOT_BITS   = 8;
+        constexpr static usize ROOT_SIZE   = 1zu << ROOT_BITS;
+        constexpr static usize ROOT_MASK   = ROOT_SIZE - 1;
+        constexpr static usize LEVEL_BITS  = 6;
+        constexpr static usize LEVEL_SIZE  = 1zu << LEVEL_BITS;
+        constexpr static usize LEVEL_MASK  = LEVEL_SIZE - 1;
+        constexpr static usize LEVEL_COUNT = 4;
+        constexpr static u64   MAX_RANGE
+            = 1zu << (ROOT_BITS + LEVEL_COUNT * LEVEL_BITS);
+
+        Spinlock                                       m_Lock;
+        usize                                          m_CPUID       = 0;
+        // The next tick to be processed
+        u64                                            m_CurrentTick = 0;
+        usize                                          m_Count       = 0;
+
+        Array<Timer::List, ROOT_SIZE>                  m_Root;
+        Array<Array<Timer::List, LEVEL_SIZE>, LEVEL_COUNT> m_Levels;
+
+        void                                           Insert(Timer& timer);
+        void                                           Cascade(usize level,
+                                                               usize index);
+        void                                           Fire(Timer& timer);
+    };
+}; // namespace Time
@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 20.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -64,3 +64,9 @@ ErrorOr<isize> DevTmpFsINode::IoCtl(usize request, usize arg)
 
     return m_Device->IoCtl(request, arg);
 }
+ErrorOr<void> DevTmpFsINode::Sync(bool dataOnly)
+{
+    if (!m_Device) return {};
+
+    return m_Device->Sync();
+}
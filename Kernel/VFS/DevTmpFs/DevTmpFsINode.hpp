@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 20.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -30,6 +30,7 @@ class DevTmpFsINode final : public SynthFsINode, NonCopyable<DevTmpFsINode>
     virtual isize Read(void* buffer, off_t offset, usize bytes) override;
     virtual isize Write(const void* buffer, off_t offset, usize bytes) override;
     virtual ErrorOr<isize> IoCtl(usize request, usize arg) override;
+    virtual ErrorOr<void>  Sync(bool dataOnly = false) override;
 
   private:
     Device* m_Device = nullptr;
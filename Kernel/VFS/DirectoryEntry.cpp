@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 19.06.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -9,6 +9,7 @@
 #include <Prism/String/StringBuilder.hpp>
 
 #include <VFS/DirectoryEntry.hpp>
+#include <VFS/Filesystem.hpp>
 #include <VFS/INode.hpp>
 #include <VFS/MountPoint.hpp>
 #include <VFS/VFS.hpp>
@@ -79,16 +80,30 @@ void DirectoryEntry::Bind(class INode* inode)
 void DirectoryEntry::InsertChild(::Ref<class DirectoryEntry> entry)
 {
     ScopedLock guard(m_Lock);
+
+    // The key views the entry's own name, so erase the replaced entry first
+    auto       it = m_Children.Find(entry->Name());
+    if (it != m_Children.end())
+    {
+        if (it->Value->IsNegative() && m_NegativeCount > 0) --m_NegativeCount;
+        m_Children.Erase(it);
+    }
+
+    if (entry->IsNegative()) ++m_NegativeCount;
     m_Children[entry->Name()] = entry;
 }
 void DirectoryEntry::RemoveChild(::Ref<class DirectoryEntry> entry)
 {
-    ScopedLock guard(m_Lock);
     Assert(entry);
-
-    auto it = m_Children.Find(entry->Name());
+    RemoveChild(entry->Name());
+}
+void DirectoryEntry::RemoveChild(StringView name)
+{
+    ScopedLock guard(m_Lock);
+    auto       it = m_Children.Find(name);
     if (it == m_Children.end()) return;
 
+    if (it->Value->IsNegative() && m_NegativeCount > 0) --m_NegativeCount;
     m_Children.Erase(it);
 }
 
@@ -158,22 +173,39 @@ DirectoryEntry::TraverseDirectories(::Ref<class DirectoryEntry> parent,
         ++index;
     }
 
-    if (m_DirOffset == m_Children.Size()) m_DirOffset = 0;
+    if (m_DirOffset == m_Children.Size() - m_NegativeCount) m_DirOffset = 0;
 
     return {};
 }
 ::Ref<DirectoryEntry> DirectoryEntry::Lookup(const String& name)
 {
-    auto entryIt = m_Children.Find(name);
-    if (entryIt != m_Children.end()) return entryIt->Value;
+    {
+        ScopedLock guard(m_Lock);
+        auto       entryIt = m_Children.Find(name);
+        if (entryIt != m_Children.end())
+        {
+            if (entryIt->Value->IsNegative()) return nullptr;
+            return entryIt->Value;
+        }
+    }
     if (!m_INode) return nullptr;
 
     ::Ref entry = CreateRef<DirectoryEntry>(nullptr, name);
-    TryOrRetVal(m_INode->Lookup(entry), nullptr);
-
     entry->SetParent(this);
-    InsertChild(entry);
 
+    auto result = m_INode->Lookup(entry);
+    if (!result)
+    {
+        // Only missing names are remembered, other failures may be transient
+        auto fs = m_INode->Filesystem();
+        if (result.Error() == ENOENT && fs && fs->CachesLookups()
+            && m_NegativeCount < MAX_NEGATIVE_ENTRIES)
+            InsertChild(entry);
+
+        return nullptr;
+    }
+
+    InsertChild(entry);
     return entry;
 }
 ErrorOr<void> DirectoryEntry::PopulateDirectoryEntries()
@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 31.05.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -82,6 +82,7 @@ class DirectoryEntry : public RefCounted
     void                      Bind(class INode* inode);
     void                      InsertChild(::Ref<class DirectoryEntry> entry);
     void                      RemoveChild(::Ref<class DirectoryEntry> entry);
+    void                      RemoveChild(StringView name);
 
     ::WeakRef<DirectoryEntry> FollowMounts();
     ::WeakRef<DirectoryEntry> FollowSymlinks(usize cnt = 0);
@@ -101,9 +102,17 @@ class DirectoryEntry : public RefCounted
         = Delegate<bool(StringView name, loff_t offset, usize ino, u64 type)>;
     ErrorOr<void> TraverseDirectories(::Ref<class DirectoryEntry> parent,
                                       DirectoryIterator           iterator);
+    /**
+     * @brief Looks up the child called `name`, the names, which the
+     * filesystem doesn't know, are remembered as negative entries, where the
+     * filesystem allows it, so that they fail without asking it again
+     *
+     * @return The child, or nullptr, if there is no such name
+     */
     ::Ref<DirectoryEntry> Lookup(const String& name);
     ErrorOr<void>         PopulateDirectoryEntries();
 
+    inline bool           IsNegative() const { return !m_INode; }
     bool                  IsMountPoint() const;
     bool                  IsDirectory() const;
     bool                  IsRegular() const;
@@ -113,15 +122,19 @@ class DirectoryEntry : public RefCounted
   private:
     friend class INode;
 
+    // Bounds the negative entries, so probing random names can't grow the cache
+    constexpr static usize    MAX_NEGATIVE_ENTRIES = 64;
+
     Spinlock                  m_Lock;
 
-    String                    m_Name      = "";
-    DirectoryEntryFlags       m_Flags     = DirectoryEntryFlags::eNegative;
-    class INode*              m_INode     = nullptr;
-    bool                      m_Populated = false;
-    usize                     m_DirOffset = 0;
+    String                    m_Name          = "";
+    DirectoryEntryFlags       m_Flags         = DirectoryEntryFlags::eNegative;
+    class INode*              m_INode         = nullptr;
+    bool                      m_Populated     = false;
+    usize                     m_DirOffset     = 0;
+    usize                     m_NegativeCount = 0;
 
-    ::WeakRef<DirectoryEntry> m_Parent    = nullptr;
-    ::Ref<DirectoryEntry>     m_MountGate = nullptr;
+    ::WeakRef<DirectoryEntry> m_Parent        = nullptr;
+    ::Ref<DirectoryEntry>     m_MountGate     = nullptr;
     UnorderedMap<StringView, ::Ref<class DirectoryEntry>> m_Children;
 };
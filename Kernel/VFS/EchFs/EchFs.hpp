@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 30.01.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -19,6 +19,9 @@ class EchFs final : public Filesystem
     }
     virtual ~EchFs();
 
+    virtual bool UsesPageCache() const override { return true; }
+    virtual bool CachesLookups() const override { return true; }
+
     virtual ErrorOr<::Ref<DirectoryEntry>>
     Mount(StringView sourcePath, const void* data = nullptr) override;
     bool         Populate(EchFsINode* inode);
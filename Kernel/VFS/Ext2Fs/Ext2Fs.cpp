@@ -1,10 +1,12 @@
 /*
  * Created by v1tr10l7 on 24.03.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
-#include <Prism/Containers/Bitmap.hpp>
+#include <Memory/Allocator/KernelHeap.hpp>
+#include <Prism/Memory/Memory.hpp>
+#include <Prism/Utility/Math.hpp>
 #include <Time/Time.hpp>
 
 #include <VFS/DirectoryEntry.hpp>
@@ -42,10 +44,16 @@ ErrorOr<::Ref<DirectoryEntry>> Ext2Fs::Mount(StringView  sourcePath,
         return nullptr;
     }
 
+    ParseMountOptions(static_cast<const char*>(data));
+
     m_BlockSize    = 1024 << m_SuperBlock->BlockSize;
     m_FragmentSize = 1024 << m_SuperBlock->FragmentSize;
+    // The groups start at the first data block, i.e. the superblock's block
     m_BlockGroupDescriptionCount
-        = m_SuperBlock->BlockCount / m_SuperBlock->BlocksPerGroup;
+        = Math::DivRoundUp(m_SuperBlock->BlockCount
+                               - m_SuperBlock->SuperBlockNumber,
+                           m_SuperBlock->BlocksPerGroup);
+    ReadBlockGroupTable();
 
     m_SuperBlock->LastMountTime = Time::GetReal().tv_sec;
     FlushSuperBlock();
@@ -81,7 +89,7 @@ ErrorOr<::Ref<DirectoryEntry>> Ext2Fs::Mount(StringView  sourcePath,
 ErrorOr<INode*> Ext2Fs::CreateNode(INode* parent, ::Ref<DirectoryEntry> entry,
                                    mode_t mode, uid_t uid, gid_t gid)
 {
-    usize inodeIndex = m_Allocator.AllocateINode();
+    usize inodeIndex = m_Allocator.AllocateINode(parent->Stats().st_ino);
     if (!inodeIndex) return nullptr;
 
     auto inode = new Ext2FsINode(entry->Name(), this, mode);
@@ -90,7 +98,7 @@ ErrorOr<INode*> Ext2Fs::CreateNode(INode* parent, ::Ref<DirectoryEntry> entry,
     inode->Initialize(inodeIndex, mode, Ext2Mode2INodeType(mode));
 
     // TODO(v1tr10l7): Defer allocation of inode blocks
-    AssignINodeBlocks(inode->m_Meta, inodeIndex, 0, 1);
+    AssignINodeBlocks(inode->m_Meta, inodeIndex, 0, 1, inode->m_BlockMap);
     WriteINodeEntry(inode->m_Meta, inodeIndex);
 
     Ext2FsINodeMeta parentMeta{};
@@ -116,7 +124,8 @@ ErrorOr<INode*> Ext2Fs::CreateNode(INode* parent, ::Ref<DirectoryEntry> entry,
         dotDotEntry->Name[0]    = '.';
         dotDotEntry->Name[1]    = '.';
 
-        WriteINode(inode->m_Meta, buffer, inodeIndex, 0, m_BlockSize);
+        WriteINode(inode->m_Meta, buffer, inodeIndex, 0, m_BlockSize,
+                   &inode->m_BlockMap);
 
         usize bgdIndex
             = (inode->m_Metadata.ID - 1) / m_SuperBlock->INodesPerGroup;
@@ -160,7 +169,7 @@ bool Ext2Fs::Populate(DirectoryEntry* dentry)
     Ext2FsINodeMeta parentMeta;
     ReadINodeEntry(&parentMeta, e2node->m_Metadata.ID);
 
-    u8* buffer = new u8[parentMeta.GetSize()];
+    u8* buffer = new (KernelHeap::Uninitialized) u8[parentMeta.GetSize()];
     ReadINode(parentMeta, buffer, 0, parentMeta.GetSize());
 
     for (usize i = 0; i < parentMeta.GetSize();)
@@ -236,205 +245,171 @@ bool Ext2Fs::Populate(DirectoryEntry* dentry)
 
 ErrorOr<void> Ext2Fs::FreeINode(INode* inode)
 {
-    auto id = inode->ID();
-    --id;
-
-    usize blockGroupIndex = id / m_SuperBlock->INodesPerGroup;
-    Ext2FsBlockGroupDescriptor blockGroup;
-    ReadBlockGroupDescriptor(&blockGroup, blockGroupIndex);
-
-    Bitmap bitmap;
-    bitmap.Allocate(m_BlockSize);
-    m_Device->Read(bitmap.Raw(),
-                   blockGroup.INodeUsageBitmapAddress * m_BlockSize,
-                   m_BlockSize);
-
-    bitmap.SetIndex(id % m_SuperBlock->INodesPerGroup, false);
-    m_Device->Write(bitmap.Raw(),
-                    blockGroup.INodeUsageBitmapAddress * m_BlockSize,
-                    m_BlockSize);
+    m_Allocator.FreeINode(inode->ID());
 
-    ++blockGroup.FreeINodeCount;
-    ++m_SuperBlock->FreeINodeCount;
-
-    WriteBlockGroupDescriptor(blockGroup, blockGroupIndex);
-    FlushSuperBlock();
-
-    bitmap.Free();
+    ScopedLock guard(m_INodeCacheLock);
+    m_INodeCache.Erase(inode->ID());
     return {};
 }
+ErrorOr<void> Ext2Fs::Sync(bool force)
+{
+    // Bitmaps and inodes go first, so a crash in between can only leak blocks
+    m_Allocator.Flush();
+    FlushINodeCache(force);
+    FlushBlockGroupTable();
+    if (m_SuperBlockDirty.Load())
+    {
+        m_SuperBlockDirty.Store(false);
+        m_SuperBlock->LastWrittenTime = Time::GetReal().tv_sec;
+        FlushSuperBlock();
+    }
+
+    return m_Device->Sync();
+}
 
 isize Ext2Fs::SetINodeBlock(Ext2FsINodeMeta& meta, u32 inode, u32 iblock,
                             u32 dblock)
 {
-    u32 blockLevel = m_BlockSize / 4;
-    if (iblock < 12)
+    if (iblock < DIRECT_BLOCKS)
     {
         meta.Blocks[iblock] = dblock;
         return dblock;
     }
 
-    iblock -= 12;
-    if (iblock >= blockLevel)
-    {
-        iblock -= blockLevel;
-        u32   singleIndex    = iblock / blockLevel;
-        off_t indirectOffset = iblock % blockLevel;
-        u32   indirectBlock  = 0;
-
-        if (singleIndex >= blockLevel)
-        {
-            iblock -= blockLevel * blockLevel;
-
-            u32 doubleIndirect      = iblock / blockLevel;
-            indirectOffset          = iblock % blockLevel;
-            u32 singleIndirectIndex = 0;
-
-            if (meta.Blocks[14] == 0)
-            {
-                meta.Blocks[14] = AllocateBlock(meta, inode);
-                WriteINodeEntry(meta, inode);
-            }
-
-            m_Device->Read(&singleIndirectIndex,
-                           meta.Blocks[14] * m_BlockSize + doubleIndirect * 4,
-                           sizeof(u32));
-
-            if (singleIndirectIndex == 0)
-            {
-                singleIndirectIndex = AllocateBlock(meta, inode);
-                m_Device->Write(&singleIndirectIndex,
-                                meta.Blocks[14] * m_BlockSize
-                                    + doubleIndirect * 4,
-                                sizeof(u32));
-            }
-
-            m_Device->Read(&indirectBlock,
-                           doubleIndirect * m_BlockSize
-                               + singleIndirectIndex * 4,
-                           sizeof(u32));
-
-            if (indirectBlock == 0)
-            {
-                u32 newBlock = AllocateBlock(meta, inode);
-                m_Device->Write(&indirectBlock,
-                                doubleIndirect * m_BlockSize
-                                    + singleIndirectIndex * 4,
-                                sizeof(u32));
-
-                indirectBlock = newBlock;
-            }
-
-            m_Device->Write(&dblock,
-                            indirectBlock * m_BlockSize * indirectOffset * 4,
-                            sizeof(u32));
-            return dblock;
-        }
-
-        if (meta.Blocks[13] == 0)
-        {
-            meta.Blocks[13] = AllocateBlock(meta, inode);
+    u32 index = iblock - DIRECT_BLOCKS;
+    u64 span  = 0;
+    u32 level = IndirectLevel(index, span);
+    if (level > 2) return 0;
 
-            WriteINodeEntry(meta, inode);
-        }
+    u32& root = meta.Blocks[DIRECT_BLOCKS + level];
+    if (root == 0)
+    {
+        root = AllocateIndirectBlock(meta, inode, dblock);
+        WriteINodeEntry(meta, inode);
+        if (root == 0) return 0;
+    }
 
-        m_Device->Read(&indirectBlock,
-                       meta.Blocks[13] * m_BlockSize + singleIndex * 4,
-                       sizeof(u32));
+    // Missing indirect blocks are allocated zeroed on the way down
+    u32 perBlock = m_BlockSize / 4;
+    u32 block    = root;
+    for (u32 depth = level; depth > 0; --depth)
+    {
+        span              /= perBlock;
+        usize entryOffset  = block * m_BlockSize + (index / span) * 4;
+        index             %= span;
 
-        if (indirectBlock == 0)
+        u32 next           = 0;
+        m_Device->Read(&next, entryOffset, sizeof(u32));
+        if (next == 0)
         {
-            indirectBlock = AllocateBlock(meta, inode);
+            next = AllocateIndirectBlock(meta, inode, dblock);
+            if (next == 0) return 0;
 
-            m_Device->Write(&indirectBlock,
-                            meta.Blocks[13] * m_BlockSize + singleIndex * 4,
-                            sizeof(u32));
+            m_Device->Write(&next, entryOffset, sizeof(u32));
         }
 
-        m_Device->Write(&dblock,
-                        indirectBlock * m_BlockSize + indirectOffset * 4,
-                        sizeof(u32));
-
-        return dblock;
+        block = next;
     }
 
-    if (meta.Blocks[12] == 0)
-    {
-        meta.Blocks[12] = AllocateBlock(meta, inode);
-
-        WriteINodeEntry(meta, inode);
-    }
-    m_Device->Write(&dblock, meta.Blocks[12] * m_BlockSize + iblock * 4,
-                    sizeof(u32));
+    m_Device->Write(&dblock, block * m_BlockSize + index * 4, sizeof(u32));
     return dblock;
 }
 void Ext2Fs::AssignINodeBlocks(Ext2FsINodeMeta& meta, u32 inode, usize start,
-                               usize blocks)
+                               usize blocks, Ext2FsBlockMap& map)
 {
-    for (usize i = 0; i < blocks; i++)
+    // Only holes are looked up, moving forward, so stale extents aren't
+    // revisited
+    bool assigned = false;
+    for (usize i = 0; i < blocks;)
     {
-        if (GetINodeBlock(meta, start + i)) continue;
+        auto  extent = MapBlock(meta, map, start + i);
+        usize run    = Math::Min<usize>(extent.End() - (start + i), blocks - i);
+        if (extent.Physical != 0)
+        {
+            i += run;
+            continue;
+        }
+
+        // Allocate the whole hole right after the preceding block, to keep the
+        // file contiguous
+        u32 goal = 0;
+        if (start + i > 0)
+        {
+            auto previous = MapBlock(meta, map, start + i - 1);
+            if (previous.Physical)
+                goal = previous.Physical + (start + i - 1 - previous.Logical)
+                     + 1;
+        }
+
+        for (usize j = 0; j < run;)
+        {
+            usize count = run - j;
+            u32   first = AllocateBlocks(meta, inode, goal, count);
+            if (!first) break;
+
+            for (usize k = 0; k < count; ++k)
+                SetINodeBlock(meta, inode, start + i + j + k, first + k);
 
-        usize dblock = AllocateBlock(meta, inode);
-        SetINodeBlock(meta, inode, start + i, dblock);
+            assigned  = true;
+            goal      = first + count;
+            j        += count;
+        }
+
+        i += run;
     }
 
+    if (assigned) map.Clear();
     WriteINodeEntry(meta, inode);
 }
 isize Ext2Fs::GrowINode(Ext2FsINodeMeta& meta, u32 inode, usize start,
-                        usize count)
+                        usize count, Ext2FsBlockMap* map)
 {
     usize blockOffset = start / m_BlockSize;
-    usize blockCount  = (count + m_BlockSize - 1) / m_BlockSize;
-    // usize blockOffset = (start & ~(m_BlockSize - 1)) >> (10 + m_BlockSize);
-    // usize blockCount = ((start & (m_BlockSize - 1)) + count + (m_BlockSize -
-    // 1))
-    //                 >> (10 + m_BlockSize);
+    usize blockCount
+        = Math::DivRoundUp(start + count, m_BlockSize) - blockOffset;
 
-    AssignINodeBlocks(meta, inode, blockOffset, blockCount);
+    Ext2FsBlockMap temporary;
+    AssignINodeBlocks(meta, inode, blockOffset, blockCount,
+                      map ? *map : temporary);
     return 0;
 }
 
-usize Ext2Fs::AllocateBlock(Ext2FsINodeMeta& meta, u32 inode)
+u32 Ext2Fs::AllocateBlocks(Ext2FsINodeMeta& meta, u32 inode, u32 goal,
+                           usize& count)
 {
-    usize allocatedBlock = m_Allocator.AllocateBlock(meta, inode);
-    if (!allocatedBlock) return 0;
+    // Without a goal, the blocks go to the inode's group
+    if (!goal)
+        goal = m_SuperBlock->SuperBlockNumber
+             + (inode - 1) / m_SuperBlock->INodesPerGroup
+                   * m_SuperBlock->BlocksPerGroup;
 
-    meta.SectorCount += m_BlockSize / m_Device->Stats().st_blksize;
-    WriteINodeEntry(meta, inode);
+    u32 first = m_Allocator.AllocateBlocks(goal, count);
+    if (!first) return 0;
 
-    --m_SuperBlock->FreeBlockCount;
-    FlushSuperBlock();
+    meta.SectorCount += count * (m_BlockSize / m_Device->Stats().st_blksize);
+    WriteINodeEntry(meta, inode);
 
-    return allocatedBlock;
+    return first;
 }
-void Ext2Fs::FreeBlock(usize block)
+u32 Ext2Fs::AllocateBlock(Ext2FsINodeMeta& meta, u32 inode, u32 goal)
 {
-    usize blockGroupIndex = block / m_SuperBlock->BlocksPerGroup;
-    Ext2FsBlockGroupDescriptor blockGroup;
-    ReadBlockGroupDescriptor(&blockGroup, blockGroupIndex);
-
-    Bitmap bitmap;
-    bitmap.Allocate(m_BlockSize);
-    m_Device->Read(bitmap.Raw(),
-                   blockGroup.BlockUsageBitmapAddress * m_BlockSize,
-                   m_BlockSize);
-    bitmap.SetIndex(block % m_SuperBlock->BlocksPerGroup, false);
-    m_Device->Write(bitmap.Raw(),
-                    blockGroup.BlockUsageBitmapAddress * m_BlockSize,
-                    m_BlockSize);
-
-    ++blockGroup.FreeBlockCount;
-    ++m_SuperBlock->FreeBlockCount;
-
-    WriteBlockGroupDescriptor(blockGroup, blockGroupIndex);
-    FlushSuperBlock();
-
-    bitmap.Free();
+    usize count = 1;
+    return AllocateBlocks(meta, inode, goal, count);
 }
+void Ext2Fs::FreeBlock(usize block) { m_Allocator.FreeBlock(block); }
 
 void Ext2Fs::ReadINodeEntry(Ext2FsINodeMeta* out, u32 index)
 {
+    {
+        ScopedLock guard(m_INodeCacheLock);
+        auto       it = m_INodeCache.Find(index);
+        if (it != m_INodeCache.end())
+        {
+            *out = it->Value.Meta;
+            return;
+        }
+    }
+
     usize tableIndex      = (index - 1) % m_SuperBlock->INodesPerGroup;
     usize blockGroupIndex = (index - 1) / m_SuperBlock->INodesPerGroup;
 
@@ -445,12 +420,28 @@ void Ext2Fs::ReadINodeEntry(Ext2FsINodeMeta* out, u32 index)
                    blockGroup.INodeTableAddress * m_BlockSize
                        + m_SuperBlock->INodeStructureSize * tableIndex,
                    sizeof(Ext2FsINodeMeta));
+
+    // Someone may have cached and modified the entry meanwhile, theirs wins
+    ScopedLock guard(m_INodeCacheLock);
+    auto       it = m_INodeCache.Find(index);
+    if (it != m_INodeCache.end())
+    {
+        *out = it->Value.Meta;
+        return;
+    }
+
+    if (m_INodeCache.Size() >= MAX_CACHED_INODES) ShrinkINodeCache();
+    auto& cached = m_INodeCache[index];
+    cached.Index = index;
+    cached.Meta  = *out;
 }
 isize Ext2Fs::WriteINode(Ext2FsINodeMeta& meta, u8* in, u32 inode, off_t offset,
-                         usize count)
+                         usize count, Ext2FsBlockMap* map)
 {
-    GrowINode(meta, inode, offset, count);
+    Ext2FsBlockMap temporary;
+    if (!map) map = &temporary;
 
+    GrowINode(meta, inode, offset, count, map);
     if (offset + count > meta.GetSize())
     {
         meta.SetSize(offset + count);
@@ -459,16 +450,23 @@ isize Ext2Fs::WriteINode(Ext2FsINodeMeta& meta, u8* in, u32 inode, off_t offset,
 
     for (usize head = 0; head < count;)
     {
-        usize iblock    = (offset + head) / m_BlockSize;
-
-        usize size      = count - head;
-        off_t subOffset = (offset + head) % m_BlockSize;
-
-        if (size > (m_BlockSize - subOffset)) size = m_BlockSize - subOffset;
-
-        usize dblock = GetINodeBlock(meta, iblock);
+        usize position    = offset + head;
+        u32   blockIndex  = position / m_BlockSize;
+        usize blockOffset = position % m_BlockSize;
+        auto  extent      = MapBlock(meta, *map, blockIndex);
+        if (extent.Physical == 0)
+        {
+            // We've ran out of space
+            if (head > 0) return head;
+            return_err(-1, ENOSPC);
+        }
 
-        m_Device->Write(in + head, dblock * m_BlockSize + subOffset, size);
+        usize skipped = blockIndex - extent.Logical;
+        usize run     = (extent.Length - skipped) * m_BlockSize - blockOffset;
+        usize size    = Math::Min(count - head, run);
+        m_Device->Write(in + head,
+                        (extent.Physical + skipped) * m_BlockSize + blockOffset,
+                        size);
         head += size;
     }
 
@@ -477,36 +475,70 @@ isize Ext2Fs::WriteINode(Ext2FsINodeMeta& meta, u8* in, u32 inode, off_t offset,
 
 void Ext2Fs::WriteINodeEntry(Ext2FsINodeMeta& in, u32 index)
 {
-    usize tableIndex      = (index - 1) % m_SuperBlock->INodesPerGroup;
-    usize blockGroupIndex = (index - 1) / m_SuperBlock->INodesPerGroup;
+    CacheINode(in, index, true, false);
+}
+void Ext2Fs::UpdateINodeTimes(Ext2FsINodeMeta& in, u32 index)
+{
+    CacheINode(in, index, true, m_Flags & MS_LAZYTIME);
+}
+ErrorOr<void> Ext2Fs::FlushINodeEntry(u32 index)
+{
+    Ext2FsINodeMeta meta;
+    {
+        ScopedLock guard(m_INodeCacheLock);
+        auto       it = m_INodeCache.Find(index);
+        if (it == m_INodeCache.end() || !it->Value.Dirty) return {};
 
-    Ext2FsBlockGroupDescriptor blockGroup;
-    ReadBlockGroupDescriptor(&blockGroup, blockGroupIndex);
+        meta                = it->Value.Meta;
+        it->Value.Dirty     = false;
+        it->Value.TimesOnly = false;
+    }
 
-    m_Device->Write(&in,
-                    blockGroup.INodeTableAddress * m_BlockSize
-                        + m_SuperBlock->INodeStructureSize * tableIndex,
-                    sizeof(Ext2FsINodeMeta));
+    WriteINodeToDisk(meta, index);
+    return {};
+}
+bool Ext2Fs::NeedsATimeUpdate(const Ext2FsINodeMeta& meta, u32 now) const
+{
+    if (m_Flags & MS_NOATIME) return false;
+    if (!(m_Flags & MS_RELATIME) || m_Flags & MS_STRICTATIME) return true;
+
+    // relatime: update the atime if it's older than mtime or ctime, or a day
+    // old
+    constexpr u32 RELATIME_INTERVAL = 24 * 60 * 60;
+    return meta.AccessTime <= meta.ModifiedTime
+        || meta.AccessTime <= meta.CreationTime
+        || now - meta.AccessTime >= RELATIME_INTERVAL;
 }
 
 isize Ext2Fs::ReadINode(Ext2FsINodeMeta& meta, u8* out, off_t offset,
-                        usize bytes)
+                        usize bytes, Ext2FsBlockMap* map)
 {
     if (static_cast<usize>(offset) > meta.GetSize()) return 0;
     if (static_cast<usize>(offset) + bytes > meta.GetSize())
         bytes = meta.GetSize() - offset;
 
+    Ext2FsBlockMap temporary;
+    if (!map) map = &temporary;
+
     for (usize head = 0; head < bytes;)
     {
-        usize blockIndex = (offset + head) / m_BlockSize;
-
-        usize size       = bytes - head;
-        offset           = (offset + head) % m_BlockSize;
-
-        if (size > (m_BlockSize - offset)) size = m_BlockSize - offset;
-
-        u32 block = GetINodeBlock(meta, blockIndex);
-        m_Device->Read(out + head, block * m_BlockSize + offset, size);
+        usize position    = offset + head;
+        u32   blockIndex  = position / m_BlockSize;
+        usize blockOffset = position % m_BlockSize;
+
+        // Whole extents go out as single requests
+        auto  extent      = MapBlock(meta, *map, blockIndex);
+        usize skipped     = blockIndex - extent.Logical;
+        usize run
+            = (extent.Length - skipped) * m_BlockSize - blockOffset;
+        usize size        = Math::Min(bytes - head, run);
+
+        // Holes read back as zeroes
+        if (extent.Physical == 0) Memory::Fill(out + head, 0, size);
+        else
+            m_Device->Read(
+                out + head,
+                (extent.Physical + skipped) * m_BlockSize + blockOffset, size);
 
         head += size;
     }
@@ -532,75 +564,254 @@ void Ext2Fs::FlushSuperBlock()
 
     m_Device->Write(m_SuperBlock, 1024, sizeof(Ext2FsSuperBlock));
 }
+void Ext2Fs::ParseMountOptions(const char* options)
+{
+    // Access times default to relatime, as on Linux
+    if (!(m_Flags & (MS_NOATIME | MS_STRICTATIME))) m_Flags |= MS_RELATIME;
+
+    constexpr u32 ATIME_FLAGS = MS_NOATIME | MS_RELATIME | MS_STRICTATIME;
+    StringView    remaining   = options ? StringView(options) : ""_sv;
+    while (remaining.Size() > 0)
+    {
+        usize comma = remaining.Find(',');
+        if (comma == StringView::NPos) comma = remaining.Size();
+
+        StringView option = remaining.Substr(0, comma);
+        remaining = comma < remaining.Size() ? remaining.Substr(comma + 1)
+                                             : ""_sv;
+
+        if (option == "noatime"_sv)
+            m_Flags = (m_Flags & ~ATIME_FLAGS) | MS_NOATIME;
+        else if (option == "relatime"_sv)
+            m_Flags = (m_Flags & ~ATIME_FLAGS) | MS_RELATIME;
+        else if (option == "strictatime"_sv)
+            m_Flags = (m_Flags & ~ATIME_FLAGS) | MS_STRICTATIME;
+        else if (option == "lazytime"_sv) m_Flags |= MS_LAZYTIME;
+        else if (option == "nolazytime"_sv) m_Flags &= ~MS_LAZYTIME;
+        else if (option.Size() > 0)
+            LogWarn("Ext2Fs: Ignoring unknown mount option: '{}'", option);
+    }
+
+    m_MountOptions = m_Flags & MS_RDONLY ? "ro" : "rw";
+    if (m_Flags & MS_NOATIME) m_MountOptions += ",noatime";
+    else if (m_Flags & MS_RELATIME) m_MountOptions += ",relatime";
+    if (m_Flags & MS_LAZYTIME) m_MountOptions += ",lazytime";
+}
+
+void Ext2Fs::ReadBlockGroupTable()
+{
+    off_t offset  = m_BlockSize >= 2048 ? m_BlockSize : m_BlockSize * 2;
+    usize count   = m_BlockGroupDescriptionCount;
+
+    m_BlockGroups = new Ext2FsBlockGroupDescriptor[count];
+    m_Device->Read(m_BlockGroups, offset,
+                   sizeof(Ext2FsBlockGroupDescriptor) * count);
+}
+void Ext2Fs::FlushBlockGroupTable()
+{
+    off_t offset = m_BlockSize >= 2048 ? m_BlockSize : m_BlockSize * 2;
+    usize count  = m_BlockGroupDescriptionCount;
+
+    // The table is small, so it's written whole, from a snapshot
+    auto  table  = new Ext2FsBlockGroupDescriptor[count];
+    {
+        ScopedLock guard(m_BlockGroupLock);
+        if (!m_BlockGroupsDirty)
+        {
+            delete[] table;
+            return;
+        }
+
+        Memory::Copy(table, m_BlockGroups,
+                     sizeof(Ext2FsBlockGroupDescriptor) * count);
+        m_BlockGroupsDirty = false;
+    }
+
+    m_Device->Write(table, offset, sizeof(Ext2FsBlockGroupDescriptor) * count);
+    delete[] table;
+}
 void Ext2Fs::ReadBlockGroupDescriptor(Ext2FsBlockGroupDescriptor* out,
                                       usize                       index)
 {
-    off_t offset = m_BlockSize >= 2048 ? m_BlockSize : m_BlockSize * 2;
+    // Past the last group, nothing is free
+    if (index >= m_BlockGroupDescriptionCount)
+    {
+        Memory::Fill(out, 0, sizeof(Ext2FsBlockGroupDescriptor));
+        return;
+    }
 
-    m_Device->Read(out, offset + sizeof(Ext2FsBlockGroupDescriptor) * index,
-                   sizeof(Ext2FsBlockGroupDescriptor));
+    ScopedLock guard(m_BlockGroupLock);
+    *out = m_BlockGroups[index];
 }
 void Ext2Fs::WriteBlockGroupDescriptor(Ext2FsBlockGroupDescriptor& in,
                                        usize                       index)
 {
-    off_t offset = m_BlockSize >= 2048 ? m_BlockSize : m_BlockSize * 2;
+    if (index >= m_BlockGroupDescriptionCount) return;
 
-    m_Device->Write(&in, offset + sizeof(Ext2FsBlockGroupDescriptor) * index,
-                    sizeof(Ext2FsBlockGroupDescriptor));
+    ScopedLock guard(m_BlockGroupLock);
+    m_BlockGroups[index] = in;
+    m_BlockGroupsDirty   = true;
 }
 
-u32 Ext2Fs::GetINodeBlock(Ext2FsINodeMeta& meta, u32 blockIndex)
+void Ext2Fs::WriteINodeToDisk(const Ext2FsINodeMeta& in, u32 index)
 {
-    u32 block      = 0;
-    u32 blockLevel = m_BlockSize / 4;
+    usize tableIndex      = (index - 1) % m_SuperBlock->INodesPerGroup;
+    usize blockGroupIndex = (index - 1) / m_SuperBlock->INodesPerGroup;
 
-    if (blockIndex < 12)
+    Ext2FsBlockGroupDescriptor blockGroup;
+    ReadBlockGroupDescriptor(&blockGroup, blockGroupIndex);
+
+    m_Device->Write(&in,
+                    blockGroup.INodeTableAddress * m_BlockSize
+                        + m_SuperBlock->INodeStructureSize * tableIndex,
+                    sizeof(Ext2FsINodeMeta));
+}
+void Ext2Fs::CacheINode(const Ext2FsINodeMeta& meta, u32 index, bool dirty,
+                        bool timesOnly)
+{
+    ScopedLock guard(m_INodeCacheLock);
+    auto       it = m_INodeCache.Find(index);
+    if (it == m_INodeCache.end() && m_INodeCache.Size() >= MAX_CACHED_INODES)
+        ShrinkINodeCache();
+
+    auto& cached = m_INodeCache[index];
+    cached.Index = index;
+    cached.Meta  = meta;
+    if (!dirty) return;
+
+    // An entry, which is already dirty, doesn't become lazy
+    if (!cached.Dirty)
     {
-        block = meta.Blocks[blockIndex];
-        return block;
+        cached.TimesOnly = timesOnly;
+        cached.DirtiedAt = Time::GetReal().tv_sec;
     }
+    else if (!timesOnly) cached.TimesOnly = false;
 
-    blockIndex -= 12;
-
-    if (blockIndex >= blockLevel)
+    cached.Dirty = true;
+}
+void Ext2Fs::ShrinkINodeCache()
+{
+    // Only clean entries can be dropped
+    Vector<u32> victims;
+    for (const auto& [index, cached] : m_INodeCache)
     {
-        blockIndex -= blockLevel;
+        if (cached.Dirty) continue;
 
-        u32 singleIndex    = blockIndex / blockLevel;
-        i64 indirectOffset = blockIndex % blockLevel;
-        u32 indirectBlock  = 0;
+        victims.PushBack(index);
+        if (victims.Size() >= MAX_CACHED_INODES / 4) break;
+    }
 
-        if (singleIndex >= blockLevel)
+    for (auto index : victims) m_INodeCache.Erase(index);
+}
+void Ext2Fs::FlushINodeCache(bool force)
+{
+    u32                 now = Time::GetReal().tv_sec;
+    Vector<CachedINode> dirty;
+    {
+        ScopedLock guard(m_INodeCacheLock);
+        for (auto& [index, cached] : m_INodeCache)
         {
-            blockIndex -= blockLevel * blockLevel;
+            if (!cached.Dirty) continue;
+            if (!force && cached.TimesOnly
+                && now - cached.DirtiedAt < LAZYTIME_EXPIRE)
+                continue;
+
+            dirty.PushBack(cached);
+            cached.Dirty     = false;
+            cached.TimesOnly = false;
+        }
+    }
 
-            u32 doubleIndirect      = blockIndex / blockLevel;
-            indirectOffset          = blockIndex % blockLevel;
-            u32 singleIndirectIndex = 0;
-            m_Device->Read(&singleIndirectIndex,
-                           meta.Blocks[14] * m_BlockSize + doubleIndirect * 4,
-                           sizeof(u32));
-            m_Device->Read(&indirectBlock,
-                           doubleIndirect * m_BlockSize
-                               + singleIndirectIndex * 4,
-                           sizeof(u32));
-            m_Device->Read(&block,
-                           indirectBlock * m_BlockSize + indirectOffset * 4,
-                           sizeof(u32));
+    for (const auto& cached : dirty)
+        WriteINodeToDisk(cached.Meta, cached.Index);
+}
 
-            return block;
-        }
+u32 Ext2Fs::GetINodeBlock(Ext2FsINodeMeta& meta, u32 blockIndex)
+{
+    if (blockIndex < DIRECT_BLOCKS) return meta.Blocks[blockIndex];
+
+    u32 entry    = 0;
+    u32 indirect = FindIndirectBlock(meta, blockIndex, entry);
+    if (indirect == 0) return 0;
 
-        m_Device->Read(&indirectBlock,
-                       meta.Blocks[13] * m_BlockSize + singleIndex * 4,
-                       sizeof(u32));
-        m_Device->Read(&block, indirectBlock * m_BlockSize + indirectOffset * 4,
-                       sizeof(u32));
+    u32 block = 0;
+    m_Device->Read(&block, indirect * m_BlockSize + entry * 4, sizeof(u32));
+    return block;
+}
+u32 Ext2Fs::IndirectLevel(u32& index, u64& span) const
+{
+    u32 perBlock = m_BlockSize / 4;
+    u32 level    = 0;
+    for (span = perBlock; index >= span && level < 3; ++level)
+    {
+        index -= span;
+        span  *= perBlock;
+    }
 
-        return block;
+    return level;
+}
+u32 Ext2Fs::FindIndirectBlock(Ext2FsINodeMeta& meta, u32 blockIndex,
+                              u32& entry)
+{
+    u32 index = blockIndex - DIRECT_BLOCKS;
+    u64 span  = 0;
+    u32 level = IndirectLevel(index, span);
+    if (level > 2) return 0;
+
+    // Reduce the index even past a missing indirect block, so the entry marks
+    // where the hole begins
+    u32 perBlock = m_BlockSize / 4;
+    u32 block    = meta.Blocks[DIRECT_BLOCKS + level];
+    for (u32 depth = level; depth > 0; --depth)
+    {
+        span      /= perBlock;
+        u32 next   = 0;
+        if (block != 0)
+            m_Device->Read(&next, block * m_BlockSize + (index / span) * 4,
+                           sizeof(u32));
+
+        index %= span;
+        block  = next;
     }
 
-    m_Device->Read(&block, meta.Blocks[12] * m_BlockSize + blockIndex * 4,
-                   sizeof(u32));
+    entry = index;
     return block;
 }
+u32 Ext2Fs::AllocateIndirectBlock(Ext2FsINodeMeta& meta, u32 inode, u32 goal)
+{
+    u32 block = AllocateBlock(meta, inode, goal);
+    if (block == 0) return 0;
+
+    u8* zeroes = new u8[m_BlockSize];
+    Memory::Fill(zeroes, 0, m_BlockSize);
+    m_Device->Write(zeroes, block * m_BlockSize, m_BlockSize);
+
+    delete[] zeroes;
+    return block;
+}
+Ext2FsBlockMap::Extent Ext2Fs::MapBlock(Ext2FsINodeMeta& meta,
+                                        Ext2FsBlockMap&  map, u32 blockIndex)
+{
+    Ext2FsBlockMap::Extent extent;
+    if (map.Find(blockIndex, extent)) return extent;
+
+    // On a miss, cache the mappings of the whole indirect block
+    if (blockIndex < DIRECT_BLOCKS) map.Insert(0, meta.Blocks, DIRECT_BLOCKS);
+    else
+    {
+        u32  entry    = 0;
+        u32  indirect = FindIndirectBlock(meta, blockIndex, entry);
+        u32  perBlock = m_BlockSize / 4;
+        u32* blocks   = new u32[perBlock];
+        if (indirect)
+            m_Device->Read(blocks, indirect * m_BlockSize, m_BlockSize);
+        else Memory::Fill(blocks, 0, m_BlockSize);
+
+        // Past the triply indirect blocks, nothing can be mapped
+        if (entry < perBlock) map.Insert(blockIndex - entry, blocks, perBlock);
+        delete[] blocks;
+    }
+
+    if (map.Find(blockIndex, extent)) return extent;
+    return {blockIndex, GetINodeBlock(meta, blockIndex), 1};
+}
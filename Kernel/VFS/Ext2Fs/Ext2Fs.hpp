@@ -1,12 +1,16 @@
 /*
  * Created by v1tr10l7 on 24.03.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
 #pragma once
 
+#include <API/Posix/sys/mount.h>
+#include <Prism/Containers/UnorderedMap.hpp>
+
 #include <VFS/Ext2Fs/Ext2FsAllocator.hpp>
+#include <VFS/Ext2Fs/Ext2FsBlockMap.hpp>
 #include <VFS/Ext2Fs/Ext2FsStructures.hpp>
 
 #include <VFS/Filesystem.hpp>
@@ -20,7 +24,18 @@ class Ext2Fs : public Filesystem
         : Filesystem("Ext2Fs", flags)
     {
     }
-    virtual ~Ext2Fs() = default;
+    virtual ~Ext2Fs() { delete[] m_BlockGroups; }
+
+    virtual StringView MountFlagsString() const override
+    {
+        return m_MountOptions;
+    }
+    virtual bool UsesPageCache() const override { return true; }
+    virtual bool CachesLookups() const override { return true; }
+    virtual bool ShouldUpdateATime() override
+    {
+        return !(m_Flags & MS_NOATIME);
+    }
 
     virtual ErrorOr<::Ref<DirectoryEntry>>
     Mount(StringView sourcePath, const void* data = nullptr) override;
@@ -32,38 +47,118 @@ class Ext2Fs : public Filesystem
     inline usize             GetBlockSize() const { return m_BlockSize; }
 
     ErrorOr<void>            FreeINode(INode* inode) override;
+    virtual ErrorOr<void>    Sync(bool force = false) override;
 
     isize SetINodeBlock(Ext2FsINodeMeta& meta, u32 inode, u32 iblock,
                         u32 dblock);
     void  AssignINodeBlocks(Ext2FsINodeMeta& meta, u32 inode, usize start,
-                            usize blocks);
-    isize GrowINode(Ext2FsINodeMeta& meta, u32 inode, usize start, usize count);
+                            usize blocks, Ext2FsBlockMap& map);
+    isize GrowINode(Ext2FsINodeMeta& meta, u32 inode, usize start, usize count,
+                    Ext2FsBlockMap* map = nullptr);
 
-    usize AllocateBlock(Ext2FsINodeMeta& meta, u32 inode);
+    /**
+     * @brief Allocates a run of up to `count` contiguous blocks for the inode,
+     * as close to the `goal` as possible, or within the inode's group, if
+     * there isn't any, `count` becomes the length of the run
+     */
+    u32   AllocateBlocks(Ext2FsINodeMeta& meta, u32 inode, u32 goal,
+                         usize& count);
+    u32   AllocateBlock(Ext2FsINodeMeta& meta, u32 inode, u32 goal = 0);
     void  FreeBlock(usize block);
 
+    /**
+     * @brief The inode entries are served from, and written to the inode
+     * cache, the dirty ones are written back by Sync, or FlushINodeEntry
+     */
     void  ReadINodeEntry(Ext2FsINodeMeta* out, u32 index);
     void  WriteINodeEntry(Ext2FsINodeMeta& in, u32 index);
-    isize ReadINode(Ext2FsINodeMeta& meta, u8* out, off_t offset, usize bytes);
+    /**
+     * @brief Writes the entry, of which only the timestamps have changed, with
+     * lazytime those are kept in memory, until something else changes, an
+     * explicit flush, or until they expire
+     */
+    void  UpdateINodeTimes(Ext2FsINodeMeta& in, u32 index);
+    ErrorOr<void> FlushINodeEntry(u32 index);
+    /**
+     * @brief Whether reading the inode should update its access time, as
+     * requested by the noatime, relatime and strictatime mount options
+     */
+    bool          NeedsATimeUpdate(const Ext2FsINodeMeta& meta, u32 now) const;
+    /**
+     * @brief Transfers the inode's data, the runs of blocks, which are
+     * contiguous on the disk, are transferred at once, the inode's block
+     * `map` is used, and filled, if it's given, otherwise a temporary one is
+     */
+    isize ReadINode(Ext2FsINodeMeta& meta, u8* out, off_t offset, usize bytes,
+                    Ext2FsBlockMap* map = nullptr);
     isize WriteINode(Ext2FsINodeMeta& meta, u8* in, u32 inode, off_t offset,
-                     usize count);
+                     usize count, Ext2FsBlockMap* map = nullptr);
 
   private:
-    INode*            m_Device                     = nullptr;
+    // 12 direct blocks, followed by singly, doubly, and triply indirect ones
+    constexpr static usize DIRECT_BLOCKS           = 12;
+    // Once full, a quarter of the clean entries is dropped
+    constexpr static usize MAX_CACHED_INODES       = 8192;
+    // Lazy timestamps are written back at the latest after a day
+    constexpr static u32   LAZYTIME_EXPIRE         = 24 * 60 * 60;
+
+    struct CachedINode
+    {
+        u32             Index     = 0;
+        Ext2FsINodeMeta Meta;
+        bool            Dirty     = false;
+        // Only the timestamps have changed since the entry got clean
+        bool            TimesOnly = false;
+        u32             DirtiedAt = 0;
+    };
+
+    INode*                         m_Device                     = nullptr;
     // u64               m_DeviceID;
 
-    Ext2FsSuperBlock* m_SuperBlock                 = nullptr;
-    usize             m_BlockSize                  = 0;
-    usize             m_FragmentSize               = 0;
-    usize             m_BlockGroupDescriptionCount = 0;
+    Ext2FsSuperBlock*              m_SuperBlock                 = nullptr;
+    Atomic<bool>                   m_SuperBlockDirty            = false;
+    usize                          m_BlockSize                  = 0;
+    usize                          m_FragmentSize               = 0;
+    usize                          m_BlockGroupDescriptionCount = 0;
+
+    // The whole descriptor table is kept in memory, and written back by Sync
+    Spinlock                       m_BlockGroupLock;
+    Ext2FsBlockGroupDescriptor*    m_BlockGroups                = nullptr;
+    bool                           m_BlockGroupsDirty           = false;
+
+    Spinlock                       m_INodeCacheLock;
+    UnorderedMap<u32, CachedINode> m_INodeCache;
+
+    String                         m_MountOptions;
     friend class Ext2FsAllocator;
     Ext2FsAllocator m_Allocator;
 
     ScopedLock&&    LockSuperBlock();
     void            ReadSuperBlock();
     void            FlushSuperBlock();
+    void            MarkSuperBlockDirty() { m_SuperBlockDirty.Store(true); }
+    void            ParseMountOptions(const char* options);
+
+    void            ReadBlockGroupTable();
+    void            FlushBlockGroupTable();
+
+    void            WriteINodeToDisk(const Ext2FsINodeMeta& in, u32 index);
+    void            CacheINode(const Ext2FsINodeMeta& meta, u32 index,
+                               bool dirty, bool timesOnly);
+    void            ShrinkINodeCache();
+    void            FlushINodeCache(bool force);
 
     void ReadBlockGroupDescriptor(Ext2FsBlockGroupDescriptor* out, usize index);
     void WriteBlockGroupDescriptor(Ext2FsBlockGroupDescriptor& in, usize index);
     u32  GetINodeBlock(Ext2FsINodeMeta& meta, u32 blockIndex);
+    // Depth of the indirection, which maps the `index`-th block past the
+    // direct ones, `index` becomes the index within the tree of that depth,
+    // which maps `span` blocks
+    u32  IndirectLevel(u32& index, u64& span) const;
+    // Indirect block, which holds the mapping of `blockIndex`, at `entry`, 0,
+    // if the block isn't mapped
+    u32  FindIndirectBlock(Ext2FsINodeMeta& meta, u32 blockIndex, u32& entry);
+    u32  AllocateIndirectBlock(Ext2FsINodeMeta& meta, u32 inode, u32 goal);
+    Ext2FsBlockMap::Extent MapBlock(Ext2FsINodeMeta& meta, Ext2FsBlockMap& map,
+                                    u32 blockIndex);
 };
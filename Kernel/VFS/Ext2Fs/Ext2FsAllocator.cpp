@@ -1,14 +1,61 @@
 /*
  * Created by v1tr10l7 on 21.06.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
-#include <Prism/Containers/Bitmap.hpp>
+#include <Prism/Memory/Memory.hpp>
+#include <Prism/Utility/Math.hpp>
 
 #include <VFS/Ext2Fs/Ext2Fs.hpp>
 #include <VFS/Ext2Fs/Ext2FsAllocator.hpp>
 
+namespace
+{
+    constexpr usize NOT_FOUND = usize(-1);
+
+    inline bool     TestBit(const u64* bitmap, usize bit)
+    {
+        return bitmap[bit / 64] & (1ull << (bit % 64));
+    }
+    inline void SetBit(u64* bitmap, usize bit, bool value)
+    {
+        if (value) bitmap[bit / 64] |= 1ull << (bit % 64);
+        else bitmap[bit / 64] &= ~(1ull << (bit % 64));
+    }
+
+    // First clear bit within [from, limit), the full words are skipped
+    // without looking at their bits
+    usize FindClearBit(const u64* bitmap, usize from, usize limit)
+    {
+        for (usize bit = from; bit < limit;)
+        {
+            usize word = bit / 64;
+            u64   free = ~bitmap[word] & (~0ull << (bit % 64));
+            if (free)
+            {
+                usize found = word * 64 + __builtin_ctzll(free);
+                return found < limit ? found : NOT_FOUND;
+            }
+
+            bit = (word + 1) * 64;
+        }
+
+        return NOT_FOUND;
+    }
+}; // namespace
+
+Ext2FsAllocator::~Ext2FsAllocator()
+{
+    for (usize i = 0; m_Groups && i < m_BlockGroupCount; ++i)
+    {
+        delete[] m_Groups[i].BlockBitmap;
+        delete[] m_Groups[i].INodeBitmap;
+    }
+
+    delete[] m_Groups;
+}
+
 void Ext2FsAllocator::Initialize(Ext2Fs* fs)
 {
     m_Filesystem      = fs;
@@ -17,132 +64,214 @@ void Ext2FsAllocator::Initialize(Ext2Fs* fs)
     auto superBlock   = m_Filesystem->GetSuperBlock();
     m_BlockSize       = m_Filesystem->GetBlockSize();
     m_BlockCount      = superBlock->BlockCount;
-    m_BlockGroupCount = m_BlockCount / superBlock->BlocksPerGroup;
     m_BlocksPerGroup  = superBlock->BlocksPerGroup;
+    m_INodesPerGroup  = superBlock->INodesPerGroup;
+    m_FirstDataBlock  = superBlock->SuperBlockNumber;
+    m_BlockGroupCount = fs->m_BlockGroupDescriptionCount;
+
+    m_Groups          = new BlockGroup[m_BlockGroupCount];
 }
 
-usize Ext2FsAllocator::AllocateINode()
+usize Ext2FsAllocator::AllocateINode(u32 parent)
 {
     auto  superBlock = m_Filesystem->GetSuperBlock();
-    usize blockCount = superBlock->BlockCount;
+    usize goal       = parent ? (parent - 1) / m_INodesPerGroup : 0;
+    if (goal >= m_BlockGroupCount) goal = 0;
 
-    for (usize i = 0; i < blockCount; i++)
+    for (usize i = 0; i < m_BlockGroupCount; i++)
     {
+        usize                      group = (goal + i) % m_BlockGroupCount;
         Ext2FsBlockGroupDescriptor blockGroup{};
-        m_Filesystem->ReadBlockGroupDescriptor(&blockGroup, i);
+        m_Filesystem->ReadBlockGroupDescriptor(&blockGroup, group);
+        if (blockGroup.FreeINodeCount == 0) continue;
+
+        u64* bitmap = LoadBitmap(group, true);
+        if (!bitmap) return 0;
+
+        // The inodes below the first non reserved one are never handed out
+        usize first = group == 0 ? superBlock->FirstNonReservedINode - 1 : 0;
 
-        if (blockGroup.FreeBlockCount <= 0) continue;
-        usize inode = AllocateINodeInGroup(i, blockGroup);
-        if (!inode) continue;
+        ScopedLock guard(m_Lock);
+        usize      bit = FindClearBit(bitmap, first, m_INodesPerGroup);
+        if (bit == NOT_FOUND) continue;
 
-        // TODO(v1tr10l7): Superblock Locking
+        SetBit(bitmap, bit, true);
+        m_Groups[group].INodeBitmapDirty = true;
+
+        m_Filesystem->ReadBlockGroupDescriptor(&blockGroup, group);
         --blockGroup.FreeINodeCount;
         --superBlock->FreeINodeCount;
-        m_Filesystem->WriteBlockGroupDescriptor(blockGroup, i);
-        m_Device->Write(superBlock, 1024, sizeof(Ext2FsSuperBlock));
+        m_Filesystem->WriteBlockGroupDescriptor(blockGroup, group);
+        m_Filesystem->MarkSuperBlockDirty();
 
-        return inode;
+        return group * m_INodesPerGroup + bit + 1;
     }
 
     return 0;
 }
-usize Ext2FsAllocator::AllocateBlock(Ext2FsINodeMeta& meta, u32 inode)
+void Ext2FsAllocator::FreeINode(u32 inode)
 {
-    auto blockGroupIndex = LocateFreeGroup();
-    if (blockGroupIndex == 0) return 0;
-
-    Ext2FsBlockGroupDescriptor blockGroup{};
-    m_Filesystem->ReadBlockGroupDescriptor(&blockGroup, blockGroupIndex);
-    Bitmap blockBitmap;
-    blockBitmap.Allocate(m_BlockSize * 8);
-    std::memset(blockBitmap.Raw(), 0xff, m_BlockSize);
+    usize group = (inode - 1) / m_INodesPerGroup;
+    if (inode == 0 || group >= m_BlockGroupCount) return;
 
-    m_Device->Read(blockBitmap.Raw(),
-                   blockGroup.BlockUsageBitmapAddress * m_BlockSize,
-                   m_BlockSize);
+    u64* bitmap = LoadBitmap(group, true);
+    if (!bitmap) return;
 
-    usize foundBlock = 0;
+    ScopedLock guard(m_Lock);
+    usize      bit = (inode - 1) % m_INodesPerGroup;
+    if (!TestBit(bitmap, bit)) return;
 
-    for (usize block = 0; block < m_BlockSize * 8; block++)
-    {
-        if (!blockBitmap.GetIndex(block))
-        {
-            blockBitmap.SetIndex(block, true);
-            foundBlock = blockGroupIndex * m_BlocksPerGroup + block;
-            break;
-        }
-    }
-    if (!foundBlock)
-    {
-        // FIXME(v1tr10l7): Corrupted filesystem?
-        // what should we do?
-        blockGroup.FreeBlockCount = 0;
-        goto exit;
-    }
+    SetBit(bitmap, bit, false);
+    m_Groups[group].INodeBitmapDirty = true;
 
-    m_Device->Write(blockBitmap.Raw(),
-                    blockGroup.BlockUsageBitmapAddress * m_BlockSize,
-                    m_BlockSize);
-    m_Device->Read(blockBitmap.Raw(),
-                   blockGroup.BlockUsageBitmapAddress * m_BlockSize,
-                   m_BlockSize);
-    --blockGroup.FreeBlockCount;
-
-exit:
-    m_Filesystem->WriteBlockGroupDescriptor(blockGroup, blockGroupIndex);
-    PMM::FreePages(Pointer(blockBitmap.Raw()).FromHigherHalf(), 1);
-    return foundBlock;
+    auto                       superBlock = m_Filesystem->GetSuperBlock();
+    Ext2FsBlockGroupDescriptor blockGroup{};
+    m_Filesystem->ReadBlockGroupDescriptor(&blockGroup, group);
+    ++blockGroup.FreeINodeCount;
+    ++superBlock->FreeINodeCount;
+    m_Filesystem->WriteBlockGroupDescriptor(blockGroup, group);
+    m_Filesystem->MarkSuperBlockDirty();
 }
 
-usize Ext2FsAllocator::LocateFreeGroup(usize blockCount)
+u32 Ext2FsAllocator::AllocateBlocks(u32 goal, usize& count)
 {
-    for (usize groupIndex = 1; groupIndex < m_BlockGroupCount; ++groupIndex)
+    if (goal < m_FirstDataBlock || goal >= m_BlockCount)
+        goal = m_FirstDataBlock;
+
+    auto  superBlock = m_Filesystem->GetSuperBlock();
+    usize goalGroup  = (goal - m_FirstDataBlock) / m_BlocksPerGroup;
+
+    // Search the goal group from the goal onwards, then from its start, then
+    // the other groups, to keep files contiguous
+    for (usize i = 0; i <= m_BlockGroupCount; i++)
     {
+        usize group = (goalGroup + i) % m_BlockGroupCount;
+        usize from  = i == 0 ? (goal - m_FirstDataBlock) % m_BlocksPerGroup : 0;
+
         Ext2FsBlockGroupDescriptor blockGroup{};
-        m_Filesystem->ReadBlockGroupDescriptor(&blockGroup, groupIndex);
+        m_Filesystem->ReadBlockGroupDescriptor(&blockGroup, group);
+        if (blockGroup.FreeBlockCount == 0) continue;
+
+        u64* bitmap = LoadBitmap(group, false);
+        if (!bitmap) return 0;
+
+        ScopedLock guard(m_Lock);
+        usize      limit = BlocksInGroup(group);
+        usize      bit   = FindClearBit(bitmap, from, limit);
+        if (bit == NOT_FOUND) continue;
+
+        usize length = 1;
+        while (length < count && bit + length < limit
+               && !TestBit(bitmap, bit + length))
+            ++length;
 
-        if (blockGroup.FreeBlockCount > 0) return groupIndex;
+        for (usize j = 0; j < length; ++j) SetBit(bitmap, bit + j, true);
+        m_Groups[group].BlockBitmapDirty = true;
+
+        m_Filesystem->ReadBlockGroupDescriptor(&blockGroup, group);
+        blockGroup.FreeBlockCount -= length;
+        superBlock->FreeBlockCount -= length;
+        m_Filesystem->WriteBlockGroupDescriptor(blockGroup, group);
+        m_Filesystem->MarkSuperBlockDirty();
+
+        count = length;
+        return m_FirstDataBlock + group * m_BlocksPerGroup + bit;
     }
 
+    count = 0;
     return 0;
 }
-usize Ext2FsAllocator::AllocateINodeInGroup(
-    usize blockGroupIndex, Ext2FsBlockGroupDescriptor& blockGroup)
+void Ext2FsAllocator::FreeBlock(u32 block)
 {
-    Bitmap bitmap;
+    if (block < m_FirstDataBlock || block >= m_BlockCount) return;
+
+    usize group  = (block - m_FirstDataBlock) / m_BlocksPerGroup;
+    u64*  bitmap = LoadBitmap(group, false);
+    if (!bitmap) return;
+
+    ScopedLock guard(m_Lock);
+    usize      bit = (block - m_FirstDataBlock) % m_BlocksPerGroup;
+    if (!TestBit(bitmap, bit)) return;
 
-    auto   superBlock = m_Filesystem->GetSuperBlock();
-    usize  blockSize  = m_Filesystem->GetBlockSize();
-    bitmap.Allocate(superBlock->BlockCount);
-    m_Device->Read(bitmap.Raw(), blockGroup.INodeUsageBitmapAddress * blockSize,
-                   blockSize);
+    SetBit(bitmap, bit, false);
+    m_Groups[group].BlockBitmapDirty = true;
 
-    usize inode = 0;
-    for (usize blockIndex = 0; blockIndex < blockSize; blockIndex++)
+    auto                       superBlock = m_Filesystem->GetSuperBlock();
+    Ext2FsBlockGroupDescriptor blockGroup{};
+    m_Filesystem->ReadBlockGroupDescriptor(&blockGroup, group);
+    ++blockGroup.FreeBlockCount;
+    ++superBlock->FreeBlockCount;
+    m_Filesystem->WriteBlockGroupDescriptor(blockGroup, group);
+    m_Filesystem->MarkSuperBlockDirty();
+}
+
+void Ext2FsAllocator::Flush()
+{
+    u8* snapshot = new u8[m_BlockSize];
+    for (usize group = 0; group < m_BlockGroupCount; ++group)
     {
-        if (bitmap.Raw()[blockIndex] == 0xff) continue;
+        Ext2FsBlockGroupDescriptor blockGroup{};
+        m_Filesystem->ReadBlockGroupDescriptor(&blockGroup, group);
 
-        for (usize bit = 0; bit < 8; bit++)
+        for (usize pass = 0; pass < 2; ++pass)
         {
-            if (!bitmap.GetIndex(bit + (blockIndex * 8)))
+            bool inodes = pass == 1;
+
+            // Written from a copy, so allocations can go on meanwhile
             {
-                inode = (blockGroupIndex * superBlock->INodesPerGroup)
-                      + blockIndex * 8 + bit + 1;
-                if ((inode > superBlock->FirstNonReservedINode && inode > 11))
-                {
-                    bitmap.SetIndex(bit + (blockIndex * 8), true);
-                    break;
-                }
+                ScopedLock guard(m_Lock);
+                auto&      state  = m_Groups[group];
+                bool&      dirty  = inodes ? state.INodeBitmapDirty
+                                           : state.BlockBitmapDirty;
+                u64*       bitmap
+                    = inodes ? state.INodeBitmap : state.BlockBitmap;
+                if (!dirty) continue;
+
+                Memory::Copy(snapshot, bitmap, m_BlockSize);
+                dirty = false;
             }
+
+            usize address = inodes ? blockGroup.INodeUsageBitmapAddress
+                                   : blockGroup.BlockUsageBitmapAddress;
+            m_Device->Write(snapshot, address * m_BlockSize, m_BlockSize);
         }
+    }
+
+    delete[] snapshot;
+}
 
-        if (inode) break;
+usize Ext2FsAllocator::BlocksInGroup(usize group) const
+{
+    usize first = m_FirstDataBlock + group * m_BlocksPerGroup;
+    return Math::Min(m_BlocksPerGroup, m_BlockCount - first);
+}
+u64* Ext2FsAllocator::LoadBitmap(usize group, bool inodes)
+{
+    auto& state = m_Groups[group];
+    {
+        ScopedLock guard(m_Lock);
+        u64*       bitmap = inodes ? state.INodeBitmap : state.BlockBitmap;
+        if (bitmap) return bitmap;
     }
 
-    if (inode)
-        m_Device->Write(bitmap.Raw(),
-                        blockGroup.INodeUsageBitmapAddress * blockSize,
-                        blockSize);
+    Ext2FsBlockGroupDescriptor blockGroup{};
+    m_Filesystem->ReadBlockGroupDescriptor(&blockGroup, group);
+    usize address = inodes ? blockGroup.INodeUsageBitmapAddress
+                           : blockGroup.BlockUsageBitmapAddress;
+
+    u64*  bitmap  = new u64[m_BlockSize / sizeof(u64)];
+    if (!bitmap) return nullptr;
+    m_Device->Read(bitmap, address * m_BlockSize, m_BlockSize);
+
+    // Read unlocked, so someone may have loaded, and modified it meanwhile
+    ScopedLock guard(m_Lock);
+    u64*&      cached = inodes ? state.INodeBitmap : state.BlockBitmap;
+    if (cached)
+    {
+        delete[] bitmap;
+        return cached;
+    }
 
-    return inode;
+    cached = bitmap;
+    return bitmap;
 }
@@ -1,24 +1,59 @@
 /*
  * Created by v1tr10l7 on 21.06.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
 #pragma once
 
+#include <Library/Locking/Spinlock.hpp>
 #include <VFS/Ext2Fs/Ext2FsStructures.hpp>
 
 class Ext2Fs;
+/**
+ * @brief Allocates the inodes and blocks, the usage bitmaps of the groups are
+ * read once, searched a word at a time, and only written back by Flush, the
+ * same goes for the counters in the group descriptors and the superblock
+ */
 class Ext2FsAllocator
 {
   public:
     Ext2FsAllocator() = default;
+    ~Ext2FsAllocator();
+
     void  Initialize(Ext2Fs* fs);
 
-    usize AllocateINode();
-    usize AllocateBlock(Ext2FsINodeMeta& meta, u32 inode);
+    /**
+     * @brief Allocates an inode, preferably in the group of the `parent`
+     * inode, so that the files end up near their directory
+     */
+    usize AllocateINode(u32 parent = 0);
+    void  FreeINode(u32 inode);
+
+    /**
+     * @brief Allocates a run of up to `count` contiguous blocks, starting at
+     * `goal`, or as close after it, as possible
+     *
+     * @return the first block of the run, or 0, if there are no free blocks
+     * left, `count` is updated to the length of the run
+     */
+    u32   AllocateBlocks(u32 goal, usize& count);
+    void  FreeBlock(u32 block);
+
+    /**
+     * @brief Writes back the bitmaps, which have changed
+     */
+    void  Flush();
 
   private:
+    struct BlockGroup
+    {
+        u64* BlockBitmap      = nullptr;
+        u64* INodeBitmap      = nullptr;
+        bool BlockBitmapDirty = false;
+        bool INodeBitmapDirty = false;
+    };
+
     Ext2Fs*      m_Filesystem      = nullptr;
     class INode* m_Device          = nullptr;
 
@@ -26,8 +61,13 @@ class Ext2FsAllocator
     usize        m_BlockCount      = 0;
     usize        m_BlockGroupCount = 0;
     usize        m_BlocksPerGroup  = 0;
+    usize        m_INodesPerGroup  = 0;
+    // Block 0 of the first group, 1 with 1 KiB blocks, 0 otherwise
+    usize        m_FirstDataBlock  = 0;
+
+    Spinlock     m_Lock;
+    BlockGroup*  m_Groups          = nullptr;
 
-    usize        LocateFreeGroup(usize blockCount = 1);
-    usize        AllocateINodeInGroup(usize                       blockGroupIndex,
-                                      Ext2FsBlockGroupDescriptor& blockGroup);
+    usize        BlocksInGroup(usize group) const;
+    u64*         LoadBitmap(usize group, bool inodes);
 };
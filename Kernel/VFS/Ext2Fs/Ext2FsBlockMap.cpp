@@ -0,0 +1,108 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#include <VFS/Ext2Fs/Ext2FsBlockMap.hpp>
+
+namespace
+{
+    // Whether `next` directly continues `extent`, both on the disk, and
+    // within the file
+    bool Continues(const Ext2FsBlockMap::Extent& extent,
+                   const Ext2FsBlockMap::Extent& next)
+    {
+        if (extent.End() != next.Logical) return false;
+        if (extent.Physical == 0) return next.Physical == 0;
+
+        return next.Physical == extent.Physical + extent.Length;
+    }
+}; // namespace
+
+bool Ext2FsBlockMap::Find(u32 logical, Extent& extent)
+{
+    ScopedLock guard(m_Lock);
+    usize      index = LowerBound(logical);
+    if (index >= m_Extents.Size() || m_Extents[index].Logical > logical
+        || m_Extents[index].End() <= logical)
+        return false;
+
+    extent = m_Extents[index];
+    return true;
+}
+void Ext2FsBlockMap::Insert(u32 logical, const u32* blocks, usize length)
+{
+    if (length == 0) return;
+
+    // Collapse the runs first, so that the lock is held only briefly
+    Vector<Extent> runs;
+    for (usize i = 0; i < length; ++i)
+    {
+        Extent next = {logical + static_cast<u32>(i), blocks[i], 1};
+        if (!runs.Empty() && Continues(runs.Back(), next))
+            ++runs.Back().Length;
+        else runs.PushBack(next);
+    }
+
+    ScopedLock guard(m_Lock);
+    if (m_Extents.Size() + runs.Size() > MAX_EXTENTS) m_Extents.Clear();
+
+    // Ranges are inserted whole, so a racer already inserted all of them
+    usize position = LowerBound(logical);
+    if (position < m_Extents.Size() && m_Extents[position].Logical <= logical
+        && m_Extents[position].End() > logical)
+        return;
+
+    // The runs are spliced in at once, merging the ones at their edges with
+    // the neighbouring extents
+    if (position < m_Extents.Size() && m_Extents[position].Logical < logical)
+        ++position;
+
+    usize first = 0;
+    usize count = runs.Size();
+    if (position > 0 && Continues(m_Extents[position - 1], runs[0]))
+    {
+        m_Extents[position - 1].Length += runs[0].Length;
+        ++first;
+    }
+    if (first < count && position < m_Extents.Size()
+        && Continues(runs[count - 1], m_Extents[position]))
+    {
+        auto& extent     = m_Extents[position];
+        extent.Logical   = runs[count - 1].Logical;
+        extent.Physical  = runs[count - 1].Physical;
+        extent.Length   += runs[count - 1].Length;
+        --count;
+    }
+    if (first >= count) return;
+
+    usize inserted = count - first;
+    usize size     = m_Extents.Size();
+    m_Extents.Resize(size + inserted);
+    for (usize i = size; i > position; --i)
+        m_Extents[i - 1 + inserted] = m_Extents[i - 1];
+    for (usize i = 0; i < inserted; ++i)
+        m_Extents[position + i] = runs[first + i];
+}
+void Ext2FsBlockMap::Clear()
+{
+    ScopedLock guard(m_Lock);
+    m_Extents.Clear();
+}
+
+usize Ext2FsBlockMap::LowerBound(u32 logical) const
+{
+    // Index of the last extent, which starts at, or before `logical`, or of
+    // the first one, if there is none
+    usize low  = 0;
+    usize high = m_Extents.Size();
+    while (high - low > 1)
+    {
+        usize middle = low + (high - low) / 2;
+        if (m_Extents[middle].Logical <= logical) low = middle;
+        else high = middle;
+    }
+
+    return low;
+}
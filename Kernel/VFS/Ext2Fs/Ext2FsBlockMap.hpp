@@ -0,0 +1,61 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#pragma once
+
+#include <Library/Locking/Spinlock.hpp>
+
+#include <Prism/Containers/Vector.hpp>
+#include <Prism/Core/NonCopyable.hpp>
+#include <Prism/Core/Types.hpp>
+
+/**
+ * @brief Cache of an inode's logical to physical block mapping, the runs of
+ * blocks, which follow each other on the disk, as well as the runs of holes,
+ * are collapsed into single extents
+ *
+ * The map is filled by the filesystem, one indirect block worth of mappings at
+ * a time, and has to be cleared, whenever the inode's blocks are reassigned
+ */
+class Ext2FsBlockMap : public NonCopyable<Ext2FsBlockMap>
+{
+  public:
+    struct Extent
+    {
+        u32 Logical  = 0;
+        // 0 for holes
+        u32 Physical = 0;
+        u32 Length   = 0;
+
+        inline u32 End() const { return Logical + Length; }
+    };
+
+    Ext2FsBlockMap() = default;
+
+    /**
+     * @brief Looks up the extent, which maps the logical block `logical`
+     *
+     * @return false, if it isn't cached
+     */
+    bool Find(u32 logical, Extent& extent);
+    /**
+     * @brief Caches the mapping of `length` logical blocks starting at
+     * `logical`, given by `blocks`, the ranges have to be always inserted as
+     * a whole, and nothing is inserted, if the first block is cached already
+     */
+    void Insert(u32 logical, const u32* blocks, usize length);
+    void Clear();
+
+  private:
+    // Heavily fragmented inodes are forgotten, and refilled on demand
+    constexpr static usize MAX_EXTENTS = 4096;
+
+    Spinlock               m_Lock;
+    // Sorted by the logical block, and never overlapping
+    Vector<Extent>         m_Extents;
+
+    usize                  LowerBound(u32 logical) const;
+};
@@ -0,0 +1,196 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#include <Prism/Memory/Memory.hpp>
+
+#include <VFS/Ext2Fs/Ext2FsDirectoryIndex.hpp>
+
+namespace Ext2FsDirectoryIndex
+{
+    namespace
+    {
+        inline u32 RotateLeft(u32 value, u32 shift)
+        {
+            return (value << shift) | (value >> (32 - shift));
+        }
+
+        // The original hash of ext3, the names' chars are mixed in one by one
+        template <typename Char>
+        u32 LegacyHash(StringView name)
+        {
+            u32 hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+            for (usize i = 0; i < name.Size(); ++i)
+            {
+                i32 c    = static_cast<Char>(name[i]);
+                u32 hash = hash1 + (hash0 ^ static_cast<u32>(c * 7152373));
+
+                if (hash & 0x80000000) hash -= 0x7fffffff;
+                hash1 = hash0;
+                hash0 = hash;
+            }
+
+            return hash0 << 1;
+        }
+
+        // Packs up to `count` * 4 chars of the name into big endian words,
+        // the rest is padded with the length of the name
+        template <typename Char>
+        void NameToBuffer(const char* name, usize length, u32* buffer,
+                          i32 count)
+        {
+            u32 pad  = static_cast<u32>(length);
+            pad     |= pad << 8;
+            pad     |= pad << 16;
+
+            u32 value = pad;
+            if (length > static_cast<usize>(count) * 4) length = count * 4;
+            for (usize i = 0; i < length; ++i)
+            {
+                value = static_cast<i32>(static_cast<Char>(name[i]))
+                      + (value << 8);
+                if (i % 4 == 3)
+                {
+                    *buffer++ = value;
+                    value     = pad;
+                    --count;
+                }
+            }
+
+            if (--count >= 0) *buffer++ = value;
+            while (--count >= 0) *buffer++ = pad;
+        }
+
+        void TeaTransform(u32 buffer[4], const u32 in[4])
+        {
+            constexpr u32 DELTA = 0x9e3779b9;
+
+            u32           sum = 0, b0 = buffer[0], b1 = buffer[1];
+            u32           a = in[0], b = in[1], c = in[2], d = in[3];
+            for (usize n = 0; n < 16; ++n)
+            {
+                sum += DELTA;
+                b0  += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+                b1  += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+            }
+
+            buffer[0] += b0;
+            buffer[1] += b1;
+        }
+
+        inline u32 F(u32 x, u32 y, u32 z) { return z ^ (x & (y ^ z)); }
+        inline u32 G(u32 x, u32 y, u32 z) { return (x & y) + ((x ^ y) & z); }
+        inline u32 H(u32 x, u32 y, u32 z) { return x ^ y ^ z; }
+
+        // The reduced MD4 of ext3, only 3 rounds over 8 words
+        void       HalfMD4Transform(u32 buffer[4], const u32 in[8])
+        {
+            constexpr u32 K1 = 0, K2 = 013240474631, K3 = 015666365641;
+
+            u32           a = buffer[0];
+            u32           b = buffer[1];
+            u32           c = buffer[2];
+            u32           d = buffer[3];
+
+            auto round = [](auto f, u32& w, u32 x, u32 y, u32 z, u32 k, u32 s)
+            { w = RotateLeft(w + f(x, y, z) + k, s); };
+
+            round(F, a, b, c, d, in[0] + K1, 3);
+            round(F, d, a, b, c, in[1] + K1, 7);
+            round(F, c, d, a, b, in[2] + K1, 11);
+            round(F, b, c, d, a, in[3] + K1, 19);
+            round(F, a, b, c, d, in[4] + K1, 3);
+            round(F, d, a, b, c, in[5] + K1, 7);
+            round(F, c, d, a, b, in[6] + K1, 11);
+            round(F, b, c, d, a, in[7] + K1, 19);
+
+            round(G, a, b, c, d, in[1] + K2, 3);
+            round(G, d, a, b, c, in[3] + K2, 5);
+            round(G, c, d, a, b, in[5] + K2, 9);
+            round(G, b, c, d, a, in[7] + K2, 13);
+            round(G, a, b, c, d, in[0] + K2, 3);
+            round(G, d, a, b, c, in[2] + K2, 5);
+            round(G, c, d, a, b, in[4] + K2, 9);
+            round(G, b, c, d, a, in[6] + K2, 13);
+
+            round(H, a, b, c, d, in[3] + K3, 3);
+            round(H, d, a, b, c, in[7] + K3, 9);
+            round(H, c, d, a, b, in[2] + K3, 11);
+            round(H, b, c, d, a, in[6] + K3, 15);
+            round(H, a, b, c, d, in[1] + K3, 3);
+            round(H, d, a, b, c, in[5] + K3, 9);
+            round(H, c, d, a, b, in[0] + K3, 11);
+            round(H, b, c, d, a, in[4] + K3, 15);
+
+            buffer[0] += a;
+            buffer[1] += b;
+            buffer[2] += c;
+            buffer[3] += d;
+        }
+
+        template <typename Char>
+        u32 HalfMD4Hash(StringView name, u32 buffer[4])
+        {
+            u32 in[8];
+            for (usize offset = 0; offset < name.Size(); offset += 32)
+            {
+                NameToBuffer<Char>(name.Raw() + offset, name.Size() - offset,
+                                   in, 8);
+                HalfMD4Transform(buffer, in);
+            }
+
+            return buffer[1];
+        }
+        template <typename Char>
+        u32 TeaHash(StringView name, u32 buffer[4])
+        {
+            u32 in[4];
+            for (usize offset = 0; offset < name.Size(); offset += 16)
+            {
+                NameToBuffer<Char>(name.Raw() + offset, name.Size() - offset,
+                                   in, 4);
+                TeaTransform(buffer, in);
+            }
+
+            return buffer[0];
+        }
+    }; // namespace
+
+    u32 Hash(StringView name, Ext2FsHashVersion version, const u32 seed[4])
+    {
+        u32 buffer[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+        if (seed && (seed[0] || seed[1] || seed[2] || seed[3]))
+            Memory::Copy(buffer, seed, sizeof(buffer));
+
+        u32 hash = 0;
+        switch (version)
+        {
+            case Ext2FsHashVersion::eLegacy:
+                hash = LegacyHash<i8>(name);
+                break;
+            case Ext2FsHashVersion::eLegacyUnsigned:
+                hash = LegacyHash<u8>(name);
+                break;
+            case Ext2FsHashVersion::eHalfMD4:
+                hash = HalfMD4Hash<i8>(name, buffer);
+                break;
+            case Ext2FsHashVersion::eHalfMD4Unsigned:
+                hash = HalfMD4Hash<u8>(name, buffer);
+                break;
+            case Ext2FsHashVersion::eTea:
+                hash = TeaHash<i8>(name, buffer);
+                break;
+            case Ext2FsHashVersion::eTeaUnsigned:
+                hash = TeaHash<u8>(name, buffer);
+                break;
+        }
+
+        // The largest hash marks the end of the directory in readdir cookies
+        hash &= ~HASH_COLLISION;
+        if (hash == 0x7fffffffu << 1) hash = (0x7fffffffu - 1) << 1;
+
+        return hash;
+    }
+}; // namespace Ext2FsDirectoryIndex
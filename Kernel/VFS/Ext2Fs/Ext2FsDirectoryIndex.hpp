@@ -0,0 +1,28 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#pragma once
+
+#include <Prism/Core/Types.hpp>
+#include <Prism/String/StringView.hpp>
+
+#include <VFS/Ext2Fs/Ext2FsStructures.hpp>
+
+namespace Ext2FsDirectoryIndex
+{
+    // The lowest hash bit is reserved, in the index it marks continued
+    // collisions
+    constexpr u32 HASH_COLLISION = 0x01;
+
+    /**
+     * @brief Hashes the name, the same way, as the directory's index was built
+     *
+     * @param seed The superblock's hash seed, zero seeds fall back to the
+     * default one
+     */
+    u32           Hash(StringView name, Ext2FsHashVersion version,
+                       const u32 seed[4]);
+}; // namespace Ext2FsDirectoryIndex
@@ -1,10 +1,12 @@
 /*
  * Created by v1tr10l7 on 24.03.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
 #include <API/Posix/dirent.h>
+#include <Memory/Allocator/KernelHeap.hpp>
+#include <Prism/Memory/Scope.hpp>
 
 #include <VFS/DirectoryEntry.hpp>
 #include <VFS/Ext2Fs/Ext2Fs.hpp>
@@ -38,8 +40,8 @@ ErrorOr<void> Ext2FsINode::TraverseDirectories(Ref<class DirectoryEntry> parent,
     LogTrace("Ext2fs: Traversing directories");
     m_Fs->ReadINodeEntry(&m_Meta, m_Metadata.ID);
 
-    u8* buffer = new u8[m_Meta.GetSize()];
-    m_Fs->ReadINode(m_Meta, buffer, 0, m_Meta.GetSize());
+    u8* buffer = new (KernelHeap::Uninitialized) u8[m_Meta.GetSize()];
+    m_Fs->ReadINode(m_Meta, buffer, 0, m_Meta.GetSize(), &m_BlockMap);
 
     usize bufferOffset = 0;
     usize i            = 0;
@@ -69,45 +71,8 @@ ErrorOr<void> Ext2FsINode::TraverseDirectories(Ref<class DirectoryEntry> parent,
             continue;
         }
 
-        Ext2FsINodeMeta inodeMeta;
-        m_Fs->ReadINodeEntry(&inodeMeta, entry->INodeIndex);
-
-        u64 mode = (inodeMeta.Permissions & 0xfff);
-        switch (entry->Type)
-        {
-            case Ext2FsDirectoryEntryType::eRegular: mode |= S_IFREG; break;
-            case Ext2FsDirectoryEntryType::eDirectory: mode |= S_IFDIR; break;
-            case Ext2FsDirectoryEntryType::eCharacterDevice:
-                mode |= S_IFCHR;
-                break;
-            case Ext2FsDirectoryEntryType::eBlockDevice: mode |= S_IFBLK; break;
-            case Ext2FsDirectoryEntryType::eFifo: mode |= S_IFIFO; break;
-            case Ext2FsDirectoryEntryType::eSocket: mode |= S_IFSOCK; break;
-            case Ext2FsDirectoryEntryType::eSymlink: mode |= S_IFLNK; break;
-
-            default:
-                LogError("Ext2Fs: Invalid directory entry type: {}",
-                         ToUnderlying(entry->Type));
-                break;
-        }
-
-        Ext2FsINode* newNode          = new Ext2FsINode(nameBuffer, m_Fs, mode);
-        newNode->m_Metadata.UID       = inodeMeta.UID;
-        newNode->m_Metadata.GID       = inodeMeta.GID;
-        newNode->m_Metadata.ID        = entry->INodeIndex;
-        newNode->m_Metadata.Size      = inodeMeta.GetSize();
-        newNode->m_Metadata.LinkCount = inodeMeta.HardLinkCount;
-        newNode->m_Metadata.BlockCount
-            = newNode->m_Metadata.Size / m_Fs->GetBlockSize();
-
-        newNode->m_Metadata.AccessTime.tv_sec        = inodeMeta.AccessTime;
-        newNode->m_Metadata.AccessTime.tv_nsec       = 0;
-        newNode->m_Metadata.ChangeTime.tv_sec        = inodeMeta.CreationTime;
-        newNode->m_Metadata.ChangeTime.tv_nsec       = 0;
-        newNode->m_Metadata.ModificationTime.tv_sec  = inodeMeta.ModifiedTime;
-        newNode->m_Metadata.ModificationTime.tv_nsec = 0;
-
-        newNode->m_Meta                              = inodeMeta;
+        Ext2FsINode* newNode
+            = CreateChild(nameBuffer, entry->INodeIndex, entry->Type);
         LogTrace(
             "Ext2Fs: New Ext2FsINode =>\n"
             "\tname => {}\n"
@@ -124,7 +89,7 @@ ErrorOr<void> Ext2FsINode::TraverseDirectories(Ref<class DirectoryEntry> parent,
         delete[] nameBuffer;
         bufferOffset += entry->Size;
 
-        auto type   = IF2DT(mode);
+        auto type   = IF2DT(newNode->m_Metadata.Mode);
         auto offset = m_DirectoryOffset;
         ++m_DirectoryOffset;
 
@@ -139,29 +104,207 @@ ErrorOr<void> Ext2FsINode::TraverseDirectories(Ref<class DirectoryEntry> parent,
 }
 ErrorOr<Ref<DirectoryEntry>> Ext2FsINode::Lookup(Ref<DirectoryEntry> dentry)
 {
-    auto iterator
-        = [&](StringView name, loff_t offset, usize ino, usize type) -> bool
+    LogTrace("Ext2Fs: Looking up an inode => `{}`", dentry->Name());
+
+    // Held throughout, the scan reads m_Meta, and concurrent lookups of the
+    // same name mustn't both create a child
+    ScopedLock guard(m_Lock);
+    auto       it = m_Children.Find(dentry->Name());
+    if (it != m_Children.end())
     {
-        if (name == dentry->Name()) return false;
+        dentry->Bind(it->Value);
+        return dentry;
+    }
 
-        return true;
-    };
+    // Only names are compared, just the matching entry's inode is read
+    m_Fs->ReadINodeEntry(&m_Meta, m_Metadata.ID);
+    u32                      index = 0;
+    Ext2FsDirectoryEntryType type  = Ext2FsDirectoryEntryType::eUnknown;
+    if (!LookupIndexed(dentry->Name(), index, type))
+        LookupLinear(dentry->Name(), index, type);
+    if (!index) return Error(ENOENT);
+
+    Ext2FsINode* child = CreateChild(dentry->Name(), index, type);
+    if (!child) return Error(ENOMEM);
+
+    m_Children[child->Name()] = child;
+    dentry->Bind(child);
+    return dentry;
+}
+Ext2FsINode* Ext2FsINode::CreateChild(StringView name, u32 index,
+                                      Ext2FsDirectoryEntryType type)
+{
+    Ext2FsINodeMeta inodeMeta;
+    m_Fs->ReadINodeEntry(&inodeMeta, index);
 
-    Delegate<bool(StringView, loff_t, usize, usize)> delegate;
-    delegate.BindLambda(iterator);
+    u64 mode = (inodeMeta.Permissions & 0xfff);
+    switch (type)
+    {
+        case Ext2FsDirectoryEntryType::eRegular: mode |= S_IFREG; break;
+        case Ext2FsDirectoryEntryType::eDirectory: mode |= S_IFDIR; break;
+        case Ext2FsDirectoryEntryType::eCharacterDevice:
+            mode |= S_IFCHR;
+            break;
+        case Ext2FsDirectoryEntryType::eBlockDevice: mode |= S_IFBLK; break;
+        case Ext2FsDirectoryEntryType::eFifo: mode |= S_IFIFO; break;
+        case Ext2FsDirectoryEntryType::eSocket: mode |= S_IFSOCK; break;
+        case Ext2FsDirectoryEntryType::eSymlink: mode |= S_IFLNK; break;
+
+        default:
+            LogError("Ext2Fs: Invalid directory entry type: {}",
+                     ToUnderlying(type));
+            break;
+    }
 
-    LogTrace("Ext2Fs: Looking up an inode => `{}`", dentry->Name());
-    TraverseDirectories(dentry->Parent().Promote(), delegate);
+    Ext2FsINode* newNode = new Ext2FsINode(name, m_Fs, mode);
+    if (!newNode) return nullptr;
+
+    newNode->m_Metadata.UID       = inodeMeta.UID;
+    newNode->m_Metadata.GID       = inodeMeta.GID;
+    newNode->m_Metadata.ID        = index;
+    newNode->m_Metadata.Size      = inodeMeta.GetSize();
+    newNode->m_Metadata.LinkCount = inodeMeta.HardLinkCount;
+    newNode->m_Metadata.BlockCount
+        = newNode->m_Metadata.Size / m_Fs->GetBlockSize();
+
+    newNode->m_Metadata.AccessTime.tv_sec        = inodeMeta.AccessTime;
+    newNode->m_Metadata.AccessTime.tv_nsec       = 0;
+    newNode->m_Metadata.ChangeTime.tv_sec        = inodeMeta.CreationTime;
+    newNode->m_Metadata.ChangeTime.tv_nsec       = 0;
+    newNode->m_Metadata.ModificationTime.tv_sec  = inodeMeta.ModifiedTime;
+    newNode->m_Metadata.ModificationTime.tv_nsec = 0;
+
+    newNode->m_Meta                              = inodeMeta;
+    return newNode;
+}
 
-    for (const auto& [name, inode] : Children())
+isize Ext2FsINode::ReadDirectoryBlock(u32 block, u8* out)
+{
+    usize blockSize = m_Fs->GetBlockSize();
+    return m_Fs->ReadINode(m_Meta, out, usize(block) * blockSize, blockSize,
+                           &m_BlockMap);
+}
+bool Ext2FsINode::FindInBlock(const u8* block, usize size, StringView name,
+                              u32& index, Ext2FsDirectoryEntryType& type)
+{
+    for (usize offset = 0; offset + sizeof(Ext2FsDirectoryEntry) <= size;)
     {
-        if (name != inode->Name()) continue;
+        auto entry
+            = reinterpret_cast<const Ext2FsDirectoryEntry*>(block + offset);
+        // Corrupted entries end the block
+        if (entry->Size < sizeof(Ext2FsDirectoryEntry)
+            || offset + entry->Size > size)
+            break;
 
-        dentry->Bind(inode);
-        return dentry;
+        if (entry->INodeIndex && entry->NameSize == name.Size()
+            && Memory::Compare(entry->Name, name.Raw(), name.Size()) == 0)
+        {
+            index = entry->INodeIndex;
+            type  = entry->Type;
+            return true;
+        }
+
+        offset += entry->Size;
     }
 
-    return Error(ENOENT);
+    return false;
+}
+void Ext2FsINode::LookupLinear(StringView name, u32& index,
+                               Ext2FsDirectoryEntryType& type)
+{
+    usize blockSize = m_Fs->GetBlockSize();
+    usize blocks    = Math::DivRoundUp(m_Meta.GetSize(), blockSize);
+
+    // Scan a block at a time, to stop as soon as the name is found
+    Scope<u8[]> block = new u8[blockSize];
+    for (usize i = 0; i < blocks; ++i)
+    {
+        isize read = ReadDirectoryBlock(i, block.Raw());
+        if (read <= 0) break;
+
+        if (FindInBlock(block.Raw(), read, name, index, type)) return;
+    }
+}
+bool Ext2FsINode::LookupIndexed(StringView name, u32& index,
+                                Ext2FsDirectoryEntryType& type)
+{
+    using namespace Ext2FsDirectoryIndex;
+
+    auto superBlock = m_Fs->GetSuperBlock();
+    if (!(m_Meta.Flags & EXT2_INDEX_FL)
+        || !(superBlock->OptionalFeatures & EXT2_FEATURE_COMPAT_DIR_INDEX))
+        return false;
+
+    usize       blockSize = m_Fs->GetBlockSize();
+    Scope<u8[]> node      = new u8[blockSize];
+    Scope<u8[]> leaf      = new u8[blockSize];
+    if (ReadDirectoryBlock(0, node.Raw()) != isize(blockSize)) return false;
+
+    // The root info follows the 12 byte "." and ".." entries, only ext3's two
+    // level trees are known
+    auto info
+        = reinterpret_cast<Ext2FsDirectoryIndexRootInfo*>(node.Raw() + 24);
+    if (info->Reserved != 0 || info->InfoSize != 8 || info->IndirectLevels > 1
+        || info->HashVersion > Ext2FsHashVersion::eTea)
+        return false;
+
+    u8 version = ToUnderlying(info->HashVersion);
+    if (superBlock->Flags & EXT2_FLAGS_UNSIGNED_HASH) version += 3;
+    u32   hash   = Hash(name, static_cast<Ext2FsHashVersion>(version),
+                        superBlock->HashSeed);
+
+    usize offset = 24 + info->InfoSize;
+    for (usize level = 0;; ++level)
+    {
+        auto countLimit = reinterpret_cast<Ext2FsDirectoryIndexCountLimit*>(
+            node.Raw() + offset);
+        auto entries = reinterpret_cast<Ext2FsDirectoryIndexEntry*>(
+            node.Raw() + offset);
+        usize count = countLimit->Count;
+        if (count == 0 || count > countLimit->Limit
+            || offset + count * sizeof(Ext2FsDirectoryIndexEntry) > blockSize)
+            return false;
+
+        // The first entry covers everything below the second one's hash
+        usize low = 1, high = count;
+        while (low < high)
+        {
+            usize middle = (low + high) / 2;
+            if (entries[middle].Hash > hash) high = middle;
+            else low = middle + 1;
+        }
+
+        // Only the lower 28 bits of the block are used, ext4 reuses the rest
+        constexpr u32 BLOCK_MASK = 0x0fffffff;
+        usize         found      = low - 1;
+        if (level == info->IndirectLevels)
+        {
+            // The names, which hash the same, might continue in the
+            // following leaves, those have the collision bit set
+            for (;;)
+            {
+                u32 block = entries[found].Block & BLOCK_MASK;
+                if (ReadDirectoryBlock(block, leaf.Raw()) != isize(blockSize))
+                    return false;
+                if (FindInBlock(leaf.Raw(), blockSize, name, index, type))
+                    return true;
+
+                if (++found >= count) break;
+                u32 next = entries[found].Hash;
+                if (!(next & HASH_COLLISION)
+                    || (next & ~HASH_COLLISION) != hash)
+                    break;
+            }
+
+            return true;
+        }
+
+        // Interior nodes start with an empty entry, which spans the block
+        u32 block = entries[found].Block & BLOCK_MASK;
+        if (ReadDirectoryBlock(block, node.Raw()) != isize(blockSize))
+            return false;
+        offset = sizeof(Ext2FsDirectoryEntry);
+    }
 }
 
 void Ext2FsINode::InsertChild(INode* node, StringView name)
@@ -177,12 +320,32 @@ isize Ext2FsINode::Read(void* buffer, off_t offset, usize bytes)
     if (offset + bytes > m_Metadata.Size)
         bytes = bytes - ((offset + bytes) - m_Metadata.Size);
 
-    m_Metadata.AccessTime = Time::GetReal();
-    m_Meta.AccessTime     = m_Metadata.AccessTime.tv_sec;
-    m_Fs->WriteINodeEntry(m_Meta, m_Metadata.ID);
+    // Both the entry and the updated atime stay in the inode cache
+    auto now = Time::GetReal();
+    if (m_Fs->NeedsATimeUpdate(m_Meta, now.tv_sec))
+    {
+        m_Metadata.AccessTime = now;
+        m_Meta.AccessTime     = now.tv_sec;
+        m_Fs->UpdateINodeTimes(m_Meta, m_Metadata.ID);
+    }
 
     return m_Fs->ReadINode(m_Meta, reinterpret_cast<u8*>(buffer), offset,
-                           bytes);
+                           bytes, &m_BlockMap);
+}
+ErrorOr<void> Ext2FsINode::FlushMetadata()
+{
+    return m_Fs->FlushINodeEntry(m_Metadata.ID);
+}
+ErrorOr<void> Ext2FsINode::Sync(bool dataOnly)
+{
+    // Syncing the filesystem skips inodes with only lazy timestamps changed
+    if (!dataOnly)
+    {
+        auto flushed = FlushMetadata();
+        if (!flushed) return Error(flushed.error());
+    }
+
+    return m_Fs->Sync();
 }
 
 /*
@@ -232,6 +395,7 @@ void Ext2FsINode::Initialize(ino_t index, mode_t mode, u16 type)
     m_Meta.Flags                    = 0;
     m_Meta.OperatingSystemSpecific1 = 0;
     for (usize i = 0; i < 15; i++) m_Meta.Blocks[i] = 0;
+    m_BlockMap.Clear();
     // FIXME(v1tr10l7): Randomly generate
     m_Meta.GenerationNumber       = 0;
     m_Meta.ExtendedAttributeBlock = 0;
@@ -244,9 +408,17 @@ ErrorOr<void> Ext2FsINode::AddDirectoryEntry(Ext2FsDirectoryEntry& dentry)
 {
     m_Fs->ReadINodeEntry(&m_Meta, m_Metadata.ID);
 
+    // Entries are only added linearly, which would stale the hash tree, so the
+    // directory stops being indexed
+    if (m_Meta.Flags & EXT2_INDEX_FL)
+    {
+        m_Meta.Flags &= ~EXT2_INDEX_FL;
+        m_Fs->WriteINodeEntry(m_Meta, m_Metadata.ID);
+    }
+
     usize pageCount = Math::DivRoundUp(m_Meta.GetSize(), PMM::PAGE_SIZE);
     auto  buffer = Pointer(PMM::CallocatePages(pageCount)).ToHigherHalf<u8*>();
-    m_Fs->ReadINode(m_Meta, buffer, 0, m_Meta.GetSize());
+    m_Fs->ReadINode(m_Meta, buffer, 0, m_Meta.GetSize(), &m_BlockMap);
 
     usize nameSize  = StringView(reinterpret_cast<char*>(dentry.Name)).Size();
     usize required  = (sizeof(Ext2FsDirectoryEntry) + nameSize + 3) & ~3;
@@ -277,7 +449,7 @@ ErrorOr<void> Ext2FsINode::AddDirectoryEntry(Ext2FsDirectoryEntry& dentry)
                 .Copy(reinterpret_cast<char*>(entry->Name), nameSize + 1);
 
             m_Fs->WriteINode(m_Meta, buffer, m_Metadata.ID, 0,
-                             m_Meta.GetSize());
+                             m_Meta.GetSize(), &m_BlockMap);
             PMM::FreePages(Pointer(buffer).FromHigherHalf(), pageCount);
             return {};
         }
@@ -295,7 +467,7 @@ ErrorOr<void> Ext2FsINode::AddDirectoryEntry(Ext2FsDirectoryEntry& dentry)
 
     pageCount = Math::DivRoundUp(m_Meta.GetSize(), PMM::PAGE_SIZE);
     buffer    = Pointer(PMM::CallocatePages(pageCount));
-    m_Fs->ReadINode(m_Meta, buffer, 0, m_Meta.GetSize());
+    m_Fs->ReadINode(m_Meta, buffer, 0, m_Meta.GetSize(), &m_BlockMap);
 
     Ext2FsDirectoryEntry* entry
         = reinterpret_cast<Ext2FsDirectoryEntry*>(buffer + offset);
@@ -307,7 +479,8 @@ ErrorOr<void> Ext2FsINode::AddDirectoryEntry(Ext2FsDirectoryEntry& dentry)
     StringView(reinterpret_cast<char*>(dentry.Name))
         .Copy(reinterpret_cast<char*>(entry->Name), nameSize + 1);
 
-    m_Fs->WriteINode(m_Meta, buffer, m_Metadata.ID, 0, m_Meta.GetSize());
+    m_Fs->WriteINode(m_Meta, buffer, m_Metadata.ID, 0, m_Meta.GetSize(),
+                     &m_BlockMap);
     PMM::FreePages(buffer, pageCount);
 
     return {};
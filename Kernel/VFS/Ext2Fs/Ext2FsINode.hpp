@@ -1,11 +1,13 @@
 /*
  * Created by v1tr10l7 on 24.03.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
 #pragma once
 
+#include <VFS/Ext2Fs/Ext2FsBlockMap.hpp>
+#include <VFS/Ext2Fs/Ext2FsDirectoryIndex.hpp>
 #include <VFS/Ext2Fs/Ext2FsStructures.hpp>
 #include <VFS/INode.hpp>
 
@@ -34,14 +36,39 @@ class Ext2FsINode : public INode
     }
     virtual ErrorOr<isize> Truncate(usize size) override { return -1; }
 
+    virtual ErrorOr<void>  FlushMetadata() override;
+    virtual ErrorOr<void>  Sync(bool dataOnly = false) override;
+
     friend class Ext2Fs;
 
   private:
     Ext2Fs*                          m_Fs;
     Ext2FsINodeMeta                  m_Meta;
+    // Mappings of the inode's blocks, which we've looked up so far
+    Ext2FsBlockMap                   m_BlockMap;
     UnorderedMap<StringView, INode*> m_Children;
     usize                            m_DirectoryOffset = 0;
 
     void          Initialize(ino_t index, mode_t mode, u16 type);
     ErrorOr<void> AddDirectoryEntry(Ext2FsDirectoryEntry& dentry);
+
+    // Instantiates the inode, which the directory entry points to
+    Ext2FsINode*  CreateChild(StringView name, u32 index,
+                              Ext2FsDirectoryEntryType type);
+
+    isize         ReadDirectoryBlock(u32 block, u8* out);
+    // Looks for the name within a single block of the directory, only the
+    // names are compared, no inodes are read
+    bool          FindInBlock(const u8* block, usize size, StringView name,
+                              u32& index, Ext2FsDirectoryEntryType& type);
+    void          LookupLinear(StringView name, u32& index,
+                               Ext2FsDirectoryEntryType& type);
+    /**
+     * @brief Walks the directory's hash tree down to the leaf, which holds
+     * the name, `index` stays 0, if it's not there
+     *
+     * @return false, if the directory's index can't be used
+     */
+    bool          LookupIndexed(StringView name, u32& index,
+                                Ext2FsDirectoryEntryType& type);
 };
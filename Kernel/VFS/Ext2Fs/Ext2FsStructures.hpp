@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 24.03.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -66,8 +66,27 @@ struct [[gnu::packed]] Ext2FsSuperBlock
     u32           JournalINode;
     u32           JournalDevice;
     u32           HeadOfOrphanINodeList;
+    u32           HashSeed[4];
+    u8            DefaultHashVersion;
+    u8            JournalBackupType;
+    u16           GroupDescriptorSize;
+    u32           DefaultMountOptions;
+    u32           FirstMetaBlockGroup;
+    u32           CreationTime;
+    u32           JournalBlocks[17];
+    u32           BlockCountHigh;
+    u32           ReservedBlockCountHigh;
+    u32           FreeBlockCountHigh;
+    u16           MinExtraINodeSize;
+    u16           WantExtraINodeSize;
+    u32           Flags;
 };
 
+// OptionalFeatures
+constexpr u32 EXT2_FEATURE_COMPAT_DIR_INDEX = 0x0020;
+// Flags, whether the directory hashes treat the names as unsigned chars
+constexpr u32 EXT2_FLAGS_UNSIGNED_HASH      = 0x0002;
+
 struct [[gnu::packed]] Ext2FsBlockGroupDescriptor
 {
     u32 BlockUsageBitmapAddress;
@@ -78,6 +97,9 @@ struct [[gnu::packed]] Ext2FsBlockGroupDescriptor
     u16 DirectoryCount;
     u16 Reserved[7];
 };
+// Ext2FsINodeMeta::Flags, the directory is indexed with a hash tree
+constexpr u32 EXT2_INDEX_FL = 0x1000;
+
 struct [[gnu::packed]] Ext2FsINodeMeta
 {
     u16             Permissions;
@@ -131,6 +153,42 @@ struct [[gnu::packed]] Ext2FsDirectoryEntry
     u8                       Name[];
 };
 
+/**
+ * @brief Hash tree of an indexed directory, its root lives in the first block,
+ * right after the "." and ".." entries, the last of which spans the rest of
+ * the block, so that the index is invisible to the linear scans, every index
+ * entry maps the names, which hash to at least Hash, to the Block of the
+ * directory, which holds them, or which indexes them further
+ */
+enum class Ext2FsHashVersion : u8
+{
+    eLegacy          = 0x00,
+    eHalfMD4         = 0x01,
+    eTea             = 0x02,
+    eLegacyUnsigned  = 0x03,
+    eHalfMD4Unsigned = 0x04,
+    eTeaUnsigned     = 0x05,
+};
+struct [[gnu::packed]] Ext2FsDirectoryIndexRootInfo
+{
+    u32               Reserved;
+    Ext2FsHashVersion HashVersion;
+    u8                InfoSize;
+    u8                IndirectLevels;
+    u8                Flags;
+};
+struct [[gnu::packed]] Ext2FsDirectoryIndexEntry
+{
+    u32 Hash;
+    u32 Block;
+};
+// Takes up the Hash of the first entry of every index node
+struct [[gnu::packed]] Ext2FsDirectoryIndexCountLimit
+{
+    u16 Limit;
+    u16 Count;
+};
+
 constexpr Ext2FsDirectoryEntryType Ext2Mode2DirectoryEntryType(mode_t mode)
 {
     if (S_ISREG(mode)) return Ext2FsDirectoryEntryType::eRegular;
@@ -1,11 +1,12 @@
 /*
  * Created by v1tr10l7 on 22.03.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
 #include <Memory/PMM.hpp>
 
+#include <Prism/Memory/Memory.hpp>
 #include <Prism/Utility/Math.hpp>
 
 #include <VFS/DirectoryEntry.hpp>
@@ -25,6 +26,48 @@ constexpr usize                FAT32_FS_INFO_OFFSET          = 484;
 constexpr usize                FAT32_REAL_FS_INFO_SIGNATURE  = 0x61417272;
 constexpr usize                FAT32_REAL_FS_INFO_SIGNATURE2 = 0xaa550000;
 
+namespace
+{
+    constexpr usize NOT_FOUND = usize(-1);
+
+    inline bool     TestBit(const u64* bitmap, usize bit)
+    {
+        return bitmap[bit / 64] & (1ull << (bit % 64));
+    }
+    inline void SetBit(u64* bitmap, usize bit, bool value)
+    {
+        if (value) bitmap[bit / 64] |= 1ull << (bit % 64);
+        else bitmap[bit / 64] &= ~(1ull << (bit % 64));
+    }
+
+    usize FindClearBit(const u64* bitmap, usize from, usize limit)
+    {
+        for (usize bit = from; bit < limit;)
+        {
+            usize word = bit / 64;
+            u64   free = ~bitmap[word] & (~0ull << (bit % 64));
+            if (free)
+            {
+                usize found = word * 64 + __builtin_ctzll(free);
+                return found < limit ? found : NOT_FOUND;
+            }
+
+            bit = (word + 1) * 64;
+        }
+
+        return NOT_FOUND;
+    }
+}; // namespace
+
+Fat32Fs::~Fat32Fs()
+{
+    for (usize i = 0; m_FatPages && i < m_FatPageCount; ++i)
+        delete[] m_FatPages[i].Entries;
+
+    delete[] m_FatPages;
+    delete[] m_ClusterBitmap;
+}
+
 ErrorOr<::Ref<DirectoryEntry>> Fat32Fs::Mount(StringView  sourcePath,
                                               const void* data)
 {
@@ -82,6 +125,13 @@ ErrorOr<::Ref<DirectoryEntry>> Fat32Fs::Mount(StringView  sourcePath,
     m_ClusterCount = (m_Device->Stats().st_blocks - dataSector)
                    / m_BootRecord.SectorsPerCluster;
 
+    // The clusters past the end of the FAT can't be used
+    usize fatSize  = m_BootRecord.SectorsPerFat * m_BootRecord.BytesPerSector;
+    m_ClusterCount = Math::Min(m_ClusterCount, fatSize / 4 - 2);
+    m_FatPageCount = Math::DivRoundUp(fatSize / 4, FAT_ENTRIES_PER_PAGE);
+    m_FatPages     = new FatPage[m_FatPageCount];
+    if (!m_FatPages) return Error(ENOMEM);
+
     UpdateFsInfo();
 
     m_RootEntry = new DirectoryEntry(nullptr, "/");
@@ -113,7 +163,9 @@ ErrorOr<INode*> Fat32Fs::CreateNode(INode* parent, ::Ref<DirectoryEntry> entry,
     if (name.Size() > 255) return_err(nullptr, ENAMETOOLONG);
     if (!S_ISREG(mode) && !S_ISDIR(mode)) return_err(nullptr, EPERM);
 
-    return new Fat32FsINode(name, this, mode);
+    auto node               = new Fat32FsINode(name, this, mode);
+    node->m_ParentDirectory = reinterpret_cast<Fat32FsINode*>(parent);
+    return node;
 }
 
 bool Fat32Fs::Populate(DirectoryEntry* dentry)
@@ -134,10 +186,13 @@ bool Fat32Fs::Populate(DirectoryEntry* dentry)
         = node->Stats().st_size / sizeof(Fat32DirectoryEntry);
 
     Fat32FsINode* f32node = reinterpret_cast<Fat32FsINode*>(node);
-    if (ReadWriteClusters(reinterpret_cast<u8*>(directoryEntries),
-                          f32node->m_Cluster, f32node->m_Metadata.BlockCount,
-                          nullptr, false)
-        == -1)
+    isize         read    = 0;
+    {
+        ScopedLock guard(f32node->m_Lock);
+        read = ReadWriteBytes(f32node, reinterpret_cast<u8*>(directoryEntries),
+                              0, f32node->m_Metadata.Size);
+    }
+    if (read == -1)
     {
         LogError("Fat32::Populate: Failed to read/write clusters");
         delete[] directoryEntries;
@@ -263,44 +318,88 @@ ErrorOr<void> Fat32Fs::Stats(statfs& stats)
     return {};
 }
 
-bool Fat32Fs::ReadBytes(u32 cluster, u8* out, off_t offset, usize bytes)
+ErrorOr<void> Fat32Fs::Sync(bool force)
+{
+    FlushFat();
+    return m_Device->Sync();
+}
+
+isize Fat32Fs::ReadWriteBytes(Fat32FsINode* inode, u8* buffer, off_t offset,
+                              usize bytes, bool write)
 {
-    bool end            = true;
-    cluster             = SkipCluster(cluster, offset / m_ClusterSize, end);
+    if (!MapClusters(inode)) return_err(-1, EIO);
 
-    off_t clusterOffset = offset % m_ClusterSize;
-    if (clusterOffset > 0)
+    auto& runs    = inode->m_Runs;
+    u32   logical = offset / m_ClusterSize;
+    usize low = 0, high = runs.Size();
+    while (low < high)
     {
-        usize count
-            = bytes > m_ClusterSize ? m_ClusterSize - clusterOffset : bytes;
-        if (ReadWriteCluster(out, cluster, clusterOffset, count, false) == -1)
-            return false;
+        usize middle = (low + high) / 2;
+        if (runs[middle].End() <= logical) low = middle + 1;
+        else high = middle;
+    }
 
-        cluster = GetNextCluster(cluster);
-        out += count;
-        bytes -= count;
+    usize head = 0;
+    for (usize i = low; head < bytes && i < runs.Size(); ++i)
+    {
+        const auto& run           = runs[i];
+        usize       position      = offset + head;
+        usize       skipped       = position / m_ClusterSize - run.Logical;
+        usize       clusterOffset = position % m_ClusterSize;
+        usize       size          = Math::Min(
+            bytes - head,
+            (run.Length - skipped) * m_ClusterSize - clusterOffset);
+
+        usize diskOffset
+            = GetClusterOffset(run.Physical + skipped) + clusterOffset;
+        isize status = write ? m_Device->Write(buffer + head, diskOffset, size)
+                             : m_Device->Read(buffer + head, diskOffset, size);
+        if (status < 0) return head > 0 ? head : -1;
+
+        head += size;
     }
 
-    usize clustersRemaining = bytes / m_ClusterSize;
-    if (clustersRemaining
-        && ReadWriteClusters(out, cluster, clustersRemaining, &cluster, false)
-               == -1)
-        return false;
+    return head;
+}
+ErrorOr<void> Fat32Fs::GrowChain(Fat32FsINode* inode, usize size)
+{
+    if (!MapClusters(inode)) return Error(EIO);
 
-    bytes -= clustersRemaining * m_ClusterSize;
-    if (bytes > 0)
+    usize count = Math::DivRoundUp(size, m_ClusterSize);
+    auto& runs  = inode->m_Runs;
+    while (inode->m_ChainLength < count)
     {
-        out += clustersRemaining * m_ClusterSize;
-        if (ReadWriteCluster(out, cluster, 0, bytes, false) == -1) return false;
+        u32 last
+            = runs.Empty() ? 0 : runs.Back().Physical + runs.Back().Length - 1;
+        usize length = count - inode->m_ChainLength;
+        u32   first  = AllocateClusters(last ? last + 1 : 0, length);
+        if (!first) return Error(ENOSPC);
+
+        if (!last) inode->m_Cluster = first;
+        else
+        {
+            ScopedLock guard(m_FatLock);
+            SetFatEntry(last, first);
+        }
+
+        if (last && first == last + 1) runs.Back().Length += length;
+        else
+        {
+            Fat32ClusterRun run
+                = {static_cast<u32>(inode->m_ChainLength), first,
+                   static_cast<u32>(length)};
+            runs.PushBack(run);
+        }
+
+        inode->m_ChainLength += length;
     }
 
-    return true;
+    return {};
 }
-
 usize Fat32Fs::GetChainSize(u32 cluster)
 {
     usize count = 0;
-    while (!IsFinalCluster(cluster))
+    while (!IsFinalCluster(cluster) && count <= m_ClusterCount)
     {
         ++count;
         cluster = GetNextCluster(cluster);
@@ -309,68 +408,241 @@ usize Fat32Fs::GetChainSize(u32 cluster)
     return count;
 }
 
-u32 Fat32Fs::AllocateCluster() { return AllocateClusters(1); }
-u32 Fat32Fs::AllocateClusters(usize count)
+u32 Fat32Fs::AllocateClusters(u32 goal, usize& count)
 {
-    ToDoWarn();
-    return 0;
+    usize limit = m_ClusterCount + 2;
+    if (!BuildClusterBitmap())
+    {
+        count = 0;
+        return 0;
+    }
+
+    ScopedLock guard(m_FatLock);
+    if (goal < 2 || goal >= limit) goal = m_FsInfo.StartAt;
+    if (goal < 2 || goal >= limit) goal = 2;
+
+    // Search from the goal, then wrap around, so files grow in one direction
+    usize first = FindClearBit(m_ClusterBitmap, goal, limit);
+    if (first == NOT_FOUND) first = FindClearBit(m_ClusterBitmap, 2, goal);
+    if (first == NOT_FOUND)
+    {
+        count = 0;
+        return 0;
+    }
+
+    usize length = 1;
+    while (length < count && first + length < limit
+           && !TestBit(m_ClusterBitmap, first + length))
+        ++length;
+
+    for (usize i = 0; i < length; ++i)
+    {
+        u32 cluster = first + i;
+        SetBit(m_ClusterBitmap, cluster, true);
+        SetFatEntry(cluster, i + 1 < length ? cluster + 1 : FAT_END_OF_CHAIN);
+    }
+
+    m_FsInfo.Free    -= length;
+    m_FsInfo.StartAt  = first + length;
+    m_FsInfoDirty     = true;
+
+    count             = length;
+    return first;
 }
 u32 Fat32Fs::GetNextCluster(u32 cluster)
 {
-    m_Device->Read(&cluster, m_FatOffset + cluster * 4, 4);
-    return cluster;
+    if (cluster < 2 || cluster >= m_ClusterCount + 2) return FAT_END_OF_CHAIN;
+
+    u32* entries = LoadFatPage(cluster / FAT_ENTRIES_PER_PAGE);
+    if (!entries) return FAT_END_OF_CHAIN;
+
+    ScopedLock guard(m_FatLock);
+    return entries[cluster % FAT_ENTRIES_PER_PAGE] & FAT_ENTRY_MASK;
+}
+
+usize Fat32Fs::GetClusterOffset(u32 cluster)
+{
+    return m_DataOffset + m_ClusterSize * (cluster - 2);
 }
-u32 Fat32Fs::SkipCluster(u32 cluster, usize count, bool& end)
+
+u32* Fat32Fs::LoadFatPage(usize page)
 {
-    end = false;
-    for (usize i = 0; i < count; ++i)
+    if (page >= m_FatPageCount) return nullptr;
     {
-        u32 next = GetNextCluster(cluster);
-        if (IsFinalCluster(next))
-        {
-            end = true;
-            break;
-        }
+        ScopedLock guard(m_FatLock);
+        if (m_FatPages[page].Entries) return m_FatPages[page].Entries;
+    }
+
+    usize fatSize = m_BootRecord.SectorsPerFat * m_BootRecord.BytesPerSector;
+    usize offset  = page * FAT_ENTRIES_PER_PAGE * 4;
+    usize bytes   = Math::Min(FAT_ENTRIES_PER_PAGE * 4, fatSize - offset);
 
-        cluster = next;
+    u32*  entries = new u32[FAT_ENTRIES_PER_PAGE];
+    if (!entries) return nullptr;
+
+    Memory::Fill(entries, 0, FAT_ENTRIES_PER_PAGE * 4);
+    if (m_Device->Read(entries, m_FatOffset + offset, bytes) < 0)
+    {
+        delete[] entries;
+        return nullptr;
     }
 
-    return cluster;
-}
+    // Read unlocked, so someone may have loaded, and modified it meanwhile
+    ScopedLock guard(m_FatLock);
+    u32*&      cached = m_FatPages[page].Entries;
+    if (cached)
+    {
+        delete[] entries;
+        return cached;
+    }
 
-usize Fat32Fs::GetClusterOffset(u32 cluster)
+    cached = entries;
+    return entries;
+}
+void Fat32Fs::SetFatEntry(u32 cluster, u32 value)
 {
-    return m_DataOffset + m_ClusterSize * (cluster - 2);
+    // The upper 4 bits of the entries are reserved, and have to be preserved
+    auto& page  = m_FatPages[cluster / FAT_ENTRIES_PER_PAGE];
+    u32&  entry = page.Entries[cluster % FAT_ENTRIES_PER_PAGE];
+    entry       = (entry & ~FAT_ENTRY_MASK) | (value & FAT_ENTRY_MASK);
+    page.Dirty  = true;
 }
-isize Fat32Fs::ReadWriteCluster(u8* dest, u32 cluster, isize offset,
-                                usize bytes, bool write)
+bool Fat32Fs::BuildClusterBitmap()
 {
-    return write
-             ? m_Device->Write(dest, GetClusterOffset(cluster) + offset, bytes)
-             : m_Device->Read(dest, GetClusterOffset(cluster) + offset, bytes);
+    {
+        ScopedLock guard(m_FatLock);
+        if (m_ClusterBitmap) return true;
+    }
+
+    // The whole FAT has to be resident, once we start allocating
+    for (usize page = 0; page < m_FatPageCount; ++page)
+        if (!LoadFatPage(page)) return false;
+
+    usize limit  = m_ClusterCount + 2;
+    usize words  = Math::DivRoundUp(limit, 64);
+    u64*  bitmap = new u64[words];
+    if (!bitmap) return false;
+    Memory::Fill(bitmap, 0, words * sizeof(u64));
+
+    ScopedLock guard(m_FatLock);
+    if (m_ClusterBitmap)
+    {
+        delete[] bitmap;
+        return true;
+    }
+
+    usize free = 0;
+    for (usize cluster = 0; cluster < limit; ++cluster)
+    {
+        u32 entry = m_FatPages[cluster / FAT_ENTRIES_PER_PAGE]
+                        .Entries[cluster % FAT_ENTRIES_PER_PAGE];
+        if (cluster >= 2 && !(entry & FAT_ENTRY_MASK)) ++free;
+        else SetBit(bitmap, cluster, true);
+    }
+
+    // The FsInfo free count is only a hint, the FAT is what counts
+    if (m_FsInfo.Free != free)
+    {
+        m_FsInfo.Free = free;
+        m_FsInfoDirty = true;
+    }
+
+    m_ClusterBitmap = bitmap;
+    return true;
 }
-isize Fat32Fs::ReadWriteClusters(u8* dest, u32 cluster, usize count,
-                                 u32* endCluster, bool write)
+void Fat32Fs::FlushFat()
 {
-    usize i = 0;
-    for (; i < count; ++i)
+    usize fatSize  = m_BootRecord.SectorsPerFat * m_BootRecord.BytesPerSector;
+    u32*  snapshot = new u32[FAT_ENTRIES_PER_PAGE];
+    if (!snapshot) return;
+
+    for (usize page = 0; page < m_FatPageCount; ++page)
     {
-        AssertMsg(cluster, "Fat32: Tried to read/write free cluster");
-        if (IsFinalCluster(cluster)) break;
-        Assert(cluster < m_ClusterCount);
+        // Written from a copy, so allocations can go on meanwhile
+        {
+            ScopedLock guard(m_FatLock);
+            auto&      state = m_FatPages[page];
+            if (!state.Dirty) continue;
 
-        isize diskOffset = GetClusterOffset(cluster);
-        isize status     = write ? m_Device->Write(dest + m_ClusterSize * i,
-                                                   diskOffset, m_ClusterSize)
-                                 : m_Device->Read(dest + m_ClusterSize * i,
-                                                  diskOffset, m_ClusterSize);
-        if (status == -1) return -1;
+            Memory::Copy(snapshot, state.Entries, FAT_ENTRIES_PER_PAGE * 4);
+            state.Dirty = false;
+        }
 
-        cluster = GetNextCluster(cluster);
+        usize offset = page * FAT_ENTRIES_PER_PAGE * 4;
+        usize bytes  = Math::Min(FAT_ENTRIES_PER_PAGE * 4, fatSize - offset);
+        for (usize fat = 0; fat < m_BootRecord.FatCount; ++fat)
+            m_Device->Write(snapshot, m_FatOffset + fat * fatSize + offset,
+                            bytes);
     }
+    delete[] snapshot;
+
+    Fat32FsInfo fsInfo;
+    {
+        ScopedLock guard(m_FatLock);
+        if (!m_FsInfoDirty) return;
 
-    if (endCluster) *endCluster = cluster;
-    return i;
+        fsInfo        = m_FsInfo;
+        m_FsInfoDirty = false;
+    }
+
+    m_Device->Write(&fsInfo,
+                    m_BootRecord.BytesPerSector * m_BootRecord.FsInfoSector
+                        + FAT32_FS_INFO_OFFSET,
+                    sizeof(Fat32FsInfo));
+}
+
+bool Fat32Fs::MapClusters(Fat32FsINode* inode)
+{
+    if (inode->m_RunsMapped) return true;
+
+    auto& runs = inode->m_Runs;
+    runs.Clear();
+    inode->m_ChainLength = 0;
+
+    // A damaged FAT may loop, but no chain is longer than the cluster count
+    for (u32 cluster = inode->m_Cluster; !IsFinalCluster(cluster);
+         cluster     = GetNextCluster(cluster))
+    {
+        if (inode->m_ChainLength >= m_ClusterCount) return false;
+
+        if (!runs.Empty()
+            && runs.Back().Physical + runs.Back().Length == cluster)
+            ++runs.Back().Length;
+        else
+        {
+            Fat32ClusterRun run
+                = {static_cast<u32>(inode->m_ChainLength), cluster, 1};
+            runs.PushBack(run);
+        }
+
+        ++inode->m_ChainLength;
+    }
+
+    return (inode->m_RunsMapped = true);
+}
+ErrorOr<void> Fat32Fs::UpdateDirectoryEntry(Fat32FsINode* inode)
+{
+    auto parent = inode->m_ParentDirectory;
+    if (!parent || inode->m_DirectoryOffset == usize(-1)) return {};
+
+    Fat32DirectoryEntry entry;
+    ScopedLock          guard(parent->m_Lock);
+    off_t               offset = inode->m_DirectoryOffset;
+    if (ReadWriteBytes(parent, reinterpret_cast<u8*>(&entry), offset,
+                       sizeof(entry))
+        != sizeof(entry))
+        return Error(EIO);
+
+    entry.ClusterLow  = inode->m_Cluster & 0xffff;
+    entry.ClusterHigh = inode->m_Cluster >> 16;
+    if (!S_ISDIR(inode->m_Metadata.Mode)) entry.Size = inode->m_Metadata.Size;
+
+    if (ReadWriteBytes(parent, reinterpret_cast<u8*>(&entry), offset,
+                       sizeof(entry), true)
+        != sizeof(entry))
+        return Error(EIO);
+
+    return {};
 }
 
 usize Fat32Fs::CountSpacePadding(u8* str, usize len)
@@ -397,39 +669,18 @@ void Fat32Fs::CopyLfnToString(Fat32LfnDirectoryEntry* entry, char* str)
 }
 void Fat32Fs::UpdateFsInfo()
 {
-    if (m_FsInfo.Free == 0xffffffff || m_FsInfo.StartAt == 0xffffffff)
-    {
-        u32* fatBuffer
-            = reinterpret_cast<u32*>(new u8[m_BootRecord.BytesPerSector]);
+    if (m_FsInfo.Free != 0xffffffff && m_FsInfo.StartAt != 0xffffffff) return;
 
-        usize clustersPerFatSector = m_BootRecord.BytesPerSector / 4;
-        m_FsInfo.Free              = 0;
+    // Building the bitmap recounts the free clusters, Sync writes FsInfo back
+    if (!BuildClusterBitmap()) return;
 
-        for (usize sector = 0; sector < m_BootRecord.SectorsPerFat; ++sector)
-        {
-            Assert(m_Device->Read(fatBuffer,
-                                  m_FatOffset
-                                      + sector * m_BootRecord.BytesPerSector,
-                                  m_BootRecord.BytesPerSector)
-                   >= 0);
-            for (usize cluster = 0; cluster < clustersPerFatSector; ++cluster)
-            {
-                if (fatBuffer[cluster] == 0)
-                {
-                    if (m_FsInfo.StartAt == 0xffffffff)
-                        m_FsInfo.StartAt
-                            = cluster + sector * clustersPerFatSector;
-                }
-
-                ++m_FsInfo.Free;
-            }
-        }
-
-        delete fatBuffer;
+    ScopedLock guard(m_FatLock);
+    if (m_FsInfo.StartAt == 0xffffffff)
+    {
+        usize first
+            = FindClearBit(m_ClusterBitmap, 2, m_ClusterCount + 2);
+        m_FsInfo.StartAt = first == NOT_FOUND ? 2 : first;
     }
 
-    m_Device->Write(&m_FsInfo,
-                    m_BootRecord.BytesPerSector * m_BootRecord.FsInfoSector
-                        + FAT32_FS_INFO_OFFSET,
-                    sizeof(Fat32FsInfo));
+    m_FsInfoDirty = true;
 }
@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 23.03.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -17,7 +17,10 @@ class Fat32Fs final : public Filesystem
         : Filesystem("Fat32Fs", flags)
     {
     }
-    virtual ~Fat32Fs() = default;
+    virtual ~Fat32Fs();
+
+    virtual bool UsesPageCache() const override { return true; }
+    virtual bool CachesLookups() const override { return true; }
 
     virtual ErrorOr<::Ref<DirectoryEntry>>
     Mount(StringView sourcePath, const void* data = nullptr) override;
@@ -26,21 +29,60 @@ class Fat32Fs final : public Filesystem
     virtual bool          Populate(DirectoryEntry* dentry) override;
 
     virtual ErrorOr<void> Stats(statfs& stats) override;
+    virtual ErrorOr<void> Sync(bool force = false) override;
+
+    inline usize          ClusterSize() const { return m_ClusterSize; }
 
+    // Clusters 0 and 1 don't exist, empty files have a zero first cluster
     constexpr bool        IsFinalCluster(usize cluster) const
     {
-        return cluster >= 0xffffff8;
+        return cluster < 2 || cluster >= 0xffffff8;
     }
 
-    bool  ReadBytes(u32 cluster, u8* out, off_t offset, usize bytes);
-    usize GetChainSize(u32 cluster);
+    /**
+     * @brief Reads, or writes `bytes` of the inode's data at `offset`, with
+     * a single device request per contiguous run of clusters
+     *
+     * @return the number of bytes transferred, which is less, than `bytes`,
+     * if the chain ends early
+     */
+    isize         ReadWriteBytes(Fat32FsINode* inode, u8* buffer, off_t offset,
+                                 usize bytes, bool write = false);
+    /**
+     * @brief Makes sure, that the inode's chain can hold at least `size`
+     * bytes, the new clusters are allocated after its last one, if possible
+     */
+    ErrorOr<void> GrowChain(Fat32FsINode* inode, usize size);
+    /**
+     * @brief Writes the inode's first cluster, and size back to its entry in
+     * the parent directory
+     */
+    ErrorOr<void> UpdateDirectoryEntry(Fat32FsINode* inode);
+    usize         GetChainSize(u32 cluster);
 
-    u32   AllocateCluster();
-    u32   AllocateClusters(usize count);
-    u32   GetNextCluster(u32 cluster);
-    u32   SkipCluster(u32 cluster, usize count, bool& endCluster);
+    /**
+     * @brief Allocates a run of up to `count` contiguous clusters, starting
+     * at `goal`, or as close after it, as possible, the run is chained, and
+     * terminated in the FAT
+     *
+     * @return the first cluster of the run, or 0, if there are no free
+     * clusters left, `count` is updated to the length of the run
+     */
+    u32           AllocateClusters(u32 goal, usize& count);
+    u32           GetNextCluster(u32 cluster);
 
   private:
+    // The FAT is read a page at a time on first use, Sync writes the dirty
+    // pages to every copy
+    struct FatPage
+    {
+        u32* Entries = nullptr;
+        bool Dirty   = false;
+    };
+    constexpr static usize FAT_ENTRIES_PER_PAGE = 1024;
+    constexpr static u32   FAT_ENTRY_MASK       = 0x0fffffff;
+    constexpr static u32   FAT_END_OF_CHAIN     = 0x0fffffff;
+
     INode*          m_Device = nullptr;
     Fat32BootRecord m_BootRecord;
     Fat32FsInfo     m_FsInfo;
@@ -51,6 +93,13 @@ class Fat32Fs final : public Filesystem
     Atomic<i64>     m_NextINodeIndex = 3;
     Fat32FsINode*   m_RootNode       = nullptr;
 
+    Spinlock        m_FatLock;
+    FatPage*        m_FatPages      = nullptr;
+    usize           m_FatPageCount  = 0;
+    // Set bits are the clusters in use, built on the first allocation
+    u64*            m_ClusterBitmap = nullptr;
+    bool            m_FsInfoDirty   = false;
+
     usize           GetClusterOffset(u32 cluster);
     constexpr usize
     GetClusterForDirectoryEntry(Fat32DirectoryEntry* entry) const
@@ -58,10 +107,12 @@ class Fat32Fs final : public Filesystem
         return (static_cast<u32>(entry->ClusterLow)
                 | (static_cast<u32>(entry->ClusterHigh) << 16));
     }
-    isize ReadWriteCluster(u8* dest, u32 cluster, isize offset, usize bytes,
-                           bool write = false);
-    isize ReadWriteClusters(u8* dest, u32 cluster, usize count, u32* endCluster,
-                            bool write = false);
+    u32*  LoadFatPage(usize page);
+    void  SetFatEntry(u32 cluster, u32 value);
+    bool  BuildClusterBitmap();
+    void  FlushFat();
+
+    bool  MapClusters(Fat32FsINode* inode);
 
     usize CountSpacePadding(u8* str, usize len);
     u8    GetLfnChecksum(u8* shortName);
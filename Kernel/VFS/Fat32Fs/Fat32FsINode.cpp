@@ -1,10 +1,12 @@
 /*
  * Created by v1tr10l7 on 22.03.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
 #include <Prism/Memory/Memory.hpp>
+#include <Prism/Memory/Scope.hpp>
+#include <Prism/Utility/Math.hpp>
 
 #include <VFS/Fat32Fs/Fat32Fs.hpp>
 #include <VFS/Fat32Fs/Fat32FsINode.hpp>
@@ -30,34 +32,10 @@ Fat32FsINode::Fat32FsINode(StringView name, class Filesystem* fs, mode_t mode)
     m_Metadata.ChangeTime       = Time::GetReal();
     m_Metadata.ModificationTime = Time::GetReal();
 
+    // Nodes for existing entries are created here too, so clusters are only
+    // allocated on the first write
     m_DirectoryOffset           = -1;
     m_Cluster                   = 0;
-
-    Fat32DirectoryEntry entry;
-    if (S_ISDIR(mode))
-    {
-        u32 cluster = m_Fat32Fs->AllocateClusters(1);
-        if (!cluster)
-        {
-            errno = ENOSPC;
-            return;
-        }
-
-        m_Cluster        = cluster;
-        entry.Attributes = Fat32Attribute::eDirectory;
-        // entry.SetCluster(cluster);
-    }
-
-    // m_DirectoryOffset
-    //     = m_Filesystem->InsertDirectoryEntry(m_Parent, entry, name);
-    if (m_DirectoryOffset == uintptr_t(-1)) { return; }
-
-    if (S_ISDIR(mode))
-    {
-        m_Populated = true;
-        Memory::Copy(entry.Name, ".          ", 11);
-        //
-    }
 }
 
 const UnorderedMap<StringView, INode*>& Fat32FsINode::Children() const
@@ -85,9 +63,62 @@ isize Fat32FsINode::Read(void* buffer, off_t offset, usize bytes)
 
     if (bytes == 0) return 0;
 
-    if (!m_Fat32Fs->ReadBytes(m_Cluster, reinterpret_cast<u8*>(buffer), offset,
-                              bytes))
-        return_err(-1, ENOENT);
+    isize read = m_Fat32Fs->ReadWriteBytes(
+        this, reinterpret_cast<u8*>(buffer), offset, bytes);
+    if (read < 0) return_err(-1, EIO);
+
+    return read;
+}
+isize Fat32FsINode::Write(const void* buffer, off_t offset, usize bytes)
+{
+    if (S_ISDIR(m_Metadata.Mode)) return_err(-1, EISDIR);
+    if (bytes == 0) return 0;
+    // Without an entry on the disk, neither the size, nor the clusters of
+    // the node could be recorded, so they would leak
+    if (m_DirectoryOffset == usize(-1)) return_err(-1, ENOTSUP);
+
+    ScopedLock guard(m_Lock);
+    usize      size    = m_Metadata.Size;
+    usize      cluster = m_Cluster;
+    auto       grown   = m_Fat32Fs->GrowChain(this, offset + bytes);
+    if (!grown) return_err(-1, grown.error());
+
+    // Zero the gap past the end, the clusters may hold a deleted file's data
+    if (static_cast<usize>(offset) > size)
+    {
+        usize       clusterSize = m_Fat32Fs->ClusterSize();
+        Scope<u8[]> zeroes      = new u8[clusterSize];
+        if (!zeroes) return_err(-1, ENOMEM);
+        Memory::Fill(zeroes.Raw(), 0, clusterSize);
+
+        for (usize position = size; position < static_cast<usize>(offset);)
+        {
+            usize count
+                = Math::Min(clusterSize, static_cast<usize>(offset) - position);
+            if (m_Fat32Fs->ReadWriteBytes(this, zeroes.Raw(), position, count,
+                                          true)
+                < 0)
+                return_err(-1, EIO);
+            position += count;
+        }
+    }
+
+    u8*   in      = reinterpret_cast<u8*>(const_cast<void*>(buffer));
+    isize written = m_Fat32Fs->ReadWriteBytes(this, in, offset, bytes, true);
+    if (written <= 0) return written < 0 ? -1 : 0;
+
+    if (static_cast<usize>(offset + written) > size)
+    {
+        m_Metadata.Size       = offset + written;
+        m_Metadata.BlockCount = Math::DivRoundUp(m_Metadata.Size,
+                                                 m_Fat32Fs->ClusterSize());
+    }
+    m_Metadata.ModificationTime = Time::GetReal();
+    m_Metadata.ChangeTime       = Time::GetReal();
+
+    if ((m_Metadata.Size != size || m_Cluster != cluster)
+        && !m_Fat32Fs->UpdateDirectoryEntry(this))
+        return_err(-1, EIO);
 
-    return bytes;
+    return written;
 }
@@ -1,13 +1,26 @@
 /*
  * Created by v1tr10l7 on 22.03.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
 #pragma once
 
+#include <Prism/Containers/Vector.hpp>
+
 #include <VFS/INode.hpp>
 
+// Clusters [Physical, Physical + Length) hold the clusters [Logical,
+// Logical + Length) of the file
+struct Fat32ClusterRun
+{
+    u32        Logical  = 0;
+    u32        Physical = 0;
+    u32        Length   = 0;
+
+    inline u32 End() const { return Logical + Length; }
+};
+
 class Fat32FsINode : public INode
 {
   public:
@@ -19,19 +32,22 @@ class Fat32FsINode : public INode
 
     virtual void  InsertChild(INode* node, StringView name) override;
     virtual isize Read(void* buffer, off_t offset, usize bytes) override;
-    virtual isize Write(const void* buffer, off_t offset, usize bytes) override
-    {
-        return -1;
-    }
+    virtual isize Write(const void* buffer, off_t offset, usize bytes) override;
     virtual ErrorOr<isize> Truncate(usize size) override { return -1; }
 
     friend class Fat32Fs;
 
   private:
-    class Fat32Fs*                         m_Fat32Fs         = nullptr;
-    usize                                  m_Cluster         = 0;
-    usize                                  m_DirectoryOffset = 0;
-    Atomic<usize>                          m_NextIndex       = 2;
+    class Fat32Fs*                   m_Fat32Fs         = nullptr;
+    Fat32FsINode*                    m_ParentDirectory = nullptr;
+    usize                            m_Cluster         = 0;
+    usize                            m_DirectoryOffset = 0;
+    Atomic<usize>                    m_NextIndex       = 2;
+
+    // The chain is walked once, and kept as runs of contiguous clusters
+    Vector<Fat32ClusterRun>          m_Runs;
+    usize                            m_ChainLength = 0;
+    bool                             m_RunsMapped  = false;
 
     UnorderedMap<StringView, INode*> m_Children;
 };
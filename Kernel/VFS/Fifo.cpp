@@ -27,7 +27,8 @@ FileDescriptor* Fifo::Open(Fifo::Direction direction)
     if (direction == Direction::eRead) ++m_ReaderCount;
     else ++m_WriterCount;
 
-    m_Event.Trigger(false);
+    m_ReadQueue.WakeAll();
+    m_WriteQueue.WakeAll();
     return fd;
 }
 
@@ -45,7 +46,8 @@ isize Fifo::Read(void* buffer, off_t offset, usize count)
         }
 
         m_Lock.Release();
-        m_Event.Await();
+        m_ReadQueue.WaitUntil(
+            [this]() { return m_Buffer.Used() > 0 || m_WriterCount == 0; });
         m_Lock.Acquire();
     }
 
@@ -54,7 +56,7 @@ isize Fifo::Read(void* buffer, off_t offset, usize count)
         [&]() -> isize
         { return m_Buffer.Read(reinterpret_cast<u8*>(buffer), count); });
 
-    m_Event.Trigger(false);
+    m_WriteQueue.WakeAll();
 cleanup:
     m_Lock.Release();
     return nread;
@@ -73,7 +75,8 @@ isize Fifo::Write(const void* buffer, off_t offset, usize count)
     while (m_Buffer.Used() == m_Buffer.Capacity())
     {
         m_Lock.Release();
-        m_Event.Await();
+        m_WriteQueue.WaitUntil(
+            [this]() { return m_Buffer.Used() < m_Buffer.Capacity(); });
         m_Lock.Acquire();
     }
 
@@ -83,7 +86,7 @@ isize Fifo::Write(const void* buffer, off_t offset, usize count)
     nwritten = CPU::AsUser(
         [&]() -> isize
         { return m_Buffer.Write(reinterpret_cast<const u8*>(buffer), count); });
-    m_Event.Trigger();
+    m_ReadQueue.WakeAll();
 
 cleanup:
     m_Lock.Release();
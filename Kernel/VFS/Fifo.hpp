@@ -7,7 +7,7 @@
 #pragma once
 
 #include <Prism/Containers/RingBuffer.hpp>
-#include <Scheduler/Event.hpp>
+#include <Scheduler/WaitQueue.hpp>
 
 #include <VFS/FileDescriptor.hpp>
 #include <VFS/INode.hpp>
@@ -37,7 +37,9 @@ class Fifo : public INode
   private:
     Atomic<usize> m_ReaderCount = 0;
     Atomic<usize> m_WriterCount = 0;
-    Event         m_Event;
+    // Separate queues, so a write never wakes up other writers
+    WaitQueue     m_ReadQueue;
+    WaitQueue     m_WriteQueue;
     RingBuffer    m_Buffer;
 
     bool          m_NonBlocking = false;
@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 15.07.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -20,6 +20,16 @@ ErrorOr<isize> File::Read(const UserBuffer& out, usize count, isize offset)
     ScopedLock guard(m_Lock);
     if (m_INode->IsDirectory()) return Error(EISDIR);
 
+    return m_INode->CachedRead(out.Raw(), offset, count);
+}
+
+ErrorOr<isize> File::DirectRead(const UserBuffer& out, usize count,
+                                isize offset)
+{
+    if (!m_INode || !m_INode->IsRegular()) return Read(out, count, offset);
+    ScopedLock guard(m_Lock);
+
+    // The page cache is written through, only unsynced shared mappings lag
     return m_INode->Read(out.Raw(), offset, count);
 }
 
@@ -28,7 +38,7 @@ ErrorOr<isize> File::Write(const UserBuffer& in, usize count, isize offset)
     ScopedLock guard(m_Lock);
     if (m_INode->IsDirectory()) return Error(EISDIR);
 
-    return m_INode->Write(in.Raw(), offset, count);
+    return m_INode->CachedWrite(in.Raw(), offset, count);
 }
 
 ErrorOr<const stat> File::Stat() const
@@ -38,7 +48,10 @@ ErrorOr<const stat> File::Stat() const
     return m_INode->Stats();
 }
 
-ErrorOr<isize> File::Truncate(off_t size) 
+ErrorOr<isize> File::Truncate(off_t size)
 {
-    return m_INode->Truncate(size);
+    auto result = m_INode->Truncate(size);
+    if (result) m_INode->CachedPages().Truncate(size);
+
+    return result;
 }
@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 30.05.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -32,6 +32,12 @@ class File
                                      isize offset = -1);
     virtual ErrorOr<isize>      Write(const UserBuffer& in, usize count,
                                       isize offset = -1);
+    /**
+     * @brief Reads straight from the filesystem, into the caller's buffer,
+     * bypassing the page cache, used by the descriptors opened with O_DIRECT
+     */
+    virtual ErrorOr<isize>      DirectRead(const UserBuffer& out, usize count,
+                                           isize offset = -1);
     virtual ErrorOr<const stat> Stat() const;
     virtual ErrorOr<isize>      Seek(i32 whence, off_t offset)
     {
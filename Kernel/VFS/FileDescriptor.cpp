@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 16.01.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -101,8 +101,11 @@ ErrorOr<isize> FileDescriptor::Read(const UserBuffer& out, usize count,
     // }
 
     if (offset < 0) offset = m_Offset;
+    if (!IsDirect()) m_Readahead.OnRead(m_File->INode(), offset, count);
 
-    isize bytesRead = m_File->Read(out, count, offset).ValueOr(0);
+    auto  result    = IsDirect() ? m_File->DirectRead(out, count, offset)
+                                 : m_File->Read(out, count, offset);
+    isize bytesRead = result.ValueOr(0);
     offset += bytesRead;
 
     m_Offset = offset;
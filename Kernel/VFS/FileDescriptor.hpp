@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 28.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -16,6 +16,7 @@
 #include <Prism/Memory/Ref.hpp>
 #include <VFS/DirectoryEntry.hpp>
 #include <VFS/File.hpp>
+#include <VFS/Readahead.hpp>
 
 enum class FileAccessMode
 {
@@ -84,11 +85,11 @@ class FileDescriptor : public RefCounted
         m_Flags = flags;
     }
 
-    inline i32  GetDescriptionFlags() const { return m_Flags; }
+    inline i32  GetDescriptionFlags() const { return m_DescriptionFlags; }
     inline void SetDescriptionFlags(i32 flags)
     {
         ScopedLock guard(m_Lock);
-        m_Flags = flags;
+        m_DescriptionFlags = flags;
     }
 
     virtual ErrorOr<isize> Read(const UserBuffer& out, usize count,
@@ -139,7 +140,17 @@ class FileDescriptor : public RefCounted
         return m_AccessMode & FileAccessMode::eWrite;
     }
 
-    inline bool IsNonBlocking() const { return m_Flags & O_NONBLOCK; }
+    inline bool IsNonBlocking() const
+    {
+        return m_DescriptionFlags & O_NONBLOCK;
+    }
+    // Whether the reads bypass the page cache
+    inline bool IsDirect() const { return m_DescriptionFlags & O_DIRECT; }
+    inline void SetReadaheadAdvice(ReadaheadAdvice advice)
+    {
+        ScopedLock guard(m_Lock);
+        m_Readahead.SetAdvice(advice);
+    }
 
     inline bool CloseOnExec() const { return m_Flags & O_CLOEXEC; }
     inline void SetCloseOnExec(bool closeOnExec)
@@ -161,6 +172,7 @@ class FileDescriptor : public RefCounted
 
     i32                      m_Flags            = 0;
     i32                      m_DescriptionFlags = 0;
+    ReadaheadState           m_Readahead;
 
     DirectoryEntries         m_DirEntries;
     DirectoryEntry::Iterator m_DirectoryIterator;
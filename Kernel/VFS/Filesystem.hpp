@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 19.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -62,6 +62,18 @@ class Filesystem : public RefCounted
      * @return DeviceID Backing device ID of the filesystem.
      */
     inline DeviceID              BackingDeviceID() const { return m_DeviceID; }
+    /**
+     * @brief Get the flags, the filesystem was mounted with, see MS_*.
+     *
+     * @return u32 Mount flags.
+     */
+    inline u32                   Flags() const { return m_Flags; }
+    /**
+     * @brief Set the mount flags, the VFS does so before mounting.
+     *
+     * @param flags Mount flags.
+     */
+    inline void                  SetFlags(u32 flags) { m_Flags = flags; }
     /**
      * @brief Get the root DirectoryEntry of this filesystem.
      *
@@ -87,6 +99,23 @@ class Filesystem : public RefCounted
      * @return StringView Flags as a string (e.g. "rw,noatime").
      */
     virtual StringView MountFlagsString() const { return "rw,noatime"; }
+    /**
+     * @brief Whether reads, and writes of regular files should go through the
+     * page cache, filesystems, which keep their files in memory anyway, don't
+     * need it.
+     *
+     * @return true if the page cache should be used.
+     */
+    virtual bool       UsesPageCache() const { return false; }
+    /**
+     * @brief Whether the lookups of the missing names, and of the whole paths
+     * can be cached, which only holds, if the namespace changes solely
+     * through the VFS, the synthetic filesystems, which grow entries on their
+     * own, can't.
+     *
+     * @return true if the lookups may be cached.
+     */
+    virtual bool       CachesLookups() const { return false; }
 
     /**
      * @brief Mount the filesystem.
@@ -122,11 +151,14 @@ class Filesystem : public RefCounted
     virtual ErrorOr<void> FreeINode(INode* inode) { return Error(ENOSYS); }
 
     /**
-     * @brief Synchronize the filesystem to the storage device.
+     * @brief Synchronize the filesystem to the storage device, the
+     * filesystems without one have nothing to synchronize.
+     * @param force Also write back the lazily updated metadata, which the
+     * periodic writeback leaves alone, i.e. sync(2), and syncfs(2)
      *
      * @return ErrorOr<void> Nothing or error.
      */
-    virtual ErrorOr<void> Sync() { return Error(ENOSYS); }
+    virtual ErrorOr<void> Sync(bool force = false) { return {}; }
     /**
      * @brief Populate directory contents, if lazy-loading is used.
      * @param Directory entry to populate.
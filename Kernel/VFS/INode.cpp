@@ -1,12 +1,16 @@
 /*
  * Created by v1tr10l7 on 19.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
 #include <Arch/CPU.hpp>
 
+#include <Memory/PMM.hpp>
+
+#include <Prism/Memory/Memory.hpp>
 #include <Prism/String/StringBuilder.hpp>
+#include <Prism/Utility/Math.hpp>
 
 #include <Scheduler/Process.hpp>
 #include <Scheduler/Thread.hpp>
@@ -37,6 +41,22 @@ INode::INode(StringView name, class Filesystem* fs)
     m_Metadata.GID = process->Credentials().EffectiveGroupID;
 }
 
+void INode::Retain()
+{
+    ScopedLock guard(m_Lock);
+    ++m_References;
+}
+void INode::Release()
+{
+    {
+        ScopedLock guard(m_Lock);
+        Assert(m_References > 0);
+        if (--m_References > 0) return;
+    }
+
+    IgnoreUnused(m_Filesystem->FreeINode(this));
+}
+
 const stat INode::Stats()
 {
     stat stats{};
@@ -95,6 +115,174 @@ bool INode::ValidatePermissions(const Credentials& creds, u32 acc)
     return true;
 }
 
+isize INode::CachedRead(void* buffer, off_t offset, usize bytes)
+{
+    // Once pages are mapped, reads go through the cache, shared mappings write
+    // there
+    if (!UsesPageCache() && m_CachedPages.PageCount() == 0)
+        return Read(buffer, offset, bytes);
+
+    usize size = m_Metadata.Size;
+    if (offset < 0) return_err(-1, EINVAL);
+    if (static_cast<usize>(offset) >= size) return 0;
+    bytes      = Math::Min(bytes, size - offset);
+
+    auto  out  = reinterpret_cast<u8*>(buffer);
+    usize done = 0;
+    while (done < bytes)
+    {
+        usize   position   = offset + done;
+        usize   index      = position / PMM::PAGE_SIZE;
+        usize   pageOffset = position % PMM::PAGE_SIZE;
+        usize   chunk = Math::Min(PMM::PAGE_SIZE - pageOffset, bytes - done);
+
+        Pointer page  = CachedPage(index);
+        if (!page) return done > 0 ? done : -1;
+
+        Memory::Copy(out + done, page.ToHigherHalf<u8*>() + pageOffset, chunk);
+        PMM::ReleasePage(page);
+        done += chunk;
+    }
+
+    return done;
+}
+isize INode::CachedWrite(const void* buffer, off_t offset, usize bytes)
+{
+    isize written = Write(buffer, offset, bytes);
+    if (written > 0) m_CachedPages.Update(offset, buffer, written);
+
+    return written;
+}
+bool INode::UsesPageCache() const
+{
+    return IsRegular() && m_Filesystem && m_Filesystem->UsesPageCache();
+}
+
+Pointer INode::CachedPage(usize index, bool write)
+{
+    if (index * PMM::PAGE_SIZE >= m_Metadata.Size) return_err(nullptr, ENXIO);
+
+    Pointer page = m_CachedPages.Lookup(index);
+    if (page) PageCache::RecordHit();
+    else
+    {
+        PageCache::RecordMiss();
+        page = FillPage(index);
+    }
+
+    return page;
+}
+
+Pointer INode::FillPage(usize index)
+{
+    // The page is read again, if a write raced with the read
+    for (;;)
+    {
+        Pointer page = PageCache::AllocatePage();
+        if (!page) return_err(nullptr, ENOMEM);
+
+        usize generation = m_CachedPages.Generation();
+        auto  data       = page.ToHigherHalf<u8*>();
+        isize read       = Read(data, index * PMM::PAGE_SIZE, PMM::PAGE_SIZE);
+        if (read < 0)
+        {
+            PMM::ReleasePage(page);
+            return nullptr;
+        }
+
+        // The part past the end of file is zeroed, so the page can be mapped as
+        // is
+        Memory::Fill(data + read, 0, PMM::PAGE_SIZE - read);
+        page = m_CachedPages.Insert(index, page, generation);
+        if (page) return page;
+    }
+}
+
+usize INode::Prefetch(usize index, usize count)
+{
+    // Runs are read through a bounce buffer of at most 128 KiB
+    constexpr usize MAX_RUN = 32;
+    if (!UsesPageCache()) return 0;
+
+    usize pageCount = Math::DivRoundUp(m_Metadata.Size, PMM::PAGE_SIZE);
+    if (index >= pageCount) return 0;
+    usize end    = index + Math::Min(count, pageCount - index);
+
+    usize filled = 0;
+    for (usize i = index; i < end;)
+    {
+        usize run = 0;
+        while (i + run < end && run < MAX_RUN)
+        {
+            Pointer page = m_CachedPages.Lookup(i + run);
+            if (page)
+            {
+                PMM::ReleasePage(page);
+                break;
+            }
+
+            ++run;
+        }
+
+        if (run == 0)
+        {
+            ++i;
+            continue;
+        }
+
+        usize read = FillPages(i, run);
+        filled += read;
+        if (read < run) break;
+        i += run;
+    }
+
+    return filled;
+}
+usize INode::FillPages(usize index, usize count)
+{
+    if (count == 1)
+    {
+        Pointer page = FillPage(index);
+        if (!page) return 0;
+
+        PMM::ReleasePage(page);
+        return 1;
+    }
+
+    usize bytes  = count * PMM::PAGE_SIZE;
+    u8*   buffer = new u8[bytes];
+    if (!buffer) return 0;
+
+    usize generation = m_CachedPages.Generation();
+    isize read       = Read(buffer, index * PMM::PAGE_SIZE, bytes);
+    if (read <= 0)
+    {
+        delete[] buffer;
+        return 0;
+    }
+
+    usize filled = 0;
+    for (; filled < count && filled * PMM::PAGE_SIZE < usize(read); ++filled)
+    {
+        Pointer page = PageCache::AllocatePage();
+        if (!page) break;
+
+        usize offset = filled * PMM::PAGE_SIZE;
+        usize chunk  = Math::Min(PMM::PAGE_SIZE, usize(read) - offset);
+        auto  data   = page.ToHigherHalf<u8*>();
+        Memory::Copy(data, buffer + offset, chunk);
+        Memory::Fill(data + chunk, 0, PMM::PAGE_SIZE - chunk);
+
+        // The rest is left to be read on demand, if a write raced with us
+        page = m_CachedPages.Insert(index + filled, page, generation);
+        if (!page) break;
+        PMM::ReleasePage(page);
+    }
+
+    delete[] buffer;
+    return filled;
+}
+
 ErrorOr<Ref<DirectoryEntry>> INode::CreateNode(Ref<DirectoryEntry> entry,
                                                mode_t mode, dev_t dev)
 {
@@ -183,3 +371,15 @@ ErrorOr<void> INode::UpdateTimestamps(timespec atime, timespec mtime,
     m_Dirty = true;
     return {};
 }
+ErrorOr<void> INode::Sync(bool dataOnly)
+{
+    if (!dataOnly && m_Dirty)
+    {
+        auto flushed = FlushMetadata();
+        if (!flushed && flushed.error() != ENOSYS)
+            return Error(flushed.error());
+    }
+
+    // Filesystems don't track per-inode blocks, so the whole one is synced
+    return m_Filesystem ? m_Filesystem->Sync() : ErrorOr<void>{};
+}
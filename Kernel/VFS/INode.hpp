@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 19.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -15,6 +15,7 @@
 #include <Prism/Utility/Delegate.hpp>
 
 #include <VFS/DirectoryEntry.hpp>
+#include <VFS/PageCache.hpp>
 
 #include <errno.h>
 
@@ -56,6 +57,13 @@ class INode
     INode(StringView name, class Filesystem* fs);
     virtual ~INode() {}
 
+    /**
+     * @brief Keeps the inode alive, after its last link is gone, the links
+     * themselves count as one reference, the last Release frees the inode
+     */
+    void                     Retain();
+    void                     Release();
+
     inline class Filesystem* Filesystem() { return m_Filesystem; }
     virtual const stat       Stats();
 
@@ -115,6 +123,43 @@ class INode
     virtual void  InsertChild(INode* node, StringView name)            = 0;
     virtual isize Read(void* buffer, off_t offset, usize bytes)        = 0;
     virtual isize Write(const void* buffer, off_t offset, usize bytes) = 0;
+
+    /**
+     * @brief Reads, and writes regular files through the page cache, if their
+     * filesystem uses it, the writes go through to Write immediately. Anything
+     * else goes straight to Read, and Write
+     */
+    isize         CachedRead(void* buffer, off_t offset, usize bytes);
+    isize         CachedWrite(const void* buffer, off_t offset, usize bytes);
+    bool          UsesPageCache() const;
+    inline PageCache::Mapping& CachedPages() { return m_CachedPages; }
+    /**
+     * @brief Looks up, or reads in the page cache's page at `index`, even if
+     * the filesystem doesn't use the cache for reads, so that the file can be
+     * mapped, the caller holds a reference to the returned page, filesystems,
+     * which keep the file contents in pages anyway, hand out their own.
+     * Unless `write` is set, the page may also be the shared zero page, so it
+     * must not be written to
+     */
+    virtual Pointer            CachedPage(usize index, bool write = false);
+    /**
+     * @brief Lets the file serve its contents straight from the `size` bytes
+     * of physical memory at `data`, until they're modified, the pages are
+     * kept alive by a reference of their own, filesystems, which can't do so,
+     * refuse, and the data has to be written instead
+     */
+    virtual bool               BorrowData(Pointer data, usize size)
+    {
+        return false;
+    }
+    /**
+     * @brief Reads the pages in [index, index + count), which aren't resident
+     * yet, into the page cache, each run of missing pages with a single read
+     *
+     * @return Number of pages read in
+     */
+    usize                      Prefetch(usize index, usize count);
+
     virtual ErrorOr<isize> IoCtl(usize request, usize arg)
     {
         return Error(ENODEV);
@@ -141,6 +186,11 @@ class INode
                                             timespec mtime = {},
                                             timespec ctime = {});
     virtual ErrorOr<void>  FlushMetadata() { return Error(ENOSYS); }
+    /**
+     * @brief Makes the inode's data, and unless `dataOnly` is set, its
+     * metadata durable, i.e. fsync and fdatasync
+     */
+    virtual ErrorOr<void>  Sync(bool dataOnly = false);
 
   protected:
     INode*            m_Parent;
@@ -148,9 +198,16 @@ class INode
     Spinlock          m_Lock;
     Metadata          m_Metadata = {};
 
-    class Filesystem* m_Filesystem;
+    class Filesystem* m_Filesystem = nullptr;
     bool              m_Populated = false;
     bool              m_Dirty     = false;
+
+  private:
+    usize              m_References = 1;
+    PageCache::Mapping m_CachedPages;
+
+    Pointer            FillPage(usize index);
+    usize              FillPages(usize index, usize count);
 };
 
 using INodeMetadata = INode::Metadata;
@@ -1,17 +1,19 @@
 /*
  * Created by v1tr10l7 on 19.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
 #include <Boot/BootModuleInfo.hpp>
 #include <Library/Logger.hpp>
+#include <Library/ZLib.hpp>
 
 #include <Memory/PMM.hpp>
 #include <Memory/VMM.hpp>
 
 #include <Prism/Utility/Math.hpp>
 #include <System/System.hpp>
+#include <Time/Time.hpp>
 
 #include <VFS/Initrd/Initrd.hpp>
 #include <VFS/Initrd/Ustar.hpp>
@@ -29,18 +31,54 @@ namespace Initrd
         }
 
         auto address = Pointer(initrd->LoadAddress).ToHigherHalf();
-        if (!Ustar::Validate(address))
+        auto format  = Ustar::Validate(address)
+                         ? ZLib::Format::eNone
+                         : ZLib::Detect(address, initrd->Size);
+        if (format == ZLib::Format::eNone && !Ustar::Validate(address))
         {
             LogError("Initrd: Unknown archive format!");
             return false;
         }
 
-        Assert(Ustar::Load(address, initrd->Size));
-        // usize pageCount
-        //     = (Math::AlignUp(initrd->Size, 512) + 512) / PMM::PAGE_SIZE;
-        // PMM::FreePages(address.FromHigherHalf<void*>(), pageCount);
+        // Files are served out of the archive, pinning the pages they lie on.
+        // The header-only pages are freed right away, the rest as files are
+        // rewritten, or deleted
+        Pointer physical    = Pointer(initrd->LoadAddress);
+        usize   first       = Math::AlignDown(physical.Raw(), PMM::PAGE_SIZE);
+        usize   last        = Math::AlignUp(physical.Raw() + initrd->Size,
+                                            PMM::PAGE_SIZE);
+        bool    releasable  = last <= PMM::GetMemoryTop();
+        bool    compressed  = format != ZLib::Format::eNone;
 
-        LogInfo("Initrd: Loaded successfully");
+        u64     start       = Time::GetMonotonicTime().Nanoseconds();
+        usize   freeAtStart = PMM::GetFreeMemory();
+        usize   size        = initrd->Size;
+        if (compressed)
+        {
+            // Nothing refers to the compressed image once extracted
+            ZLib::Inflater stream(address, initrd->Size);
+            Assert(Ustar::Load(stream));
+            size = stream.TotalOut();
+        }
+        else Assert(Ustar::Load(address, initrd->Size, releasable));
+
+        if (releasable)
+            for (usize page = first; page < last; page += PMM::PAGE_SIZE)
+                PMM::ReleasePage(Pointer(page));
+
+        u64   elapsed   = Time::GetMonotonicTime().Nanoseconds() - start;
+        isize footprint = isize(freeAtStart) - isize(PMM::GetFreeMemory());
+
+        StringView method = "by copying";
+        if (format == ZLib::Format::eGZip) method = "from gzip";
+        else if (format == ZLib::Format::eZLib) method = "from zlib";
+        else if (releasable) method = "in place";
+
+        LogInfo(
+            "Initrd: Loaded {} KiB ({} KiB image) {} in {} us, the free "
+            "memory changed by {} KiB",
+            size / 1024, initrd->Size / 1024, method, elapsed / 1000,
+            -footprint / 1024);
         return true;
     }
 } // namespace Initrd
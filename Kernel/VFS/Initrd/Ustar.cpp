@@ -1,13 +1,12 @@
 /*
  * Created by v1tr10l7 on 19.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
 
 #include <API/UnixTypes.hpp>
 #include <Drivers/Core/Device.hpp>
-#include <Library/ZLib.hpp>
 
 #include <Prism/String/StringUtils.hpp>
 #include <Prism/Utility/Math.hpp>
@@ -26,39 +25,21 @@ namespace Ustar
         return StringView(file->Signature, MAGIC_LENGTH - 1) == MAGIC;
     }
 
-    ErrorOr<void> Load(Pointer address, usize size)
+    namespace
     {
-        LogTrace("USTAR: Loading at '{:#x}'...", address);
-
-        // ZLib::Decompressor decompressor(address, size);
-        // Assert(decompressor.Decompress(size));
-        //
-        // address = decompressor.DecompressedData();
-        // size = decompressor.DecompressedSize();
-
-        auto current = address.As<FileHeader>();
-        auto getNextFile
-            = [](FileHeader* current, usize fileSize) -> FileHeader*
-        {
-            Pointer nextFile
-                = Pointer(current).Offset(512 + Math::AlignUp(fileSize, 512));
-
-            return nextFile.As<FileHeader>();
-        };
-
-        while (StringView(current->Signature, MAGIC_LENGTH - 1) == MAGIC)
+        /**
+         * @brief Creates the entry described by the header, except for the
+         * data of the regular files
+         *
+         * @return the regular file, into which the data should go, if any
+         */
+        ErrorOr<Ref<DirectoryEntry>> CreateEntry(const FileHeader* current)
         {
             PathView filename(current->FileName);
             PathView linkName(current->LinkName);
 
             auto     mode = StringUtils::ToNumber<mode_t>(current->Mode, 8);
-            usize    size = StringUtils::ToNumber<usize>(current->FileSize, 8);
-
-            if (filename == "./"_pv)
-            {
-                current = getNextFile(current, size);
-                continue;
-            }
+            if (filename == "./"_pv) return nullptr;
 
             Ref<DirectoryEntry> dentry = nullptr;
             switch (current->Type)
@@ -73,17 +54,7 @@ namespace Ustar
                             "USTAR: Failed to create regular file!, path: "
                             "'{}'",
                             filename);
-                    else if (dentry->INode()->Write(
-                                 reinterpret_cast<u8*>(
-                                     reinterpret_cast<uintptr_t>(current)
-                                     + 512),
-                                 0, size)
-                             != isize(size))
-                        LogError(
-                            "USTAR: Could not write to regular file! path: "
-                            "'{}'",
-                            filename);
-                    break;
+                    return dentry;
                 case FILE_TYPE_HARD_LINK:
                     if (!VFS::Link(filename, linkName))
                         LogError(
@@ -130,9 +101,107 @@ namespace Ustar
                 default: break;
             }
 
+            return nullptr;
+        }
+    }; // namespace
+
+    ErrorOr<void> Load(Pointer address, usize size, bool inPlace)
+    {
+        LogTrace("USTAR: Loading at '{:#x}'...", address);
+
+        auto current = address.As<FileHeader>();
+        auto getNextFile
+            = [](FileHeader* current, usize fileSize) -> FileHeader*
+        {
+            Pointer nextFile
+                = Pointer(current).Offset(512 + Math::AlignUp(fileSize, 512));
+
+            return nextFile.As<FileHeader>();
+        };
+
+        while (StringView(current->Signature, MAGIC_LENGTH - 1) == MAGIC)
+        {
+            usize size   = StringUtils::ToNumber<usize>(current->FileSize, 8);
+            auto  dentry = TryOrRet(CreateEntry(current));
+            if (!dentry)
+            {
+                current = getNextFile(current, size);
+                continue;
+            }
+
+            if (inPlace
+                && dentry->INode()->BorrowData(
+                    Pointer(current).Offset(512).FromHigherHalf(), size))
+            {
+                current = getNextFile(current, size);
+                continue;
+            }
+            if (size
+                && dentry->INode()->Write(
+                       reinterpret_cast<u8*>(
+                           reinterpret_cast<uintptr_t>(current) + 512),
+                       0, size)
+                       != isize(size))
+                LogError(
+                    "USTAR: Could not write to regular file! path: "
+                    "'{}'",
+                    current->FileName);
+            // Writes only ever grow the file, so its size has to be set
+            (void)dentry->INode()->Truncate(size);
+
             current = getNextFile(current, size);
         }
 
         return {};
     }
+    ErrorOr<void> Load(ZLib::Inflater& stream)
+    {
+        LogTrace("USTAR: Loading from a compressed stream...");
+
+        // Headers are pulled out of the stream one at a time, and data goes
+        // straight from the inflater's window into the files
+        alignas(FileHeader) u8 block[512];
+        auto                   current = reinterpret_cast<FileHeader*>(block);
+        for (;;)
+        {
+            if (stream.Read(block, sizeof(block)) != sizeof(block)) break;
+            if (StringView(current->Signature, MAGIC_LENGTH - 1) != MAGIC)
+                break;
+
+            usize size   = StringUtils::ToNumber<usize>(current->FileSize, 8);
+            auto  dentry = TryOrRet(CreateEntry(current));
+
+            usize padded = Math::AlignUp(size, 512);
+            for (usize offset = 0; offset < padded;)
+            {
+                const u8* data  = nullptr;
+                isize     bytes = stream.Next(data, padded - offset);
+                if (bytes <= 0) return Error(EIO);
+
+                usize count
+                    = offset < size ? Math::Min(usize(bytes), size - offset)
+                                    : 0;
+                if (dentry && count
+                    && dentry->INode()->Write(data, offset, count)
+                           != isize(count))
+                {
+                    LogError(
+                        "USTAR: Could not write to regular file! path: "
+                        "'{}'",
+                        current->FileName);
+                    dentry = nullptr;
+                }
+
+                offset += bytes;
+            }
+            if (dentry) (void)dentry->INode()->Truncate(size);
+        }
+
+        // The end of the archive is followed by the checksum of the stream
+        const u8* rest = nullptr;
+        while (stream.Next(rest, 64_kib) > 0);
+
+        if (stream.Failed()) return Error(EIO);
+        return {};
+    }
 } // namespace Ustar
@@ -1,11 +1,13 @@
 /*
  * Created by v1tr10l7 on 19.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
 #pragma once
 
+#include <Library/ZLib.hpp>
+
 #include <Prism/Core/Error.hpp>
 #include <Prism/Core/Types.hpp>
 #include <Prism/Memory/Pointer.hpp>
@@ -48,5 +50,18 @@ namespace Ustar
     constexpr const u8   FILE_TYPE_CONTIGUOUS       = '7';
 
     bool                 Validate(Pointer address);
-    ErrorOr<void>        Load(Pointer address, usize size);
+    /**
+     * @brief Extracts the archive at `address` into the root filesystem
+     *
+     * @param inPlace Whether the regular files may keep serving their data
+     * out of the archive, in which case they hold references to its pages,
+     * and the caller should drop its own, once it's done with the archive
+     */
+    ErrorOr<void>        Load(Pointer address, usize size,
+                              bool inPlace = false);
+    /**
+     * @brief Extracts the archive, as it's being decompressed, only a single
+     * header, and the window of the inflater are ever held in memory
+     */
+    ErrorOr<void>        Load(ZLib::Inflater& stream);
 } // namespace Ustar
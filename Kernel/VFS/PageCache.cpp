@@ -0,0 +1,306 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#include <Memory/PMM.hpp>
+
+#include <Prism/Containers/Vector.hpp>
+#include <Prism/Memory/Memory.hpp>
+#include <Prism/Utility/Math.hpp>
+
+#include <Time/Time.hpp>
+#include <VFS/PageCache.hpp>
+
+namespace PageCache
+{
+    namespace
+    {
+        // The cache may take up to half the memory, and shrinks below 1/32 free
+        constexpr usize CACHE_LIMIT_DIVISOR = 2;
+        constexpr usize LOW_MEMORY_DIVISOR  = 32;
+        constexpr usize RECLAIM_BATCH       = 32;
+
+        // Resident pages, in the order of insertion, the clock hand sweeps
+        // from the front, and moves the pages, it has spared, to the back
+        Spinlock        s_ClockLock;
+        Page::List      s_Clock;
+
+        Atomic<usize>   s_PageCount  = 0;
+        Atomic<usize>   s_DirtyCount = 0;
+        Atomic<usize>   s_Hits       = 0;
+        Atomic<usize>   s_Misses     = 0;
+        Atomic<usize>   s_Evictions  = 0;
+
+        usize           PageLimit()
+        {
+            return PMM::GetTotalMemory() / PMM::PAGE_SIZE / CACHE_LIMIT_DIVISOR;
+        }
+        bool UnderPressure()
+        {
+            return s_PageCount.Load() >= PageLimit()
+                || PMM::GetFreeMemory()
+                       < PMM::GetTotalMemory() / LOW_MEMORY_DIVISOR;
+        }
+    }; // namespace
+
+    Pointer Mapping::Lookup(usize index)
+    {
+        ScopedLock guard(m_Lock);
+        Page*      page = m_Pages.Find(index);
+        if (!page) return nullptr;
+
+        page->Referenced.Store(true);
+        PMM::ReferencePage(page->Physical);
+        return page->Physical;
+    }
+    Pointer Mapping::Insert(usize index, Pointer physical, usize generation)
+    {
+        Page*      page = new Page;
+
+        ScopedLock guard(m_Lock);
+        if (Page* resident = m_Pages.Find(index))
+        {
+            delete page;
+            PMM::ReleasePage(physical);
+
+            resident->Referenced.Store(true);
+            PMM::ReferencePage(resident->Physical);
+            return resident->Physical;
+        }
+
+        // A write has landed, while the page was being read, so it might
+        // miss the written data
+        if (generation != ANY_GENERATION && generation != m_Generation)
+        {
+            delete page;
+            PMM::ReleasePage(physical);
+            return nullptr;
+        }
+
+        // Untracked pages are handed back, and go away with their reference
+        if (!page || !m_Pages.Insert(index, page))
+        {
+            delete page;
+            return physical;
+        }
+
+        page->Physical = physical;
+        page->Owner    = this;
+        page->Index    = index;
+        page->Referenced.Store(true);
+
+        // The reference we got becomes the cache's, the caller gets a new one
+        PMM::ReferencePage(physical);
+        {
+            ScopedLock clockGuard(s_ClockLock);
+            s_Clock.PushBack(page);
+        }
+
+        ++s_PageCount;
+        return physical;
+    }
+
+    usize Mapping::Generation()
+    {
+        ScopedLock guard(m_Lock);
+        return m_Generation;
+    }
+
+    void Mapping::Update(usize offset, const void* data, usize bytes,
+                         bool dirty)
+    {
+        {
+            ScopedLock guard(m_Lock);
+            ++m_Generation;
+            if (m_Pages.Empty()) return;
+        }
+
+        auto  source = reinterpret_cast<const u8*>(data);
+        usize done   = 0;
+        while (done < bytes)
+        {
+            usize   position   = offset + done;
+            usize   pageOffset = position % PMM::PAGE_SIZE;
+            usize   chunk
+                = Math::Min(PMM::PAGE_SIZE - pageOffset, bytes - done);
+
+            Pointer page  = Lookup(position / PMM::PAGE_SIZE);
+            if (page)
+            {
+                Memory::Copy(page.ToHigherHalf<u8*>() + pageOffset,
+                             source + done, chunk);
+                if (dirty) MarkDirty(position / PMM::PAGE_SIZE);
+                PMM::ReleasePage(page);
+            }
+
+            done += chunk;
+        }
+    }
+    bool Mapping::MarkDirty(usize index)
+    {
+        ScopedLock guard(m_Lock);
+        Page*      page = m_Pages.Find(index);
+        if (!page) return false;
+        if (page->Dirty.Load()) return true;
+
+        page->DirtiedAt = Time::GetMonotonicTime().Nanoseconds();
+        page->Dirty.Store(true);
+        ++m_DirtyCount;
+        ++s_DirtyCount;
+        return true;
+    }
+    usize Mapping::CollectDirty(Vector<DirtyPage>& pages, u64 dirtiedBefore)
+    {
+        ScopedLock guard(m_Lock);
+        if (m_DirtyCount.Load() == 0) return 0;
+
+        usize collected = 0;
+        m_Pages.ForEach(
+            [&](usize index, Page* page)
+            {
+                if (!page->Dirty.Load() || page->DirtiedAt >= dirtiedBefore)
+                    return;
+
+                page->Dirty.Store(false);
+                --m_DirtyCount;
+                --s_DirtyCount;
+
+                PMM::ReferencePage(page->Physical);
+                pages.PushBack({index, page->Physical});
+                ++collected;
+            });
+
+        return collected;
+    }
+    void Mapping::Truncate(usize size)
+    {
+        ScopedLock guard(m_Lock);
+        ++m_Generation;
+        if (m_Pages.Empty()) return;
+
+        usize         firstDropped = Math::DivRoundUp(size, PMM::PAGE_SIZE);
+        Vector<Page*> dropped;
+        m_Pages.ForEach(
+            [&](usize index, Page* page)
+            {
+                if (index >= firstDropped) dropped.PushBack(page);
+            });
+        for (auto page : dropped) Evict(page);
+
+        usize tail = size % PMM::PAGE_SIZE;
+        if (Page* last = tail ? m_Pages.Find(size / PMM::PAGE_SIZE) : nullptr)
+            Memory::Fill(last->Physical.ToHigherHalf<u8*>() + tail, 0,
+                         PMM::PAGE_SIZE - tail);
+    }
+
+    usize Mapping::Drop(usize index, usize count)
+    {
+        ScopedLock    guard(m_Lock);
+        Vector<Page*> dropped;
+        m_Pages.ForEach(
+            [&](usize pageIndex, Page* page)
+            {
+                if (pageIndex < index || pageIndex - index >= count) return;
+                if (page->Dirty.Load()
+                    || PMM::PageReferenceCount(page->Physical) > 1)
+                    return;
+
+                dropped.PushBack(page);
+            });
+        for (auto page : dropped) Evict(page);
+
+        return dropped.Size();
+    }
+
+    void Mapping::Evict(Page* page)
+    {
+        if (page->Dirty.Load())
+        {
+            --m_DirtyCount;
+            --s_DirtyCount;
+        }
+
+        m_Pages.Erase(page->Index);
+        {
+            ScopedLock clockGuard(s_ClockLock);
+            if (page->Hook.IsLinked()) page->Hook.Unlink(page);
+        }
+
+        --s_PageCount;
+        PMM::ReleasePage(page->Physical);
+        delete page;
+    }
+
+    Pointer AllocatePage()
+    {
+        if (UnderPressure()) Reclaim(RECLAIM_BATCH);
+
+        Pointer page = PMM::AllocatePages(1);
+        if (!page && Reclaim(RECLAIM_BATCH) > 0) page = PMM::AllocatePages(1);
+
+        return page;
+    }
+    usize Reclaim(usize pages)
+    {
+        usize      reclaimed = 0;
+
+        ScopedLock guard(s_ClockLock);
+        // Every page gets at most one second chance per sweep
+        usize      budget = 2 * s_PageCount.Load();
+        while (reclaimed < pages && budget-- > 0 && !s_Clock.Empty())
+        {
+            Page* page = s_Clock.PopFrontElement();
+            s_Clock.PushBack(page);
+
+            if (page->Referenced.Load())
+            {
+                page->Referenced.Store(false);
+                continue;
+            }
+
+            // Mappings take the clock's lock under their own, so only try
+            // theirs
+            Mapping* owner = page->Owner;
+            if (!owner->m_Lock.TestAndAcquire()) continue;
+
+            // Someone is still copying from, or to the page, or it has yet to
+            // be written back
+            if (PMM::PageReferenceCount(page->Physical) > 1
+                || page->Dirty.Load())
+            {
+                owner->m_Lock.Release();
+                continue;
+            }
+
+            owner->m_Pages.Erase(page->Index);
+            page->Hook.Unlink(page);
+            owner->m_Lock.Release();
+
+            PMM::ReleasePage(page->Physical);
+            delete page;
+
+            --s_PageCount;
+            ++s_Evictions;
+            ++reclaimed;
+        }
+
+        return reclaimed;
+    }
+
+    void       RecordHit() { ++s_Hits; }
+    void       RecordMiss() { ++s_Misses; }
+    Statistics GetStatistics()
+    {
+        Statistics stats;
+        stats.Pages     = s_PageCount.Load();
+        stats.Limit     = PageLimit();
+        stats.Dirty     = s_DirtyCount.Load();
+        stats.Hits      = s_Hits.Load();
+        stats.Misses    = s_Misses.Load();
+        stats.Evictions = s_Evictions.Load();
+
+        return stats;
+    }
+}; // namespace PageCache
@@ -0,0 +1,180 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#pragma once
+
+#include <Library/Locking/Spinlock.hpp>
+#include <Library/RadixTree.hpp>
+
+#include <Prism/Containers/IntrusiveList.hpp>
+#include <Prism/Containers/Vector.hpp>
+#include <Prism/Core/NonCopyable.hpp>
+#include <Prism/Memory/Pointer.hpp>
+#include <Prism/Utility/Atomic.hpp>
+
+/**
+ * @brief Global cache of file contents, in page sized chunks. Every inode owns
+ * a PageCache::Mapping, which indexes its resident pages by their offset
+ * within the file, while all of the resident pages sit on a single clock list,
+ * from which they are evicted, whenever the cache outgrows its limit, or the
+ * PMM runs low on free memory
+ *
+ * Resident pages hold one PMM reference on behalf of the cache, everyone
+ * copying from, or to them takes an additional one, so that they can be
+ * evicted, or truncated away at any time, without pulling the memory from
+ * under their readers
+ *
+ * Pages may also be marked dirty, when their owner writes back lazily, dirty
+ * pages are never reclaimed, until the owner collects them for writeback
+ */
+namespace PageCache
+{
+    class Mapping;
+    struct Statistics
+    {
+        usize Pages     = 0;
+        usize Limit     = 0;
+        usize Dirty     = 0;
+        usize Hits      = 0;
+        usize Misses    = 0;
+        usize Evictions = 0;
+    };
+
+    struct Page : public NonCopyable<Page>
+    {
+        // Physical address of the cached data
+        Pointer      Physical   = nullptr;
+        Mapping*     Owner      = nullptr;
+        usize        Index      = 0;
+        // Set on every lookup, and cleared by the clock hand, pages that
+        // weren't referenced since the last sweep are evicted
+        Atomic<bool> Referenced = false;
+        // Set, while the page holds data, which has yet to be written back
+        Atomic<bool> Dirty      = false;
+        // Monotonic time, at which the page got dirty
+        u64          DirtiedAt  = 0;
+
+        using List              = IntrusiveList<Page>;
+
+      private:
+        friend class IntrusiveList<Page>;
+        friend struct IntrusiveListHook<Page>;
+        friend usize Reclaim(usize);
+        friend class Mapping;
+
+        IntrusiveListHook<Page> Hook;
+    };
+
+    struct DirtyPage
+    {
+        usize   Index    = 0;
+        Pointer Physical = nullptr;
+    };
+
+    class Mapping : public NonCopyable<Mapping>
+    {
+      public:
+        static constexpr usize ANY_GENERATION = usize(-1);
+
+        Mapping() = default;
+        ~Mapping() { Invalidate(); }
+
+        inline usize PageCount() const { return m_Pages.Size(); }
+        inline usize DirtyCount() const { return m_DirtyCount.Load(); }
+
+        /**
+         * @brief Looks up the page caching the file data at `index` *
+         * PAGE_SIZE, the caller holds a reference to the returned page, and
+         * must drop it with PMM::ReleasePage, once it's done with it
+         *
+         * @return Physical address of the page, or nullptr, if it isn't
+         * resident
+         */
+        Pointer      Lookup(usize index);
+        /**
+         * @brief Inserts the freshly filled `page`, obtained from
+         * PageCache::AllocatePage, at `index`, if someone else has raced us to
+         * it, the page is released, and theirs is returned instead. Pages read
+         * from the backing store pass the `generation`, sampled before the
+         * read, and are refused, if the mapping was written to since then
+         *
+         * @return The page, which should be used, the caller holds one
+         * reference to it either way, or nullptr, if the page was stale
+         */
+        Pointer      Insert(usize index, Pointer page,
+                            usize generation = ANY_GENERATION);
+        /**
+         * @brief Returns the generation of the mapping, which advances on
+         * every Update, and Truncate
+         */
+        usize        Generation();
+
+        /**
+         * @brief Copies `bytes` of `data` written at `offset` into the resident
+         * pages, which cover them, so that they stay coherent with the backing
+         * store, or so that they get written back later, if `dirty` is set
+         */
+        void         Update(usize offset, const void* data, usize bytes,
+                            bool dirty = false);
+        /**
+         * @brief Marks the resident page at `index` dirty
+         *
+         * @return false, if the page isn't resident
+         */
+        bool         MarkDirty(usize index);
+        /**
+         * @brief Collects the pages, which got dirty before `dirtiedBefore`,
+         * in the ascending order of their indices, and marks them clean, the
+         * caller holds a reference to each of them, and has to drop it, once
+         * they're written back
+         *
+         * @return Number of pages collected
+         */
+        usize        CollectDirty(Vector<DirtyPage>& pages, u64 dirtiedBefore);
+        /**
+         * @brief Drops the pages past `size`, and zeroes the tail of the last
+         * one
+         */
+        void         Truncate(usize size);
+        inline void  Invalidate() { Truncate(0); }
+        /**
+         * @brief Evicts the pages in [index, index + count), which are
+         * neither dirty, nor in use, i.e. POSIX_FADV_DONTNEED
+         *
+         * @return Number of pages evicted
+         */
+        usize        Drop(usize index, usize count);
+
+      private:
+        friend usize     Reclaim(usize);
+
+        Spinlock         m_Lock;
+        RadixTree<Page>  m_Pages;
+        Atomic<usize>    m_DirtyCount = 0;
+        usize            m_Generation = 0;
+
+        void             Evict(Page* page);
+    };
+
+    /**
+     * @brief Allocates a page for the cache, reclaiming resident pages, if
+     * needed
+     *
+     * @return Physical address of the page, or nullptr on failure
+     */
+    Pointer    AllocatePage();
+    /**
+     * @brief Evicts up to `pages` of resident pages, which are neither
+     * referenced recently, nor in use
+     *
+     * @return Number of pages evicted
+     */
+    usize      Reclaim(usize pages);
+
+    void       RecordHit();
+    void       RecordMiss();
+    Statistics GetStatistics();
+}; // namespace PageCache
@@ -0,0 +1,96 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#include <Library/Locking/Spinlock.hpp>
+
+#include <Prism/Containers/UnorderedMap.hpp>
+#include <Prism/Containers/Vector.hpp>
+#include <Prism/Utility/Atomic.hpp>
+
+#include <VFS/DirectoryEntry.hpp>
+#include <VFS/Filesystem.hpp>
+#include <VFS/INode.hpp>
+#include <VFS/PathCache.hpp>
+
+namespace PathCache
+{
+    namespace
+    {
+        constexpr usize MAX_CACHED_PATHS = 1024;
+
+        struct CachedPath
+        {
+            Ref<DirectoryEntry> Base        = nullptr;
+            bool                FollowLinks = false;
+            u64                 Generation  = 0;
+            VFS::PathResolution Resolution;
+        };
+
+        Spinlock                         s_Lock;
+        UnorderedMap<String, CachedPath> s_Paths;
+        Atomic<u64>                      s_Generation = 1;
+
+        // Stale entries are dropped when full, if none are stale, start over
+        void                             Shrink(u64 generation)
+        {
+            Vector<String> stale;
+            for (const auto& [path, cached] : s_Paths)
+                if (cached.Generation != generation) stale.PushBack(path);
+            if (stale.Size() == 0)
+                for (const auto& [path, cached] : s_Paths) stale.PushBack(path);
+
+            for (const auto& path : stale) s_Paths.Erase(path);
+        }
+
+        bool IsCacheable(const Ref<DirectoryEntry>& entry)
+        {
+            if (!entry) return true;
+
+            auto inode = entry->INode();
+            auto fs    = inode ? inode->Filesystem() : nullptr;
+            return fs && fs->CachesLookups();
+        }
+    }; // namespace
+
+    bool Lookup(Ref<DirectoryEntry> base, PathView path, bool followLinks,
+                VFS::PathResolution& resolution)
+    {
+        u64        generation = s_Generation.Load();
+
+        ScopedLock guard(s_Lock);
+        auto       it = s_Paths.Find(String(StringView(path)));
+        if (it == s_Paths.end()) return false;
+
+        const auto& cached = it->Value;
+        if (cached.Generation != generation || cached.Base != base
+            || cached.FollowLinks != followLinks)
+            return false;
+
+        resolution = cached.Resolution;
+        return true;
+    }
+    void Insert(Ref<DirectoryEntry> base, PathView path, bool followLinks,
+                const VFS::PathResolution& resolution, u64 generation)
+    {
+        if (!resolution.Entry || generation != s_Generation.Load()) return;
+        if (!IsCacheable(resolution.Entry) || !IsCacheable(resolution.Parent))
+            return;
+
+        CachedPath cached;
+        cached.Base        = base;
+        cached.FollowLinks = followLinks;
+        cached.Generation  = generation;
+        cached.Resolution  = resolution;
+
+        ScopedLock guard(s_Lock);
+        if (s_Paths.Size() >= MAX_CACHED_PATHS) Shrink(generation);
+
+        s_Paths[String(StringView(path))] = cached;
+    }
+
+    u64  Generation() { return s_Generation.Load(); }
+    void Invalidate() { ++s_Generation; }
+}; // namespace PathCache
@@ -0,0 +1,48 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#pragma once
+
+#include <Prism/Utility/Path.hpp>
+
+#include <VFS/VFS.hpp>
+
+/**
+ * @brief Cache of the whole paths, which were successfully resolved, keyed by
+ * the path and the directory, it was resolved from, so that the hot paths,
+ * like the ones, which get stat'ed over and over, take a single hash probe,
+ * instead of walking every component
+ *
+ * Only the positive results are cached, a name, which starts to exist, can't
+ * change what an existing path resolves to, the removals, renames and mounts
+ * do however, so they invalidate the whole cache at once, by bumping its
+ * generation
+ */
+namespace PathCache
+{
+    /**
+     * @brief Looks up the resolution of `path`, relative to `base`
+     *
+     * @return true, if the path was found, and `resolution` was filled in
+     */
+    bool Lookup(Ref<DirectoryEntry> base, PathView path, bool followLinks,
+                VFS::PathResolution& resolution);
+    /**
+     * @brief Caches the `resolution` of `path`, the `generation` has to be
+     * taken, before the path was resolved, so that the results, which raced
+     * with an invalidation, are never served
+     */
+    void Insert(Ref<DirectoryEntry> base, PathView path, bool followLinks,
+                const VFS::PathResolution& resolution, u64 generation);
+
+    u64  Generation();
+
+    /**
+     * @brief Forgets every cached path, has to be called, whenever an
+     * existing name is removed, or starts to resolve elsewhere
+     */
+    void Invalidate();
+}; // namespace PathCache
@@ -1,6 +1,6 @@
 /*resolver.INode()
  * Created by v1tr10l7 on 20.06.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -20,8 +20,8 @@ ErrorOr<void> PathResolver::Initialize(Ref<class ::DirectoryEntry> const root,
     if (path.Empty()) return Terminate(EINVAL);
     m_Root           = root ?: VFS::RootDirectoryEntry();
 
+    // Resolve splits the path, once it knows if the last component is looked up
     m_Path           = path;
-    m_Tokens         = m_Path.Split();
     m_Position       = 0;
 
     m_Parent         = path.Absolute() ? VFS::RootDirectoryEntry() : root;
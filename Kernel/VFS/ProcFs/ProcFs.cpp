@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 19.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -8,12 +8,16 @@
 #include <Boot/CommandLine.hpp>
 
 #include <Drivers/Core/DeviceManager.hpp>
+#include <Memory/Allocator/BuddyAllocator.hpp>
+#include <Memory/Allocator/KernelHeap.hpp>
 #include <Prism/String/StringUtils.hpp>
 
+#include <Scheduler/Scheduler.hpp>
 #include <System/System.hpp>
 #include <Time/Time.hpp>
 
 #include <VFS/MountPoint.hpp>
+#include <VFS/PageCache.hpp>
 #include <VFS/VFS.hpp>
 
 #include <VFS/ProcFs/ProcFs.hpp>
@@ -21,6 +25,27 @@
 
 UnorderedMap<pid_t, Process*> ProcFs::s_Processes;
 
+struct ProcFsBuddyInfoProperty : public ProcFsProperty
+{
+    virtual void GenerateRecord() override
+    {
+        Buffer.Clear();
+        Buffer.Resize(PMM::PAGE_SIZE);
+
+        auto allocator = PMM::GetBuddyAllocator();
+        if (!allocator) return;
+
+        for (usize i = 0; i < BuddyAllocator::ZONE_COUNT; i++)
+        {
+            auto zone = static_cast<BuddyAllocator::Zone>(i);
+            Write("zone {:>6}", BuddyAllocator::ZoneName(zone));
+
+            for (usize order = 0; order <= BuddyAllocator::MAX_ORDER; order++)
+                Write(" {:>6}", allocator->FreeBlockCount(zone, order));
+            Write("\n");
+        }
+    }
+};
 struct ProcFsCmdLineProperty : public ProcFsProperty
 {
     virtual void GenerateRecord() override
@@ -45,6 +70,25 @@ struct ProcFsFilesystemsProperty : public ProcFsProperty
         //     Write("{} {}\n", physical ? "     " : "nodev", fs);
     }
 };
+struct ProcFsMemInfoProperty : public ProcFsProperty
+{
+    virtual void GenerateRecord() override
+    {
+        Buffer.Clear();
+        Buffer.Resize(PMM::PAGE_SIZE);
+
+        auto  cache      = PageCache::GetStatistics();
+        usize pageSizeKb = PMM::PAGE_SIZE / 1024;
+        Write("MemTotal:       {:>10} kB\n", PMM::GetTotalMemory() / 1024);
+        Write("MemFree:        {:>10} kB\n", PMM::GetFreeMemory() / 1024);
+        Write("Cached:         {:>10} kB\n", cache.Pages * pageSizeKb);
+        Write("CachedLimit:    {:>10} kB\n", cache.Limit * pageSizeKb);
+        Write("Dirty:          {:>10} kB\n", cache.Dirty * pageSizeKb);
+        Write("CacheHits:      {:>10}\n", cache.Hits);
+        Write("CacheMisses:    {:>10}\n", cache.Misses);
+        Write("CacheEvictions: {:>10}\n", cache.Evictions);
+    }
+};
 struct ProcFsModulesProperty : public ProcFsProperty
 {
     virtual void GenerateRecord() override
@@ -94,6 +138,46 @@ struct ProcFsPartitionsProperty : public ProcFsProperty
         }
     }
 };
+struct ProcFsSchedStatProperty : public ProcFsProperty
+{
+    virtual void GenerateRecord() override
+    {
+        Buffer.Clear();
+        Buffer.Resize(PMM::PAGE_SIZE);
+
+        Write("cpu\tqueued\tmigrations\tsteal_attempts\tsteals\tswitches\n");
+        for (usize cpuID = 0; cpuID < Scheduler::GetCPUCount(); cpuID++)
+        {
+            auto stats = Scheduler::GetStatistics(cpuID);
+            Write("{}\t{}\t{}\t{}\t{}\t{}\n", cpuID, stats.QueuedThreads,
+                  stats.Migrations, stats.StealAttempts, stats.Steals,
+                  stats.ContextSwitches);
+        }
+    }
+};
+struct ProcFsSlabInfoProperty : public ProcFsProperty
+{
+    virtual void GenerateRecord() override
+    {
+        Buffer.Clear();
+        Buffer.Resize(PMM::PAGE_SIZE);
+
+        Write("name\tactive\tcached\tobjsize\tobjperslab\tslabs\tallocs\t"
+              "frees\n");
+        for (usize i = 0; i < KernelHeap::SizeClassCount(); i++)
+        {
+            auto stats = KernelHeap::GetStatistics(i);
+            Write("kmalloc-{}\t{}\t{}\t{}\t{}\t{}\t{}\t{}\n",
+                  stats.ObjectSize, stats.ActiveObjects, stats.CachedObjects,
+                  stats.ObjectSize, stats.ObjectsPerSlab, stats.Slabs,
+                  stats.Allocations, stats.Frees);
+        }
+
+        auto large = KernelHeap::GetLargeObjectStatistics();
+        Write("kmalloc-large\t{}\t0\t{}\t1\t{}\t{}\t{}\n", large.Objects,
+              PMM::PAGE_SIZE, large.Pages, large.Allocations, large.Frees);
+    }
+};
 struct ProcFsUptimeProperty : public ProcFsProperty
 {
     virtual void GenerateRecord() override
@@ -130,10 +214,12 @@ struct ProcFsMemoryRegionsProperty : public ProcFsProperty
         auto process = Process::GetCurrent();
 
         Write("======================================================\n");
-        Write("Base\t\tLength\t\tPhys\t\tAccess\n");
+        Write("Base\t\tLength\t\tPhys\t\tResident\tAccess\n");
         for (const auto& [base, region] : process->AddressSpace())
-            Write("{:#x}\t\t{:#x}\t\t{:#x}\t\t{:#b}\n", base, region->Size(),
-                  region->PhysicalBase().Raw(), ToString(region->Access()));
+            Write("{:#x}\t\t{:#x}\t\t{:#x}\t\t{:#x}\t\t{:#b}\n", base,
+                  region->Size(), region->PhysicalBase().Raw(),
+                  region->ResidentPageCount() * PMM::PAGE_SIZE,
+                  ToString(region->Access()));
         Write("======================================================\n");
     }
 };
@@ -147,16 +233,24 @@ struct ProcFsStatusProperty : public ProcFsProperty
         if (!process) return;
 
         Write("Name: {}\n", process->Name());
+
+        auto& addressSpace = process->AddressSpace();
+        Write("VmSize: {} kB\n", addressSpace.VirtualSize() / 1024);
+        Write("VmRSS: {} kB\n", addressSpace.ResidentSize() / 1024);
     }
 };
 
 static constexpr ProcFsProperty* CreateProcFsProperty(StringView name)
 {
-    if (name == "cmdline"_sv) return new ProcFsCmdLineProperty();
+    if (name == "buddyinfo"_sv) return new ProcFsBuddyInfoProperty();
+    else if (name == "cmdline"_sv) return new ProcFsCmdLineProperty();
     else if (name == "filesystems"_sv) return new ProcFsFilesystemsProperty();
+    else if (name == "meminfo"_sv) return new ProcFsMemInfoProperty();
     else if (name == "modules"_sv) return new ProcFsModulesProperty();
     else if (name == "mounts"_sv) return new ProcFsMountsProperty();
     else if (name == "partitions"_sv) return new ProcFsPartitionsProperty();
+    else if (name == "schedstat"_sv) return new ProcFsSchedStatProperty();
+    else if (name == "slabinfo"_sv) return new ProcFsSlabInfoProperty();
     else if (name == "uptime"_sv) return new ProcFsUptimeProperty();
     else if (name == "version"_sv) return new ProcFsVersionProperty();
     else if (name == "vm_regions"_sv) return new ProcFsMemoryRegionsProperty;
@@ -220,11 +314,15 @@ ErrorOr<::Ref<DirectoryEntry>> ProcFs::Mount(StringView  sourcePath,
     m_Root = maybeRoot.Value();
     m_RootEntry->Bind(m_Root);
 
+    AddChild("buddyinfo");
     AddChild("cmdline");
     AddChild("filesystems");
+    AddChild("meminfo");
     AddChild("modules");
     AddChild("mounts");
     AddChild("partitions");
+    AddChild("schedstat");
+    AddChild("slabinfo");
     AddChild("uptime");
     AddChild("version");
     AddChild("vm_regions");
@@ -0,0 +1,149 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#include <Library/Locking/Semaphore.hpp>
+#include <Library/Locking/Spinlock.hpp>
+
+#include <Memory/PMM.hpp>
+
+#include <Prism/Containers/Deque.hpp>
+#include <Prism/Utility/Math.hpp>
+
+#include <Scheduler/Process.hpp>
+#include <Scheduler/Scheduler.hpp>
+
+#include <VFS/INode.hpp>
+#include <VFS/Readahead.hpp>
+
+namespace
+{
+    // Windows start at 16 KiB, and grow to 128 KiB, or 256 KiB when advised
+    // sequential
+    constexpr usize INITIAL_WINDOW     = 4;
+    constexpr usize MAX_WINDOW         = 32;
+    constexpr usize MAX_ADVISED_WINDOW = 64;
+    constexpr usize MAX_QUEUED         = 64;
+
+    struct Request
+    {
+        INode* Target = nullptr;
+        usize  Index  = 0;
+        usize  Count  = 0;
+    };
+
+    Spinlock       s_Lock;
+    Deque<Request> s_Queue;
+    usize          s_QueuedCount = 0;
+    Semaphore      s_Pending;
+
+    void           Worker()
+    {
+        for (;;)
+        {
+            s_Pending.Wait();
+
+            Request request;
+            {
+                ScopedLock guard(s_Lock, true);
+                if (s_Queue.Empty()) continue;
+
+                request = s_Queue.Front();
+                s_Queue.PopFront();
+                --s_QueuedCount;
+            }
+
+            request.Target->Prefetch(request.Index, request.Count);
+            request.Target->Release();
+        }
+    }
+}; // namespace
+
+void ReadaheadState::SetAdvice(ReadaheadAdvice advice)
+{
+    m_Advice     = advice;
+    m_WindowSize = 0;
+}
+
+void ReadaheadState::OnRead(INode* inode, usize offset, usize bytes)
+{
+    if (m_Advice == ReadaheadAdvice::eRandom || bytes == 0 || !inode
+        || !inode->UsesPageCache())
+        return;
+
+    // Nothing past the end of file is read ahead, clamping the read to it
+    // also keeps its last byte from wrapping around
+    usize size = inode->Size();
+    if (offset >= size) return;
+    bytes            = Math::Min(bytes, size - offset);
+
+    usize first      = offset / PMM::PAGE_SIZE;
+    usize last       = (offset + bytes - 1) / PMM::PAGE_SIZE;
+    bool  sequential = first == m_PreviousIndex || first == m_PreviousIndex + 1;
+    m_PreviousIndex  = last;
+
+    if (!sequential)
+    {
+        m_WindowSize = 0;
+        return;
+    }
+
+    usize maxWindow = m_Advice == ReadaheadAdvice::eSequential
+                        ? MAX_ADVISED_WINDOW
+                        : MAX_WINDOW;
+    usize windowEnd = m_WindowStart + m_WindowSize;
+    if (m_WindowSize == 0)
+    {
+        m_WindowStart = last + 1;
+        m_WindowSize  = m_Advice == ReadaheadAdvice::eSequential
+                          ? maxWindow / 2
+                          : INITIAL_WINDOW;
+    }
+    // The reader hasn't caught up with the window yet
+    else if (last < m_WindowStart) return;
+    else
+    {
+        m_WindowStart = Math::Max(windowEnd, last + 1);
+        m_WindowSize  = Math::Min(m_WindowSize * 2, maxWindow);
+    }
+
+    usize pageCount = Math::DivRoundUp(size, PMM::PAGE_SIZE);
+    if (m_WindowStart >= pageCount) return;
+
+    Readahead::Submit(inode, m_WindowStart,
+                      Math::Min(m_WindowSize, pageCount - m_WindowStart));
+}
+
+namespace Readahead
+{
+    void Initialize()
+    {
+        auto colonel = Scheduler::KernelProcess();
+        auto worker  = colonel->CreateThread(Worker, 0);
+        Scheduler::EnqueueThread(worker.Raw());
+    }
+
+    void Submit(INode* inode, usize index, usize count)
+    {
+        if (!inode || count == 0) return;
+
+        // The queued requests keep their inodes alive, until they're served
+        inode->Retain();
+        bool queued = false;
+        {
+            ScopedLock guard(s_Lock, true);
+            queued = s_QueuedCount < MAX_QUEUED;
+            if (queued)
+            {
+                s_Queue.PushBack({inode, index, count});
+                ++s_QueuedCount;
+            }
+        }
+
+        if (!queued) return inode->Release();
+
+        s_Pending.Signal();
+    }
+}; // namespace Readahead
@@ -0,0 +1,62 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#pragma once
+
+#include <Prism/Core/Types.hpp>
+
+class INode;
+
+// The access patterns, the readahead can be told about, see posix_fadvise
+enum class ReadaheadAdvice
+{
+    eNormal,
+    eRandom,
+    eSequential,
+};
+
+/**
+ * @brief Readahead state of an open file, the reads, which continue where the
+ * previous one ended, form a stream, whose window doubles on every hit, while
+ * any other read collapses it. Once the reader enters the window, which was
+ * prefetched last, the next one is queued, so that the I/O keeps running ahead
+ * of the reader
+ */
+class ReadaheadState
+{
+  public:
+    inline ReadaheadAdvice Advice() const { return m_Advice; }
+    void                   SetAdvice(ReadaheadAdvice advice);
+
+    /**
+     * @brief Called before the read of `bytes` at `offset` is served
+     */
+    void                   OnRead(INode* inode, usize offset, usize bytes);
+
+  private:
+    ReadaheadAdvice m_Advice        = ReadaheadAdvice::eNormal;
+
+    // Last page read, the reads starting on it, or right after it, are
+    // sequential, the first read of the file is too
+    usize           m_PreviousIndex = usize(-1);
+    // The window prefetched last, in pages, empty, while not streaming
+    usize           m_WindowStart   = 0;
+    usize           m_WindowSize    = 0;
+};
+
+namespace Readahead
+{
+    /**
+     * @brief Starts the readahead thread
+     */
+    void Initialize();
+
+    /**
+     * @brief Queues the prefetch of `count` pages of `inode` at `index`, the
+     * requests, which don't fit the queue, are dropped, as they are only hints
+     */
+    void Submit(INode* inode, usize index, usize count);
+}; // namespace Readahead
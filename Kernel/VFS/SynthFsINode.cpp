@@ -1,13 +1,20 @@
 /*
  * Created by v1tr10l7 on 28.03.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
+#include <Memory/PMM.hpp>
+
+#include <Prism/Containers/Vector.hpp>
+#include <Prism/Memory/Memory.hpp>
+#include <Prism/Utility/Math.hpp>
+
 #include <Scheduler/Process.hpp>
 #include <Time/Time.hpp>
 
 #include <VFS/Filesystem.hpp>
+#include <VFS/PageCache.hpp>
 #include <VFS/SynthFsINode.hpp>
 
 SynthFsINode::SynthFsINode(StringView name, class Filesystem* fs, INodeID id,
@@ -16,8 +23,9 @@ SynthFsINode::SynthFsINode(StringView name, class Filesystem* fs, INodeID id,
 {
     m_Metadata.ID           = id;
     m_Metadata.Mode         = mode;
-    // Every directory has at least two entries: '.' and '..'
-    m_Metadata.Size         = IsDirectory() ?: DIRECTORY_ENTRY_SIZE * 2;
+    // Every directory has at least two entries: '.' and '..', new files are
+    // empty
+    m_Metadata.Size         = IsDirectory() ? DIRECTORY_ENTRY_SIZE * 2 : 0;
     m_Metadata.LinkCount    = 1 + IsDirectory();
 
     m_Metadata.BlockSize    = PMM::PAGE_SIZE;
@@ -38,6 +46,11 @@ SynthFsINode::SynthFsINode(StringView name, class Filesystem* fs, INodeID id,
     m_Metadata.ModificationTime = Time::GetReal();
     m_Metadata.ChangeTime       = Time::GetReal();
 }
+SynthFsINode::~SynthFsINode()
+{
+    FreePages(0);
+    ReturnBorrowed();
+}
 
 ErrorOr<void>
 SynthFsINode::TraverseDirectories(Ref<class DirectoryEntry> parent,
@@ -81,12 +94,6 @@ ErrorOr<Ref<DirectoryEntry>> SynthFsINode::CreateNode(Ref<DirectoryEntry> entry,
         TryOrRet(m_Filesystem->AllocateNode(entry->Name(), mode)));
 
     inode->m_Parent = this;
-    if (S_ISREG(mode))
-    {
-        inode->m_Metadata.Size = inode->GetDefaultSize();
-        inode->m_Buffer.Resize(GetDefaultSize());
-    }
-
     inode->m_Metadata.DeviceID = dev;
     m_Metadata.Size += DIRECTORY_ENTRY_SIZE;
 
@@ -161,10 +168,35 @@ isize SynthFsINode::Read(void* buffer, off_t offset, usize bytes)
     Assert(offset >= 0);
 
     ScopedLock guard(m_Lock);
-    bytes = Min(bytes, m_Buffer.Size() - offset);
+    usize      size = m_Metadata.Size;
+    if (static_cast<usize>(offset) >= size) return 0;
+    bytes = Min(bytes, size - offset);
 
     if (m_Filesystem->ShouldUpdateATime()) UpdateTimestamps(Time::GetReal());
-    m_Buffer.Read(offset, reinterpret_cast<Byte*>(buffer), bytes);
+
+    auto out = reinterpret_cast<u8*>(buffer);
+    for (usize done = 0; done < bytes;)
+    {
+        usize   position   = offset + done;
+        usize   pageOffset = position % PMM::PAGE_SIZE;
+        usize   chunk      = Min(PMM::PAGE_SIZE - pageOffset, bytes - done);
+
+        Pointer page       = PageAt(position / PMM::PAGE_SIZE, false);
+        if (page)
+            Memory::Copy(out + done, page.ToHigherHalf<u8*>() + pageOffset,
+                         chunk);
+        else if (position < m_BorrowedSize)
+        {
+            usize borrowed = Min(chunk, m_BorrowedSize - position);
+            Memory::Copy(out + done,
+                         m_Borrowed.Offset(position).ToHigherHalf<u8*>(),
+                         borrowed);
+            Memory::Fill(out + done + borrowed, 0, chunk - borrowed);
+        }
+        else Memory::Fill(out + done, 0, chunk);
+
+        done += chunk;
+    }
 
     return bytes;
 }
@@ -175,28 +207,54 @@ isize SynthFsINode::Write(const void* buffer, off_t offset, usize bytes)
 
     ScopedLock guard(m_Lock);
 
-    usize      newCapacity = m_Buffer.Size() ?: PMM::PAGE_SIZE;
-    while (offset + bytes > newCapacity) newCapacity *= 2;
-
-    ResizeBuffer(newCapacity);
+    auto       in   = reinterpret_cast<const u8*>(buffer);
+    usize      done = 0;
+    while (done < bytes)
+    {
+        usize   position   = offset + done;
+        usize   pageOffset = position % PMM::PAGE_SIZE;
+        usize   chunk      = Min(PMM::PAGE_SIZE - pageOffset, bytes - done);
+
+        Pointer page       = PageAt(position / PMM::PAGE_SIZE, true);
+        if (!page)
+        {
+            // We've ran out of space
+            if (done > 0) break;
+            return -1;
+        }
+
+        Memory::Copy(page.ToHigherHalf<u8*>() + pageOffset, in + done, chunk);
+        done += chunk;
+    }
 
-    // TODO(v1tr10l7): Handle filesystem memory limits
-    m_Buffer.Write(offset, reinterpret_cast<const Byte*>(buffer), bytes);
+    if (offset + done > m_Metadata.Size) m_Metadata.Size = offset + done;
     auto currentTime = Time::GetReal();
     if (m_Filesystem->ShouldUpdateATime())
         UpdateTimestamps(currentTime, currentTime);
 
-    return bytes;
+    return done;
 }
 ErrorOr<Path>  SynthFsINode::ReadLink() { return m_Target; }
 
 ErrorOr<isize> SynthFsINode::Truncate(usize size)
 {
     ScopedLock guard(m_Lock);
-    if (size == m_Buffer.Size()) return 0;
+    if (size == m_Metadata.Size) return 0;
 
-    RetOnError(ResizeBuffer(size));
-    m_Buffer.ShrinkToFit();
+    // Growing leaves a hole. Shrinking frees the pages past the end, and zeroes
+    // the last one's tail
+    if (size < m_Metadata.Size)
+    {
+        FreePages(Math::DivRoundUp(size, PMM::PAGE_SIZE));
+        m_BorrowedSize = Min(m_BorrowedSize, size);
+        if (m_BorrowedSize == 0) ReturnBorrowed();
+
+        usize tail = size % PMM::PAGE_SIZE;
+        if (Pointer last = PageAt(size / PMM::PAGE_SIZE, false); tail && last)
+            Memory::Fill(last.ToHigherHalf<u8*>() + tail, 0,
+                         PMM::PAGE_SIZE - tail);
+    }
+    m_Metadata.Size = size;
 
     auto currentTime = Time::GetReal();
     auto atime = m_Filesystem->ShouldUpdateATime() ? currentTime : timespec{};
@@ -238,7 +296,7 @@ ErrorOr<void> SynthFsINode::Unlink(Ref<DirectoryEntry> entry)
     if (inodeLinkCount == 0 + inode->IsDirectory())
     {
         m_Children.Erase(it);
-        IgnoreUnused(m_Filesystem->FreeINode(inode));
+        inode->Release();
     }
 
     auto parent = entry->Parent();
@@ -259,11 +317,112 @@ ErrorOr<void> SynthFsINode::RmDir(Ref<DirectoryEntry> entry)
     return Unlink(entry);
 }
 
-ErrorOr<void> SynthFsINode::ResizeBuffer(usize newSize)
+Pointer SynthFsINode::CachedPage(usize index, bool write)
 {
-    m_Buffer.Resize(newSize);
-    m_Metadata.Size       = m_Buffer.Size();
-    m_Metadata.BlockCount = Math::DivRoundUp(newSize, 512);
+    if (!IsRegular()) return INode::CachedPage(index, write);
 
-    return {};
+    // Mappings share the file's own pages, holes only read map the zero page
+    ScopedLock guard(m_Lock);
+    usize      position = index * PMM::PAGE_SIZE;
+    if (position >= m_Metadata.Size) return_err(nullptr, ENXIO);
+
+    bool    hole = position >= m_BorrowedSize;
+    Pointer page = PageAt(index, write || !hole);
+    if (!page && !write && hole) page = PMM::ZeroPage();
+    if (page) PMM::ReferencePage(page);
+
+    return page;
+}
+bool SynthFsINode::BorrowData(Pointer data, usize size)
+{
+    ScopedLock guard(m_Lock);
+    if (!IsRegular() || !m_Pages.Empty() || m_BorrowedSpan || size == 0)
+        return false;
+
+    usize first = Math::AlignDown(data.Raw(), PMM::PAGE_SIZE);
+    usize last  = Math::AlignUp(data.Raw() + size, PMM::PAGE_SIZE);
+    for (usize page = first; page < last; page += PMM::PAGE_SIZE)
+        PMM::ReferencePage(Pointer(page));
+
+    m_Borrowed      = data;
+    m_BorrowedSize  = size;
+    m_BorrowedSpan  = size;
+    m_Metadata.Size = size;
+
+    return true;
+}
+
+Pointer SynthFsINode::PageAt(usize index, bool allocate)
+{
+    void* page = m_Pages.Find(index);
+    if (page || !allocate) return Pointer(page);
+
+    if (!ChargePages(1)) return_err(nullptr, ENOSPC);
+
+    // Borrowed pages holding only our data are taken over, others are copied
+    usize   position = index * PMM::PAGE_SIZE;
+    Pointer source   = m_Borrowed.Offset(position);
+    usize   borrowed = position < m_BorrowedSize
+                         ? Min(PMM::PAGE_SIZE, m_BorrowedSize - position)
+                         : 0;
+    Pointer fresh    = nullptr;
+    if (borrowed == PMM::PAGE_SIZE && source.Raw() % PMM::PAGE_SIZE == 0)
+    {
+        fresh = source;
+        PMM::ReferencePage(fresh);
+    }
+    else
+    {
+        fresh = PageCache::AllocatePage();
+        if (!fresh)
+        {
+            UnchargePages(1);
+            return_err(nullptr, ENOMEM);
+        }
+
+        auto data = fresh.ToHigherHalf<u8*>();
+        if (borrowed) Memory::Copy(data, source.ToHigherHalf<u8*>(), borrowed);
+        Memory::Fill(data + borrowed, 0, PMM::PAGE_SIZE - borrowed);
+    }
+
+    if (!m_Pages.Insert(index, reinterpret_cast<void*>(fresh.Raw())))
+    {
+        PMM::ReleasePage(fresh);
+        UnchargePages(1);
+        return_err(nullptr, ENOMEM);
+    }
+
+    m_Metadata.BlockCount += PMM::PAGE_SIZE / 512;
+    return fresh;
+}
+void SynthFsINode::FreePages(usize index)
+{
+    Vector<usize> released;
+    m_Pages.ForEach(
+        [&](usize pageIndex, void*)
+        {
+            if (pageIndex >= index) released.PushBack(pageIndex);
+        });
+    if (released.Empty()) return;
+
+    // Pages still mapped somewhere stay alive until their last mapping is gone
+    for (usize pageIndex : released)
+        PMM::ReleasePage(Pointer(m_Pages.Erase(pageIndex)));
+
+    UnchargePages(released.Size());
+    m_Metadata.BlockCount -= released.Size() * (PMM::PAGE_SIZE / 512);
+}
+void SynthFsINode::ReturnBorrowed()
+{
+    if (!m_BorrowedSpan) return;
+
+    usize first = Math::AlignDown(m_Borrowed.Raw(), PMM::PAGE_SIZE);
+    usize last
+        = Math::AlignUp(m_Borrowed.Raw() + m_BorrowedSpan, PMM::PAGE_SIZE);
+    for (usize page = first; page < last; page += PMM::PAGE_SIZE)
+        PMM::ReleasePage(Pointer(page));
+
+    m_Borrowed     = nullptr;
+    m_BorrowedSize = 0;
+    m_BorrowedSpan = 0;
 }
@@ -1,12 +1,12 @@
 /*
  * Created by v1tr10l7 on 28.03.2025.
- * Copyright (c) 2024-2025, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
 #pragma once
 
-#include <Prism/Memory/Buffer.hpp>
+#include <Library/RadixTree.hpp>
 
 #include <VFS/INode.hpp>
 
@@ -15,7 +15,7 @@ class SynthFsINode : public INode
   public:
     SynthFsINode(StringView name, class Filesystem* fs, INodeID id,
                  INodeMode mode);
-    virtual ~SynthFsINode() = default;
+    virtual ~SynthFsINode();
 
     virtual ErrorOr<void>
     TraverseDirectories(Ref<class DirectoryEntry> parent,
@@ -24,8 +24,6 @@ class SynthFsINode : public INode
     virtual ErrorOr<Ref<DirectoryEntry>>
                                   Lookup(Ref<DirectoryEntry> dentry) override;
 
-    inline static constexpr usize GetDefaultSize() { return 0x1000; }
-
     virtual const UnorderedMap<StringView, INode*>& Children() const
     {
         return m_Children;
@@ -48,6 +46,8 @@ class SynthFsINode : public INode
     virtual ErrorOr<Path>  ReadLink() override;
 
     virtual ErrorOr<isize> Truncate(usize size) override;
+    virtual Pointer CachedPage(usize index, bool write = false) override;
+    virtual bool           BorrowData(Pointer data, usize size) override;
     virtual ErrorOr<void> Rename(INode* newParent, StringView newName) override;
 
     virtual ErrorOr<void> Unlink(Ref<DirectoryEntry> entry) override;
@@ -62,9 +62,33 @@ class SynthFsINode : public INode
   protected:
     inline static constexpr usize    DIRECTORY_ENTRY_SIZE = 20;
 
-    Buffer                           m_Buffer;
+    // Regular file contents, in pages indexed by file offset, holes have no
+    // pages
+    RadixTree<void>                  m_Pages;
+    // The memory, which the pages, that weren't written to yet, are read
+    // from, m_BorrowedSize shrinks along with the file, while m_BorrowedSpan
+    // is what we hold the references to
+    Pointer                          m_Borrowed     = nullptr;
+    usize                            m_BorrowedSize = 0;
+    usize                            m_BorrowedSpan = 0;
     UnorderedMap<StringView, INode*> m_Children;
     String                           m_Target = ""_s;
 
-    ErrorOr<void>                    ResizeBuffer(usize newSize);
+    /**
+     * @brief Accounts for `count` more pages of file data, filesystems with a
+     * size limit refuse to go past it
+     */
+    virtual bool                     ChargePages(usize count) { return true; }
+    virtual void                     UnchargePages(usize count) {}
+
+    /**
+     * @brief Looks up the page at `index`, the holes are filled with a zeroed
+     * page, if `allocate` is set, the caller holds m_Lock
+     */
+    Pointer                          PageAt(usize index, bool allocate);
+    /**
+     * @brief Releases the pages from `index` onwards
+     */
+    void                             FreePages(usize index);
+    void                             ReturnBorrowed();
 };
@@ -1,10 +1,13 @@
 /*
  * Created by v1tr10l7 on 19.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
+#include <API/Posix/sys/mount.h>
 #include <Memory/PMM.hpp>
+#include <Prism/String/StringUtils.hpp>
+#include <Prism/Utility/Math.hpp>
 #include <System/Limits.hpp>
 #include <Time/Time.hpp>
 
@@ -16,6 +19,40 @@
 
 using namespace System;
 
+namespace
+{
+    // Parses a number with an optional k, m, or g suffix
+    bool ParseSize(StringView value, usize& result)
+    {
+        usize number = 0, i = 0;
+        for (; i < value.Size() && value[i] >= '0' && value[i] <= '9'; ++i)
+        {
+            usize digit = value[i] - '0';
+            if (number > (usize(-1) - digit) / 10) return false;
+            number = number * 10 + digit;
+        }
+        if (i == 0 || i + 1 < value.Size()) return false;
+
+        if (i < value.Size())
+        {
+            usize shift = 0;
+            switch (value[i] | 0x20)
+            {
+                case 'k': shift = 10; break;
+                case 'm': shift = 20; break;
+                case 'g': shift = 30; break;
+                default: return false;
+            }
+
+            if (number > usize(-1) >> shift) return false;
+            number <<= shift;
+        }
+
+        result = number;
+        return true;
+    }
+}; // namespace
+
 TmpFs::TmpFs(u32 flags)
     : Filesystem("TmpFs", flags)
     , m_MaxINodeCount(0)
@@ -31,13 +68,14 @@ ErrorOr<::Ref<DirectoryEntry>> TmpFs::Mount(StringView  sourcePath,
     m_BlockSize          = PMM::PAGE_SIZE;
     m_BytesLimit         = PMM::GetTotalMemory() / 2;
 
-    m_MaxBlockCount      = 64_kib;
+    m_MaxBlockCount      = PMM::GetTotalMemory() / PMM::PAGE_SIZE / 2;
     m_UsedBlockCount     = 0;
 
     m_MaxINodeCount      = PMM::GetTotalMemory() / PMM::PAGE_SIZE / 2;
     m_FreeINodeCount     = m_MaxINodeCount;
 
     m_MaxSize            = PMM::GetTotalMemory() / 2;
+    ParseMountOptions(static_cast<const char*>(data));
 
     m_RootEntry          = CreateRef<DirectoryEntry>(nullptr, "/");
     m_Root               = TryOrRet(AllocateNode("/", 0644 | S_IFDIR));
@@ -72,6 +110,66 @@ ErrorOr<void> TmpFs::FreeINode(INode* inode)
     return {};
 }
 
+bool TmpFs::ChargePages(usize count)
+{
+    ScopedLock guard(m_Lock);
+    if (m_UsedBlockCount + count > m_MaxBlockCount) return false;
+
+    m_UsedBlockCount += count;
+    return true;
+}
+void TmpFs::UnchargePages(usize count)
+{
+    ScopedLock guard(m_Lock);
+    m_UsedBlockCount -= Math::Min(count, m_UsedBlockCount);
+}
+
+void TmpFs::ParseMountOptions(const char* options)
+{
+    StringView remaining = options ? StringView(options) : ""_sv;
+    while (remaining.Size() > 0)
+    {
+        usize comma = remaining.Find(',');
+        if (comma == StringView::NPos) comma = remaining.Size();
+
+        StringView option = remaining.Substr(0, comma);
+        remaining = comma < remaining.Size() ? remaining.Substr(comma + 1)
+                                             : ""_sv;
+
+        usize      equals = option.Find('=');
+        StringView name
+            = equals == StringView::NPos ? option : option.Substr(0, equals);
+        StringView value
+            = equals == StringView::NPos ? ""_sv : option.Substr(equals + 1);
+
+        // Percentages above 100 are rejected, which also keeps the product
+        // below from overflowing
+        usize number = 0;
+        if (name == "size"_sv && value.Size() > 1
+            && value[value.Size() - 1] == '%'
+            && ParseSize(value.Substr(0, value.Size() - 1), number)
+            && number <= 100)
+            m_MaxBlockCount
+                = PMM::GetTotalMemory() / PMM::PAGE_SIZE * number / 100;
+        else if (name == "size"_sv && ParseSize(value, number))
+            m_MaxBlockCount = Math::DivRoundUp(number, PMM::PAGE_SIZE);
+        else if (name == "nr_inodes"_sv && ParseSize(value, number))
+        {
+            m_MaxINodeCount  = number;
+            m_FreeINodeCount = number;
+        }
+        else if (option.Size() > 0)
+            LogWarn("TmpFs: Ignoring unknown mount option: '{}'", option);
+    }
+
+    m_MaxSize      = m_MaxBlockCount * PMM::PAGE_SIZE;
+    m_MountOptions = m_Flags & MS_RDONLY ? "ro" : "rw";
+    m_MountOptions += ",size=";
+    m_MountOptions += StringUtils::ToString(m_MaxSize >> 10);
+    m_MountOptions += "k,nr_inodes=";
+    m_MountOptions += StringUtils::ToString(m_MaxINodeCount);
+}
+
 ErrorOr<void> TmpFs::Stats(statfs& stats)
 {
     Memory::Fill(&stats, 0, sizeof(statfs));
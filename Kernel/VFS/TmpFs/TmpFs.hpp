@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 19.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -27,18 +27,30 @@ class TmpFs : public Filesystem
                                          INodeMode  mode) override;
     virtual ErrorOr<void>   FreeINode(INode* inode) override;
 
+    virtual StringView MountFlagsString() const override
+    {
+        return m_MountOptions;
+    }
+
     virtual bool Populate(DirectoryEntry* dentry) override { return true; }
+    virtual bool CachesLookups() const override { return true; }
     virtual ErrorOr<void> Stats(statfs& stats) override;
     constexpr usize       FreeINodeCount() const { return m_FreeINodeCount; }
 
   private:
+    // Pages of file data, which may be allocated, i.e. the size= option
     usize         m_MaxBlockCount  = 0;
-    Atomic<usize> m_UsedBlockCount = 0;
+    usize         m_UsedBlockCount = 0;
     usize         m_MaxINodeCount  = 0;
     Atomic<usize> m_FreeINodeCount = PMM::PAGE_SIZE << 2;
     usize         m_MaxSize        = 0;
 
     usize         m_Size           = 0;
+    String        m_MountOptions;
+
+    bool          ChargePages(usize count);
+    void          UnchargePages(usize count);
+    void          ParseMountOptions(const char* options);
 
     friend class TmpFsINode;
 };
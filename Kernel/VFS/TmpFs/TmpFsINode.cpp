@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 19.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -18,3 +18,17 @@ TmpFsINode::TmpFsINode(StringView name, class Filesystem* fs, INodeID id,
     : SynthFsINode(name, fs, id, mode)
 {
 }
+TmpFsINode::~TmpFsINode()
+{
+    // Released here, the base class can't return them to the filesystem limit
+    FreePages(0);
+}
+
+bool TmpFsINode::ChargePages(usize count)
+{
+    return reinterpret_cast<TmpFs*>(m_Filesystem)->ChargePages(count);
+}
+void TmpFsINode::UnchargePages(usize count)
+{
+    reinterpret_cast<TmpFs*>(m_Filesystem)->UnchargePages(count);
+}
@@ -1,13 +1,12 @@
 /*
  * Created by v1tr10l7 on 19.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
 #pragma once
 
 #include <Library/Logger.hpp>
-#include <Prism/Memory/Buffer.hpp>
 
 #include <VFS/DirectoryEntry.hpp>
 #include <VFS/SynthFsINode.hpp>
@@ -27,6 +26,11 @@ class TmpFsINode final : public SynthFsINode
   public:
     TmpFsINode(StringView name, class Filesystem* fs, INodeID id,
                INodeMode mode);
+    virtual ~TmpFsINode();
+
+  protected:
+    virtual bool ChargePages(usize count) override;
+    virtual void UnchargePages(usize count) override;
 
   private:
     friend class TmpFs;
@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 19.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -8,6 +8,7 @@
 #include <Arch/CPU.hpp>
 
 #include <Drivers/Core/DeviceManager.hpp>
+#include <Drivers/Storage/WriteBack.hpp>
 
 #include <Library/Locking/Spinlock.hpp>
 #include <Library/Locking/SpinlockProtected.hpp>
@@ -23,6 +24,7 @@
 #include <VFS/INode.hpp>
 #include <VFS/Initrd/Initrd.hpp>
 #include <VFS/MountPoint.hpp>
+#include <VFS/PathCache.hpp>
 #include <VFS/PathResolver.hpp>
 #include <VFS/ProcFs/ProcFs.hpp>
 #include <VFS/TmpFs/TmpFs.hpp>
@@ -309,9 +311,11 @@ namespace VFS
     {
         if (!parent || path.Absolute()) parent = RootDirectoryEntry();
         PathResolution res = {nullptr, nullptr, ""_sv};
+        if (PathCache::Lookup(parent, path, followLinks, res)) return res;
 
-        PathResolver   resolver(parent, path);
-        auto           resolutionResult = resolver.Resolve(followLinks);
+        u64          generation = PathCache::Generation();
+        PathResolver resolver(parent, path);
+        auto         resolutionResult = resolver.Resolve(followLinks);
         CtosUnused(resolutionResult);
 
         auto parentEntry = resolver.ParentEntry();
@@ -322,6 +326,7 @@ namespace VFS
         res.Entry    = entry;
         res.BaseName = resolver.BaseName();
 
+        PathCache::Insert(parent, path, followLinks, res, generation);
         return res;
     }
     ErrorOr<Ref<DirectoryEntry>> ResolveParent(Ref<DirectoryEntry> parent,
@@ -349,7 +354,6 @@ namespace VFS
         return TryOrRet(Mount(nullptr, ""_pv, "/"_pv, filesystemName));
     }
 
-    // TODO: flags
     ErrorOr<Ref<MountPoint>> Mount(Ref<DirectoryEntry> parent,
                                    PathView sourcePath, PathView target,
                                    StringView fsName, i32 flags,
@@ -357,6 +361,7 @@ namespace VFS
     {
         Ref<Filesystem> fs = TryOrRet(InstantiateFilesystem(fsName));
         if (target.Empty()) return Error(EINVAL);
+        fs->SetFlags(flags);
 
         PathResolver targetResolver(parent, target);
         auto         targetEntry = TryOrRet(targetResolver.Resolve(
@@ -384,6 +389,7 @@ namespace VFS
 
         fsRoot->SetParent(targetEntry);
         targetEntry->SetMountGate(fsRoot);
+        PathCache::Invalidate();
 
         if (sourcePath.Empty())
             LogTrace("VFS: Mounted Filesystem '{}' on '{}'", fsName, target);
@@ -402,19 +408,22 @@ namespace VFS
         return false;
     }
 
-    ErrorOr<void> Sync()
+    ErrorOr<void> Sync(bool force)
     {
         MountPoint::Iterator iterator;
         iterator.BindLambda(
-            [](Ref<MountPoint> mount) -> bool
+            [force](Ref<MountPoint> mount) -> bool
             {
                 auto fs = mount->Filesystem();
-                fs->Sync();
+                fs->Sync(force);
 
                 return true;
             });
 
         MountPoint::Iterate(iterator);
+
+        // The devices, which were written to directly, have to be synced too
+        WriteBack::SyncAll();
         return {};
     }
 
@@ -1,6 +1,6 @@
 /*
  * Created by v1tr10l7 on 19.11.2024.
- * Copyright (c) 2024-2024, Szymon Zemke <v1tr10l7@proton.me>
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
  *
  * SPDX-License-Identifier: GPL-3
  */
@@ -60,7 +60,7 @@ namespace VFS
                                    i32 flags = 0, const void* data = nullptr);
     bool Unmount(Ref<DirectoryEntry> parent, PathView path, i32 flags = 0);
 
-    ErrorOr<void>                Sync();
+    ErrorOr<void>                Sync(bool force = false);
 
     ErrorOr<Ref<DirectoryEntry>> CreateNode(Ref<DirectoryEntry> parent,
                                             StringView name, mode_t mode,
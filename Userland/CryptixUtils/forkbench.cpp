@@ -0,0 +1,101 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures fork latency of a process with a growing amount of resident,
+// anonymous memory, optionally having the child write to every page, which
+// shows the cost of breaking the copy-on-write sharing
+//
+// usage: forkbench [-w] [iterations]
+
+constexpr size_t MIB          = 1024 * 1024;
+constexpr size_t PAGE_SIZE    = 4096;
+constexpr size_t SIZES_MIB[]  = {16, 64, 256, 1024};
+
+static uint64_t  Now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return static_cast<uint64_t>(ts.tv_sec) * 1'000'000'000ull + ts.tv_nsec;
+}
+
+static bool Measure(size_t size, bool touch, int iterations)
+{
+    auto memory = static_cast<char*>(mmap(nullptr, size,
+                                          PROT_READ | PROT_WRITE,
+                                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (memory == MAP_FAILED)
+    {
+        perror("forkbench: mmap");
+        return false;
+    }
+    memset(memory, 0xaa, size);
+
+    uint64_t forkTotal = 0;
+    uint64_t waitTotal = 0;
+    for (int i = 0; i < iterations; i++)
+    {
+        uint64_t start = Now();
+        pid_t    pid   = fork();
+        if (pid < 0)
+        {
+            perror("forkbench: fork");
+            munmap(memory, size);
+            return false;
+        }
+        if (pid == 0)
+        {
+            if (touch)
+                for (size_t offset = 0; offset < size; offset += PAGE_SIZE)
+                    memory[offset] = 0x55;
+            _exit(0);
+        }
+
+        uint64_t forked = Now();
+        int      status = 0;
+        waitpid(pid, &status, 0);
+        uint64_t end = Now();
+
+        forkTotal += forked - start;
+        waitTotal += end - start;
+    }
+
+    printf("%6zu MiB: fork() %10llu ns, fork() + exit %12llu ns\n", size / MIB,
+           static_cast<unsigned long long>(forkTotal / iterations),
+           static_cast<unsigned long long>(waitTotal / iterations));
+
+    munmap(memory, size);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    bool touch      = false;
+    int  iterations = 10;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-w") == 0) touch = true;
+        else iterations = atoi(argv[i]);
+    }
+    if (iterations <= 0) iterations = 1;
+
+    printf("forkbench: %d iterations, the child %s\n", iterations,
+           touch ? "writes to every page" : "exits immediately");
+    for (size_t sizeMib : SIZES_MIB)
+        if (!Measure(sizeMib * MIB, touch, iterations)) return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,66 @@
+/*
+ * Created by v1tr10l7 on 16.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures the round trip latency of the cheapest syscalls, getpid, which
+// does nothing but the dispatch, and a 1 byte read, which also goes through
+// the file descriptor table, and the VFS
+//
+// usage: syscallbench [iterations]
+
+static uint64_t Now()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return static_cast<uint64_t>(ts.tv_sec) * 1'000'000'000ull + ts.tv_nsec;
+}
+
+template <typename Func>
+static void Measure(const char* name, long iterations, Func func)
+{
+    // Warm up the caches, and the TLB first
+    for (long i = 0; i < iterations / 10; i++) func();
+
+    uint64_t start = Now();
+    for (long i = 0; i < iterations; i++) func();
+    uint64_t elapsed = Now() - start;
+
+    printf("%-12s %8llu ns/call (%ld calls)\n", name,
+           static_cast<unsigned long long>(elapsed / iterations), iterations);
+}
+
+int main(int argc, char** argv)
+{
+    long iterations = argc > 1 ? atol(argv[1]) : 1'000'000;
+    if (iterations <= 0) iterations = 1;
+
+    int fd = open("/dev/zero", O_RDONLY);
+    if (fd < 0)
+    {
+        perror("syscallbench: open");
+        return EXIT_FAILURE;
+    }
+
+    // NOTE: libc might cache the pid, so the syscall is issued directly
+    Measure("getpid", iterations, []() { syscall(SYS_getpid); });
+    Measure("read(1)", iterations,
+            [fd]()
+            {
+                char c;
+                if (read(fd, &c, 1) != 1) perror("syscallbench: read");
+            });
+
+    close(fd);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,75 @@
+/*
+ * Created by v1tr10l7 on 17.10.2026.
+ * Copyright (c) 2024-2026, Szymon Zemke <v1tr10l7@proton.me>
+ *
+ * SPDX-License-Identifier: GPL-3
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Checks, that files created on a tmpfs start out empty, and that their size
+// follows what was written to them
+//
+// usage: tmpfscheck [directory]
+
+static bool ExpectSize(int fd, off_t expected, const char* what)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+    {
+        perror("tmpfscheck: fstat");
+        return false;
+    }
+    if (st.st_size == expected) return true;
+
+    fprintf(stderr, "tmpfscheck: %s: st_size is %lld, expected %lld\n", what,
+            static_cast<long long>(st.st_size),
+            static_cast<long long>(expected));
+    return false;
+}
+
+int main(int argc, char** argv)
+{
+    const char* directory = argc > 1 ? argv[1] : "/tmp";
+    char        path[256];
+    snprintf(path, sizeof(path), "%s/tmpfscheck.%d", directory, getpid());
+
+    int fd = open(path, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        perror("tmpfscheck: open");
+        return EXIT_FAILURE;
+    }
+
+    bool        ok      = ExpectSize(fd, 0, "new file");
+
+    const char  data[]  = "x\n";
+    const off_t written = sizeof(data) - 1;
+    if (write(fd, data, written) != written)
+    {
+        perror("tmpfscheck: write");
+        ok = false;
+    }
+    ok = ExpectSize(fd, written, "after a short write") && ok;
+
+    char buffer[64];
+    if (pread(fd, buffer, sizeof(buffer), 0) != written
+        || memcmp(buffer, data, written) != 0)
+    {
+        fprintf(stderr, "tmpfscheck: the data read back differs\n");
+        ok = false;
+    }
+
+    if (ftruncate(fd, 0) < 0) perror("tmpfscheck: ftruncate");
+    ok = ExpectSize(fd, 0, "after truncating") && ok;
+
+    close(fd);
+    unlink(path);
+
+    printf("tmpfscheck: %s\n", ok ? "passed" : "FAILED");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}